@@ -186,6 +186,8 @@ void print_tree(bx_param_c *node, int level = 0);
 #define BX_RAISE_INTR()             bx_pc_system.raise_INTR()
 #define BX_CLEAR_INTR()             bx_pc_system.clear_INTR()
 #define BX_HRQ                      bx_pc_system.HRQ
+#define BX_LOCK_DEVICES()           bx_pc_system.lock_devices()
+#define BX_UNLOCK_DEVICES()         bx_pc_system.unlock_devices()
 
 #if BX_SUPPORT_SMP
 #define BX_CPU(x)                   (bx_cpu_array[x])
@@ -425,6 +427,8 @@ BOCHSAPI_MSVCONLY void bx_show_ips_handler(void);
 #endif
 void CDECL bx_signal_handler(int signum);
 int bx_atexit(void);
+void bx_sr_before_save_state(void);
+void bx_sr_after_restore_state(void);
 BOCHSAPI extern bx_debug_t bx_dbg;
 
 #if BX_SUPPORT_APIC
@@ -1831,6 +1831,7 @@ one_more:
       BX_TICKN(max_executed);
     }
 #endif
+    bx_pc_system.handle_snapshot_request();
   }
 
   sim_running->set(0);
@@ -1869,6 +1870,7 @@ void bx_dbg_stepN_command(int cpu, Bit32u count)
     bx_guard.interrupt_requested = 0;
     bx_dbg_set_icount_guard(cpu, count);
     BX_CPU(cpu)->cpu_loop();
+    bx_pc_system.handle_snapshot_request();
   }
 #if BX_SUPPORT_SMP
   else {
@@ -1888,6 +1890,7 @@ void bx_dbg_stepN_command(int cpu, Bit32u count)
 
       // when (BX_SMP_PROCESSORS == 1) ticks are handled inside the cpu loop
       BX_TICK1();
+      bx_pc_system.handle_snapshot_request();
     }
   }
 #endif
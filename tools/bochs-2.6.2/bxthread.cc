@@ -0,0 +1,105 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2013  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include "bochs.h"
+#include "bxthread.h"
+
+#if BX_HAVE_THREADS
+
+#ifndef WIN32
+void bx_init_recursive_mutex(pthread_mutex_t *mutex)
+{
+  pthread_mutexattr_t attr;
+
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(mutex, &attr);
+  pthread_mutexattr_destroy(&attr);
+}
+#endif
+
+void bx_thread_join(BX_THREAD_ID(id))
+{
+#ifdef WIN32
+  HANDLE handle = OpenThread(SYNCHRONIZE, FALSE, id);
+  if (handle != NULL) {
+    WaitForSingleObject(handle, INFINITE);
+    CloseHandle(handle);
+  }
+#else
+  pthread_join(id, NULL);
+#endif
+}
+
+bx_bool bx_create_sem(bx_thread_sem_t *sem)
+{
+#ifdef WIN32
+  sem->handle = CreateSemaphore(NULL, 0, 0x7fffffff, NULL);
+  return (sem->handle != NULL);
+#else
+  sem->count = 0;
+  if (pthread_mutex_init(&sem->mutex, NULL) != 0)
+    return 0;
+  if (pthread_cond_init(&sem->cond, NULL) != 0) {
+    pthread_mutex_destroy(&sem->mutex);
+    return 0;
+  }
+  return 1;
+#endif
+}
+
+void bx_destroy_sem(bx_thread_sem_t *sem)
+{
+#ifdef WIN32
+  CloseHandle(sem->handle);
+#else
+  pthread_cond_destroy(&sem->cond);
+  pthread_mutex_destroy(&sem->mutex);
+#endif
+}
+
+void bx_wait_sem(bx_thread_sem_t *sem)
+{
+#ifdef WIN32
+  WaitForSingleObject(sem->handle, INFINITE);
+#else
+  pthread_mutex_lock(&sem->mutex);
+  while (sem->count == 0)
+    pthread_cond_wait(&sem->cond, &sem->mutex);
+  sem->count--;
+  pthread_mutex_unlock(&sem->mutex);
+#endif
+}
+
+void bx_set_sem(bx_thread_sem_t *sem)
+{
+#ifdef WIN32
+  ReleaseSemaphore(sem->handle, 1, NULL);
+#else
+  pthread_mutex_lock(&sem->mutex);
+  sem->count++;
+  pthread_cond_signal(&sem->cond);
+  pthread_mutex_unlock(&sem->mutex);
+#endif
+}
+
+#endif
@@ -0,0 +1,116 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2013  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+
+// Portable host thread, lock, semaphore and atomic helpers
+
+#ifndef BX_THREAD_H
+#define BX_THREAD_H
+
+#if BX_HAVE_THREADS
+
+#ifndef WIN32
+#include <pthread.h>
+#endif
+
+#ifdef WIN32
+#define BX_THREAD_ID(id) DWORD (id)
+#define BX_THREAD_FUNC(name,arg) DWORD WINAPI name(LPVOID arg)
+#define BX_THREAD_EXIT return 0
+#define BX_THREAD_CREATE(name,arg,id) CreateThread(NULL, 0, name, arg, 0, &(id))
+#define BX_LOCK(mutex) EnterCriticalSection(&(mutex))
+#define BX_UNLOCK(mutex) LeaveCriticalSection(&(mutex))
+#define BX_MUTEX(mutex) CRITICAL_SECTION (mutex)
+#define BX_INIT_MUTEX(mutex) InitializeCriticalSection(&(mutex))
+// critical sections are always recursive on win32
+#define BX_INIT_RECURSIVE_MUTEX(mutex) InitializeCriticalSection(&(mutex))
+#define BX_FINI_MUTEX(mutex) DeleteCriticalSection(&(mutex))
+#define BX_COND(cond) CONDITION_VARIABLE (cond)
+#define BX_INIT_COND(cond) InitializeConditionVariable(&(cond))
+#define BX_FINI_COND(cond)
+#define BX_WAIT_COND(cond,mutex) SleepConditionVariableCS(&(cond), &(mutex), INFINITE)
+#define BX_BROADCAST_COND(cond) WakeAllConditionVariable(&(cond))
+#define BX_MSLEEP(val) Sleep(val)
+#else
+#define BX_THREAD_ID(id) pthread_t (id)
+#define BX_THREAD_FUNC(name,arg) void* name(void* arg)
+#define BX_THREAD_EXIT pthread_exit(NULL)
+#define BX_THREAD_CREATE(name,arg,id) \
+    pthread_create(&(id), NULL, name, arg)
+#define BX_LOCK(mutex) pthread_mutex_lock(&(mutex))
+#define BX_UNLOCK(mutex) pthread_mutex_unlock(&(mutex))
+#define BX_MUTEX(mutex) pthread_mutex_t (mutex)
+#define BX_INIT_MUTEX(mutex) pthread_mutex_init(&(mutex),NULL)
+#define BX_INIT_RECURSIVE_MUTEX(mutex) bx_init_recursive_mutex(&(mutex))
+#define BX_FINI_MUTEX(mutex) pthread_mutex_destroy(&(mutex))
+#define BX_COND(cond) pthread_cond_t (cond)
+#define BX_INIT_COND(cond) pthread_cond_init(&(cond),NULL)
+#define BX_FINI_COND(cond) pthread_cond_destroy(&(cond))
+#define BX_WAIT_COND(cond,mutex) pthread_cond_wait(&(cond), &(mutex))
+#define BX_BROADCAST_COND(cond) pthread_cond_broadcast(&(cond))
+#define BX_MSLEEP(val) usleep((val)*1000)
+#endif
+
+#ifndef WIN32
+BOCHSAPI_MSVCONLY extern void bx_init_recursive_mutex(pthread_mutex_t *mutex);
+#endif
+
+BOCHSAPI_MSVCONLY extern void bx_thread_join(BX_THREAD_ID(id));
+
+// counting semaphore used for handing work between host threads
+typedef struct
+{
+#ifdef WIN32
+  HANDLE handle;
+#else
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int count;
+#endif
+} bx_thread_sem_t;
+
+BOCHSAPI_MSVCONLY extern bx_bool bx_create_sem(bx_thread_sem_t *sem);
+BOCHSAPI_MSVCONLY extern void bx_destroy_sem(bx_thread_sem_t *sem);
+BOCHSAPI_MSVCONLY extern void bx_wait_sem(bx_thread_sem_t *sem);
+BOCHSAPI_MSVCONLY extern void bx_set_sem(bx_thread_sem_t *sem);
+
+// atomic operations on words shared between host threads, all of them
+// return the value found in memory before the operation
+#if defined(_MSC_VER)
+#define bx_atomic_or32(ptr, val) \
+    ((Bit32u) InterlockedOr((volatile LONG*)(ptr), (LONG)(val)))
+#define bx_atomic_and32(ptr, val) \
+    ((Bit32u) InterlockedAnd((volatile LONG*)(ptr), (LONG)(val)))
+#define bx_atomic_add32(ptr, val) \
+    ((Bit32u) InterlockedExchangeAdd((volatile LONG*)(ptr), (LONG)(val)))
+#define bx_atomic_cas32(ptr, oldval, newval) \
+    ((Bit32u) InterlockedCompareExchange((volatile LONG*)(ptr), (LONG)(newval), (LONG)(oldval)))
+#else
+#define bx_atomic_or32(ptr, val)  __sync_fetch_and_or((volatile Bit32u*)(ptr), (Bit32u)(val))
+#define bx_atomic_and32(ptr, val) __sync_fetch_and_and((volatile Bit32u*)(ptr), (Bit32u)(val))
+#define bx_atomic_add32(ptr, val) __sync_fetch_and_add((volatile Bit32u*)(ptr), (Bit32u)(val))
+#define bx_atomic_cas32(ptr, oldval, newval) \
+    __sync_val_compare_and_swap((volatile Bit32u*)(ptr), (Bit32u)(oldval), (Bit32u)(newval))
+#endif
+
+#endif // BX_HAVE_THREADS
+
+#endif
@@ -408,6 +408,20 @@ void bx_init_options()
       "Maximum amount of instructions allowed to execute before returning control to another CPU.",
       BX_SMP_QUANTUM_MIN, BX_SMP_QUANTUM_MAX,
       16);
+  new bx_param_bool_c(cpu_param,
+      "host_threads", "Simulate each CPU on its own host thread",
+      "Run every simulated processor on a separate host thread so SMP guests can use multiple host cores.",
+      0);
+  new bx_param_num_c(cpu_param,
+      "host_quantum", "Quantum ticks for CPU host threads",
+      "Amount of instructions each processor thread executes before the simulated time is advanced.",
+      BX_SMP_HOST_QUANTUM_MIN, BX_SMP_HOST_QUANTUM_MAX,
+      4096);
+  new bx_param_num_c(cpu_param,
+      "spin_threshold", "PAUSE spin loop threshold",
+      "Number of back to back PAUSE instructions after which a spinning processor yields its quantum (0 = disabled).",
+      0, BX_MAX_BIT32U,
+      0);
 #endif
   new bx_param_bool_c(cpu_param,
       "reset_on_triple_fault", "Enable CPU reset on triple fault",
@@ -423,6 +437,30 @@ void bx_init_options()
       "cpuid_limit_winnt", "Limit max CPUID function to 3",
       "Limit max CPUID function reported to 3 to workaround WinNT issue",
       0);
+  bx_param_num_c *icache_entries = new bx_param_num_c(cpu_param,
+      "icache_entries", "Trace cache entries",
+      "Number of entries in the trace cache, must be a power of 2",
+      4096, 16*1024*1024,
+      256*1024);
+  icache_entries->set_runtime_param(1);
+  bx_param_num_c *icache_mpool = new bx_param_num_c(cpu_param,
+      "icache_mpool", "Trace cache instruction pool size",
+      "Number of decoded instructions kept by the trace cache before it is flushed",
+      4096, 64*1024*1024,
+      576*1024);
+  icache_mpool->set_runtime_param(1);
+  bx_param_num_c *icache_victim = new bx_param_num_c(cpu_param,
+      "icache_victim", "Trace cache victim entries",
+      "Number of entries in the trace cache victim cache, must be a power of 2",
+      1, 256,
+      8);
+  icache_victim->set_runtime_param(1);
+  bx_param_num_c *icache_split = new bx_param_num_c(cpu_param,
+      "icache_split", "Trace cache page split entries",
+      "Number of traces crossing the page boundary tracked by the trace cache, must be a power of 2",
+      1, 256,
+      8);
+  icache_split->set_runtime_param(1);
 #if BX_SUPPORT_MONITOR_MWAIT
   new bx_param_bool_c(cpu_param,
       "mwait_is_nop", "Don't put CPU to sleep state by MWAIT",
@@ -669,6 +707,42 @@ void bx_init_options()
       1, 2048,
       BX_DEFAULT_MEM_MEGS);
   host_ramsize->set_ask_format("Enter host memory size (MB): [%d] ");
+
+  static const char *ram_backend_list[] = { "heap", "mmap", NULL };
+  bx_param_enum_c *ram_backend = new bx_param_enum_c(ram,
+      "backend",
+      "Host memory backend",
+      "Allocate guest RAM from the heap or map it with mmap()",
+      ram_backend_list,
+      BX_MEM_BACKEND_HEAP,
+      BX_MEM_BACKEND_HEAP);
+  ram_backend->set_ask_format("Choose host memory backend [%s] ");
+
+  bx_param_filename_c *ram_file = new bx_param_filename_c(ram,
+      "file",
+      "RAM image file",
+      "File mapped as initial guest RAM contents (mmap backend only)",
+      "", BX_PATHNAME_LEN);
+  ram_file->set_format("Name of RAM image file: %s");
+  new bx_param_bool_c(ram,
+      "shared",
+      "Write guest RAM to the file",
+      "Map the RAM image file shared, so guest writes go to the file",
+      0);
+  new bx_param_bool_c(ram,
+      "incremental",
+      "Incremental save/restore",
+      "Save only the guest RAM pages written since the last checkpoint",
+      0);
+  static const char *ram_restore_list[] = { "eager", "lazy", "prefetch", NULL };
+  bx_param_enum_c *ram_restore = new bx_param_enum_c(ram,
+      "restore",
+      "Guest RAM restore mode",
+      "Read the guest RAM of a saved state at once or when the guest touches it (mmap backend only)",
+      ram_restore_list,
+      BX_MEM_RESTORE_EAGER,
+      BX_MEM_RESTORE_EAGER);
+  ram_restore->set_ask_format("Choose guest RAM restore mode [%s] ");
   ram->set_options(ram->SERIES_ASK);
 
   path = new bx_param_filename_c(rom,
@@ -788,6 +862,10 @@ void bx_init_options()
   clock_sync->set_dependent_list(deplist, 0);
   clock_sync->set_dependent_bitmap(BX_CLOCK_SYNC_REALTIME, 1);
   clock_sync->set_dependent_bitmap(BX_CLOCK_SYNC_BOTH, 1);
+  new bx_param_bool_c(clock_cmos,
+      "idle_skip", "Skip idle time",
+      "If enabled, the time jumps to the next timer event while all processors are halted",
+      0);
 
   bx_list_c *cmosimage = new bx_list_c(clock_cmos, "cmosimage", "CMOS Image Options");
   bx_param_bool_c *use_cmosimage = new bx_param_bool_c(cmosimage,
@@ -1366,6 +1444,13 @@ void bx_init_options()
         BX_ATA_TRANSLATION_NONE);
       translation->set_ask_format("Enter translation type: [%s]");
 
+      bx_param_bool_c *async = new bx_param_bool_c(menu,
+        "async",
+        "Asynchronous DMA",
+        "Perform bus master transfers on host I/O threads",
+        0);
+      async->set_ask_format("Use asynchronous DMA? [%s] ");
+
       // the master/slave menu depends on the ATA channel's enabled flag
       enabled->get_dependent_list()->add(menu);
       // the type selector depends on the ATA channel's enabled flag
@@ -1373,7 +1458,7 @@ void bx_init_options()
 
       // all items depend on the drive type
       type->set_dependent_list(menu->clone(), 0);
-      type->set_dependent_bitmap(BX_ATA_DEVICE_DISK, 0x7e6);
+      type->set_dependent_bitmap(BX_ATA_DEVICE_DISK, 0xfe6);
       type->set_dependent_bitmap(BX_ATA_DEVICE_CDROM, 0x30a);
 
       type->set_handler(bx_param_handler);
@@ -1475,6 +1560,29 @@ void bx_init_options()
       "Debug messages written to i/o port 0xE9 will be displayed on console",
       0);
 
+  // save/restore options
+  menu = new bx_list_c(misc, "save_restore", "Save/Restore Options");
+  menu->set_options(menu->SHOW_PARENT | menu->USE_BOX_TITLE);
+  static const char *sr_format_list[] = { "text", "binary", NULL };
+  new bx_param_enum_c(menu,
+      "format",
+      "Save/restore format",
+      "Save the state as text files or as a single compressed binary file",
+      sr_format_list,
+      BX_SR_FORMAT_TEXT,
+      BX_SR_FORMAT_TEXT);
+  new bx_param_num_c(menu,
+      "threads",
+      "Save/restore threads",
+      "Number of host threads compressing and decompressing the binary state file",
+      1, 64,
+      4);
+  new bx_param_bool_c(menu,
+      "snapshot_port",
+      "Enable snapshot port",
+      "Let the guest take and restore in-memory snapshots through port 0x8900",
+      0);
+
   // GDB stub
   menu = new bx_list_c(misc, "gdbstub", "GDB Stub Options");
   menu->set_options(menu->SHOW_PARENT | menu->USE_BOX_TITLE);
@@ -1569,6 +1677,10 @@ void bx_init_options()
   misc->add(SIM->get_param(BXPN_MOUSE_ENABLED));
   misc->add(SIM->get_param(BXPN_KBD_PASTE_DELAY));
   misc->add(SIM->get_param(BXPN_USER_SHORTCUT));
+  misc->add(SIM->get_param(BXPN_ICACHE_ENTRIES));
+  misc->add(SIM->get_param(BXPN_ICACHE_MPOOL));
+  misc->add(SIM->get_param(BXPN_ICACHE_VICTIM));
+  misc->add(SIM->get_param(BXPN_ICACHE_SPLIT));
   misc->set_options(misc->SHOW_PARENT | misc->SHOW_GROUP_NAME);
 }
 
@@ -2511,6 +2623,19 @@ static int parse_line_formatted(const char *context, int num_params, char *param
         SIM->get_param_num(BXPN_HOST_MEM_SIZE)->set(atol(&params[i][5]));
       } else if (!strncmp(params[i], "guest=", 6)) {
         SIM->get_param_num(BXPN_MEM_SIZE)->set(atol(&params[i][6]));
+      } else if (!strncmp(params[i], "backend=", 8)) {
+        if (!SIM->get_param_enum(BXPN_MEM_BACKEND)->set_by_name(&params[i][8]))
+          PARSE_ERR(("%s: memory directive: unknown backend '%s'.", context, &params[i][8]));
+      } else if (!strncmp(params[i], "file=", 5)) {
+        SIM->get_param_string(BXPN_MEM_FILE)->set(&params[i][5]);
+        SIM->get_param_enum(BXPN_MEM_BACKEND)->set(BX_MEM_BACKEND_MMAP);
+      } else if (!strncmp(params[i], "shared=", 7)) {
+        SIM->get_param_bool(BXPN_MEM_FILE_SHARED)->set(atol(&params[i][7]));
+      } else if (!strncmp(params[i], "incremental=", 12)) {
+        SIM->get_param_bool(BXPN_MEM_INCREMENTAL)->set(atol(&params[i][12]));
+      } else if (!strncmp(params[i], "restore=", 8)) {
+        if (!SIM->get_param_enum(BXPN_MEM_RESTORE)->set_by_name(&params[i][8]))
+          PARSE_ERR(("%s: memory directive: unknown restore mode '%s'.", context, &params[i][8]));
       } else {
         PARSE_ERR(("%s: memory directive malformed.", context));
       }
@@ -2736,6 +2861,9 @@ static int parse_line_formatted(const char *context, int num_params, char *param
       else if (!strncmp(params[i], "rtc_sync=", 9)) {
         SIM->get_param_bool(BXPN_CLOCK_RTC_SYNC)->set(atol(&params[i][9]));
       }
+      else if (!strncmp(params[i], "idle_skip=", 10)) {
+        SIM->get_param_bool(BXPN_CLOCK_IDLE_SKIP)->set(atol(&params[i][10]));
+      }
       else if (!strcmp(params[i], "time0=local")) {
         SIM->get_param_num(BXPN_CLOCK_TIME0)->set(BX_CLOCK_TIME0_LOCAL);
       }
@@ -2845,6 +2973,16 @@ static int parse_line_formatted(const char *context, int num_params, char *param
       PARSE_ERR(("%s: port_e9_hack directive malformed.", context));
     }
   }
+  else if (!strcmp(params[0], "save_restore")) {
+    if (num_params < 2) {
+      PARSE_ERR(("%s: save_restore directive malformed.", context));
+    }
+    for (i=1; i<num_params; i++) {
+      if (bx_parse_param_from_list(context, params[i], (bx_list_c*) SIM->get_param(BXPN_SAVE_RESTORE)) < 0) {
+        PARSE_ERR(("%s: save_restore directive malformed.", context));
+      }
+    }
+  }
   else if (!strcmp(params[0], "load32bitOSImage")) {
     if ((num_params!=4) && (num_params!=5)) {
       PARSE_ERR(("%s: load32bitOSImage directive: wrong # args.", context));
@@ -3142,7 +3280,8 @@ int bx_write_clock_cmos_options(FILE *fp)
       fprintf(fp, ", time0=%u", SIM->get_param_num(BXPN_CLOCK_TIME0)->get());
   }
 
-  fprintf(fp, ", rtc_sync=%d\n", SIM->get_param_bool(BXPN_CLOCK_RTC_SYNC)->get());
+  fprintf(fp, ", rtc_sync=%d", SIM->get_param_bool(BXPN_CLOCK_RTC_SYNC)->get());
+  fprintf(fp, ", idle_skip=%d\n", SIM->get_param_bool(BXPN_CLOCK_IDLE_SKIP)->get());
 
   if (strlen(SIM->get_param_string(BXPN_CMOSIMAGE_PATH)->getptr()) > 0) {
     fprintf(fp, "cmosimage: file=%s, ", SIM->get_param_string(BXPN_CMOSIMAGE_PATH)->getptr());
@@ -3249,8 +3388,20 @@ int bx_write_configuration(const char *rc, int overwrite)
     fprintf(fp, ", options=\"%s\"\n", sparam->getptr());
   else
     fprintf(fp, "\n");
-  fprintf(fp, "memory: host=%d, guest=%d\n", SIM->get_param_num(BXPN_HOST_MEM_SIZE)->get(),
+  fprintf(fp, "memory: host=%d, guest=%d", SIM->get_param_num(BXPN_HOST_MEM_SIZE)->get(),
     SIM->get_param_num(BXPN_MEM_SIZE)->get());
+  if (SIM->get_param_enum(BXPN_MEM_BACKEND)->get() != BX_MEM_BACKEND_HEAP) {
+    fprintf(fp, ", backend=%s", SIM->get_param_enum(BXPN_MEM_BACKEND)->get_selected());
+    sparam = SIM->get_param_string(BXPN_MEM_FILE);
+    if (!sparam->isempty())
+      fprintf(fp, ", file=\"%s\", shared=%d", sparam->getptr(),
+        SIM->get_param_bool(BXPN_MEM_FILE_SHARED)->get());
+  }
+  if (SIM->get_param_bool(BXPN_MEM_INCREMENTAL)->get())
+    fprintf(fp, ", incremental=1");
+  if (SIM->get_param_enum(BXPN_MEM_RESTORE)->get() != BX_MEM_RESTORE_EAGER)
+    fprintf(fp, ", restore=%s", SIM->get_param_enum(BXPN_MEM_RESTORE)->get_selected());
+  fprintf(fp, "\n");
   sparam = SIM->get_param_string(BXPN_ROM_PATH);
   if (!sparam->isempty()) {
     fprintf(fp, "romimage: file=\"%s\"", sparam->getptr());
@@ -3323,10 +3474,13 @@ int bx_write_configuration(const char *rc, int overwrite)
     SIM->get_param_string(BXPN_VGA_EXTENSION)->getptr(),
     SIM->get_param_num(BXPN_VGA_UPDATE_FREQUENCY)->get());
 #if BX_SUPPORT_SMP
-  fprintf(fp, "cpu: count=%u:%u:%u, ips=%u, quantum=%d, ",
+  fprintf(fp, "cpu: count=%u:%u:%u, ips=%u, quantum=%d, host_threads=%d, host_quantum=%d, spin_threshold=%u, ",
     SIM->get_param_num(BXPN_CPU_NPROCESSORS)->get(), SIM->get_param_num(BXPN_CPU_NCORES)->get(),
     SIM->get_param_num(BXPN_CPU_NTHREADS)->get(), SIM->get_param_num(BXPN_IPS)->get(),
-    SIM->get_param_num(BXPN_SMP_QUANTUM)->get());
+    SIM->get_param_num(BXPN_SMP_QUANTUM)->get(),
+    SIM->get_param_bool(BXPN_SMP_HOST_THREADS)->get(),
+    SIM->get_param_num(BXPN_SMP_HOST_QUANTUM)->get(),
+    SIM->get_param_num(BXPN_SMP_SPIN_THRESHOLD)->get());
 #else
   fprintf(fp, "cpu: count=1, ips=%u, ", SIM->get_param_num(BXPN_IPS)->get());
 #endif
@@ -3334,6 +3488,11 @@ int bx_write_configuration(const char *rc, int overwrite)
     SIM->get_param_enum(BXPN_CPU_MODEL)->get_selected(),
     SIM->get_param_bool(BXPN_RESET_ON_TRIPLE_FAULT)->get(),
     SIM->get_param_bool(BXPN_CPUID_LIMIT_WINNT)->get());
+  fprintf(fp, ", icache_entries=%u, icache_mpool=%u, icache_victim=%u, icache_split=%u",
+    SIM->get_param_num(BXPN_ICACHE_ENTRIES)->get(),
+    SIM->get_param_num(BXPN_ICACHE_MPOOL)->get(),
+    SIM->get_param_num(BXPN_ICACHE_VICTIM)->get(),
+    SIM->get_param_num(BXPN_ICACHE_SPLIT)->get());
 #if BX_CPU_LEVEL >= 5
   fprintf(fp, ", ignore_bad_msrs=%d", SIM->get_param_bool(BXPN_IGNORE_BAD_MSRS)->get());
 #endif
@@ -3357,6 +3516,7 @@ int bx_write_configuration(const char *rc, int overwrite)
   fprintf(fp, "print_timestamps: enabled=%d\n", bx_dbg.print_timestamps);
   bx_write_debugger_options(fp);
   fprintf(fp, "port_e9_hack: enabled=%d\n", SIM->get_param_bool(BXPN_PORT_E9_HACK)->get());
+  bx_write_param_list(fp, (bx_list_c*) SIM->get_param(BXPN_SAVE_RESTORE), NULL, 0);
   fprintf(fp, "private_colormap: enabled=%d\n", SIM->get_param_bool(BXPN_PRIVATE_COLORMAP)->get());
 #if BX_WITH_AMIGAOS
   fprintf(fp, "fullscreen: enabled=%d\n", SIM->get_param_bool(BXPN_FULLSCREEN)->get());
@@ -851,6 +851,8 @@ BX_CPU_C::read_RMW_virtual_byte_32(unsigned s, Bit32u offset)
 
   BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
 
+  BX_CPU_LOCK_BUS();
+
   if (seg->cache.valid & SegAccessWOK) {
     if (offset <= seg->cache.u.segment.limit_scaled) {
 accessOK:
@@ -897,6 +899,8 @@ BX_CPU_C::read_RMW_virtual_word_32(unsigned s, Bit32u offset)
 
   BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
 
+  BX_CPU_LOCK_BUS();
+
   if (seg->cache.valid & SegAccessWOK) {
     if (offset < seg->cache.u.segment.limit_scaled) {
 accessOK:
@@ -957,6 +961,8 @@ BX_CPU_C::read_RMW_virtual_dword_32(unsigned s, Bit32u offset)
 
   BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
 
+  BX_CPU_LOCK_BUS();
+
   if (seg->cache.valid & SegAccessWOK) {
     if (offset < (seg->cache.u.segment.limit_scaled-2)) {
 accessOK:
@@ -1017,6 +1023,8 @@ BX_CPU_C::read_RMW_virtual_qword_32(unsigned s, Bit32u offset)
 
   BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
 
+  BX_CPU_LOCK_BUS();
+
   if (seg->cache.valid & SegAccessWOK) {
     if (offset <= (seg->cache.u.segment.limit_scaled-7)) {
 accessOK:
@@ -685,6 +685,8 @@ void BX_CPU_C::read_virtual_ymmword_aligned_64(unsigned s, Bit64u offset, BxPack
 BX_CPU_C::read_RMW_virtual_byte_64(unsigned s, Bit64u offset)
 {
   BX_ASSERT(BX_CPU_THIS_PTR cpu_mode == BX_MODE_LONG_64);
+  BX_CPU_LOCK_BUS();
+
   Bit8u data;
 
   Bit64u laddr = get_laddr64(s, offset);
@@ -721,6 +723,8 @@ BX_CPU_C::read_RMW_virtual_byte_64(unsigned s, Bit64u offset)
 BX_CPU_C::read_RMW_virtual_word_64(unsigned s, Bit64u offset)
 {
   BX_ASSERT(BX_CPU_THIS_PTR cpu_mode == BX_MODE_LONG_64);
+  BX_CPU_LOCK_BUS();
+
   Bit16u data;
 
   Bit64u laddr = get_laddr64(s, offset);
@@ -775,6 +779,8 @@ BX_CPU_C::read_RMW_virtual_word_64(unsigned s, Bit64u offset)
 BX_CPU_C::read_RMW_virtual_dword_64(unsigned s, Bit64u offset)
 {
   BX_ASSERT(BX_CPU_THIS_PTR cpu_mode == BX_MODE_LONG_64);
+  BX_CPU_LOCK_BUS();
+
   Bit32u data;
 
   Bit64u laddr = get_laddr64(s, offset);
@@ -829,6 +835,8 @@ BX_CPU_C::read_RMW_virtual_dword_64(unsigned s, Bit64u offset)
 BX_CPU_C::read_RMW_virtual_qword_64(unsigned s, Bit64u offset)
 {
   BX_ASSERT(BX_CPU_THIS_PTR cpu_mode == BX_MODE_LONG_64);
+  BX_CPU_LOCK_BUS();
+
   Bit64u data;
 
   Bit64u laddr = get_laddr64(s, offset);
@@ -28,6 +28,8 @@
 
 #if BX_CPU_LEVEL >= 6
 
+#include "simd_host.h"
+
 //
 // XMM - Byte Representation of a 128-bit AES State
 //
@@ -287,12 +289,61 @@ BX_CPP_INLINE Bit32u AES_RotWord(Bit32u x)
   return (x >> 8) | (x << 24);
 }
 
+#if BX_HOST_RUNTIME_ISA
+
+//
+// Host AES-NI and PCLMULQDQ, used when the host processor reports them
+//
+
+static const bx_bool host_aesni = (bx_host_cpuid_ext_features() & BX_CPUID_EXT_AES) != 0;
+static const bx_bool host_pclmulqdq = (bx_host_cpuid_ext_features() & BX_CPUID_EXT_PCLMULQDQ) != 0;
+
+#define AES_HOST_2OP(name, func)                                                            \
+  BX_HOST_TARGET("aes") static void name(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2) \
+  {                                                                                         \
+    _mm_storeu_si128((__m128i *) op1,                                                       \
+        func(_mm_loadu_si128((const __m128i *) op1), _mm_loadu_si128((const __m128i *) op2))); \
+  }
+
+AES_HOST_2OP(AES_HostEncrypt, _mm_aesenc_si128)
+AES_HOST_2OP(AES_HostEncryptLast, _mm_aesenclast_si128)
+AES_HOST_2OP(AES_HostDecrypt, _mm_aesdec_si128)
+AES_HOST_2OP(AES_HostDecryptLast, _mm_aesdeclast_si128)
+
+BX_HOST_TARGET("aes") static void AES_HostInverseMixColumns(BxPackedXmmRegister *op)
+{
+  _mm_storeu_si128((__m128i *) op, _mm_aesimc_si128(_mm_loadu_si128((const __m128i *) op)));
+}
+
+// the host instruction needs an immediate, only imm8[0] and imm8[4] matter
+BX_HOST_TARGET("pclmul") static void HostCarrylessMultiply(BxPackedXmmRegister *r,
+       const BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2, unsigned imm8)
+{
+  __m128i a = _mm_loadu_si128((const __m128i *) op1), b = _mm_loadu_si128((const __m128i *) op2);
+
+  switch(imm8 & 0x11) {
+    case 0x00: a = _mm_clmulepi64_si128(a, b, 0x00); break;
+    case 0x01: a = _mm_clmulepi64_si128(a, b, 0x01); break;
+    case 0x10: a = _mm_clmulepi64_si128(a, b, 0x10); break;
+    default:   a = _mm_clmulepi64_si128(a, b, 0x11); break;
+  }
+
+  _mm_storeu_si128((__m128i *) r, a);
+}
+
+#endif
+
 /* 66 0F 38 DB */
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::AESIMC_VdqWdqR(bxInstruction_c *i)
 {
   BxPackedXmmRegister op = BX_READ_XMM_REG(i->src());
 
-  AES_InverseMixColumns(op);
+#if BX_HOST_RUNTIME_ISA
+  if (host_aesni)
+    AES_HostInverseMixColumns(&op);
+  else
+#endif
+    AES_InverseMixColumns(op);
 
   BX_WRITE_XMM_REGZ(i->dst(), op, i->getVL());
 
@@ -304,12 +355,19 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::AESENC_VdqHdqWdqR(bxInstruction_c
 {
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->src1()), op2 = BX_READ_XMM_REG(i->src2());
 
-  AES_ShiftRows(op1);
-  AES_SubstituteBytes(op1);
-  AES_MixColumns(op1);
+#if BX_HOST_RUNTIME_ISA
+  if (host_aesni)
+    AES_HostEncrypt(&op1, &op2);
+  else
+#endif
+  {
+    AES_ShiftRows(op1);
+    AES_SubstituteBytes(op1);
+    AES_MixColumns(op1);
 
-  op1.xmm64u(0) ^= op2.xmm64u(0);
-  op1.xmm64u(1) ^= op2.xmm64u(1);
+    op1.xmm64u(0) ^= op2.xmm64u(0);
+    op1.xmm64u(1) ^= op2.xmm64u(1);
+  }
 
   BX_WRITE_XMM_REGZ(i->dst(), op1, i->getVL());
 
@@ -321,11 +379,18 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::AESENCLAST_VdqHdqWdqR(bxInstructio
 {
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->src1()), op2 = BX_READ_XMM_REG(i->src2());
 
-  AES_ShiftRows(op1);
-  AES_SubstituteBytes(op1);
+#if BX_HOST_RUNTIME_ISA
+  if (host_aesni)
+    AES_HostEncryptLast(&op1, &op2);
+  else
+#endif
+  {
+    AES_ShiftRows(op1);
+    AES_SubstituteBytes(op1);
 
-  op1.xmm64u(0) ^= op2.xmm64u(0);
-  op1.xmm64u(1) ^= op2.xmm64u(1);
+    op1.xmm64u(0) ^= op2.xmm64u(0);
+    op1.xmm64u(1) ^= op2.xmm64u(1);
+  }
 
   BX_WRITE_XMM_REGZ(i->dst(), op1, i->getVL());
 
@@ -337,12 +402,19 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::AESDEC_VdqHdqWdqR(bxInstruction_c
 {
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->src1()), op2 = BX_READ_XMM_REG(i->src2());
 
-  AES_InverseShiftRows(op1);
-  AES_InverseSubstituteBytes(op1);
-  AES_InverseMixColumns(op1);
+#if BX_HOST_RUNTIME_ISA
+  if (host_aesni)
+    AES_HostDecrypt(&op1, &op2);
+  else
+#endif
+  {
+    AES_InverseShiftRows(op1);
+    AES_InverseSubstituteBytes(op1);
+    AES_InverseMixColumns(op1);
 
-  op1.xmm64u(0) ^= op2.xmm64u(0);
-  op1.xmm64u(1) ^= op2.xmm64u(1);
+    op1.xmm64u(0) ^= op2.xmm64u(0);
+    op1.xmm64u(1) ^= op2.xmm64u(1);
+  }
 
   BX_WRITE_XMM_REGZ(i->dst(), op1, i->getVL());
 
@@ -354,11 +426,18 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::AESDECLAST_VdqHdqWdqR(bxInstructio
 {
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->src1()), op2 = BX_READ_XMM_REG(i->src2());
 
-  AES_InverseShiftRows(op1);
-  AES_InverseSubstituteBytes(op1);
+#if BX_HOST_RUNTIME_ISA
+  if (host_aesni)
+    AES_HostDecryptLast(&op1, &op2);
+  else
+#endif
+  {
+    AES_InverseShiftRows(op1);
+    AES_InverseSubstituteBytes(op1);
 
-  op1.xmm64u(0) ^= op2.xmm64u(0);
-  op1.xmm64u(1) ^= op2.xmm64u(1);
+    op1.xmm64u(0) ^= op2.xmm64u(0);
+    op1.xmm64u(1) ^= op2.xmm64u(1);
+  }
 
   BX_WRITE_XMM_REGZ(i->dst(), op1, i->getVL());
 
@@ -390,28 +469,35 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::PCLMULQDQ_VdqHdqWdqIbR(bxInstructi
 
   Bit8u imm8 = i->Ib();
 
-  //
-  // Initialize sources for Carry Less Multiplication [R = A CLMUL B]
-  //
-
-  // A determined by imm8[0]
-  a.xmm64u(0) = op1.xmm64u(imm8 & 1);
-  a.xmm64u(1) = 0;
-
-  // B determined by imm8[4]
-  Bit64u b = op2.xmm64u((imm8 >> 4) & 1);
-
-  r.xmm64u(0) = 0;
-  r.xmm64u(1) = 0;
-
-  for (int n = 0; b && n < 64; n++) {
-      if (b & 1) {
-          r.xmm64u(0) ^= a.xmm64u(0);
-          r.xmm64u(1) ^= a.xmm64u(1);
-      }
-      a.xmm64u(1) = (a.xmm64u(1) << 1) | (a.xmm64u(0) >> 63);
-      a.xmm64u(0) <<= 1;
-      b >>= 1;
+#if BX_HOST_RUNTIME_ISA
+  if (host_pclmulqdq)
+    HostCarrylessMultiply(&r, &op1, &op2, imm8);
+  else
+#endif
+  {
+    //
+    // Initialize sources for Carry Less Multiplication [R = A CLMUL B]
+    //
+
+    // A determined by imm8[0]
+    a.xmm64u(0) = op1.xmm64u(imm8 & 1);
+    a.xmm64u(1) = 0;
+
+    // B determined by imm8[4]
+    Bit64u b = op2.xmm64u((imm8 >> 4) & 1);
+
+    r.xmm64u(0) = 0;
+    r.xmm64u(1) = 0;
+
+    for (int n = 0; b && n < 64; n++) {
+        if (b & 1) {
+            r.xmm64u(0) ^= a.xmm64u(0);
+            r.xmm64u(1) ^= a.xmm64u(1);
+        }
+        a.xmm64u(1) = (a.xmm64u(1) << 1) | (a.xmm64u(0) >> 63);
+        a.xmm64u(0) <<= 1;
+        b >>= 1;
+    }
   }
 
   BX_WRITE_XMM_REGZ(i->dst(), r, i->getVL());
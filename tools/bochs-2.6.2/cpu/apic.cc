@@ -300,7 +300,9 @@ void bx_local_apic_c::read(bx_phy_address addr, void *data, unsigned len)
     BX_PANIC(("APIC read at address 0x" FMT_PHY_ADDRX " spans 32-bit boundary !", addr));
     return;
   }
+  BX_LOCK_DEVICES();
   Bit32u value = read_aligned(addr & ~0x3);
+  BX_UNLOCK_DEVICES();
   if(len == 4) { // must be 32-bit aligned
     *((Bit32u *)data) = value;
     return;
@@ -327,7 +329,10 @@ void bx_local_apic_c::write(bx_phy_address addr, void *data, unsigned len)
     return;
   }
 
+  // IPIs sent by the write are delivered into the other local APICs
+  BX_LOCK_DEVICES();
   write_aligned(addr, *((Bit32u*) data));
+  BX_UNLOCK_DEVICES();
 }
 
 // APIC read: 4 byte read from 16-byte aligned APIC address
@@ -961,12 +966,14 @@ Bit8u bx_local_apic_c::get_ppr(void)
 
 void bx_local_apic_c::set_tpr(Bit8u priority)
 {
+  BX_LOCK_DEVICES();
   if(priority < task_priority) {
     task_priority = priority;
     service_local_apic();
   } else {
     task_priority = priority;
   }
+  BX_UNLOCK_DEVICES();
 }
 
 Bit8u bx_local_apic_c::get_apr(void)
@@ -289,6 +289,11 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVMSKB_GdUdq(bxInstruction_c *i
   unsigned len = i->getVL();
   Bit32u mask = 0;
 
+#if BX_HOST_AVX2
+  if (len == BX_VL256)
+    mask = (Bit32u) _mm256_movemask_epi8(ymm_host_load(&op));
+  else
+#endif
   for (unsigned n=0; n < len; n++)
     mask |= sse_pmovmskb(&op.avx128(n)) << (16*n);
 
@@ -339,6 +344,14 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPTEST_VdqWdqR(bxInstruction_c *i)
 
   unsigned result = EFlagsZFMask | EFlagsCFMask;
 
+#if BX_HOST_AVX2
+  if (len == BX_VL256) {
+    __m256i host_op1 = ymm_host_load(&op1), host_op2 = ymm_host_load(&op2);
+    if (! _mm256_testz_si256(host_op1, host_op2)) result &= ~EFlagsZFMask;
+    if (! _mm256_testc_si256(host_op1, host_op2)) result &= ~EFlagsCFMask;
+  }
+  else
+#endif
   for (unsigned n=0; n < (2*len); n++) {
     if ((op2.avx64u(n) &  op1.avx64u(n)) != 0) result &= ~EFlagsZFMask;
     if ((op2.avx64u(n) & ~op1.avx64u(n)) != 0) result &= ~EFlagsCFMask;
@@ -406,15 +419,20 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VBLENDPD_VpdHpdWpdIbR(bxInstructio
 /* Opcode: VEX.66.0F.3A 4A (VEX.W=0) */
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VBLENDVPS_VpsHpsWpsIbR(bxInstruction_c *i)
 {
-  BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2()),
-           mask = BX_READ_AVX_REG(i->src3());
-
   unsigned len = i->getVL();
 
-  for (unsigned n=0; n < len; n++)
-    sse_blendvps(&op1.avx128(n), &op2.avx128(n), &mask.avx128(n));
+  if (BX_HOST_AVX2 && len == BX_VL256) {
+    YMM_HOST_3OP(&BX_AVX_REG(i->dst()), &BX_AVX_REG(i->src1()), &BX_AVX_REG(i->src2()), &BX_AVX_REG(i->src3()), ymm_host_blendvps);
+  }
+  else {
+    BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2()),
+             mask = BX_READ_AVX_REG(i->src3());
 
-  BX_WRITE_AVX_REGZ(i->dst(), op1, len);
+    for (unsigned n=0; n < len; n++)
+      sse_blendvps(&op1.avx128(n), &op2.avx128(n), &mask.avx128(n));
+
+    BX_WRITE_AVX_REGZ(i->dst(), op1, len);
+  }
 
   BX_NEXT_INSTR(i);
 }
@@ -422,15 +440,20 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VBLENDVPS_VpsHpsWpsIbR(bxInstructi
 /* Opcode: VEX.66.0F.3A 4B (VEX.W=0) */
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VBLENDVPD_VpdHpdWpdIbR(bxInstruction_c *i)
 {
-  BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2()),
-           mask = BX_READ_AVX_REG(i->src3());
-
   unsigned len = i->getVL();
 
-  for (unsigned n=0; n < len; n++)
-    sse_blendvpd(&op1.avx128(n), &op2.avx128(n), &mask.avx128(n));
+  if (BX_HOST_AVX2 && len == BX_VL256) {
+    YMM_HOST_3OP(&BX_AVX_REG(i->dst()), &BX_AVX_REG(i->src1()), &BX_AVX_REG(i->src2()), &BX_AVX_REG(i->src3()), ymm_host_blendvpd);
+  }
+  else {
+    BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2()),
+             mask = BX_READ_AVX_REG(i->src3());
 
-  BX_WRITE_AVX_REGZ(i->dst(), op1, len);
+    for (unsigned n=0; n < len; n++)
+      sse_blendvpd(&op1.avx128(n), &op2.avx128(n), &mask.avx128(n));
+
+    BX_WRITE_AVX_REGZ(i->dst(), op1, len);
+  }
 
   BX_NEXT_INSTR(i);
 }
@@ -438,15 +461,20 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VBLENDVPD_VpdHpdWpdIbR(bxInstructi
 /* Opcode: VEX.66.0F.3A 4C (VEX.W=0) */
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPBLENDVB_VdqHdqWdqIbR(bxInstruction_c *i)
 {
-  BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2()),
-           mask = BX_READ_AVX_REG(i->src3());
-           
   unsigned len = i->getVL();
 
-  for (unsigned n=0; n < len; n++)
-    sse_pblendvb(&op1.avx128(n), &op2.avx128(n), &mask.avx128(n));
+  if (BX_HOST_AVX2 && len == BX_VL256) {
+    YMM_HOST_3OP(&BX_AVX_REG(i->dst()), &BX_AVX_REG(i->src1()), &BX_AVX_REG(i->src2()), &BX_AVX_REG(i->src3()), _mm256_blendv_epi8);
+  }
+  else {
+    BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2()),
+             mask = BX_READ_AVX_REG(i->src3());
 
-  BX_WRITE_AVX_REGZ(i->dst(), op1, len);
+    for (unsigned n=0; n < len; n++)
+      sse_pblendvb(&op1.avx128(n), &op2.avx128(n), &mask.avx128(n));
+
+    BX_WRITE_AVX_REGZ(i->dst(), op1, len);
+  }
 
   BX_NEXT_INSTR(i);
 }
@@ -486,14 +514,20 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VEXTRACTF128_WdqVdqIbR(bxInstructi
 /* Opcode: VEX.66.0F.38 0C (VEX.W=0) */
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPERMILPS_VpsHpsWpsR(bxInstruction_c *i)
 {
-  BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1());
-  BxPackedAvxRegister op2 = BX_READ_AVX_REG(i->src2()), result;
   unsigned len = i->getVL();
 
-  for (unsigned n=0; n < len; n++)
-    sse_permilps(&result.avx128(n), &op1.avx128(n), &op2.avx128(n));
+  if (BX_HOST_AVX2 && len == BX_VL256) {
+    YMM_HOST_2OP(&BX_AVX_REG(i->dst()), &BX_AVX_REG(i->src1()), &BX_AVX_REG(i->src2()), ymm_host_permilps);
+  }
+  else {
+    BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1());
+    BxPackedAvxRegister op2 = BX_READ_AVX_REG(i->src2()), result;
 
-  BX_WRITE_AVX_REGZ(i->dst(), result, len);
+    for (unsigned n=0; n < len; n++)
+      sse_permilps(&result.avx128(n), &op1.avx128(n), &op2.avx128(n));
+
+    BX_WRITE_AVX_REGZ(i->dst(), result, len);
+  }
 
   BX_NEXT_INSTR(i);
 }
@@ -501,14 +535,20 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPERMILPS_VpsHpsWpsR(bxInstruction
 /* Opcode: VEX.66.0F.3A 05 (VEX.W=0) */
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPERMILPD_VpdHpdWpdR(bxInstruction_c *i)
 {
-  BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1());
-  BxPackedAvxRegister op2 = BX_READ_AVX_REG(i->src2()), result;
   unsigned len = i->getVL();
 
-  for (unsigned n=0; n < len; n++)
-    sse_permilpd(&result.avx128(n), &op1.avx128(n), &op2.avx128(n));
+  if (BX_HOST_AVX2 && len == BX_VL256) {
+    YMM_HOST_2OP(&BX_AVX_REG(i->dst()), &BX_AVX_REG(i->src1()), &BX_AVX_REG(i->src2()), ymm_host_permilpd);
+  }
+  else {
+    BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1());
+    BxPackedAvxRegister op2 = BX_READ_AVX_REG(i->src2()), result;
 
-  BX_WRITE_AVX_REGZ(i->dst(), result, len);
+    for (unsigned n=0; n < len; n++)
+      sse_permilpd(&result.avx128(n), &op1.avx128(n), &op2.avx128(n));
+
+    BX_WRITE_AVX_REGZ(i->dst(), result, len);
+  }
 
   BX_NEXT_INSTR(i);
 }
@@ -31,159 +31,208 @@
 #include "simd_int.h"
 #include "simd_compare.h"
 
-#define AVX_2OP(HANDLER, func)                                                              \
+#define AVX_2OP(HANDLER, func, host_func)                                                   \
   /* AVX instruction with two src operands */                                               \
   BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C :: HANDLER (bxInstruction_c *i)              \
   {                                                                                         \
-    BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2()); \
     unsigned len = i->getVL();                                                              \
                                                                                             \
-    for (unsigned n=0; n < len; n++)                                                        \
-      (func)(&op1.avx128(n), &op2.avx128(n));                                               \
+    if (BX_HOST_AVX2 && len == BX_VL256) {                                                  \
+      YMM_HOST_2OP(&BX_AVX_REG(i->dst()), &BX_AVX_REG(i->src1()), &BX_AVX_REG(i->src2()), host_func); \
+    }                                                                                       \
+    else {                                                                                  \
+      BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2()); \
                                                                                             \
-    BX_WRITE_AVX_REGZ(i->dst(), op1, len);                                                  \
+      for (unsigned n=0; n < len; n++)                                                      \
+        (func)(&op1.avx128(n), &op2.avx128(n));                                             \
+                                                                                            \
+      BX_WRITE_AVX_REGZ(i->dst(), op1, len);                                                \
+    }                                                                                       \
                                                                                             \
     BX_NEXT_INSTR(i);                                                                       \
   }
 
-AVX_2OP(VANDPS_VpsHpsWpsR, sse_andps)
-AVX_2OP(VANDNPS_VpsHpsWpsR, sse_andnps)
-AVX_2OP(VXORPS_VpsHpsWpsR, sse_xorps)
-AVX_2OP(VORPS_VpsHpsWpsR, sse_orps)
-
-AVX_2OP(VUNPCKLPS_VpsHpsWpsR, sse_unpcklps)
-AVX_2OP(VUNPCKLPD_VpdHpdWpdR, sse_unpcklpd)
-AVX_2OP(VUNPCKHPS_VpsHpsWpsR, sse_unpckhps)
-AVX_2OP(VUNPCKHPD_VpdHpdWpdR, sse_unpckhpd)
-
-AVX_2OP(VPADDB_VdqHdqWdqR, sse_paddb)
-AVX_2OP(VPADDW_VdqHdqWdqR, sse_paddw)
-AVX_2OP(VPADDD_VdqHdqWdqR, sse_paddd)
-AVX_2OP(VPADDQ_VdqHdqWdqR, sse_paddq)
-AVX_2OP(VPSUBB_VdqHdqWdqR, sse_psubb)
-AVX_2OP(VPSUBW_VdqHdqWdqR, sse_psubw)
-AVX_2OP(VPSUBD_VdqHdqWdqR, sse_psubd)
-AVX_2OP(VPSUBQ_VdqHdqWdqR, sse_psubq)
-
-AVX_2OP(VPCMPEQB_VdqHdqWdqR, sse_pcmpeqb)
-AVX_2OP(VPCMPEQW_VdqHdqWdqR, sse_pcmpeqw)
-AVX_2OP(VPCMPEQD_VdqHdqWdqR, sse_pcmpeqd)
-AVX_2OP(VPCMPEQQ_VdqHdqWdqR, sse_pcmpeqq)
-AVX_2OP(VPCMPGTB_VdqHdqWdqR, sse_pcmpgtb)
-AVX_2OP(VPCMPGTW_VdqHdqWdqR, sse_pcmpgtw)
-AVX_2OP(VPCMPGTD_VdqHdqWdqR, sse_pcmpgtd)
-AVX_2OP(VPCMPGTQ_VdqHdqWdqR, sse_pcmpgtq)
-
-AVX_2OP(VPMINSB_VdqHdqWdqR, sse_pminsb)
-AVX_2OP(VPMINSW_VdqHdqWdqR, sse_pminsw)
-AVX_2OP(VPMINSD_VdqHdqWdqR, sse_pminsd)
-AVX_2OP(VPMINUB_VdqHdqWdqR, sse_pminub)
-AVX_2OP(VPMINUW_VdqHdqWdqR, sse_pminuw)
-AVX_2OP(VPMINUD_VdqHdqWdqR, sse_pminud)
-AVX_2OP(VPMAXSB_VdqHdqWdqR, sse_pmaxsb)
-AVX_2OP(VPMAXSW_VdqHdqWdqR, sse_pmaxsw)
-AVX_2OP(VPMAXSD_VdqHdqWdqR, sse_pmaxsd)
-AVX_2OP(VPMAXUB_VdqHdqWdqR, sse_pmaxub)
-AVX_2OP(VPMAXUW_VdqHdqWdqR, sse_pmaxuw)
-AVX_2OP(VPMAXUD_VdqHdqWdqR, sse_pmaxud)
-
-AVX_2OP(VPSIGNB_VdqHdqWdqR, sse_psignb)
-AVX_2OP(VPSIGNW_VdqHdqWdqR, sse_psignw)
-AVX_2OP(VPSIGND_VdqHdqWdqR, sse_psignd)
-
-AVX_2OP(VPSUBSB_VdqHdqWdqR, sse_psubsb)
-AVX_2OP(VPSUBSW_VdqHdqWdqR, sse_psubsw)
-AVX_2OP(VPSUBUSB_VdqHdqWdqR, sse_psubusb)
-AVX_2OP(VPSUBUSW_VdqHdqWdqR, sse_psubusw)
-AVX_2OP(VPADDSB_VdqHdqWdqR, sse_paddsb)
-AVX_2OP(VPADDSW_VdqHdqWdqR, sse_paddsw)
-AVX_2OP(VPADDUSB_VdqHdqWdqR, sse_paddusb)
-AVX_2OP(VPADDUSW_VdqHdqWdqR, sse_paddusw)
-
-AVX_2OP(VPHADDW_VdqHdqWdqR, sse_phaddw)
-AVX_2OP(VPHADDD_VdqHdqWdqR, sse_phaddd)
-AVX_2OP(VPHADDSW_VdqHdqWdqR, sse_phaddsw)
-AVX_2OP(VPHSUBW_VdqHdqWdqR, sse_phsubw)
-AVX_2OP(VPHSUBD_VdqHdqWdqR, sse_phsubd)
-AVX_2OP(VPHSUBSW_VdqHdqWdqR, sse_phsubsw)
-
-AVX_2OP(VPAVGB_VdqHdqWdqR, sse_pavgb)
-AVX_2OP(VPAVGW_VdqHdqWdqR, sse_pavgw)
-
-AVX_2OP(VPACKUSWB_VdqHdqWdqR, sse_packuswb)
-AVX_2OP(VPACKSSWB_VdqHdqWdqR, sse_packsswb)
-AVX_2OP(VPACKUSDW_VdqHdqWdqR, sse_packusdw)
-AVX_2OP(VPACKSSDW_VdqHdqWdqR, sse_packssdw)
-
-AVX_2OP(VPUNPCKLBW_VdqHdqWdqR, sse_punpcklbw)
-AVX_2OP(VPUNPCKLWD_VdqHdqWdqR, sse_punpcklwd)
-AVX_2OP(VPUNPCKHBW_VdqHdqWdqR, sse_punpckhbw)
-AVX_2OP(VPUNPCKHWD_VdqHdqWdqR, sse_punpckhwd)
-
-AVX_2OP(VPMULLD_VdqHdqWdqR, sse_pmulld)
-AVX_2OP(VPMULLW_VdqHdqWdqR, sse_pmullw)
-AVX_2OP(VPMULHW_VdqHdqWdqR, sse_pmulhw)
-AVX_2OP(VPMULHUW_VdqHdqWdqR, sse_pmulhuw)
-AVX_2OP(VPMULDQ_VdqHdqWdqR, sse_pmuldq)
-AVX_2OP(VPMULUDQ_VdqHdqWdqR, sse_pmuludq)
-AVX_2OP(VPMULHRSW_VdqHdqWdqR, sse_pmulhrsw)
-
-AVX_2OP(VPMADDWD_VdqHdqWdqR, sse_pmaddwd)
-AVX_2OP(VPMADDUBSW_VdqHdqWdqR, sse_pmaddubsw)
-
-AVX_2OP(VPSADBW_VdqHdqWdqR, sse_psadbw)
-
-AVX_2OP(VPSRAVD_VdqHdqWdqR, sse_psravd)
-AVX_2OP(VPSLLVD_VdqHdqWdqR, sse_psllvd)
-AVX_2OP(VPSLLVQ_VdqHdqWdqR, sse_psllvq)
-AVX_2OP(VPSRLVD_VdqHdqWdqR, sse_psrlvd)
-AVX_2OP(VPSRLVQ_VdqHdqWdqR, sse_psrlvq)
-
-#define AVX_1OP(HANDLER, func)                                                             \
-  /* AVX instruction with single src operand */                                            \
-  BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C :: HANDLER (bxInstruction_c *i)             \
-  {                                                                                        \
-    BxPackedAvxRegister op = BX_READ_AVX_REG(i->src());                                    \
-    unsigned len = i->getVL();                                                             \
-                                                                                           \
-    for (unsigned n=0; n < len; n++)                                                       \
-      (func)(&op.avx128(n));                                                               \
-                                                                                           \
-    BX_WRITE_AVX_REGZ(i->dst(), op, len);                                                  \
-                                                                                           \
-    BX_NEXT_INSTR(i);                                                                      \
+AVX_2OP(VANDPS_VpsHpsWpsR, sse_andps, _mm256_and_si256)
+AVX_2OP(VANDNPS_VpsHpsWpsR, sse_andnps, _mm256_andnot_si256)
+AVX_2OP(VXORPS_VpsHpsWpsR, sse_xorps, _mm256_xor_si256)
+AVX_2OP(VORPS_VpsHpsWpsR, sse_orps, _mm256_or_si256)
+
+AVX_2OP(VUNPCKLPS_VpsHpsWpsR, sse_unpcklps, _mm256_unpacklo_epi32)
+AVX_2OP(VUNPCKLPD_VpdHpdWpdR, sse_unpcklpd, _mm256_unpacklo_epi64)
+AVX_2OP(VUNPCKHPS_VpsHpsWpsR, sse_unpckhps, _mm256_unpackhi_epi32)
+AVX_2OP(VUNPCKHPD_VpdHpdWpdR, sse_unpckhpd, _mm256_unpackhi_epi64)
+
+AVX_2OP(VPADDB_VdqHdqWdqR, sse_paddb, _mm256_add_epi8)
+AVX_2OP(VPADDW_VdqHdqWdqR, sse_paddw, _mm256_add_epi16)
+AVX_2OP(VPADDD_VdqHdqWdqR, sse_paddd, _mm256_add_epi32)
+AVX_2OP(VPADDQ_VdqHdqWdqR, sse_paddq, _mm256_add_epi64)
+AVX_2OP(VPSUBB_VdqHdqWdqR, sse_psubb, _mm256_sub_epi8)
+AVX_2OP(VPSUBW_VdqHdqWdqR, sse_psubw, _mm256_sub_epi16)
+AVX_2OP(VPSUBD_VdqHdqWdqR, sse_psubd, _mm256_sub_epi32)
+AVX_2OP(VPSUBQ_VdqHdqWdqR, sse_psubq, _mm256_sub_epi64)
+
+AVX_2OP(VPCMPEQB_VdqHdqWdqR, sse_pcmpeqb, _mm256_cmpeq_epi8)
+AVX_2OP(VPCMPEQW_VdqHdqWdqR, sse_pcmpeqw, _mm256_cmpeq_epi16)
+AVX_2OP(VPCMPEQD_VdqHdqWdqR, sse_pcmpeqd, _mm256_cmpeq_epi32)
+AVX_2OP(VPCMPEQQ_VdqHdqWdqR, sse_pcmpeqq, _mm256_cmpeq_epi64)
+AVX_2OP(VPCMPGTB_VdqHdqWdqR, sse_pcmpgtb, _mm256_cmpgt_epi8)
+AVX_2OP(VPCMPGTW_VdqHdqWdqR, sse_pcmpgtw, _mm256_cmpgt_epi16)
+AVX_2OP(VPCMPGTD_VdqHdqWdqR, sse_pcmpgtd, _mm256_cmpgt_epi32)
+AVX_2OP(VPCMPGTQ_VdqHdqWdqR, sse_pcmpgtq, _mm256_cmpgt_epi64)
+
+AVX_2OP(VPMINSB_VdqHdqWdqR, sse_pminsb, _mm256_min_epi8)
+AVX_2OP(VPMINSW_VdqHdqWdqR, sse_pminsw, _mm256_min_epi16)
+AVX_2OP(VPMINSD_VdqHdqWdqR, sse_pminsd, _mm256_min_epi32)
+AVX_2OP(VPMINUB_VdqHdqWdqR, sse_pminub, _mm256_min_epu8)
+AVX_2OP(VPMINUW_VdqHdqWdqR, sse_pminuw, _mm256_min_epu16)
+AVX_2OP(VPMINUD_VdqHdqWdqR, sse_pminud, _mm256_min_epu32)
+AVX_2OP(VPMAXSB_VdqHdqWdqR, sse_pmaxsb, _mm256_max_epi8)
+AVX_2OP(VPMAXSW_VdqHdqWdqR, sse_pmaxsw, _mm256_max_epi16)
+AVX_2OP(VPMAXSD_VdqHdqWdqR, sse_pmaxsd, _mm256_max_epi32)
+AVX_2OP(VPMAXUB_VdqHdqWdqR, sse_pmaxub, _mm256_max_epu8)
+AVX_2OP(VPMAXUW_VdqHdqWdqR, sse_pmaxuw, _mm256_max_epu16)
+AVX_2OP(VPMAXUD_VdqHdqWdqR, sse_pmaxud, _mm256_max_epu32)
+
+AVX_2OP(VPSIGNB_VdqHdqWdqR, sse_psignb, _mm256_sign_epi8)
+AVX_2OP(VPSIGNW_VdqHdqWdqR, sse_psignw, _mm256_sign_epi16)
+AVX_2OP(VPSIGND_VdqHdqWdqR, sse_psignd, _mm256_sign_epi32)
+
+AVX_2OP(VPSUBSB_VdqHdqWdqR, sse_psubsb, _mm256_subs_epi8)
+AVX_2OP(VPSUBSW_VdqHdqWdqR, sse_psubsw, _mm256_subs_epi16)
+AVX_2OP(VPSUBUSB_VdqHdqWdqR, sse_psubusb, _mm256_subs_epu8)
+AVX_2OP(VPSUBUSW_VdqHdqWdqR, sse_psubusw, _mm256_subs_epu16)
+AVX_2OP(VPADDSB_VdqHdqWdqR, sse_paddsb, _mm256_adds_epi8)
+AVX_2OP(VPADDSW_VdqHdqWdqR, sse_paddsw, _mm256_adds_epi16)
+AVX_2OP(VPADDUSB_VdqHdqWdqR, sse_paddusb, _mm256_adds_epu8)
+AVX_2OP(VPADDUSW_VdqHdqWdqR, sse_paddusw, _mm256_adds_epu16)
+
+AVX_2OP(VPHADDW_VdqHdqWdqR, sse_phaddw, _mm256_hadd_epi16)
+AVX_2OP(VPHADDD_VdqHdqWdqR, sse_phaddd, _mm256_hadd_epi32)
+AVX_2OP(VPHADDSW_VdqHdqWdqR, sse_phaddsw, _mm256_hadds_epi16)
+AVX_2OP(VPHSUBW_VdqHdqWdqR, sse_phsubw, _mm256_hsub_epi16)
+AVX_2OP(VPHSUBD_VdqHdqWdqR, sse_phsubd, _mm256_hsub_epi32)
+AVX_2OP(VPHSUBSW_VdqHdqWdqR, sse_phsubsw, _mm256_hsubs_epi16)
+
+AVX_2OP(VPAVGB_VdqHdqWdqR, sse_pavgb, _mm256_avg_epu8)
+AVX_2OP(VPAVGW_VdqHdqWdqR, sse_pavgw, _mm256_avg_epu16)
+
+AVX_2OP(VPACKUSWB_VdqHdqWdqR, sse_packuswb, _mm256_packus_epi16)
+AVX_2OP(VPACKSSWB_VdqHdqWdqR, sse_packsswb, _mm256_packs_epi16)
+AVX_2OP(VPACKUSDW_VdqHdqWdqR, sse_packusdw, _mm256_packus_epi32)
+AVX_2OP(VPACKSSDW_VdqHdqWdqR, sse_packssdw, _mm256_packs_epi32)
+
+AVX_2OP(VPUNPCKLBW_VdqHdqWdqR, sse_punpcklbw, _mm256_unpacklo_epi8)
+AVX_2OP(VPUNPCKLWD_VdqHdqWdqR, sse_punpcklwd, _mm256_unpacklo_epi16)
+AVX_2OP(VPUNPCKHBW_VdqHdqWdqR, sse_punpckhbw, _mm256_unpackhi_epi8)
+AVX_2OP(VPUNPCKHWD_VdqHdqWdqR, sse_punpckhwd, _mm256_unpackhi_epi16)
+
+AVX_2OP(VPMULLD_VdqHdqWdqR, sse_pmulld, _mm256_mullo_epi32)
+AVX_2OP(VPMULLW_VdqHdqWdqR, sse_pmullw, _mm256_mullo_epi16)
+AVX_2OP(VPMULHW_VdqHdqWdqR, sse_pmulhw, _mm256_mulhi_epi16)
+AVX_2OP(VPMULHUW_VdqHdqWdqR, sse_pmulhuw, _mm256_mulhi_epu16)
+AVX_2OP(VPMULDQ_VdqHdqWdqR, sse_pmuldq, _mm256_mul_epi32)
+AVX_2OP(VPMULUDQ_VdqHdqWdqR, sse_pmuludq, _mm256_mul_epu32)
+AVX_2OP(VPMULHRSW_VdqHdqWdqR, sse_pmulhrsw, _mm256_mulhrs_epi16)
+
+AVX_2OP(VPMADDWD_VdqHdqWdqR, sse_pmaddwd, _mm256_madd_epi16)
+AVX_2OP(VPMADDUBSW_VdqHdqWdqR, sse_pmaddubsw, _mm256_maddubs_epi16)
+
+AVX_2OP(VPSADBW_VdqHdqWdqR, sse_psadbw, _mm256_sad_epu8)
+
+AVX_2OP(VPSRAVD_VdqHdqWdqR, sse_psravd, _mm256_srav_epi32)
+AVX_2OP(VPSLLVD_VdqHdqWdqR, sse_psllvd, _mm256_sllv_epi32)
+AVX_2OP(VPSLLVQ_VdqHdqWdqR, sse_psllvq, _mm256_sllv_epi64)
+AVX_2OP(VPSRLVD_VdqHdqWdqR, sse_psrlvd, _mm256_srlv_epi32)
+AVX_2OP(VPSRLVQ_VdqHdqWdqR, sse_psrlvq, _mm256_srlv_epi64)
+
+#define AVX_1OP(HANDLER, func, host_func)                                                   \
+  /* AVX instruction with single src operand */                                             \
+  BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C :: HANDLER (bxInstruction_c *i)              \
+  {                                                                                         \
+    unsigned len = i->getVL();                                                              \
+                                                                                            \
+    if (BX_HOST_AVX2 && len == BX_VL256) {                                                  \
+      YMM_HOST_1OP(&BX_AVX_REG(i->dst()), &BX_AVX_REG(i->src()), host_func);                \
+    }                                                                                       \
+    else {                                                                                  \
+      BxPackedAvxRegister op = BX_READ_AVX_REG(i->src());                                   \
+                                                                                            \
+      for (unsigned n=0; n < len; n++)                                                      \
+        (func)(&op.avx128(n));                                                              \
+                                                                                            \
+      BX_WRITE_AVX_REGZ(i->dst(), op, len);                                                 \
+    }                                                                                       \
+                                                                                            \
+    BX_NEXT_INSTR(i);                                                                       \
   }
 
-AVX_1OP(VPABSB_VdqWdqR, sse_pabsb)
-AVX_1OP(VPABSW_VdqWdqR, sse_pabsw)
-AVX_1OP(VPABSD_VdqWdqR, sse_pabsd)
+AVX_1OP(VPABSB_VdqWdqR, sse_pabsb, _mm256_abs_epi8)
+AVX_1OP(VPABSW_VdqWdqR, sse_pabsw, _mm256_abs_epi16)
+AVX_1OP(VPABSD_VdqWdqR, sse_pabsd, _mm256_abs_epi32)
 
-#define AVX_PSHIFT(HANDLER, func)                                                          \
-  /* AVX packed shift instruction */                                                       \
-  BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C:: HANDLER (bxInstruction_c *i)              \
-  {                                                                                        \
-    BxPackedAvxRegister op  = BX_READ_AVX_REG(i->src1());                                  \
-    unsigned len = i->getVL();                                                             \
-                                                                                           \
-    for (unsigned n=0; n < len; n++)                                                       \
-      (func)(&op.avx128(n), BX_READ_XMM_REG_LO_QWORD(i->src2()));                          \
-                                                                                           \
-    BX_WRITE_AVX_REGZ(i->dst(), op, len);                                                  \
-                                                                                           \
-    BX_NEXT_INSTR(i);                                                                      \
+#define AVX_PSHIFT(HANDLER, func, host_func)                                                \
+  /* AVX packed shift instruction */                                                        \
+  BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C:: HANDLER (bxInstruction_c *i)               \
+  {                                                                                         \
+    unsigned len = i->getVL();                                                              \
+    Bit64u shift_64 = BX_READ_XMM_REG_LO_QWORD(i->src2());                                  \
+                                                                                            \
+    if (BX_HOST_AVX2 && len == BX_VL256) {                                                  \
+      YMM_HOST_SHIFT(&BX_AVX_REG(i->dst()), &BX_AVX_REG(i->src1()), shift_64, host_func);   \
+    }                                                                                       \
+    else {                                                                                  \
+      BxPackedAvxRegister op  = BX_READ_AVX_REG(i->src1());                                 \
+                                                                                            \
+      for (unsigned n=0; n < len; n++)                                                      \
+        (func)(&op.avx128(n), shift_64);                                                    \
+                                                                                            \
+      BX_WRITE_AVX_REGZ(i->dst(), op, len);                                                 \
+    }                                                                                       \
+                                                                                            \
+    BX_NEXT_INSTR(i);                                                                       \
+  }
+
+AVX_PSHIFT(VPSRLW_VdqHdqWdqR, sse_psrlw, _mm256_srl_epi16);
+AVX_PSHIFT(VPSRLD_VdqHdqWdqR, sse_psrld, _mm256_srl_epi32);
+AVX_PSHIFT(VPSRLQ_VdqHdqWdqR, sse_psrlq, _mm256_srl_epi64);
+AVX_PSHIFT(VPSRAW_VdqHdqWdqR, sse_psraw, _mm256_sra_epi16);
+AVX_PSHIFT(VPSRAD_VdqHdqWdqR, sse_psrad, _mm256_sra_epi32);
+AVX_PSHIFT(VPSLLW_VdqHdqWdqR, sse_psllw, _mm256_sll_epi16);
+AVX_PSHIFT(VPSLLD_VdqHdqWdqR, sse_pslld, _mm256_sll_epi32);
+AVX_PSHIFT(VPSLLQ_VdqHdqWdqR, sse_psllq, _mm256_sll_epi64);
+
+#define AVX_PSHIFT_IMM(HANDLER, func, host_func)                                            \
+  /* AVX packed shift with imm8 instruction */                                              \
+  BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C:: HANDLER (bxInstruction_c *i)               \
+  {                                                                                         \
+    unsigned len = i->getVL();                                                              \
+                                                                                            \
+    if (BX_HOST_AVX2 && len == BX_VL256) {                                                  \
+      YMM_HOST_SHIFT(&BX_AVX_REG(i->dst()), &BX_AVX_REG(i->src()), i->Ib(), host_func);     \
+    }                                                                                       \
+    else {                                                                                  \
+      BxPackedAvxRegister op  = BX_READ_AVX_REG(i->src());                                  \
+                                                                                            \
+      for (unsigned n=0; n < len; n++)                                                      \
+        (func)(&op.avx128(n), i->Ib());                                                     \
+                                                                                            \
+      BX_WRITE_AVX_REGZ(i->dst(), op, len);                                                 \
+    }                                                                                       \
+                                                                                            \
+    BX_NEXT_INSTR(i);                                                                       \
   }
 
-AVX_PSHIFT(VPSRLW_VdqHdqWdqR, sse_psrlw);
-AVX_PSHIFT(VPSRLD_VdqHdqWdqR, sse_psrld);
-AVX_PSHIFT(VPSRLQ_VdqHdqWdqR, sse_psrlq);
-AVX_PSHIFT(VPSRAW_VdqHdqWdqR, sse_psraw);
-AVX_PSHIFT(VPSRAD_VdqHdqWdqR, sse_psrad);
-AVX_PSHIFT(VPSLLW_VdqHdqWdqR, sse_psllw);
-AVX_PSHIFT(VPSLLD_VdqHdqWdqR, sse_pslld);
-AVX_PSHIFT(VPSLLQ_VdqHdqWdqR, sse_psllq);
-
-#define AVX_PSHIFT_IMM(HANDLER, func)                                                      \
-  /* AVX packed shift with imm8 instruction */                                             \
+AVX_PSHIFT_IMM(VPSRLW_UdqIb, sse_psrlw, _mm256_srl_epi16);
+AVX_PSHIFT_IMM(VPSRLD_UdqIb, sse_psrld, _mm256_srl_epi32);
+AVX_PSHIFT_IMM(VPSRLQ_UdqIb, sse_psrlq, _mm256_srl_epi64);
+AVX_PSHIFT_IMM(VPSRAW_UdqIb, sse_psraw, _mm256_sra_epi16);
+AVX_PSHIFT_IMM(VPSRAD_UdqIb, sse_psrad, _mm256_sra_epi32);
+AVX_PSHIFT_IMM(VPSLLW_UdqIb, sse_psllw, _mm256_sll_epi16);
+AVX_PSHIFT_IMM(VPSLLD_UdqIb, sse_pslld, _mm256_sll_epi32);
+AVX_PSHIFT_IMM(VPSLLQ_UdqIb, sse_psllq, _mm256_sll_epi64);
+
+#define AVX_PSHIFT_BYTES_IMM(HANDLER, func)                                                \
+  /* AVX packed byte shift with imm8 instruction */                                        \
   BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C:: HANDLER (bxInstruction_c *i)              \
   {                                                                                        \
     BxPackedAvxRegister op  = BX_READ_AVX_REG(i->src());                                   \
@@ -197,17 +246,8 @@ AVX_PSHIFT(VPSLLQ_VdqHdqWdqR, sse_psllq);
     BX_NEXT_INSTR(i);                                                                      \
   }
 
-AVX_PSHIFT_IMM(VPSRLW_UdqIb, sse_psrlw);
-AVX_PSHIFT_IMM(VPSRLD_UdqIb, sse_psrld);
-AVX_PSHIFT_IMM(VPSRLQ_UdqIb, sse_psrlq);
-AVX_PSHIFT_IMM(VPSRAW_UdqIb, sse_psraw);
-AVX_PSHIFT_IMM(VPSRAD_UdqIb, sse_psrad);
-AVX_PSHIFT_IMM(VPSLLW_UdqIb, sse_psllw);
-AVX_PSHIFT_IMM(VPSLLD_UdqIb, sse_pslld);
-AVX_PSHIFT_IMM(VPSLLQ_UdqIb, sse_psllq);
-
-AVX_PSHIFT_IMM(VPSRLDQ_UdqIb, sse_psrldq);
-AVX_PSHIFT_IMM(VPSLLDQ_UdqIb, sse_pslldq);
+AVX_PSHIFT_BYTES_IMM(VPSRLDQ_UdqIb, sse_psrldq);
+AVX_PSHIFT_BYTES_IMM(VPSLLDQ_UdqIb, sse_pslldq);
 
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPSHUFHW_VdqWdqIbR(bxInstruction_c *i)
 {
@@ -239,14 +279,20 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPSHUFLW_VdqWdqIbR(bxInstruction_c
 
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPSHUFB_VdqHdqWdqR(bxInstruction_c *i)
 {
-  BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1());
-  BxPackedAvxRegister op2 = BX_READ_AVX_REG(i->src2()), result;
   unsigned len = i->getVL();
 
-  for (unsigned n=0; n < len; n++)
-    sse_pshufb(&result.avx128(n), &op1.avx128(n), &op2.avx128(n));
+  if (BX_HOST_AVX2 && len == BX_VL256) {
+    YMM_HOST_2OP(&BX_AVX_REG(i->dst()), &BX_AVX_REG(i->src1()), &BX_AVX_REG(i->src2()), _mm256_shuffle_epi8);
+  }
+  else {
+    BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1());
+    BxPackedAvxRegister op2 = BX_READ_AVX_REG(i->src2()), result;
 
-  BX_WRITE_AVX_REGZ(i->dst(), result, len);
+    for (unsigned n=0; n < len; n++)
+      sse_pshufb(&result.avx128(n), &op1.avx128(n), &op2.avx128(n));
+
+    BX_WRITE_AVX_REGZ(i->dst(), result, len);
+  }
 
   BX_NEXT_INSTR(i);
 }
@@ -346,6 +392,9 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPBROADCASTQ_VdqWq(bxInstruction_c
 
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVSXBW256_VdqWdqR(bxInstruction_c *i)
 {
+#if BX_HOST_AVX2
+  ymm_host_store(&BX_AVX_REG(i->dst()), _mm256_cvtepi8_epi16(xmm_host_load(&BX_READ_XMM_REG(i->src()))));
+#else
   BxPackedXmmRegister op = BX_READ_XMM_REG(i->src());
   BxPackedAvxRegister result;
 
@@ -353,12 +402,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVSXBW256_VdqWdqR(bxInstruction
     result.avx16u(n) = (Bit8s) op.xmmsbyte(n);
 
   BX_WRITE_AVX_REG(i->dst(), result);
+#endif
 
   BX_NEXT_INSTR(i);
 }
 
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVSXBD256_VdqWqR(bxInstruction_c *i)
 {
+#if BX_HOST_AVX2
+  ymm_host_store(&BX_AVX_REG(i->dst()), _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *) &BX_READ_XMM_REG(i->src()))));
+#else
   BxPackedAvxRegister result;
   BxPackedMmxRegister op;
 
@@ -375,12 +428,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVSXBD256_VdqWqR(bxInstruction_
   result.avx32u(7) = (Bit8s) MMXSB7(op);
 
   BX_WRITE_AVX_REG(i->dst(), result);
+#endif
 
   BX_NEXT_INSTR(i);
 }
 
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVSXBQ256_VdqWdR(bxInstruction_c *i)
 {
+#if BX_HOST_AVX2
+  ymm_host_store(&BX_AVX_REG(i->dst()), _mm256_cvtepi8_epi64(_mm_cvtsi32_si128(BX_READ_XMM_REG_LO_DWORD(i->src()))));
+#else
   BxPackedAvxRegister result;
   Bit32u val32 = BX_READ_XMM_REG_LO_DWORD(i->src());
 
@@ -390,12 +447,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVSXBQ256_VdqWdR(bxInstruction_
   result.avx64u(3) = (Bit8s) (val32 >> 24);
 
   BX_WRITE_AVX_REG(i->dst(), result);
+#endif
 
   BX_NEXT_INSTR(i);
 }
 
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVSXWD256_VdqWdqR(bxInstruction_c *i)
 {
+#if BX_HOST_AVX2
+  ymm_host_store(&BX_AVX_REG(i->dst()), _mm256_cvtepi16_epi32(xmm_host_load(&BX_READ_XMM_REG(i->src()))));
+#else
   BxPackedXmmRegister op = BX_READ_XMM_REG(i->src());
   BxPackedAvxRegister result;
 
@@ -409,12 +470,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVSXWD256_VdqWdqR(bxInstruction
   result.avx32u(7) = op.xmm16s(7);
 
   BX_WRITE_AVX_REG(i->dst(), result);
+#endif
 
   BX_NEXT_INSTR(i);
 }
 
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVSXWQ256_VdqWqR(bxInstruction_c *i)
 {
+#if BX_HOST_AVX2
+  ymm_host_store(&BX_AVX_REG(i->dst()), _mm256_cvtepi16_epi64(_mm_loadl_epi64((const __m128i *) &BX_READ_XMM_REG(i->src()))));
+#else
   BxPackedAvxRegister result;
   BxPackedMmxRegister op;
 
@@ -427,12 +492,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVSXWQ256_VdqWqR(bxInstruction_
   result.avx64u(3) = MMXSW3(op);
 
   BX_WRITE_AVX_REG(i->dst(), result);
+#endif
 
   BX_NEXT_INSTR(i);
 }
 
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVSXDQ256_VdqWdqR(bxInstruction_c *i)
 {
+#if BX_HOST_AVX2
+  ymm_host_store(&BX_AVX_REG(i->dst()), _mm256_cvtepi32_epi64(xmm_host_load(&BX_READ_XMM_REG(i->src()))));
+#else
   BxPackedXmmRegister op = BX_READ_XMM_REG(i->src());
   BxPackedAvxRegister result;
 
@@ -442,12 +511,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVSXDQ256_VdqWdqR(bxInstruction
   result.avx64u(3) = op.xmm32s(3);
 
   BX_WRITE_AVX_REG(i->dst(), result);
+#endif
 
   BX_NEXT_INSTR(i);
 }
 
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVZXBW256_VdqWdqR(bxInstruction_c *i)
 {
+#if BX_HOST_AVX2
+  ymm_host_store(&BX_AVX_REG(i->dst()), _mm256_cvtepu8_epi16(xmm_host_load(&BX_READ_XMM_REG(i->src()))));
+#else
   BxPackedXmmRegister op = BX_READ_XMM_REG(i->src());
   BxPackedAvxRegister result;
 
@@ -455,12 +528,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVZXBW256_VdqWdqR(bxInstruction
     result.avx16u(n) = op.xmmubyte(n);
 
   BX_WRITE_AVX_REG(i->dst(), result);
+#endif
 
   BX_NEXT_INSTR(i);
 }
 
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVZXBD256_VdqWqR(bxInstruction_c *i)
 {
+#if BX_HOST_AVX2
+  ymm_host_store(&BX_AVX_REG(i->dst()), _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) &BX_READ_XMM_REG(i->src()))));
+#else
   BxPackedAvxRegister result;
   BxPackedMmxRegister op;
 
@@ -477,12 +554,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVZXBD256_VdqWqR(bxInstruction_
   result.avx32u(7) = MMXUB7(op);
 
   BX_WRITE_AVX_REG(i->dst(), result);
+#endif
 
   BX_NEXT_INSTR(i);
 }
 
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVZXBQ256_VdqWdR(bxInstruction_c *i)
 {
+#if BX_HOST_AVX2
+  ymm_host_store(&BX_AVX_REG(i->dst()), _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(BX_READ_XMM_REG_LO_DWORD(i->src()))));
+#else
   BxPackedAvxRegister result;
   Bit32u val32 = BX_READ_XMM_REG_LO_DWORD(i->src());
 
@@ -492,12 +573,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVZXBQ256_VdqWdR(bxInstruction_
   result.avx64u(3) = (Bit8u) (val32 >> 24);
 
   BX_WRITE_AVX_REG(i->dst(), result);
+#endif
 
   BX_NEXT_INSTR(i);
 }
 
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVZXWD256_VdqWdqR(bxInstruction_c *i)
 {
+#if BX_HOST_AVX2
+  ymm_host_store(&BX_AVX_REG(i->dst()), _mm256_cvtepu16_epi32(xmm_host_load(&BX_READ_XMM_REG(i->src()))));
+#else
   BxPackedXmmRegister op = BX_READ_XMM_REG(i->src());
   BxPackedAvxRegister result;
 
@@ -511,12 +596,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVZXWD256_VdqWdqR(bxInstruction
   result.avx32u(7) = op.xmm16u(7);
 
   BX_WRITE_AVX_REG(i->dst(), result);
+#endif
 
   BX_NEXT_INSTR(i);
 }
 
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVZXWQ256_VdqWqR(bxInstruction_c *i)
 {
+#if BX_HOST_AVX2
+  ymm_host_store(&BX_AVX_REG(i->dst()), _mm256_cvtepu16_epi64(_mm_loadl_epi64((const __m128i *) &BX_READ_XMM_REG(i->src()))));
+#else
   BxPackedAvxRegister result;
   BxPackedMmxRegister op;
 
@@ -529,12 +618,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVZXWQ256_VdqWqR(bxInstruction_
   result.avx64u(3) = MMXUW3(op);
 
   BX_WRITE_AVX_REG(i->dst(), result);
+#endif
 
   BX_NEXT_INSTR(i);
 }
 
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVZXDQ256_VdqWdqR(bxInstruction_c *i)
 {
+#if BX_HOST_AVX2
+  ymm_host_store(&BX_AVX_REG(i->dst()), _mm256_cvtepu32_epi64(xmm_host_load(&BX_READ_XMM_REG(i->src()))));
+#else
   BxPackedXmmRegister op = BX_READ_XMM_REG(i->src());
   BxPackedAvxRegister result;
 
@@ -544,6 +637,7 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPMOVZXDQ256_VdqWdqR(bxInstruction
   result.avx64u(3) = op.xmm32u(3);
 
   BX_WRITE_AVX_REG(i->dst(), result);
+#endif
 
   BX_NEXT_INSTR(i);
 }
@@ -563,6 +657,10 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPALIGNR_VdqHdqWdqIbR(bxInstructio
 
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPERMD_VdqHdqWdqR(bxInstruction_c *i)
 {
+#if BX_HOST_AVX2
+  ymm_host_store(&BX_AVX_REG(i->dst()),
+    _mm256_permutevar8x32_epi32(ymm_host_load(&BX_AVX_REG(i->src2())), ymm_host_load(&BX_AVX_REG(i->src1()))));
+#else
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1());
   BxPackedAvxRegister op2 = BX_READ_AVX_REG(i->src2()), result;
 
@@ -576,6 +674,7 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VPERMD_VdqHdqWdqR(bxInstruction_c
   result.avx32u(7) = op2.avx32u(op1.avx32u(7) & 0x7);
 
   BX_WRITE_AVX_REG(i->dst(), result);
+#endif
 
   BX_NEXT_INSTR(i);
 }
@@ -191,14 +191,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VSQRTPS_VpsWpsR(bxInstruction_c *i
   BxPackedAvxRegister op = BX_READ_AVX_REG(i->src());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  if (! SSE_HOST_FP_2OP(&op.avx128(0), &op.avx128(0), len, BX_HOST_FP_SQRTPS)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < (4*len); n++) {
-    op.avx32u(n) = float32_sqrt(op.avx32u(n), status);
-  }
+    for (unsigned n=0; n < (4*len); n++) {
+      op.avx32u(n) = float32_sqrt(op.avx32u(n), status);
+    }
 
-  check_exceptionsSSE(status.float_exception_flags);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
   BX_WRITE_AVX_REGZ(i->dst(), op, len);
 
   BX_NEXT_INSTR(i);
@@ -210,14 +212,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VSQRTPD_VpdWpdR(bxInstruction_c *i
   BxPackedAvxRegister op = BX_READ_AVX_REG(i->src());
   unsigned len = i->getVL();
   
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  if (! SSE_HOST_FP_2OP(&op.avx128(0), &op.avx128(0), len, BX_HOST_FP_SQRTPD)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < (2*len); n++) {
-    op.avx64u(n) = float64_sqrt(op.avx64u(n), status);
-  }
+    for (unsigned n=0; n < (2*len); n++) {
+      op.avx64u(n) = float64_sqrt(op.avx64u(n), status);
+    }
 
-  check_exceptionsSSE(status.float_exception_flags);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_AVX_REGZ(i->dst(), op, len);
 
@@ -316,14 +320,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VADDPS_VpsHpsWpsR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  if (! SSE_HOST_FP_2OP(&op1.avx128(0), &op2.avx128(0), len, BX_HOST_FP_ADDPS)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_addps(&op1.avx128(n), &op2.avx128(n), status);
-  }
+    for (unsigned n=0; n < len; n++) {
+      sse_addps(&op1.avx128(n), &op2.avx128(n), status);
+    }
 
-  check_exceptionsSSE(status.float_exception_flags);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -336,14 +342,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VADDPD_VpdHpdWpdR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
   
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  if (! SSE_HOST_FP_2OP(&op1.avx128(0), &op2.avx128(0), len, BX_HOST_FP_ADDPD)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_addpd(&op1.avx128(n), &op2.avx128(n), status);
-  }
+    for (unsigned n=0; n < len; n++) {
+      sse_addpd(&op1.avx128(n), &op2.avx128(n), status);
+    }
 
-  check_exceptionsSSE(status.float_exception_flags);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -386,14 +394,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VMULPS_VpsHpsWpsR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  if (! SSE_HOST_FP_2OP(&op1.avx128(0), &op2.avx128(0), len, BX_HOST_FP_MULPS)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_mulps(&op1.avx128(n), &op2.avx128(n), status);
-  }
+    for (unsigned n=0; n < len; n++) {
+      sse_mulps(&op1.avx128(n), &op2.avx128(n), status);
+    }
 
-  check_exceptionsSSE(status.float_exception_flags);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -406,14 +416,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VMULPD_VpdHpdWpdR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  if (! SSE_HOST_FP_2OP(&op1.avx128(0), &op2.avx128(0), len, BX_HOST_FP_MULPD)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_mulpd(&op1.avx128(n), &op2.avx128(n), status);
-  }
+    for (unsigned n=0; n < len; n++) {
+      sse_mulpd(&op1.avx128(n), &op2.avx128(n), status);
+    }
 
-  check_exceptionsSSE(status.float_exception_flags);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -591,14 +603,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VSUBPS_VpsHpsWpsR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  if (! SSE_HOST_FP_2OP(&op1.avx128(0), &op2.avx128(0), len, BX_HOST_FP_SUBPS)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_subps(&op1.avx128(n), &op2.avx128(n), status);
-  }
+    for (unsigned n=0; n < len; n++) {
+      sse_subps(&op1.avx128(n), &op2.avx128(n), status);
+    }
 
-  check_exceptionsSSE(status.float_exception_flags);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -611,14 +625,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VSUBPD_VpdHpdWpdR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  if (! SSE_HOST_FP_2OP(&op1.avx128(0), &op2.avx128(0), len, BX_HOST_FP_SUBPD)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_subpd(&op1.avx128(n), &op2.avx128(n), status);
-  }
+    for (unsigned n=0; n < len; n++) {
+      sse_subpd(&op1.avx128(n), &op2.avx128(n), status);
+    }
 
-  check_exceptionsSSE(status.float_exception_flags);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -661,14 +677,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VMINPS_VpsHpsWpsR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  if (! SSE_HOST_FP_2OP(&op1.avx128(0), &op2.avx128(0), len, BX_HOST_FP_MINPS)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_minps(&op1.avx128(n), &op2.avx128(n), status);
-  }
+    for (unsigned n=0; n < len; n++) {
+      sse_minps(&op1.avx128(n), &op2.avx128(n), status);
+    }
 
-  check_exceptionsSSE(status.float_exception_flags);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -681,14 +699,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VMINPD_VpdHpdWpdR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  if (! SSE_HOST_FP_2OP(&op1.avx128(0), &op2.avx128(0), len, BX_HOST_FP_MINPD)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_minpd(&op1.avx128(n), &op2.avx128(n), status);
-  }
+    for (unsigned n=0; n < len; n++) {
+      sse_minpd(&op1.avx128(n), &op2.avx128(n), status);
+    }
 
-  check_exceptionsSSE(status.float_exception_flags);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -733,14 +753,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VDIVPS_VpsHpsWpsR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  if (! SSE_HOST_FP_2OP(&op1.avx128(0), &op2.avx128(0), len, BX_HOST_FP_DIVPS)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_divps(&op1.avx128(n), &op2.avx128(n), status);
-  }
+    for (unsigned n=0; n < len; n++) {
+      sse_divps(&op1.avx128(n), &op2.avx128(n), status);
+    }
 
-  check_exceptionsSSE(status.float_exception_flags);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -753,14 +775,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VDIVPD_VpdHpdWpdR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  if (! SSE_HOST_FP_2OP(&op1.avx128(0), &op2.avx128(0), len, BX_HOST_FP_DIVPD)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_divpd(&op1.avx128(n), &op2.avx128(n), status);
-  }
+    for (unsigned n=0; n < len; n++) {
+      sse_divpd(&op1.avx128(n), &op2.avx128(n), status);
+    }
 
-  check_exceptionsSSE(status.float_exception_flags);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -803,14 +827,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VMAXPS_VpsHpsWpsR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  if (! SSE_HOST_FP_2OP(&op1.avx128(0), &op2.avx128(0), len, BX_HOST_FP_MAXPS)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_maxps(&op1.avx128(n), &op2.avx128(n), status);
-  }
+    for (unsigned n=0; n < len; n++) {
+      sse_maxps(&op1.avx128(n), &op2.avx128(n), status);
+    }
 
-  check_exceptionsSSE(status.float_exception_flags);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -823,14 +849,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VMAXPD_VpdHpdWpdR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  if (! SSE_HOST_FP_2OP(&op1.avx128(0), &op2.avx128(0), len, BX_HOST_FP_MAXPD)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_maxpd(&op1.avx128(n), &op2.avx128(n), status);
-  }
+    for (unsigned n=0; n < len; n++) {
+      sse_maxpd(&op1.avx128(n), &op2.avx128(n), status);
+    }
 
-  check_exceptionsSSE(status.float_exception_flags);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -875,14 +903,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VHADDPD_VpdHpdWpdR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  if (! SSE_HOST_FP_2OP(&op1.avx128(0), &op2.avx128(0), len, BX_HOST_FP_HADDPD)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_haddpd(&op1.avx128(n), &op2.avx128(n), status);
-  }
+    for (unsigned n=0; n < len; n++) {
+      sse_haddpd(&op1.avx128(n), &op2.avx128(n), status);
+    }
 
-  check_exceptionsSSE(status.float_exception_flags);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -895,14 +925,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VHADDPS_VpsHpsWpsR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  if (! SSE_HOST_FP_2OP(&op1.avx128(0), &op2.avx128(0), len, BX_HOST_FP_HADDPS)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_haddps(&op1.avx128(n), &op2.avx128(n), status);
-  }
+    for (unsigned n=0; n < len; n++) {
+      sse_haddps(&op1.avx128(n), &op2.avx128(n), status);
+    }
 
-  check_exceptionsSSE(status.float_exception_flags);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -915,14 +947,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VHSUBPD_VpdHpdWpdR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  if (! SSE_HOST_FP_2OP(&op1.avx128(0), &op2.avx128(0), len, BX_HOST_FP_HSUBPD)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_hsubpd(&op1.avx128(n), &op2.avx128(n), status);
-  }
+    for (unsigned n=0; n < len; n++) {
+      sse_hsubpd(&op1.avx128(n), &op2.avx128(n), status);
+    }
 
-  check_exceptionsSSE(status.float_exception_flags);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -935,14 +969,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VHSUBPS_VpsHpsWpsR(bxInstruction_c
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  if (! SSE_HOST_FP_2OP(&op1.avx128(0), &op2.avx128(0), len, BX_HOST_FP_HSUBPS)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_hsubps(&op1.avx128(n), &op2.avx128(n), status);
-  }
+    for (unsigned n=0; n < len; n++) {
+      sse_hsubps(&op1.avx128(n), &op2.avx128(n), status);
+    }
 
-  check_exceptionsSSE(status.float_exception_flags);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -1040,14 +1076,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VADDSUBPD_VpdHpdWpdR(bxInstruction
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  if (! SSE_HOST_FP_2OP(&op1.avx128(0), &op2.avx128(0), len, BX_HOST_FP_ADDSUBPD)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_addsubpd(&op1.avx128(n), &op2.avx128(n), status);
-  }
+    for (unsigned n=0; n < len; n++) {
+      sse_addsubpd(&op1.avx128(n), &op2.avx128(n), status);
+    }
 
-  check_exceptionsSSE(status.float_exception_flags);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
@@ -1060,14 +1098,16 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VADDSUBPS_VpsHpsWpsR(bxInstruction
   BxPackedAvxRegister op1 = BX_READ_AVX_REG(i->src1()), op2 = BX_READ_AVX_REG(i->src2());
   unsigned len = i->getVL();
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  if (! SSE_HOST_FP_2OP(&op1.avx128(0), &op2.avx128(0), len, BX_HOST_FP_ADDSUBPS)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  for (unsigned n=0; n < len; n++) {
-    sse_addsubps(&op1.avx128(n), &op2.avx128(n), status);
-  }
+    for (unsigned n=0; n < len; n++) {
+      sse_addsubps(&op1.avx128(n), &op2.avx128(n), status);
+    }
 
-  check_exceptionsSSE(status.float_exception_flags);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_AVX_REGZ(i->dst(), op1, len);
 
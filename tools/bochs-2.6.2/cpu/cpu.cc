@@ -24,29 +24,6 @@
 #include "cpu.h"
 #define LOG_THIS BX_CPU_THIS_PTR
 
-#define InstrumentICACHE 0
-
-#if InstrumentICACHE
-static unsigned iCacheLookups=0;
-static unsigned iCacheMisses=0;
-
-#define InstrICache_StatsMask 0xffffff
-
-#define InstrICache_Stats() {\
-  if ((iCacheLookups & InstrICache_StatsMask) == 0) { \
-    BX_INFO(("ICACHE lookups: %u, misses: %u, hit rate = %6.2f%% ", \
-          iCacheLookups, \
-          iCacheMisses,  \
-          (iCacheLookups-iCacheMisses) * 100.0f / iCacheLookups)); \
-    iCacheLookups = iCacheMisses = 0; \
-  } \
-}
-#define InstrICache_Increment(v) (v)++
-#else
-#define InstrICache_Stats()
-#define InstrICache_Increment(v)
-#endif
-
 void BX_CPU_C::cpu_loop(void)
 {
 #if BX_DEBUGGER
@@ -208,6 +185,64 @@ void BX_CPU_C::cpu_run_trace(void)
 #endif // BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
 }
 
+// Executes traces until at least 'quantum' instructions were retired, the
+// processor was halted, entered a PAUSE spin loop or the round was cancelled.
+// Called on the host thread dedicated to this processor. Returns number of
+// retired instructions.
+Bit32u BX_CPU_C::cpu_run_quantum(Bit32u quantum)
+{
+  Bit64u icount_start = BX_CPU_THIS_PTR icount;
+
+  while ((Bit32u)(BX_CPU_THIS_PTR icount - icount_start) < quantum) {
+    if (BX_CPU_THIS_PTR smp_flush_request)
+      handle_smp_flush_request();
+
+    // the start-up IPI changes the processor state from another thread,
+    // never touch the processor state until it was delivered
+    if (BX_CPU_THIS_PTR activity_state == BX_ACTIVITY_STATE_WAIT_FOR_SIPI)
+      break;
+
+    // events signalled by other threads might be lost when racing with
+    // async_event update by this processor, re-evaluate them here
+    if (unmasked_events_pending() || (BX_HRQ && BX_CPU_ID == BX_BOOTSTRAP_PROCESSOR))
+      BX_CPU_THIS_PTR async_event |= 1;
+
+    Bit64u icount = BX_CPU_THIS_PTR icount_last_sync = BX_CPU_THIS_PTR icount;
+    cpu_run_trace();
+    unlock_bus();
+
+    if (BX_CPU_THIS_PTR icount == icount) break; // the processor is halted
+
+    // the processor spins on a lock, yield the rest of the quantum
+    if (BX_CPU_THIS_PTR spin_loop) {
+      BX_CPU_THIS_PTR spin_loop = 0;
+      break;
+    }
+
+    if (bx_pc_system.smp_stop_round || bx_pc_system.kill_bochs_request)
+      break;
+  }
+
+  return (Bit32u)(BX_CPU_THIS_PTR icount - icount_start);
+}
+
+void BX_CPU_C::request_smp_flush(Bit32u what)
+{
+  bx_atomic_or32(&BX_CPU_THIS_PTR smp_flush_request, what);
+  bx_atomic_or32(&BX_CPU_THIS_PTR async_event, BX_ASYNC_EVENT_STOP_TRACE);
+}
+
+void BX_CPU_C::handle_smp_flush_request(void)
+{
+  Bit32u what = bx_atomic_and32(&BX_CPU_THIS_PTR smp_flush_request, 0);
+
+  if (what & BX_SMP_FLUSH_ICACHE)
+    BX_CPU_THIS_PTR iCache.flushICacheEntries();
+
+  if (what & BX_SMP_FLUSH_TLB)
+    TLB_flush();
+}
+
 #endif
 
 bxICacheEntry_c* BX_CPU_C::getICacheEntry(void)
@@ -219,9 +254,6 @@ bxICacheEntry_c* BX_CPU_C::getICacheEntry(void)
     eipBiased = RIP + BX_CPU_THIS_PTR eipPageBias;
   }
 
-  InstrICache_Increment(iCacheLookups);
-  InstrICache_Stats();
-
   bx_phy_address pAddr = BX_CPU_THIS_PTR pAddrFetchPage + eipBiased;
   bxICacheEntry_c *entry = BX_CPU_THIS_PTR iCache.find_entry(pAddr, BX_CPU_THIS_PTR fetchModeMask);
 
@@ -229,16 +261,20 @@ bxICacheEntry_c* BX_CPU_C::getICacheEntry(void)
   {
     // iCache miss. No validated instruction with matching fetch parameters
     // is in the iCache.
-    InstrICache_Increment(iCacheMisses);
+    BX_CPU_THIS_PTR iCache.stats.misses++;
     entry = serveICacheMiss(entry, (Bit32u) eipBiased, pAddr);
   }
+  else {
+    BX_CPU_THIS_PTR iCache.stats.hits++;
+  }
 
   return entry;
 }
 
 #if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
 
-// The function is called after taken branch instructions and tries to link the branch to the next trace
+// The function is called after taken branch instructions and at the end of
+// traces falling through into the next one and tries to link to the next trace
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::linkTrace(bxInstruction_c *i)
 {
 #if BX_SUPPORT_SMP
@@ -273,14 +309,12 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::linkTrace(bxInstruction_c *i)
     return;
   }
 
-  InstrICache_Increment(iCacheLookups);
-  InstrICache_Stats();
-
   bx_phy_address pAddr = BX_CPU_THIS_PTR pAddrFetchPage + eipBiased;
   bxICacheEntry_c *entry = BX_CPU_THIS_PTR iCache.find_entry(pAddr, BX_CPU_THIS_PTR fetchModeMask);
 
   if (entry != NULL) // link traces - handle only hit cases
   {
+    BX_CPU_THIS_PTR iCache.stats.hits++;
     i->setNextTrace(entry->i);
     i = entry->i;
     BX_EXECUTE_INSTRUCTION(i);
@@ -772,6 +772,46 @@ typedef struct {
 
 #define PAGE_OFFSET(laddr) ((Bit32u)(laddr) & 0xfff)
 
+// BX_STLB_SETS/BX_STLB_WAYS: geometry of the second level TLB which
+//   refills the direct mapped TLB above. Its entries are tagged with the
+//   address space they belong to (paging controls, PCID, VPID/ASID and
+//   the EPT/nested paging root) and survive CR3 reloads and VM entries.
+// BX_STLB_CONTEXTS: number of address spaces tracked at the same time.
+
+#define BX_STLB_SETS     512
+#define BX_STLB_WAYS     4
+#define BX_STLB_CONTEXTS 16
+#define BX_STLB_SET_OF(lpf) ((unsigned)((lpf) >> 12) & (BX_STLB_SETS-1))
+
+typedef struct {
+  bx_TLB_entry tlb;
+  Bit32u stamp;         // stamp of the owning context, 0 if invalid
+} bx_STLB_entry;
+
+typedef struct {
+  Bit32u ctrl;          // paging controls from CR0/CR4/EFER
+  Bit32u asid;          // VPID or ASID of the guest, 0 for the host
+  Bit32u pcid;          // PCID or BX_STLB_GLOBAL_PCID for global pages
+  Bit32u stamp;         // entries carrying another stamp are stale
+  bx_phy_address root;  // EPT pointer or nested paging CR3
+  Bit32u lru;
+} bx_STLB_context;
+
+#define BX_STLB_GLOBAL_PCID 0x1000
+
+// BX_PSC_SIZE: Number of entries in each of the PDE, PDPTE and PML4
+//   paging-structure caches. They hold the non-leaf entries of PAE and
+//   long mode page walks so a TLB miss only has to read the PTE.
+
+#define BX_PSC_SIZE 64
+
+typedef struct {
+  bx_address key;         // linear address bits above the mapped region
+  bx_phy_address ppf;     // paging structure referenced by the entry
+  Bit32u combined_access; // R/W and U/S of this and the upper levels
+  Bit32u nx;              // set if this or an upper level has XD
+} bx_PSC_entry;
+
 #include "icache.h"
 
 // general purpose register
@@ -1132,13 +1172,23 @@ public: // for now...
   Bit32u  event_mask;
   Bit32u  async_event;
 
+  // with threaded SMP the events could be signalled by other processors
+  // running on their own host threads
   BX_SMF BX_CPP_INLINE void signal_event(Bit32u event) {
+#if BX_SUPPORT_SMP
+    bx_atomic_or32(&BX_CPU_THIS_PTR pending_event, event);
+#else
     BX_CPU_THIS_PTR pending_event |= event;
+#endif
     if (! is_masked_event(event)) BX_CPU_THIS_PTR async_event = 1;
   }
 
   BX_SMF BX_CPP_INLINE void clear_event(Bit32u event) {
+#if BX_SUPPORT_SMP
+    bx_atomic_and32(&BX_CPU_THIS_PTR pending_event, ~event);
+#else
     BX_CPU_THIS_PTR pending_event &= ~event;
+#endif
   }
 
   BX_SMF BX_CPP_INLINE void mask_event(Bit32u event) {
@@ -1166,6 +1216,30 @@ public: // for now...
 
 #define BX_ASYNC_EVENT_STOP_TRACE (1<<31)
 
+#if BX_SUPPORT_SMP
+  // TLB and trace cache flushes requested while the processors are running
+  // on their own host threads, performed by the processor between traces
+  volatile Bit32u smp_flush_request;
+#define BX_SMP_FLUSH_TLB    (1<<0)
+#define BX_SMP_FLUSH_ICACHE (1<<1)
+
+  // the processor holds bx_pc_system.bus_mutex for locked RMW access
+  bx_bool bus_locked;
+
+  // PAUSE loop detection: a processor spinning on a lock gives up the
+  // rest of its quantum so the lock holder can make progress
+  unsigned spin_threshold; // back to back PAUSEs making a spin loop, 0 = off
+  Bit32u pause_count;      // back to back PAUSEs executed so far
+  Bit64u pause_icount;     // icount of the last PAUSE instruction
+  bx_bool spin_loop;       // spin loop detected, quantum has to be yielded
+
+  struct {
+    Bit64u pauses;
+    Bit64u spinLoops;
+  } spin_stats;
+#define BX_SPIN_LOOP_GAP 64 // max instructions between two PAUSEs of a spin loop
+#endif
+
 #if BX_X86_DEBUGGER
   bx_bool  in_repeat;
 #endif
@@ -1224,6 +1298,29 @@ public: // for now...
 #if BX_CPU_LEVEL >= 5
     bx_bool split_large;
 #endif
+    bx_STLB_entry stlb[BX_STLB_SETS][BX_STLB_WAYS];
+    Bit8u stlb_victim[BX_STLB_SETS];
+    bx_STLB_context context[BX_STLB_CONTEXTS];
+    unsigned cur_context, cur_global_context;
+    Bit32u next_stamp, lru_clock;
+#if BX_CPU_LEVEL >= 5
+    bx_bool stlb_large;
+#endif
+
+    struct {
+      Bit64u misses;          // translations not found in the first level
+      Bit64u conflictMisses;  // ... because another page owned the slot
+      Bit64u stlbHits;
+      Bit64u pageWalks;
+      Bit64u stlbEvictions;   // live second level entries replaced
+      Bit64u contextSwitches; // address space changes kept in the STLB
+      Bit64u flushes;         // full flushes
+      Bit64u nonGlobalFlushes;
+      Bit64u contextFlushes;  // CR3 reloads invalidating one address space
+      Bit64u invlpgs;
+      Bit64u flushedEntries;  // first level entries discarded by flushes
+      Bit64u pscHits[3];      // walks started below PDE, PDPTE or PML4
+    } stats;
   } TLB;
 
 #define BX_TLB_ENTRY_OF(lpf) (&BX_CPU_THIS_PTR TLB.entry[BX_TLB_INDEX_OF((lpf), 0)])
@@ -1232,6 +1329,12 @@ public: // for now...
   struct {
     Bit64u entry[4];
   } PDPTR_CACHE;
+
+  // paging-structure caches, indexed by BX_LEVEL_PDE..BX_LEVEL_PML4 less 1
+  struct {
+    bx_PSC_entry entry[3][BX_PSC_SIZE];
+    bx_bool used;
+  } PSC;
 #endif
 
   // An instruction cache.  Each entry should be exactly 32 bytes, and
@@ -3585,6 +3688,7 @@ public: // for now...
   BX_SMF BX_INSF_TYPE BxError(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
 #if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
   BX_SMF BX_INSF_TYPE BxEndTrace(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
+  BX_SMF BX_INSF_TYPE BxEndTraceLink(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
 #endif
 #if BX_CPU_LEVEL >= 6
   BX_SMF BX_INSF_TYPE BxNoSSE(bxInstruction_c *) BX_CPP_AttrRegparmN(1);
@@ -3601,6 +3705,10 @@ public: // for now...
 #if BX_SUPPORT_AVX
   BX_SMF bx_address BxResolveGatherD(bxInstruction_c *, unsigned) BX_CPP_AttrRegparmN(2);
   BX_SMF bx_address BxResolveGatherQ(bxInstruction_c *, unsigned) BX_CPP_AttrRegparmN(2);
+#if BX_DEBUGGER == 0 && BX_INSTRUMENTATION == 0
+  BX_SMF void FastGather(bxInstruction_c *i, BxPackedAvxRegister *dest, BxPackedAvxRegister *mask,
+       unsigned num_elements, unsigned len, bx_bool qindex);
+#endif
 #endif
 // <TAG-CLASS-CPU-END>
 
@@ -3634,6 +3742,9 @@ public: // for now...
   BX_SMF void cpu_loop(void);
 #if BX_SUPPORT_SMP
   BX_SMF void cpu_run_trace(void);
+  BX_SMF Bit32u cpu_run_quantum(Bit32u quantum);
+  BX_SMF void request_smp_flush(Bit32u what);
+  BX_SMF void handle_smp_flush_request(void);
 #endif
   BX_SMF bx_bool handleAsyncEvent(void);
   BX_SMF bx_bool handleWaitForEvent(void);
@@ -3645,6 +3756,8 @@ public: // for now...
 #endif
   BX_SMF void boundaryFetch(const Bit8u *fetchPtr, unsigned remainingInPage, bxInstruction_c *);
   BX_SMF bxICacheEntry_c *serveICacheMiss(bxICacheEntry_c *entry, Bit32u eipBiased, bx_phy_address pAddr);
+  BX_SMF void allocICache(void);
+  static void icache_runtime_config_handler(void *);
   BX_SMF bxICacheEntry_c* getICacheEntry(void);
   BX_SMF bx_bool mergeTraces(bxICacheEntry_c *entry, bxInstruction_c *i, bx_phy_address pAddr);
 #if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
@@ -3949,24 +4062,20 @@ public: // for now...
        bx_descriptor_t *descriptor, bx_address rip, Bit8u cpl);
 
 #if BX_SUPPORT_REPEAT_SPEEDUPS
-  BX_SMF Bit32u FastRepMOVSB(bxInstruction_c *i, unsigned srcSeg, bx_address srcOff,
-       unsigned dstSeg, bx_address dstOff, Bit32u  byteCount);
-  BX_SMF Bit32u FastRepMOVSW(bxInstruction_c *i, unsigned srcSeg, bx_address srcOff,
-       unsigned dstSeg, bx_address dstOff, Bit32u  wordCount);
-  BX_SMF Bit32u FastRepMOVSD(bxInstruction_c *i, unsigned srcSeg, bx_address srcOff,
-       unsigned dstSeg, bx_address dstOff, Bit32u dwordCount);
-
-  BX_SMF Bit32u FastRepSTOSB(bxInstruction_c *i, unsigned dstSeg, bx_address dstOff,
-       Bit8u  val, Bit32u  byteCount);
-  BX_SMF Bit32u FastRepSTOSW(bxInstruction_c *i, unsigned dstSeg, bx_address dstOff,
-       Bit16u val, Bit32u  wordCount);
-  BX_SMF Bit32u FastRepSTOSD(bxInstruction_c *i, unsigned dstSeg, bx_address dstOff,
-       Bit32u val, Bit32u dwordCount);
-
-  BX_SMF Bit32u FastRepINSW(bxInstruction_c *i, bx_address dstOff,
-       Bit16u port, Bit32u wordCount);
-  BX_SMF Bit32u FastRepOUTSW(bxInstruction_c *i, unsigned srcSeg, bx_address srcOff,
-       Bit16u port, Bit32u wordCount);
+  BX_SMF BX_CPP_INLINE bx_address FastRepAsizeMask(bxInstruction_c *i);
+  BX_SMF Bit32u FastRepGetHostAddr(bxInstruction_c *i, unsigned seg, bx_address offset,
+       unsigned len, unsigned rw, Bit8u **hostAddr);
+  BX_SMF Bit32u FastRepLimitCount(bxInstruction_c *i, Bit32u count);
+  BX_SMF void FastRepAdvance(bxInstruction_c *i, Bit32u count, unsigned len, unsigned regs);
+  BX_SMF void FastRepCompareFlags(Bit64u op1, Bit64u op2, unsigned len);
+
+  BX_SMF Bit32u FastRepMOVS(bxInstruction_c *i, unsigned len);
+  BX_SMF Bit32u FastRepSTOS(bxInstruction_c *i, unsigned len);
+  BX_SMF Bit32u FastRepLODS(bxInstruction_c *i, unsigned len);
+  BX_SMF Bit32u FastRepCMPS(bxInstruction_c *i, unsigned len);
+  BX_SMF Bit32u FastRepSCAS(bxInstruction_c *i, unsigned len);
+  BX_SMF Bit32u FastRepINS(bxInstruction_c *i, unsigned len);
+  BX_SMF Bit32u FastRepOUTS(bxInstruction_c *i, unsigned len);
 #endif
 
   BX_SMF void repeat(bxInstruction_c *i, BxRepIterationPtr_tR execute) BX_CPP_AttrRegparmN(2);
@@ -4014,7 +4123,21 @@ public: // for now...
   BX_SMF void TLB_flushNonGlobal(void);
 #endif
   BX_SMF void TLB_flush(void);
+  BX_SMF void TLB_flushL1(bx_bool keep_global);
+  BX_SMF void TLB_flushContext(void);
+  BX_SMF void TLB_flushASID(Bit32u asid, bx_bool keep_global);
   BX_SMF void TLB_invlpg(bx_address laddr);
+  BX_SMF void STLB_init(void);
+  BX_SMF Bit32u STLB_newStamp(void);
+  BX_SMF unsigned STLB_findContext(unsigned hint, Bit32u ctrl, Bit32u asid, Bit32u pcid, bx_phy_address root);
+  BX_SMF void STLB_switchContext(void);
+  BX_SMF bx_STLB_entry *STLB_lookup(bx_address lpf);
+  BX_SMF void STLB_insert(const bx_TLB_entry *tlbEntry);
+#if BX_CPU_LEVEL >= 6
+  BX_SMF void PSC_flush(void);
+  BX_SMF int PSC_lookup(bx_address laddr, int max_level, bx_phy_address &ppf, Bit32u &combined_access, Bit32u &nx);
+  BX_SMF void PSC_insert(bx_address laddr, int level, bx_phy_address ppf, Bit32u combined_access, Bit32u nx);
+#endif
   BX_SMF void inhibit_interrupts(unsigned mask);
   BX_SMF bx_bool interrupts_inhibited(unsigned mask);
   BX_SMF const char *strseg(bx_segment_reg_t *seg);
@@ -4034,7 +4157,7 @@ public: // for now...
 
   BX_SMF bx_bool SetCR0(bxInstruction_c *i, bx_address val);
   BX_SMF bx_bool check_CR0(bx_address val) BX_CPP_AttrRegparmN(1);
-  BX_SMF bx_bool SetCR3(bx_address val) BX_CPP_AttrRegparmN(1);
+  BX_SMF bx_bool SetCR3(bx_address val, bx_bool noflush = 0) BX_CPP_AttrRegparmN(2);
 #if BX_CPU_LEVEL >= 5
   BX_SMF bx_bool SetCR4(bxInstruction_c *i, bx_address val);
   BX_SMF bx_bool check_CR4(bx_address val) BX_CPP_AttrRegparmN(1);
@@ -4222,6 +4345,28 @@ public: // for now...
   BX_SMF BX_CPP_INLINE void sync_icount(void) { BX_CPU_THIS_PTR icount_last_sync = BX_CPU_THIS_PTR icount; }
   BX_SMF BX_CPP_INLINE Bit64u get_icount_last_sync(void) { return BX_CPU_THIS_PTR icount_last_sync; }
 
+#if BX_SUPPORT_SMP
+  // Locked read-modify-write memory access when the processors are running
+  // on their own host threads. The bus is released by the processor thread
+  // loop right after completion of the current instruction.
+  BX_SMF BX_CPP_INLINE void lock_bus(void) {
+    if (bx_pc_system.smp_threaded && ! BX_CPU_THIS_PTR bus_locked) {
+      BX_LOCK(bx_pc_system.bus_mutex);
+      BX_CPU_THIS_PTR bus_locked = 1;
+      BX_CPU_THIS_PTR async_event |= BX_ASYNC_EVENT_STOP_TRACE;
+    }
+  }
+  BX_SMF BX_CPP_INLINE void unlock_bus(void) {
+    if (BX_CPU_THIS_PTR bus_locked) {
+      BX_CPU_THIS_PTR bus_locked = 0;
+      BX_UNLOCK(bx_pc_system.bus_mutex);
+    }
+  }
+#define BX_CPU_LOCK_BUS() BX_CPU_THIS_PTR lock_bus()
+#else
+#define BX_CPU_LOCK_BUS()
+#endif
+
   BX_SMF BX_CPP_INLINE bx_address get_instruction_pointer(void);
 
   BX_SMF BX_CPP_INLINE Bit32u get_eip(void) { return (BX_CPU_THIS_PTR gen_reg[BX_32BIT_REG_EIP].dword.erx); }
@@ -4572,6 +4717,30 @@ BX_CPP_INLINE bx_address BX_CPU_C::get_laddr(unsigned seg, bx_address offset)
   return get_laddr32(seg, (Bit32u) offset);
 }
 
+#if BX_SUPPORT_REPEAT_SPEEDUPS
+// Returns the mask of the string instruction address size
+BX_CPP_INLINE bx_address BX_CPU_C::FastRepAsizeMask(bxInstruction_c *i)
+{
+#if BX_SUPPORT_X86_64
+  if (i->as64L()) return BX_CONST64(0xffffffffffffffff);
+#endif
+  return i->as32L() ? 0xffffffff : 0xffff;
+}
+
+// index registers updated by BX_CPU_C::FastRepAdvance()
+#define BX_FAST_REP_RSI 0x1
+#define BX_FAST_REP_RDI 0x2
+
+// Advances an index register by delta within the address size, 16-bit
+// address size leaves the upper part of the register untouched
+#define FAST_REP_ADVANCE(reg, delta, mask) {                         \
+  if ((mask) == 0xffff)                                             \
+    (reg) = ((reg) & ~((bx_address) 0xffff)) | (((reg) + (delta)) & 0xffff); \
+  else                                                              \
+    (reg) = ((reg) + (delta)) & (mask);                             \
+}
+#endif
+
 BX_CPP_INLINE Bit8u BX_CPU_C::get_reg8l(unsigned reg)
 {
   assert(reg < BX_GENERAL_REGISTERS);
@@ -28,6 +28,8 @@
 
 #if BX_CPU_LEVEL >= 6
 
+#include "simd_host.h"
+
 // 3-byte opcodes
 
 #define CRC32_POLYNOMIAL BX_CONST64(0x11edc6f41)
@@ -72,51 +74,97 @@ static Bit32u mod2_64bit(Bit64u divisor, Bit64u dividend)
   return (Bit32u) remainder;
 }
 
+#if BX_HOST_RUNTIME_ISA
+
+// host SSE4.2 CRC32, used when the host processor reports it
+
+static const bx_bool host_crc32 = (bx_host_cpuid_ext_features() & BX_CPUID_EXT_SSE4_2) != 0;
+
+BX_HOST_TARGET("sse4.2") static Bit32u HostCRC32_8(Bit32u crc, Bit8u data)
+{
+  return _mm_crc32_u8(crc, data);
+}
+
+BX_HOST_TARGET("sse4.2") static Bit32u HostCRC32_16(Bit32u crc, Bit16u data)
+{
+  return _mm_crc32_u16(crc, data);
+}
+
+BX_HOST_TARGET("sse4.2") static Bit32u HostCRC32_32(Bit32u crc, Bit32u data)
+{
+  return _mm_crc32_u32(crc, data);
+}
+
+#endif
+
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::CRC32_GdEbR(bxInstruction_c *i)
 {
   Bit8u op1 = BX_READ_8BIT_REGx(i->src(), i->extend8bitL());
-
   Bit32u op2 = BX_READ_32BIT_REG(i->dst());
-  op2 = BitReflect32(op2);
 
-  Bit64u tmp1 = ((Bit64u) BitReflect8 (op1)) << 32;
-  Bit64u tmp2 = ((Bit64u) op2) <<  8;
-  Bit64u tmp3 = tmp1 ^ tmp2;
-  op2 = mod2_64bit(CRC32_POLYNOMIAL, tmp3);
+#if BX_HOST_RUNTIME_ISA
+  if (host_crc32)
+    op2 = HostCRC32_8(op2, op1);
+  else
+#endif
+  {
+    op2 = BitReflect32(op2);
+
+    Bit64u tmp1 = ((Bit64u) BitReflect8 (op1)) << 32;
+    Bit64u tmp2 = ((Bit64u) op2) <<  8;
+    Bit64u tmp3 = tmp1 ^ tmp2;
+    op2 = BitReflect32(mod2_64bit(CRC32_POLYNOMIAL, tmp3));
+  }
 
-  BX_WRITE_32BIT_REGZ(i->dst(), BitReflect32(op2));
+  BX_WRITE_32BIT_REGZ(i->dst(), op2);
 
   BX_NEXT_INSTR(i);
 }
 
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::CRC32_GdEwR(bxInstruction_c *i)
 {
-  Bit32u op2 = BX_READ_32BIT_REG(i->dst());
-  op2 = BitReflect32(op2);
   Bit16u op1 = BX_READ_16BIT_REG(i->src());
+  Bit32u op2 = BX_READ_32BIT_REG(i->dst());
 
-  Bit64u tmp1 = ((Bit64u) BitReflect16(op1)) << 32;
-  Bit64u tmp2 = ((Bit64u) op2) << 16;
-  Bit64u tmp3 = tmp1 ^ tmp2;
-  op2 = mod2_64bit(CRC32_POLYNOMIAL, tmp3);
+#if BX_HOST_RUNTIME_ISA
+  if (host_crc32)
+    op2 = HostCRC32_16(op2, op1);
+  else
+#endif
+  {
+    op2 = BitReflect32(op2);
+
+    Bit64u tmp1 = ((Bit64u) BitReflect16(op1)) << 32;
+    Bit64u tmp2 = ((Bit64u) op2) << 16;
+    Bit64u tmp3 = tmp1 ^ tmp2;
+    op2 = BitReflect32(mod2_64bit(CRC32_POLYNOMIAL, tmp3));
+  }
 
-  BX_WRITE_32BIT_REGZ(i->dst(), BitReflect32(op2));
+  BX_WRITE_32BIT_REGZ(i->dst(), op2);
 
   BX_NEXT_INSTR(i);
 }
 
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::CRC32_GdEdR(bxInstruction_c *i)
 {
-  Bit32u op2 = BX_READ_32BIT_REG(i->dst());
-  op2 = BitReflect32(op2);
   Bit32u op1 = BX_READ_32BIT_REG(i->src());
+  Bit32u op2 = BX_READ_32BIT_REG(i->dst());
 
-  Bit64u tmp1 = ((Bit64u) BitReflect32(op1)) << 32;
-  Bit64u tmp2 = ((Bit64u) op2) << 32;
-  Bit64u tmp3 = tmp1 ^ tmp2;
-  op2 = mod2_64bit(CRC32_POLYNOMIAL, tmp3);
+#if BX_HOST_RUNTIME_ISA
+  if (host_crc32)
+    op2 = HostCRC32_32(op2, op1);
+  else
+#endif
+  {
+    op2 = BitReflect32(op2);
+
+    Bit64u tmp1 = ((Bit64u) BitReflect32(op1)) << 32;
+    Bit64u tmp2 = ((Bit64u) op2) << 32;
+    Bit64u tmp3 = tmp1 ^ tmp2;
+    op2 = BitReflect32(mod2_64bit(CRC32_POLYNOMIAL, tmp3));
+  }
 
-  BX_WRITE_32BIT_REGZ(i->dst(), BitReflect32(op2));
+  BX_WRITE_32BIT_REGZ(i->dst(), op2);
 
   BX_NEXT_INSTR(i);
 }
@@ -125,20 +173,31 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::CRC32_GdEdR(bxInstruction_c *i)
 
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::CRC32_GdEqR(bxInstruction_c *i)
 {
-  Bit32u op2 = BX_READ_32BIT_REG(i->dst());
-  op2 = BitReflect32(op2);
   Bit64u op1 = BX_READ_64BIT_REG(i->src());
+  Bit32u op2 = BX_READ_32BIT_REG(i->dst());
 
-  Bit64u tmp1 = ((Bit64u) BitReflect32(op1 & 0xffffffff)) << 32;
-  Bit64u tmp2 = ((Bit64u) op2) << 32;
-  Bit64u tmp3 = tmp1 ^ tmp2;
-  op2  = mod2_64bit(CRC32_POLYNOMIAL, tmp3);
-  tmp1 = ((Bit64u) BitReflect32(op1 >> 32)) << 32;
-  tmp2 = ((Bit64u) op2) << 32;
-  tmp3 = tmp1 ^ tmp2;
-  op2  = mod2_64bit(CRC32_POLYNOMIAL, tmp3);
+#if BX_HOST_RUNTIME_ISA
+  if (host_crc32) {
+    // CRC32 of a qword is the CRC32 of its low and then its high dword
+    op2 = HostCRC32_32(op2, (Bit32u) op1);
+    op2 = HostCRC32_32(op2, (Bit32u)(op1 >> 32));
+  }
+  else
+#endif
+  {
+    op2 = BitReflect32(op2);
+
+    Bit64u tmp1 = ((Bit64u) BitReflect32(op1 & 0xffffffff)) << 32;
+    Bit64u tmp2 = ((Bit64u) op2) << 32;
+    Bit64u tmp3 = tmp1 ^ tmp2;
+    op2  = mod2_64bit(CRC32_POLYNOMIAL, tmp3);
+    tmp1 = ((Bit64u) BitReflect32(op1 >> 32)) << 32;
+    tmp2 = ((Bit64u) op2) << 32;
+    tmp3 = tmp1 ^ tmp2;
+    op2  = BitReflect32(mod2_64bit(CRC32_POLYNOMIAL, tmp3));
+  }
 
-  BX_WRITE_32BIT_REGZ(i->dst(), BitReflect32(op2));
+  BX_WRITE_32BIT_REGZ(i->dst(), op2);
 
   BX_NEXT_INSTR(i);
 }
@@ -705,8 +705,15 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::MOV_CR3Rq(bxInstruction_c *i)
   }
 #endif
 
+  bx_bool noflush = 0;
+  if (BX_CPU_THIS_PTR cr4.get_PCIDE()) {
+    // CR3[63] keeps the cached translations of the new PCID
+    noflush = (bx_bool)(val_64 >> 63);
+    val_64 &= BX_CONST64(0x7fffffffffffffff);
+  }
+
   // no PDPTR checks in long mode
-  if (! SetCR3(val_64))
+  if (! SetCR3(val_64, noflush))
     exception(BX_GP_EXCEPTION, 0);
 
   BX_INSTR_TLB_CNTRL(BX_CPU_ID, BX_INSTR_MOV_CR3, val_64);
@@ -1309,7 +1316,7 @@ bx_bool BX_CPU_C::SetCR4(bxInstruction_c *i, bx_address val)
 }
 #endif // BX_CPU_LEVEL >= 5
 
-bx_bool BX_CPP_AttrRegparmN(1) BX_CPU_C::SetCR3(bx_address val)
+bx_bool BX_CPP_AttrRegparmN(2) BX_CPU_C::SetCR3(bx_address val, bx_bool noflush)
 {
 #if BX_SUPPORT_X86_64
   if (long_mode()) {
@@ -1322,13 +1329,14 @@ bx_bool BX_CPP_AttrRegparmN(1) BX_CPU_C::SetCR3(bx_address val)
 
   BX_CPU_THIS_PTR cr3 = val;
 
-  // flush TLB even if value does not change
-#if BX_CPU_LEVEL >= 6
-  if (BX_CPU_THIS_PTR cr4.get_PGE())
-    TLB_flushNonGlobal(); // Don't flush Global entries.
-  else
-#endif
-    TLB_flush();          // Flush Global entries also.
+  // flush the untagged first level TLB even if value does not change,
+  // global pages only exist with CR4.PGE set
+  TLB_flushL1(1);
+
+  // the second level TLB is tagged with the PCID, translations of the
+  // other address spaces survive and a no-flush reload keeps these too
+  if (! noflush)
+    TLB_flushContext();
 
   return 1;
 }
@@ -390,4 +390,31 @@ void BX_CPU_C::dbg_get_idtr(bx_dbg_global_sreg_t *sreg)
 void BX_CPU_C::atexit(void)
 {
   debug(BX_CPU_THIS_PTR prev_rip);
+
+  BX_INFO(("trace cache: " FMT_LL "u hits, " FMT_LL "u misses, " FMT_LL "u victim hits, " FMT_LL "u page split traces",
+    BX_CPU_THIS_PTR iCache.stats.hits, BX_CPU_THIS_PTR iCache.stats.misses,
+    BX_CPU_THIS_PTR iCache.stats.victimHits, BX_CPU_THIS_PTR iCache.stats.pageSplitTraces));
+  BX_INFO(("trace cache: " FMT_LL "u SMC invalidations, " FMT_LL "u flushes, " FMT_LL "u of them with a full pool",
+    BX_CPU_THIS_PTR iCache.stats.smcInvalidations, BX_CPU_THIS_PTR iCache.stats.flushes,
+    BX_CPU_THIS_PTR iCache.stats.poolFlushes));
+  BX_INFO(("TLB: " FMT_LL "u misses (" FMT_LL "u conflicts), " FMT_LL "u STLB hits, " FMT_LL "u page walks, " FMT_LL "u STLB evictions",
+    BX_CPU_THIS_PTR TLB.stats.misses, BX_CPU_THIS_PTR TLB.stats.conflictMisses,
+    BX_CPU_THIS_PTR TLB.stats.stlbHits, BX_CPU_THIS_PTR TLB.stats.pageWalks,
+    BX_CPU_THIS_PTR TLB.stats.stlbEvictions));
+  BX_INFO(("TLB: " FMT_LL "u context switches, " FMT_LL "u flushes, " FMT_LL "u non-global flushes, " FMT_LL "u context flushes, "
+    FMT_LL "u INVLPGs, " FMT_LL "u entries flushed",
+    BX_CPU_THIS_PTR TLB.stats.contextSwitches, BX_CPU_THIS_PTR TLB.stats.flushes,
+    BX_CPU_THIS_PTR TLB.stats.nonGlobalFlushes, BX_CPU_THIS_PTR TLB.stats.contextFlushes,
+    BX_CPU_THIS_PTR TLB.stats.invlpgs, BX_CPU_THIS_PTR TLB.stats.flushedEntries));
+#if BX_CPU_LEVEL >= 6
+  BX_INFO(("paging-structure cache: " FMT_LL "u PDE hits, " FMT_LL "u PDPTE hits, " FMT_LL "u PML4E hits",
+    BX_CPU_THIS_PTR TLB.stats.pscHits[0], BX_CPU_THIS_PTR TLB.stats.pscHits[1],
+    BX_CPU_THIS_PTR TLB.stats.pscHits[2]));
+#endif
+#if BX_SUPPORT_SMP
+  if (BX_CPU_THIS_PTR spin_threshold > 0) {
+    BX_INFO(("spin loops: " FMT_LL "u PAUSEs, " FMT_LL "u spin loops detected",
+      BX_CPU_THIS_PTR spin_stats.pauses, BX_CPU_THIS_PTR spin_stats.spinLoops));
+  }
+#endif
 }
@@ -68,9 +68,17 @@ bx_bool BX_CPU_C::handleWaitForEvent(void)
 
     if (BX_HRQ && BX_DBG_ASYNC_DMA) {
       // handle DMA also when CPU is halted
+      BX_LOCK_DEVICES();
       DEV_dma_raise_hlda();
+      BX_UNLOCK_DEVICES();
     }
 
+#if BX_HAVE_THREADS
+    // a host thread finished work for a device
+    if (bx_pc_system.timer_signal_pending)
+      bx_pc_system.handle_timer_signals();
+#endif
+
     // for multiprocessor simulation, even if this CPU is halted we still
     // must give the others a chance to simulate.  If an interrupt has
     // arrived, then clear the HALT condition; otherwise just return from
@@ -95,7 +103,9 @@ bx_bool BX_CPU_C::handleWaitForEvent(void)
       return 1; // Return to caller of cpu_loop.
     }
 
-    BX_TICKN(10); // when in HLT run time faster for single CPU
+    // when in HLT run time faster for single CPU
+    if (! bx_pc_system.skip_idle_ticks())
+      BX_TICKN(10);
   }
 
   return 0;
@@ -126,6 +136,7 @@ void BX_CPU_C::InterruptAcknowledge(void)
 #endif
 
   // NOTE: similar code in ::take_irq()
+  BX_LOCK_DEVICES();
 #if BX_SUPPORT_APIC
   if (is_pending(BX_EVENT_PENDING_LAPIC_INTR))
     vector = BX_CPU_THIS_PTR lapic.acknowledge_int();
@@ -133,6 +144,7 @@ void BX_CPU_C::InterruptAcknowledge(void)
 #endif
     // if no local APIC, always acknowledge the PIC.
     vector = DEV_pic_iac(); // may set INTR with next interrupt
+  BX_UNLOCK_DEVICES();
 
   BX_CPU_THIS_PTR EXT = 1; /* external event */
 #if BX_SUPPORT_VMX
@@ -170,6 +182,12 @@ bx_bool BX_CPU_C::handleAsyncEvent(void)
   //
   // This area is where we process special conditions and events.
   //
+#if BX_HAVE_THREADS
+  // a host thread finished work for a device
+  if (bx_pc_system.timer_signal_pending)
+    bx_pc_system.handle_timer_signals();
+#endif
+
   if (BX_CPU_THIS_PTR activity_state != BX_ACTIVITY_STATE_ACTIVE) {
     // For one processor, pass the time as quickly as possible until
     // an interrupt wakes up the CPU.
@@ -181,6 +199,11 @@ bx_bool BX_CPU_C::handleAsyncEvent(void)
     return 1; // Return to caller of cpu_loop.
   }
 
+  if (bx_pc_system.snapshot_request) {
+    // the caller of cpu_loop takes or restores the snapshot
+    return 1; // Return to caller of cpu_loop.
+  }
+
   // Priority 1: Hardware Reset and Machine Checks
   //   RESET
   //   Machine Check
@@ -325,7 +348,9 @@ bx_bool BX_CPU_C::handleAsyncEvent(void)
   else if (BX_HRQ && BX_DBG_ASYNC_DMA) {
     // NOTE: similar code in ::take_dma()
     // assert Hold Acknowledge (HLDA) and go into a bus hold state
+    BX_LOCK_DEVICES();
     DEV_dma_raise_hlda();
+    BX_UNLOCK_DEVICES();
   }
 
   if (BX_CPU_THIS_PTR get_TF())
@@ -394,10 +419,17 @@ void BX_CPU_C::deliver_SIPI(unsigned vector)
     if (BX_CPU_THIS_PTR in_vmx_guest)
       VMexit(VMX_VMEXIT_SIPI, vector);
 #endif
-    BX_CPU_THIS_PTR activity_state = BX_ACTIVITY_STATE_ACTIVE;
     RIP = 0;
     load_seg_reg(&BX_CPU_THIS_PTR sregs[BX_SEG_REG_CS], vector*0x100);
     unmask_event(BX_EVENT_INIT | BX_EVENT_SMI | BX_EVENT_NMI);
+    // the processor might be simulated by another host thread which is
+    // waiting for the state change, make it visible only at the end
+#if BX_SUPPORT_SMP
+    bx_atomic_cas32(&BX_CPU_THIS_PTR activity_state,
+        BX_ACTIVITY_STATE_WAIT_FOR_SIPI, BX_ACTIVITY_STATE_ACTIVE);
+#else
+    BX_CPU_THIS_PTR activity_state = BX_ACTIVITY_STATE_ACTIVE;
+#endif
     BX_INFO(("CPU %d started up at %04X:%08X by APIC",
                    BX_CPU_THIS_PTR bx_cpuid, vector*0x100, EIP));
   } else {
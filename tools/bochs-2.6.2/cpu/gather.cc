@@ -48,6 +48,82 @@ bx_address BX_CPP_AttrRegparmN(2) BX_CPU_C::BxResolveGatherQ(bxInstruction_c *i,
     return (Bit32u) (BX_READ_32BIT_REG(i->sibBase()) + (index << i->sibScale()) + i->displ32s());
 }
 
+#if BX_DEBUGGER == 0 && BX_INSTRUMENTATION == 0
+
+// Gathers all active elements straight from host memory when every one of
+// them hits a TLB resident page that allows direct host access. Each
+// distinct page is looked up once. Nothing is written unless all elements
+// qualify; completed elements are cleared from the mask so the regular
+// element-by-element loop which follows has nothing left to read. Any
+// element needing a page walk, segment or alignment checks beyond the
+// simple ones makes the whole gather take the regular path, which keeps
+// the guest visible fault ordering intact.
+void BX_CPU_C::FastGather(bxInstruction_c *i, BxPackedAvxRegister *dest, BxPackedAvxRegister *mask,
+       unsigned num_elements, unsigned len, bx_bool qindex)
+{
+  Bit8u *hostAddr[8], *hostPage = 0;
+  bx_address lpf = 1; // never matches a page frame
+  unsigned n;
+
+  for (n=0; n < num_elements; n++) {
+    hostAddr[n] = 0;
+    if (len == 4 ? (mask->avx32u(n) == 0) : (mask->avx64u(n) == 0))
+      continue;
+
+    bx_address offset = qindex ? BxResolveGatherQ(i, n) : BxResolveGatherD(i, n);
+    bx_address laddr;
+
+#if BX_SUPPORT_X86_64
+    if (BX_CPU_THIS_PTR cpu_mode == BX_MODE_LONG_64) {
+      laddr = get_laddr64(i->seg(), offset);
+      // canonical boundary is page aligned
+      if (! IsCanonical(laddr)) return;
+    }
+    else
+#endif
+    {
+      bx_segment_reg_t *segPtr = &BX_CPU_THIS_PTR sregs[i->seg()];
+      if (!(segPtr->cache.valid & SegAccessROK))
+        return;
+      if ((Bit64u) offset + len - 1 > segPtr->cache.u.segment.limit_scaled)
+        return;
+
+      laddr = get_laddr32(i->seg(), (Bit32u) offset);
+    }
+
+#if BX_CPU_LEVEL >= 4
+    if (BX_CPU_THIS_PTR alignment_check() && (laddr & (len-1)))
+      return;
+#endif
+
+    if (PAGE_OFFSET(laddr) > (0x1000 - len))
+      return;
+
+    if (LPFOf(laddr) != lpf) {
+      lpf = LPFOf(laddr);
+      hostPage = v2h_read_byte(lpf, BX_CPU_THIS_PTR user_pl);
+      if (! hostPage) return;
+    }
+
+    hostAddr[n] = hostPage + PAGE_OFFSET(laddr);
+  }
+
+  for (n=0; n < num_elements; n++) {
+    if (! hostAddr[n]) continue;
+
+    if (len == 4) {
+      ReadHostDWordFromLittleEndian((Bit32u*) hostAddr[n], dest->avx32u(n));
+      mask->avx32u(n) = 0;
+    }
+    else {
+      ReadHostQWordFromLittleEndian((Bit64u*) hostAddr[n], dest->avx64u(n));
+      mask->avx64u(n) = 0;
+    }
+  }
+}
+
+#endif
+
 BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VGATHERDPS_VpsHps(bxInstruction_c *i)
 {
   if (! i->as32L()) {
@@ -81,6 +157,10 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VGATHERDPS_VpsHps(bxInstruction_c
       mask->avx32u(n) = 0;
   }
 
+#if BX_DEBUGGER == 0 && BX_INSTRUMENTATION == 0
+  FastGather(i, dest, mask, num_elements, 4, 0);
+#endif
+
   for (n=0; n < 8; n++)
   {
     if (n >= num_elements) {
@@ -130,6 +210,10 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VGATHERQPS_VpsHps(bxInstruction_c
       mask->avx32u(n) = 0;
   }
 
+#if BX_DEBUGGER == 0 && BX_INSTRUMENTATION == 0
+  FastGather(i, dest, mask, num_elements, 4, 1);
+#endif
+
   for (n=0; n < 4; n++)
   {
     if (n >= num_elements) {
@@ -182,6 +266,10 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VGATHERDPD_VpdHpd(bxInstruction_c
       mask->avx64u(n) = 0;
   }
 
+#if BX_DEBUGGER == 0 && BX_INSTRUMENTATION == 0
+  FastGather(i, dest, mask, num_elements, 8, 0);
+#endif
+
   for (unsigned n=0; n < 4; n++)
   {
     if (n >= num_elements) {
@@ -231,6 +319,10 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::VGATHERQPD_VpdHpd(bxInstruction_c
       mask->avx64u(n) = 0;
   }
 
+#if BX_DEBUGGER == 0 && BX_INSTRUMENTATION == 0
+  FastGather(i, dest, mask, num_elements, 8, 1);
+#endif
+
   for (n=0; n < 4; n++)
   {
     if (n >= num_elements) {
@@ -32,6 +32,16 @@ bxPageWriteStampTable pageWriteStampTable;
 
 void flushICaches(void)
 {
+#if BX_SUPPORT_SMP
+  if (bx_pc_system.smp_in_round) {
+    // processors running on their own host threads flush their trace
+    // caches before the next trace, the write stamps are left as is
+    for (unsigned i=0; i<BX_SMP_PROCESSORS; i++)
+      BX_CPU(i)->request_smp_flush(BX_SMP_FLUSH_ICACHE);
+    return;
+  }
+#endif
+
   for (unsigned i=0; i<BX_SMP_PROCESSORS; i++) {
     BX_CPU(i)->iCache.flushICacheEntries();
     BX_CPU(i)->async_event |= BX_ASYNC_EVENT_STOP_TRACE;
@@ -40,10 +50,99 @@ void flushICaches(void)
   pageWriteStampTable.resetWriteStamps();
 }
 
+void bxICache_c::allocate(unsigned entries, unsigned poolSize, unsigned nVictim, unsigned nPageSplit)
+{
+  release();
+
+  entry = new bxICacheEntry_c[entries];
+  entryMask = entries - 1;
+  mpool = new bxInstruction_c[poolSize];
+  mpoolSize = poolSize;
+  victimCache = new bxVictimCacheEntry[nVictim];
+  victimEntries = nVictim;
+  pageSplitIndex = new pageSplitEntryIndex[nPageSplit];
+  pageSplitEntries = nPageSplit;
+
+  flushICacheEntries();
+  stats.flushes = 0;
+}
+
+void bxICache_c::release(void)
+{
+  delete [] entry;
+  entry = NULL;
+  delete [] mpool;
+  mpool = NULL;
+  delete [] victimCache;
+  victimCache = NULL;
+  delete [] pageSplitIndex;
+  pageSplitIndex = NULL;
+}
+
+// round the size down to a power of two
+static unsigned icache_size_pow2(unsigned size, unsigned min)
+{
+  unsigned pow2 = min;
+  while ((pow2 << 1) <= size && (pow2 << 1) != 0) pow2 <<= 1;
+  return pow2;
+}
+
+void BX_CPU_C::allocICache(void)
+{
+  const char *pname[4] = { BXPN_ICACHE_ENTRIES, BXPN_ICACHE_MPOOL, BXPN_ICACHE_VICTIM, BXPN_ICACHE_SPLIT };
+  unsigned size[4];
+
+  for (unsigned n=0; n<4; n++) {
+    size[n] = SIM->get_param_num(pname[n])->get();
+    if (n != 1) {
+      unsigned pow2 = icache_size_pow2(size[n], (n == 0) ? 4096 : 1);
+      if (pow2 != size[n]) {
+        BX_INFO(("%s=%u is not a power of 2, using %u", pname[n], size[n], pow2));
+        size[n] = pow2;
+      }
+    }
+  }
+
+  if (BX_CPU_THIS_PTR iCache.entry != NULL) {
+    BX_INFO(("trace cache resized to %u entries, %u instructions pool", size[0], size[1]));
+  }
+
+  BX_CPU_THIS_PTR iCache.allocate(size[0], size[1], size[2], size[3]);
+  BX_CPU_THIS_PTR iCache.resizeRequest = 0;
+}
+
+void BX_CPU_C::icache_runtime_config_handler(void *this_ptr)
+{
+  BX_CPU_C *class_ptr = (BX_CPU_C *) this_ptr;
+  bxICache_c *iCache = &class_ptr->iCache;
+
+  // the cache can't be reallocated while the trace is running, just post
+  // the request, it will be served on the next cache miss. Processors
+  // simulated on their own host threads are stopped between the rounds
+  // and could be resized right away.
+  if ((iCache->entryMask + 1) != icache_size_pow2(SIM->get_param_num(BXPN_ICACHE_ENTRIES)->get(), 4096) ||
+       iCache->mpoolSize != SIM->get_param_num(BXPN_ICACHE_MPOOL)->get() ||
+       iCache->victimEntries != icache_size_pow2(SIM->get_param_num(BXPN_ICACHE_VICTIM)->get(), 1) ||
+       iCache->pageSplitEntries != icache_size_pow2(SIM->get_param_num(BXPN_ICACHE_SPLIT)->get(), 1))
+  {
+#if BX_SUPPORT_SMP
+    if (bx_pc_system.smp_threaded && ! bx_pc_system.smp_in_round) {
+      class_ptr->allocICache();
+      return;
+    }
+#endif
+    iCache->resizeRequest = 1;
+  }
+}
+
 void handleSMC(bx_phy_address pAddr, Bit32u mask)
 {
   for (unsigned i=0; i<BX_SMP_PROCESSORS; i++) {
+#if BX_SUPPORT_SMP
+    bx_atomic_or32(&BX_CPU(i)->async_event, BX_ASYNC_EVENT_STOP_TRACE);
+#else
     BX_CPU(i)->async_event |= BX_ASYNC_EVENT_STOP_TRACE;
+#endif
     BX_CPU(i)->iCache.handleSMC(pAddr, mask);
   }
 }
@@ -55,6 +154,14 @@ BX_INSF_TYPE BX_CPU_C::BxEndTrace(bxInstruction_c *i)
   // do nothing, return to main cpu_loop
 }
 
+BX_INSF_TYPE BX_CPU_C::BxEndTraceLink(bxInstruction_c *i)
+{
+  // the trace fell through into the next one, try to link them unless
+  // the fetch mode was changed since the end of trace opcode was created
+  if (i->Id() == BX_CPU_THIS_PTR fetchModeMask)
+    linkTrace(i);
+}
+
 void genDummyICacheEntry(bxInstruction_c *i)
 {
   i->setILen(0);
@@ -62,10 +169,21 @@ void genDummyICacheEntry(bxInstruction_c *i)
   i->execute1 = &BX_CPU_C::BxEndTrace;
 }
 
+void genEndOfTraceEntry(bxInstruction_c *i, Bit32u fetchModeMask)
+{
+  genDummyICacheEntry(i);
+  i->execute1 = &BX_CPU_C::BxEndTraceLink;
+  i->setNextTrace(NULL);
+  i->modRMForm.Id = fetchModeMask;
+}
+
 #endif
 
 bxICacheEntry_c* BX_CPU_C::serveICacheMiss(bxICacheEntry_c *entry, Bit32u eipBiased, bx_phy_address pAddr)
 {
+  if (BX_CPU_THIS_PTR iCache.resizeRequest)
+    allocICache();
+
   entry = BX_CPU_THIS_PTR iCache.get_entry(pAddr, BX_CPU_THIS_PTR fetchModeMask);
 
   BX_CPU_THIS_PTR iCache.victim_entry(entry, BX_CPU_THIS_PTR fetchModeMask);
@@ -172,7 +290,7 @@ bxICacheEntry_c* BX_CPU_C::serveICacheMiss(bxICacheEntry_c *entry, Bit32u eipBia
 
 #if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
   entry->tlen++; /* Add the inserted end of trace opcode */
-  genDummyICacheEntry(i);
+  genEndOfTraceEntry(i, BX_CPU_THIS_PTR fetchModeMask);
 #endif
 
   BX_CPU_THIS_PTR iCache.commit_trace(entry->tlen);
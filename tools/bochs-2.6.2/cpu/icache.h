@@ -25,15 +25,46 @@
 #define BX_ICACHE_H
 
 extern void handleSMC(bx_phy_address pAddr, Bit32u mask);
+extern void handleDirtyPage(bx_phy_address pAddr);
 
 class bxPageWriteStampTable
 {
 #define PHY_MEM_PAGES (1024*1024)
   Bit32u *fineGranularityMapping;
 
+  // guest RAM write tracking for the snapshots and checkpoints, one byte
+  // per page which is set to 0xff by the first write to the page
+  Bit8u *dirtyPages;
+  Bit32u trackedPages; // zero if the tracking is disabled
+
+  BX_CPP_INLINE void trackWrite(bx_phy_address pAddr) {
+    bx_phy_address page = pAddr >> 12;
+    if (page < trackedPages && dirtyPages[page] != 0xff)
+      handleDirtyPage(pAddr);
+  }
+
+  // with threaded SMP the table is shared between host threads
+  BX_CPP_INLINE void setMask(Bit32u index, Bit32u mask) {
+#if BX_SUPPORT_SMP
+    bx_atomic_or32(&fineGranularityMapping[index], mask);
+#else
+    fineGranularityMapping[index] |= mask;
+#endif
+  }
+
+  BX_CPP_INLINE void clearMask(Bit32u index, Bit32u mask) {
+#if BX_SUPPORT_SMP
+    bx_atomic_and32(&fineGranularityMapping[index], ~mask);
+#else
+    fineGranularityMapping[index] &= ~mask;
+#endif
+  }
+
 public:
   bxPageWriteStampTable() {
     fineGranularityMapping = new Bit32u[PHY_MEM_PAGES];
+    dirtyPages = NULL;
+    trackedPages = 0;
     resetWriteStamps();
   }
  ~bxPageWriteStampTable() { delete [] fineGranularityMapping; }
@@ -53,12 +84,19 @@ public:
     Bit32u mask  = 1 << (PAGE_OFFSET((Bit32u) pAddr) >> 7);
            mask |= 1 << (PAGE_OFFSET((Bit32u) pAddr + len - 1) >> 7);
 
-    fineGranularityMapping[hash(pAddr)] |= mask;
+    setMask(hash(pAddr), mask);
   }
 
   BX_CPP_INLINE void markICacheMask(bx_phy_address pAddr, Bit32u mask)
   {
-    fineGranularityMapping[hash(pAddr)] |= mask;
+    setMask(hash(pAddr), mask);
+  }
+
+  // the map is owned by the caller, pass NULL to stop the tracking
+  BX_CPP_INLINE void setDirtyPageMap(Bit8u *map, Bit32u pages) {
+    trackedPages = 0;
+    dirtyPages = map;
+    if (map) trackedPages = pages;
   }
 
   // whole page is being altered
@@ -66,9 +104,27 @@ public:
   {
     Bit32u index = hash(pAddr);
 
+    trackWrite(pAddr);
+
     if (fineGranularityMapping[index]) {
       handleSMC(pAddr, 0xffffffff); // one of the CPUs might be running trace from this page
-      fineGranularityMapping[index] = 0;
+      clearMask(index, 0xffffffff);
+    }
+  }
+
+  // range of pages is being altered, e.g. by DMA
+  BX_CPP_INLINE void decWriteStampRange(bx_phy_address pAddr, Bit32u len)
+  {
+    bx_phy_address pPage = pAddr & ~((bx_phy_address) 0xfff);
+    Bit32u pages = (Bit32u)((pAddr + len - 1 - pPage) >> 12) + 1;
+
+    for (; pages > 0; pages--, pPage += 0x1000) {
+      Bit32u index = hash(pPage);
+      trackWrite(pPage);
+      if (fineGranularityMapping[index]) {
+        handleSMC(pPage, 0xffffffff); // one of the CPUs might be running trace from this page
+        clearMask(index, 0xffffffff);
+      }
     }
   }
 
@@ -77,6 +133,8 @@ public:
   {
     Bit32u index = hash(pAddr);
 
+    trackWrite(pAddr);
+
     if (fineGranularityMapping[index]) {
        Bit32u mask  = 1 << (PAGE_OFFSET((Bit32u) pAddr) >> 7);
               mask |= 1 << (PAGE_OFFSET((Bit32u) pAddr + len - 1) >> 7);
@@ -84,7 +142,7 @@ public:
        if (fineGranularityMapping[index] & mask) {
           // one of the CPUs might be running trace from this page
           handleSMC(pAddr, mask);
-          fineGranularityMapping[index] &= ~mask;
+          clearMask(index, mask);
        }       
     }
   }
@@ -101,8 +159,12 @@ BX_CPP_INLINE void bxPageWriteStampTable::resetWriteStamps(void)
 
 extern bxPageWriteStampTable pageWriteStampTable;
 
+// default sizes of the instruction cache, can be changed using the
+// cpu: icache_entries, icache_mpool, icache_victim and icache_split options
 #define BxICacheEntries (256 * 1024)  // Must be a power of 2.
 #define BxICacheMemPool (576 * 1024)
+#define BxICacheVictimEntries 8       // Must be a power of 2.
+#define BxICachePageSplitEntries 8    // Must be a power of 2.
 
 #define BX_MAX_TRACE_LENGTH 32
 
@@ -117,51 +179,62 @@ struct bxICacheEntry_c
 
 #define BX_ICACHE_INVALID_PHY_ADDRESS (bx_phy_address(-1))
 
-BX_CPP_INLINE void flushSMC(bxICacheEntry_c *e)
-{
-  if (e->pAddr != BX_ICACHE_INVALID_PHY_ADDRESS) {
-    e->pAddr = BX_ICACHE_INVALID_PHY_ADDRESS;
-#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
-    extern void genDummyICacheEntry(bxInstruction_c *i);
-    for (unsigned instr=0;instr < e->tlen; instr++)
-      genDummyICacheEntry(e->i + instr);
-#endif
-  }
-}
-
 class BOCHSAPI bxICache_c {
 public:
-  bxICacheEntry_c entry[BxICacheEntries];
-  bxInstruction_c mpool[BxICacheMemPool];
+  bxICacheEntry_c *entry;
+  Bit32u entryMask;     // number of entries - 1
+  bxInstruction_c *mpool;
+  unsigned mpoolSize;
   unsigned mpindex;
 
-#define BX_ICACHE_PAGE_SPLIT_ENTRIES 8 /* must be power of two */
   struct pageSplitEntryIndex {
     bx_phy_address ppf; // Physical address of 2nd page of the trace 
     bxICacheEntry_c *e; // Pointer to icache entry
-  } pageSplitIndex[BX_ICACHE_PAGE_SPLIT_ENTRIES];
+  } *pageSplitIndex;
+  unsigned pageSplitEntries; // must be power of two
   int nextPageSplitIndex;
 
-#define BX_ICACHE_VICTIM_ENTRIES 8 /* must be power of two */
   struct bxVictimCacheEntry {
     Bit32u fetchModeMask;
     bxICacheEntry_c vc_entry;
-  } victimCache[BX_ICACHE_VICTIM_ENTRIES];
+  } *victimCache;
+  unsigned victimEntries; // must be power of two
   int nextVictimCacheIndex;
 
+  // set when the cache sizes were changed at runtime, the cache is
+  // reallocated on the next cache miss
+  bx_bool resizeRequest;
+
+  struct {
+    Bit64u hits;
+    Bit64u misses;
+    Bit64u victimHits;
+    Bit64u pageSplitTraces;
+    Bit64u smcInvalidations;
+    Bit64u flushes;
+    Bit64u poolFlushes; // flushes because the instruction pool was full
+  } stats;
+
 public:
-  bxICache_c() { flushICacheEntries(); }
+  bxICache_c(): entry(NULL), mpool(NULL), pageSplitIndex(NULL), victimCache(NULL), resizeRequest(0) {
+    memset(&stats, 0, sizeof(stats));
+  }
+ ~bxICache_c() { release(); }
 
-  BX_CPP_INLINE static unsigned hash(bx_phy_address pAddr, unsigned fetchModeMask)
+  void allocate(unsigned entries, unsigned poolSize, unsigned nVictim, unsigned nPageSplit);
+  void release(void);
+
+  BX_CPP_INLINE unsigned hash(bx_phy_address pAddr, unsigned fetchModeMask) const
   {
-//  return ((pAddr + (pAddr << 2) + (pAddr>>6)) & (BxICacheEntries-1)) ^ fetchModeMask;
-    return ((pAddr) & (BxICacheEntries-1)) ^ fetchModeMask;
+//  return ((pAddr + (pAddr << 2) + (pAddr>>6)) & entryMask) ^ fetchModeMask;
+    return ((pAddr) & entryMask) ^ fetchModeMask;
   }
 
   BX_CPP_INLINE void alloc_trace(bxICacheEntry_c *e)
   {
     // took +1 garbend for instruction chaining speedup (end-of-trace opcode)
-    if ((mpindex + BX_MAX_TRACE_LENGTH + 1) > BxICacheMemPool) {
+    if ((mpindex + BX_MAX_TRACE_LENGTH + 1) > mpoolSize) {
+      stats.poolFlushes++;
       flushICacheEntries();
     }
     e->i = &mpool[mpindex];
@@ -173,6 +246,7 @@ public:
   BX_CPP_INLINE void commit_page_split_trace(bx_phy_address paddr, bxICacheEntry_c *entry)
   {
     mpindex += entry->tlen;
+    stats.pageSplitTraces++;
 
     // register page split entry
     if (pageSplitIndex[nextPageSplitIndex].ppf != BX_ICACHE_INVALID_PHY_ADDRESS)
@@ -181,14 +255,15 @@ public:
     pageSplitIndex[nextPageSplitIndex].ppf = paddr;
     pageSplitIndex[nextPageSplitIndex].e = entry;
 
-    nextPageSplitIndex = (nextPageSplitIndex+1) & (BX_ICACHE_PAGE_SPLIT_ENTRIES-1);
+    nextPageSplitIndex = (nextPageSplitIndex+1) & (pageSplitEntries-1);
   }
 
   BX_CPP_INLINE bxICacheEntry_c *lookup_victim_cache(bx_phy_address pAddr, Bit32u fetchModeMask)
   {
-    for (int i=0; i < BX_ICACHE_VICTIM_ENTRIES;i++) {
+    for (unsigned i=0; i < victimEntries;i++) {
       bxVictimCacheEntry *e = &victimCache[i];
       if (e->vc_entry.pAddr == pAddr && e->fetchModeMask == fetchModeMask) {
+        stats.victimHits++;
         return &e->vc_entry;
       }
     }
@@ -201,10 +276,12 @@ public:
     if (entry->pAddr != BX_ICACHE_INVALID_PHY_ADDRESS) {
       victimCache[nextVictimCacheIndex].fetchModeMask = fetchModeMask;
       victimCache[nextVictimCacheIndex].vc_entry = *entry;
-      nextVictimCacheIndex = (nextVictimCacheIndex+1) & (BX_ICACHE_VICTIM_ENTRIES-1);
+      nextVictimCacheIndex = (nextVictimCacheIndex+1) & (victimEntries-1);
     }
   }
 
+  BX_CPP_INLINE void flushSMC(bxICacheEntry_c *e);
+
   BX_CPP_INLINE void handleSMC(bx_phy_address pAddr, Bit32u mask);
 
   BX_CPP_INLINE void flushICacheEntries(void);
@@ -229,22 +306,37 @@ BX_CPP_INLINE void bxICache_c::flushICacheEntries(void)
   bxICacheEntry_c* e = entry;
   unsigned i;
 
-  for (i=0; i<BxICacheEntries; i++, e++) {
+  stats.flushes++;
+
+  for (i=0; i<=entryMask; i++, e++) {
     e->pAddr = BX_ICACHE_INVALID_PHY_ADDRESS;
     e->traceMask = 0;
   }
 
   nextPageSplitIndex = 0;
-  for (i=0;i<BX_ICACHE_PAGE_SPLIT_ENTRIES;i++)
+  for (i=0;i<pageSplitEntries;i++)
     pageSplitIndex[i].ppf = BX_ICACHE_INVALID_PHY_ADDRESS;
 
   nextVictimCacheIndex = 0;
-  for (i=0;i<BX_ICACHE_VICTIM_ENTRIES;i++)
+  for (i=0;i<victimEntries;i++)
     victimCache[i].vc_entry.pAddr = BX_ICACHE_INVALID_PHY_ADDRESS;
 
   mpindex = 0;
 }
 
+BX_CPP_INLINE void bxICache_c::flushSMC(bxICacheEntry_c *e)
+{
+  if (e->pAddr != BX_ICACHE_INVALID_PHY_ADDRESS) {
+    e->pAddr = BX_ICACHE_INVALID_PHY_ADDRESS;
+    stats.smcInvalidations++;
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS
+    extern void genDummyICacheEntry(bxInstruction_c *i);
+    for (unsigned instr=0;instr < e->tlen; instr++)
+      genDummyICacheEntry(e->i + instr);
+#endif
+  }
+}
+
 BX_CPP_INLINE void bxICache_c::handleSMC(bx_phy_address pAddr, Bit32u mask)
 {
   Bit32u pAddrIndex = bxPageWriteStampTable::hash(pAddr);
@@ -262,7 +354,7 @@ BX_CPP_INLINE void bxICache_c::handleSMC(bx_phy_address pAddr, Bit32u mask)
   if (mask & 0x1) {
     // the store touched 1st cache line in the page, check for
     // page split traces to invalidate.
-    for (unsigned i=0;i<BX_ICACHE_PAGE_SPLIT_ENTRIES;i++) {
+    for (unsigned i=0;i<pageSplitEntries;i++) {
       if (pageSplitIndex[i].ppf != BX_ICACHE_INVALID_PHY_ADDRESS) {
         if (pAddrIndex == bxPageWriteStampTable::hash(pageSplitIndex[i].ppf)) {
           pageSplitIndex[i].ppf = BX_ICACHE_INVALID_PHY_ADDRESS;
@@ -272,13 +364,15 @@ BX_CPP_INLINE void bxICache_c::handleSMC(bx_phy_address pAddr, Bit32u mask)
     }
   }
 
-  for (unsigned i=0;i < BX_ICACHE_VICTIM_ENTRIES; i++) {
+  for (unsigned i=0;i < victimEntries; i++) {
     bxICacheEntry_c *e = &victimCache[i].vc_entry;
     if (pAddrIndex == bxPageWriteStampTable::hash(e->pAddr) && (e->traceMask & mask) != 0) {
       flushSMC(e);
     }
   }
 
+  // the cache has at least 4096 entries, so all traces starting in the
+  // page are found in the 4096 entries following the page entry
   bxICacheEntry_c *e = get_entry(LPFOf(pAddr), 0);
 
   // go over 32 "cache lines" of 128 byte each
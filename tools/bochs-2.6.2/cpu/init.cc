@@ -54,6 +54,16 @@ BX_CPU_C::BX_CPU_C(unsigned id): bx_cpuid(id)
   svm_extensions_bitmask = 0;
 #endif
 
+#if BX_SUPPORT_SMP
+  smp_flush_request = 0;
+  bus_locked = 0;
+  spin_threshold = 0;
+  pause_count = 0;
+  pause_icount = 0;
+  spin_loop = 0;
+  memset(&spin_stats, 0, sizeof(spin_stats));
+#endif
+
   srand(time(NULL)); // initialize random generator for RDRAND/RDSEED
 }
 
@@ -119,11 +129,21 @@ void BX_CPU_C::initialize(void)
   BX_CPU_THIS_PTR ignore_bad_msrs = SIM->get_param_bool(BXPN_IGNORE_BAD_MSRS)->get();
 #endif
 
+#if BX_SUPPORT_SMP
+  if (BX_SMP_PROCESSORS > 1)
+    BX_CPU_THIS_PTR spin_threshold = SIM->get_param_num(BXPN_SMP_SPIN_THRESHOLD)->get();
+#endif
+
   init_SMRAM();
 
 #if BX_SUPPORT_VMX
   init_VMCS();
 #endif
+
+  STLB_init();
+
+  allocICache();
+  SIM->register_runtime_config_handler(this, icache_runtime_config_handler);
 }
 
 // save/restore functionality
@@ -418,6 +438,40 @@ void BX_CPU_C::register_state(void)
     BXRS_HEX_PARAM_FIELD(tlb_entry, ppf, TLB.entry[n].ppf);
     BXRS_HEX_PARAM_FIELD(tlb_entry, accessBits, TLB.entry[n].accessBits);
   }
+
+  // host side counters, for the debugger only (logged at exit otherwise)
+  bx_list_c *icache = new bx_list_c(cpu, "ICACHE");
+  BXRS_DEC_PARAM_FIELD(icache, hits, iCache.stats.hits);
+  BXRS_DEC_PARAM_FIELD(icache, misses, iCache.stats.misses);
+  BXRS_DEC_PARAM_FIELD(icache, victim_hits, iCache.stats.victimHits);
+  BXRS_DEC_PARAM_FIELD(icache, page_split_traces, iCache.stats.pageSplitTraces);
+  BXRS_DEC_PARAM_FIELD(icache, smc_invalidations, iCache.stats.smcInvalidations);
+  BXRS_DEC_PARAM_FIELD(icache, flushes, iCache.stats.flushes);
+  BXRS_DEC_PARAM_FIELD(icache, pool_flushes, iCache.stats.poolFlushes);
+
+  bx_list_c *tlb_stats = new bx_list_c(cpu, "TLB_STATS");
+  BXRS_DEC_PARAM_FIELD(tlb_stats, misses, TLB.stats.misses);
+  BXRS_DEC_PARAM_FIELD(tlb_stats, conflict_misses, TLB.stats.conflictMisses);
+  BXRS_DEC_PARAM_FIELD(tlb_stats, stlb_hits, TLB.stats.stlbHits);
+  BXRS_DEC_PARAM_FIELD(tlb_stats, page_walks, TLB.stats.pageWalks);
+  BXRS_DEC_PARAM_FIELD(tlb_stats, stlb_evictions, TLB.stats.stlbEvictions);
+  BXRS_DEC_PARAM_FIELD(tlb_stats, context_switches, TLB.stats.contextSwitches);
+  BXRS_DEC_PARAM_FIELD(tlb_stats, flushes, TLB.stats.flushes);
+  BXRS_DEC_PARAM_FIELD(tlb_stats, non_global_flushes, TLB.stats.nonGlobalFlushes);
+  BXRS_DEC_PARAM_FIELD(tlb_stats, context_flushes, TLB.stats.contextFlushes);
+  BXRS_DEC_PARAM_FIELD(tlb_stats, invlpgs, TLB.stats.invlpgs);
+  BXRS_DEC_PARAM_FIELD(tlb_stats, flushed_entries, TLB.stats.flushedEntries);
+#if BX_CPU_LEVEL >= 6
+  BXRS_DEC_PARAM_FIELD(tlb_stats, psc_pde_hits, TLB.stats.pscHits[0]);
+  BXRS_DEC_PARAM_FIELD(tlb_stats, psc_pdpte_hits, TLB.stats.pscHits[1]);
+  BXRS_DEC_PARAM_FIELD(tlb_stats, psc_pml4_hits, TLB.stats.pscHits[2]);
+#endif
+
+#if BX_SUPPORT_SMP
+  bx_list_c *spin = new bx_list_c(cpu, "SPIN_STATS");
+  BXRS_DEC_PARAM_FIELD(spin, pauses, spin_stats.pauses);
+  BXRS_DEC_PARAM_FIELD(spin, spin_loops, spin_stats.spinLoops);
+#endif
 #endif
 }
 
@@ -518,6 +572,7 @@ void BX_CPU_C::param_restore(bx_param_c *param, Bit64s val)
 
 void BX_CPU_C::after_restore_state(void)
 {
+  TLB_flush();
   handleCpuContextChange();
 
   BX_CPU_THIS_PTR prev_rip = RIP;
@@ -533,6 +588,9 @@ void BX_CPU_C::after_restore_state(void)
 
   assert_checks();
   debug(RIP);
+
+  // in-memory snapshots are restored in the middle of the cpu loop
+  BX_CPU_THIS_PTR async_event |= BX_ASYNC_EVENT_STOP_TRACE;
 }
 // end of save/restore functionality
 
@@ -919,6 +977,7 @@ void BX_CPU_C::reset(unsigned source)
   }
 #endif
 
+  TLB_flush();
   handleCpuContextChange();
 
 #if BX_CPU_LEVEL >= 4
@@ -32,154 +32,108 @@
 //
 
 #if BX_SUPPORT_REPEAT_SPEEDUPS
-Bit32u BX_CPU_C::FastRepINSW(bxInstruction_c *i, bx_address dstOff, Bit16u port, Bit32u wordCount)
+Bit32u BX_CPU_C::FastRepINS(bxInstruction_c *i, unsigned len)
 {
-  Bit32u wordsFitDst;
-  signed int pointerDelta;
   Bit8u *hostAddrDst;
-  unsigned count;
 
-  BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
+  if (BX_CPU_THIS_PTR async_event) return 0;
 
-  bx_segment_reg_t *dstSegPtr = &BX_CPU_THIS_PTR sregs[BX_SEG_REG_ES];
-  if (!(dstSegPtr->cache.valid & SegAccessWOK))
-    return 0;
-  if ((dstOff | 0xfff) > dstSegPtr->cache.u.segment.limit_scaled)
-    return 0;
+  // the destination must be writable before reading from the IO port
+  Bit32u count = FastRepGetHostAddr(i, BX_SEG_REG_ES, RDI, len, BX_WRITE, &hostAddrDst);
+  count = FastRepLimitCount(i, count);
+  if (count < 2) return 0;
 
-  bx_address laddrDst = get_laddr32(BX_SEG_REG_ES, dstOff);
-  // check that the address is word aligned
-  if (laddrDst & 1) return 0;
+  bx_bool df = BX_CPU_THIS_PTR get_DF();
+  int pointerDelta = df ? -(int) len : (int) len;
+  Bit16u port = DX;
+  Bit32u n = 0;
 
-  hostAddrDst = v2h_write_byte(laddrDst, BX_CPU_THIS_PTR user_pl);
-  // Check that native host access was not vetoed for that page
-  if (!hostAddrDst) return 0;
-
-  // See how many words can fit in the rest of this page.
-  if (BX_CPU_THIS_PTR get_DF()) {
-    // Counting downward
-    // 1st word must cannot cross page boundary because it is word aligned
-    wordsFitDst = (2 + (PAGE_OFFSET(laddrDst))) >> 1;
-    pointerDelta = -2;
-  }
-  else {
-    // Counting upward
-    wordsFitDst = (0x1000 - PAGE_OFFSET(laddrDst)) >> 1;
-    pointerDelta =  2;
-  }
-
-  // Restrict word count to the number that will fit in this page.
-  if (wordCount > wordsFitDst)
-      wordCount = wordsFitDst;
-
-  // If after all the restrictions, there is anything left to do...
-  if (wordCount) {
-    for (count=0; count<wordCount; ) {
-      bx_devices.bulkIOQuantumsTransferred = 0;
-      if (BX_CPU_THIS_PTR get_DF()==0) { // Only do accel for DF=0
-        bx_devices.bulkIOHostAddr = hostAddrDst;
-        bx_devices.bulkIOQuantumsRequested = (wordCount - count);
-      }
+  while (n < count) {
+    bx_devices.bulkIOQuantumsTransferred = 0;
+    if (! df) { // Only do accel for DF=0
+      bx_devices.bulkIOHostAddr = hostAddrDst;
+      bx_devices.bulkIOQuantumsRequested = (count - n);
+    }
+    else
+      bx_devices.bulkIOQuantumsRequested = 0;
+    Bit32u value = BX_INP(port, len);
+    if (bx_devices.bulkIOQuantumsTransferred) {
+      hostAddrDst = bx_devices.bulkIOHostAddr;
+      n += bx_devices.bulkIOQuantumsTransferred;
+    }
+    else {
+      if (len == 1)
+        *hostAddrDst = (Bit8u) value;
+      else if (len == 2)
+        WriteHostWordToLittleEndian(hostAddrDst, (Bit16u) value);
       else
-        bx_devices.bulkIOQuantumsRequested = 0;
-      Bit16u temp16 = BX_INP(port, 2);
-      if (bx_devices.bulkIOQuantumsTransferred) {
-        hostAddrDst = bx_devices.bulkIOHostAddr;
-        count += bx_devices.bulkIOQuantumsTransferred;
-      }
-      else {
-        WriteHostWordToLittleEndian(hostAddrDst, temp16);
-        hostAddrDst += pointerDelta;
-        count++;
-      }
-      // Terminate early if there was an event.
-      if (BX_CPU_THIS_PTR async_event) break;
+        WriteHostDWordToLittleEndian(hostAddrDst, value);
+      hostAddrDst += pointerDelta;
+      n++;
     }
-
-    // Reset for next non-bulk IO
-    bx_devices.bulkIOQuantumsRequested = 0;
-
-    return count;
+    // Terminate early if there was an event.
+    if (BX_CPU_THIS_PTR async_event) break;
   }
 
-  return 0;
+  // Reset for next non-bulk IO
+  bx_devices.bulkIOQuantumsRequested = 0;
+
+  FastRepAdvance(i, n, len, BX_FAST_REP_RDI);
+  return n;
 }
 
-Bit32u BX_CPU_C::FastRepOUTSW(bxInstruction_c *i, unsigned srcSeg, bx_address srcOff, Bit16u port, Bit32u wordCount)
+Bit32u BX_CPU_C::FastRepOUTS(bxInstruction_c *i, unsigned len)
 {
-  Bit32u wordsFitSrc;
-  signed int pointerDelta;
   Bit8u *hostAddrSrc;
-  unsigned count;
 
-  BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
+  if (BX_CPU_THIS_PTR async_event) return 0;
 
-  bx_segment_reg_t *srcSegPtr = &BX_CPU_THIS_PTR sregs[srcSeg];
-  if (!(srcSegPtr->cache.valid & SegAccessROK))
-    return 0;
-  if ((srcOff | 0xfff) > srcSegPtr->cache.u.segment.limit_scaled)
-    return 0;
+  Bit32u count = FastRepGetHostAddr(i, i->seg(), RSI, len, BX_READ, &hostAddrSrc);
+  count = FastRepLimitCount(i, count);
+  if (count < 2) return 0;
 
-  bx_address laddrSrc = get_laddr32(srcSeg, srcOff);
-  // check that the address is word aligned
-  if (laddrSrc & 1) return 0;
+  bx_bool df = BX_CPU_THIS_PTR get_DF();
+  int pointerDelta = df ? -(int) len : (int) len;
+  Bit16u port = DX;
+  Bit32u n = 0;
 
-  hostAddrSrc = v2h_read_byte(laddrSrc, BX_CPU_THIS_PTR user_pl);
-
-  // Check that native host access was not vetoed for that page
-  if (!hostAddrSrc) return 0;
-
-  // See how many words can fit in the rest of this page.
-  if (BX_CPU_THIS_PTR get_DF()) {
-    // Counting downward
-    // 1st word must cannot cross page boundary because it is word aligned
-    wordsFitSrc = (2 + (PAGE_OFFSET(laddrSrc))) >> 1;
-    pointerDelta = (unsigned) -2;
-  }
-  else {
-    // Counting upward
-    wordsFitSrc = (0x1000 - PAGE_OFFSET(laddrSrc)) >> 1;
-    pointerDelta =  2;
-  }
-
-  // Restrict word count to the number that will fit in this page.
-  if (wordCount > wordsFitSrc)
-      wordCount = wordsFitSrc;
-
-  // If after all the restrictions, there is anything left to do...
-  if (wordCount) {
-    for (count=0; count<wordCount; ) {
-      bx_devices.bulkIOQuantumsTransferred = 0;
-      if (BX_CPU_THIS_PTR get_DF()==0) { // Only do accel for DF=0
-        bx_devices.bulkIOHostAddr = hostAddrSrc;
-        bx_devices.bulkIOQuantumsRequested = (wordCount - count);
-      }
-      else
-        bx_devices.bulkIOQuantumsRequested = 0;
-      Bit16u temp16;
-      ReadHostWordFromLittleEndian(hostAddrSrc, temp16);
-      BX_OUTP(port, temp16, 2);
-      if (bx_devices.bulkIOQuantumsTransferred) {
-        hostAddrSrc = bx_devices.bulkIOHostAddr;
-        count += bx_devices.bulkIOQuantumsTransferred;
-      }
-      else {
-        hostAddrSrc += pointerDelta;
-        count++;
-      }
-      // Terminate early if there was an event.
-      if (BX_CPU_THIS_PTR async_event) break;
+  while (n < count) {
+    bx_devices.bulkIOQuantumsTransferred = 0;
+    if (! df) { // Only do accel for DF=0
+      bx_devices.bulkIOHostAddr = hostAddrSrc;
+      bx_devices.bulkIOQuantumsRequested = (count - n);
     }
-
-    // Reset for next non-bulk IO
-    bx_devices.bulkIOQuantumsRequested = 0;
-
-    return count;
+    else
+      bx_devices.bulkIOQuantumsRequested = 0;
+    Bit32u value;
+    if (len == 1)
+      value = *hostAddrSrc;
+    else if (len == 2) {
+      Bit16u value16;
+      ReadHostWordFromLittleEndian(hostAddrSrc, value16);
+      value = value16;
+    }
+    else
+      ReadHostDWordFromLittleEndian(hostAddrSrc, value);
+    BX_OUTP(port, value, len);
+    if (bx_devices.bulkIOQuantumsTransferred) {
+      hostAddrSrc = bx_devices.bulkIOHostAddr;
+      n += bx_devices.bulkIOQuantumsTransferred;
+    }
+    else {
+      hostAddrSrc += pointerDelta;
+      n++;
+    }
+    // Terminate early if there was an event.
+    if (BX_CPU_THIS_PTR async_event) break;
   }
 
-  return 0;
-}
+  // Reset for next non-bulk IO
+  bx_devices.bulkIOQuantumsRequested = 0;
 
+  FastRepAdvance(i, n, len, BX_FAST_REP_RSI);
+  return n;
+}
 #endif
 
 //
@@ -213,6 +167,10 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::REP_INSB_YbDX(bxInstruction_c *i)
 // 16-bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::INSB16_YbDX(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepINS(i, 1)) return;
+#endif
+
   // trigger any segment or page faults before reading from IO port
   Bit8u value8 = read_RMW_virtual_byte_32(BX_SEG_REG_ES, DI);
 
@@ -229,6 +187,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::INSB16_YbDX(bxInstruction_c *i)
 // 32-bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::INSB32_YbDX(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepINS(i, 1)) return;
+#endif
+
   // trigger any segment or page faults before reading from IO port
   Bit8u value8 = read_RMW_virtual_byte(BX_SEG_REG_ES, EDI);
 
@@ -250,6 +212,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::INSB32_YbDX(bxInstruction_c *i)
 // 64-bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::INSB64_YbDX(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepINS(i, 1)) return;
+#endif
+
   // trigger any segment or page faults before reading from IO port
   Bit8u value8 = read_RMW_virtual_byte_64(BX_SEG_REG_ES, RDI);
 
@@ -292,6 +258,10 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::REP_INSW_YwDX(bxInstruction_c *i)
 // 16-bit operand size, 16-bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::INSW16_YwDX(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepINS(i, 2)) return;
+#endif
+
   // trigger any segment or page faults before reading from IO port
   Bit16u value16 = read_RMW_virtual_word_32(BX_SEG_REG_ES, DI);
 
@@ -308,52 +278,21 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::INSW16_YwDX(bxInstruction_c *i)
 // 16-bit operand size, 32-bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::INSW32_YwDX(bxInstruction_c *i)
 {
-  Bit16u value16=0;
-  Bit32u edi = EDI;
-  unsigned incr = 2;
-
 #if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
-  /* If conditions are right, we can transfer IO to physical memory
-   * in a batch, rather than one instruction at a time.
-   */
-  if (i->repUsedL() && !BX_CPU_THIS_PTR async_event)
-  {
-    Bit32u wordCount = ECX;
-    BX_ASSERT(wordCount > 0);
-    wordCount = FastRepINSW(i, edi, DX, wordCount);
-    if (wordCount) {
-      // Decrement the ticks count by the number of iterations, minus
-      // one, since the main cpu loop will decrement one.  Also,
-      // the count is predecremented before examined, so defintely
-      // don't roll it under zero.
-      BX_TICKN(wordCount-1);
-      RCX = ECX - (wordCount-1);
-      incr = wordCount << 1; // count * 2.
-    }
-    else {
-      // trigger any segment or page faults before reading from IO port
-      value16 = read_RMW_virtual_word(BX_SEG_REG_ES, edi);
-
-      value16 = BX_INP(DX, 2);
-
-      write_RMW_virtual_word(value16);
-    }
-  }
-  else
+  if (i->repUsedL() && FastRepINS(i, 2)) return;
 #endif
-  {
-    // trigger any segment or page faults before reading from IO port
-    value16 = read_RMW_virtual_word_32(BX_SEG_REG_ES, edi);
 
-    value16 = BX_INP(DX, 2);
+  // trigger any segment or page faults before reading from IO port
+  Bit16u value16 = read_RMW_virtual_word(BX_SEG_REG_ES, EDI);
 
-    write_RMW_virtual_word(value16);
-  }
+  value16 = BX_INP(DX, 2);
+
+  write_RMW_virtual_word(value16);
 
   if (BX_CPU_THIS_PTR get_DF())
-    RDI = EDI - incr;
+    RDI = EDI - 2;
   else
-    RDI = EDI + incr;
+    RDI = EDI + 2;
 }
 
 #if BX_SUPPORT_X86_64
@@ -361,6 +300,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::INSW32_YwDX(bxInstruction_c *i)
 // 16-bit operand size, 64-bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::INSW64_YwDX(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepINS(i, 2)) return;
+#endif
+
   // trigger any segment or page faults before reading from IO port
   Bit16u value16 = read_RMW_virtual_word_64(BX_SEG_REG_ES, RDI);
 
@@ -403,6 +346,10 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::REP_INSD_YdDX(bxInstruction_c *i)
 // 32-bit operand size, 16-bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::INSD16_YdDX(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepINS(i, 4)) return;
+#endif
+
   // trigger any segment or page faults before reading from IO port
   Bit32u value32 = read_RMW_virtual_dword_32(BX_SEG_REG_ES, DI);
 
@@ -419,6 +366,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::INSD16_YdDX(bxInstruction_c *i)
 // 32-bit operand size, 32-bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::INSD32_YdDX(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepINS(i, 4)) return;
+#endif
+
   // trigger any segment or page faults before reading from IO port
   Bit32u value32 = read_RMW_virtual_dword(BX_SEG_REG_ES, EDI);
 
@@ -437,6 +388,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::INSD32_YdDX(bxInstruction_c *i)
 // 32-bit operand size, 64-bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::INSD64_YdDX(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepINS(i, 4)) return;
+#endif
+
   // trigger any segment or page faults before reading from IO port
   Bit32u value32 = read_RMW_virtual_dword_64(BX_SEG_REG_ES, RDI);
 
@@ -483,6 +438,10 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::REP_OUTSB_DXXb(bxInstruction_c *i)
 // 16-bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::OUTSB16_DXXb(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepOUTS(i, 1)) return;
+#endif
+
   Bit8u value8 = read_virtual_byte_32(i->seg(), SI);
   BX_OUTP(DX, value8, 1);
 
@@ -495,6 +454,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::OUTSB16_DXXb(bxInstruction_c *i)
 // 32-bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::OUTSB32_DXXb(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepOUTS(i, 1)) return;
+#endif
+
   Bit8u value8 = read_virtual_byte(i->seg(), ESI);
   BX_OUTP(DX, value8, 1);
 
@@ -509,6 +472,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::OUTSB32_DXXb(bxInstruction_c *i)
 // 64-bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::OUTSB64_DXXb(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepOUTS(i, 1)) return;
+#endif
+
   Bit8u value8 = read_virtual_byte_64(i->seg(), RSI);
   BX_OUTP(DX, value8, 1);
 
@@ -547,6 +514,10 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::REP_OUTSW_DXXw(bxInstruction_c *i)
 // 16-bit operand size, 16-bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::OUTSW16_DXXw(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepOUTS(i, 2)) return;
+#endif
+
   Bit16u value16 = read_virtual_word_32(i->seg(), SI);
   BX_OUTP(DX, value16, 2);
 
@@ -559,40 +530,17 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::OUTSW16_DXXw(bxInstruction_c *i)
 // 16-bit operand size, 32-bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::OUTSW32_DXXw(bxInstruction_c *i)
 {
-  Bit16u value16;
-  Bit32u esi = ESI;
-  unsigned incr = 2;
-
 #if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
-  /* If conditions are right, we can transfer IO to physical memory
-   * in a batch, rather than one instruction at a time.
-   */
-  if (i->repUsedL() && !BX_CPU_THIS_PTR async_event) {
-    Bit32u wordCount = ECX;
-    wordCount = FastRepOUTSW(i, i->seg(), esi, DX, wordCount);
-    if (wordCount) {
-      // Decrement eCX.  Note, the main loop will decrement 1 also, so
-      // decrement by one less than expected, like the case above.
-      BX_TICKN(wordCount-1); // Main cpu loop also decrements one more.
-      RCX = ECX - (wordCount-1);
-      incr = wordCount << 1; // count * 2.
-    }
-    else {
-      value16 = read_virtual_word(i->seg(), esi);
-      BX_OUTP(DX, value16, 2);
-    }
-  }
-  else
+  if (i->repUsedL() && FastRepOUTS(i, 2)) return;
 #endif
-  {
-    value16 = read_virtual_word(i->seg(), esi);
-    BX_OUTP(DX, value16, 2);
-  }
+
+  Bit16u value16 = read_virtual_word(i->seg(), ESI);
+  BX_OUTP(DX, value16, 2);
 
   if (BX_CPU_THIS_PTR get_DF())
-    RSI = ESI - incr;
+    RSI = ESI - 2;
   else
-    RSI = ESI + incr;
+    RSI = ESI + 2;
 }
 
 #if BX_SUPPORT_X86_64
@@ -600,6 +548,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::OUTSW32_DXXw(bxInstruction_c *i)
 // 16-bit operand size, 64-bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::OUTSW64_DXXw(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepOUTS(i, 2)) return;
+#endif
+
   Bit16u value16 = read_virtual_word_64(i->seg(), RSI);
   BX_OUTP(DX, value16, 2);
 
@@ -638,6 +590,10 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::REP_OUTSD_DXXd(bxInstruction_c *i)
 // 32-bit operand size, 16-bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::OUTSD16_DXXd(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepOUTS(i, 4)) return;
+#endif
+
   Bit32u value32 = read_virtual_dword_32(i->seg(), SI);
   BX_OUTP(DX, value32, 4);
 
@@ -650,6 +606,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::OUTSD16_DXXd(bxInstruction_c *i)
 // 32-bit operand size, 32-bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::OUTSD32_DXXd(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepOUTS(i, 4)) return;
+#endif
+
   Bit32u value32 = read_virtual_dword(i->seg(), ESI);
   BX_OUTP(DX, value32, 4);
 
@@ -664,6 +624,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::OUTSD32_DXXd(bxInstruction_c *i)
 // 32-bit operand size, 64-bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::OUTSD64_DXXd(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepOUTS(i, 4)) return;
+#endif
+
   Bit32u value32 = read_virtual_dword_64(i->seg(), RSI);
   BX_OUTP(DX, value32, 4);
 
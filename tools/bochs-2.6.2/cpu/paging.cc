@@ -340,94 +340,232 @@ static const Bit8u priv_check[BX_PRIV_CHECK_SIZE] =
 #define TLB_SysExecuteOK  (0x10)
 #define TLB_UserExecuteOK (0x20)
 
-// === TLB Instrumentation section ==============================
+// === Second level TLB ==========================================
+//
+// The direct mapped TLB above is looked up inline by every memory access.
+// It is not tagged, so it has to be flushed whenever the address space
+// changes.  A miss in it probes a set associative second level TLB
+// before walking the page tables.  Second level entries are tagged with
+// the address space they were filled for: the paging controls, the PCID
+// (CR4.PCIDE), the VPID or ASID of a VMX/SVM guest and the EPT/nested
+// paging root.  Their translations survive CR3 reloads and VM entries
+// and exits.
+//
+// Each address space in use owns one of BX_STLB_CONTEXTS context slots.
+// An entry records the stamp of its slot, and handing the slot a fresh
+// stamp invalidates all of its entries at once.  Global pages are kept
+// in a separate slot so they hit from every PCID.
 
-// Note: this is an approximation of what Peter Tattam had.
+Bit32u BX_CPU_C::STLB_newStamp(void)
+{
+  if (BX_CPU_THIS_PTR TLB.next_stamp == 0) {
+    // the stamps wrapped around, drop all entries so none can alias
+    for (unsigned set=0; set < BX_STLB_SETS; set++)
+      for (unsigned way=0; way < BX_STLB_WAYS; way++)
+        BX_CPU_THIS_PTR TLB.stlb[set][way].stamp = 0;
+
+    BX_CPU_THIS_PTR TLB.next_stamp = 1;
+    for (unsigned n=0; n < BX_STLB_CONTEXTS; n++)
+      BX_CPU_THIS_PTR TLB.context[n].stamp = BX_CPU_THIS_PTR TLB.next_stamp++;
+  }
 
-#define InstrumentTLB 0
+  return BX_CPU_THIS_PTR TLB.next_stamp++;
+}
 
-#if InstrumentTLB
-static unsigned tlbLookups=0;
-static unsigned tlbMisses=0;
-static unsigned tlbGlobalFlushes=0;
-static unsigned tlbNonGlobalFlushes=0;
+void BX_CPU_C::STLB_init(void)
+{
+  memset(BX_CPU_THIS_PTR TLB.stlb, 0, sizeof(BX_CPU_THIS_PTR TLB.stlb));
+  memset(BX_CPU_THIS_PTR TLB.stlb_victim, 0, sizeof(BX_CPU_THIS_PTR TLB.stlb_victim));
+  memset(&BX_CPU_THIS_PTR TLB.stats, 0, sizeof(BX_CPU_THIS_PTR TLB.stats));
 
-#define InstrTLB_StatsMask 0xfffff
+  BX_CPU_THIS_PTR TLB.next_stamp = 1;
+  BX_CPU_THIS_PTR TLB.lru_clock = 0;
 
-#define InstrTLB_Stats() {\
-  if ((tlbLookups & InstrTLB_StatsMask) == 0) { \
-    BX_INFO(("TLB lookup:%8d miss:%8d %6.2f%% flush:%8d %6.2f%%", \
-          tlbLookups, \
-          tlbMisses, \
-          tlbMisses * 100.0 / tlbLookups, \
-          (tlbGlobalFlushes+tlbNonGlobalFlushes), \
-          (tlbGlobalFlushes+tlbNonGlobalFlushes) * 100.0 / tlbLookups \
-          )); \
-    tlbLookups = tlbMisses = tlbGlobalFlushes = tlbNonGlobalFlushes = 0; \
-    } \
+  for (unsigned n=0; n < BX_STLB_CONTEXTS; n++) {
+    bx_STLB_context *ctx = &BX_CPU_THIS_PTR TLB.context[n];
+    ctx->ctrl = ctx->asid = ctx->pcid = 0xffffffff; // never matches
+    ctx->root = 0;
+    ctx->lru = 0;
+    ctx->stamp = STLB_newStamp();
   }
-#define InstrTLB_Increment(v) (v)++
 
-#else
-#define InstrTLB_Stats()
-#define InstrTLB_Increment(v)
+  BX_CPU_THIS_PTR TLB.cur_context = 0;
+  BX_CPU_THIS_PTR TLB.cur_global_context = 0;
+#if BX_CPU_LEVEL >= 5
+  BX_CPU_THIS_PTR TLB.stlb_large = 0;
 #endif
 
-// ==============================================================
+#if BX_CPU_LEVEL >= 6
+  BX_CPU_THIS_PTR PSC.used = 1;
+  PSC_flush();
+#endif
+}
 
-void BX_CPU_C::TLB_flush(void)
+unsigned BX_CPU_C::STLB_findContext(unsigned hint, Bit32u ctrl, Bit32u asid, Bit32u pcid, bx_phy_address root)
 {
-#if InstrumentTLB
-  InstrTLB_Increment(tlbGlobalFlushes);
-#endif
+  bx_STLB_context *ctx = &BX_CPU_THIS_PTR TLB.context[hint];
+  if (ctx->pcid == pcid && ctx->asid == asid && ctx->ctrl == ctrl && ctx->root == root) {
+    ctx->lru = ++BX_CPU_THIS_PTR TLB.lru_clock;
+    return hint;
+  }
+
+  unsigned n, victim = 0;
+  for (n=0; n < BX_STLB_CONTEXTS; n++) {
+    ctx = &BX_CPU_THIS_PTR TLB.context[n];
+    if (ctx->pcid == pcid && ctx->asid == asid && ctx->ctrl == ctrl && ctx->root == root) {
+      BX_CPU_THIS_PTR TLB.stats.contextSwitches++;
+      ctx->lru = ++BX_CPU_THIS_PTR TLB.lru_clock;
+      return n;
+    }
+    if (ctx->lru < BX_CPU_THIS_PTR TLB.context[victim].lru)
+      victim = n;
+  }
+
+  // recycle the least recently used slot, its entries become stale
+  ctx = &BX_CPU_THIS_PTR TLB.context[victim];
+  ctx->ctrl = ctrl;
+  ctx->asid = asid;
+  ctx->pcid = pcid;
+  ctx->root = root;
+  ctx->stamp = STLB_newStamp();
+  ctx->lru = ++BX_CPU_THIS_PTR TLB.lru_clock;
+  return victim;
+}
 
-  invalidate_prefetch_q();
+void BX_CPU_C::STLB_switchContext(void)
+{
+  // paging controls which affect the translation or the cached permissions
+  Bit32u ctrl = BX_CPU_THIS_PTR cr0.get32() & (BX_CR0_PG_MASK | BX_CR0_WP_MASK);
+#if BX_CPU_LEVEL >= 5
+  ctrl |= BX_CPU_THIS_PTR cr4.get32() & BX_CR4_FLUSH_TLB_MASK;
+  ctrl |= BX_CPU_THIS_PTR efer.get32() & (BX_EFER_NXE_MASK | BX_EFER_LMA_MASK);
+#endif
 
-  invalidate_stack_cache();
+  Bit32u asid = 0, pcid = 0;
+  bx_phy_address root = 0;
 
-  for (unsigned n=0; n<BX_TLB_SIZE; n++) {
-    BX_CPU_THIS_PTR TLB.entry[n].lpf = BX_INVALID_TLB_ENTRY;
-    BX_CPU_THIS_PTR TLB.entry[n].accessBits = 0;
+#if BX_SUPPORT_VMX
+  if (BX_CPU_THIS_PTR in_vmx_guest) {
+    asid = 0x10000;
+#if BX_SUPPORT_VMX >= 2
+    if (SECONDARY_VMEXEC_CONTROL(VMX_VM_EXEC_CTRL3_VPID_ENABLE))
+      asid |= BX_CPU_THIS_PTR vmcs.vpid;
+    if (SECONDARY_VMEXEC_CONTROL(VMX_VM_EXEC_CTRL3_EPT_ENABLE))
+      root = (bx_phy_address) BX_CPU_THIS_PTR vmcs.eptptr;
+#endif
   }
-
-#if BX_CPU_LEVEL >= 5
-  BX_CPU_THIS_PTR TLB.split_large = 0;  // flush whole TLB
 #endif
-
-#if BX_SUPPORT_MONITOR_MWAIT
-  // invalidating of the TLB might change translation for monitored page
-  // and cause subsequent MWAIT instruction to wait forever
-  BX_CPU_THIS_PTR monitor.reset_monitor();
+#if BX_SUPPORT_SVM
+  if (BX_CPU_THIS_PTR in_svm_guest) {
+    asid = BX_CPU_THIS_PTR vmcb.ctrls.guest_asid;
+    if (SVM_NESTED_PAGING_ENABLED)
+      root = (bx_phy_address) BX_CPU_THIS_PTR vmcb.ctrls.ncr3;
+  }
+#endif
+#if BX_SUPPORT_X86_64
+  if (BX_CPU_THIS_PTR cr4.get_PCIDE())
+    pcid = (Bit32u) BX_CPU_THIS_PTR cr3 & 0xfff;
 #endif
+
+  // called on every first level miss, the address space rarely changed
+  // since the last one: its slots are still the current ones
+  bx_STLB_context *ctx = &BX_CPU_THIS_PTR TLB.context[BX_CPU_THIS_PTR TLB.cur_context];
+  bx_STLB_context *global = &BX_CPU_THIS_PTR TLB.context[BX_CPU_THIS_PTR TLB.cur_global_context];
+  if (ctx->pcid == pcid && ctx->asid == asid && ctx->ctrl == ctrl && ctx->root == root &&
+      global->pcid == BX_STLB_GLOBAL_PCID && global->asid == asid && global->ctrl == ctrl && global->root == root)
+    return;
+
+  BX_CPU_THIS_PTR TLB.cur_context = STLB_findContext(BX_CPU_THIS_PTR TLB.cur_context,
+        ctrl, asid, pcid, root);
+  BX_CPU_THIS_PTR TLB.cur_global_context = STLB_findContext(BX_CPU_THIS_PTR TLB.cur_global_context,
+        ctrl, asid, BX_STLB_GLOBAL_PCID, root);
 }
 
-#if BX_CPU_LEVEL >= 6
-void BX_CPU_C::TLB_flushNonGlobal(void)
+bx_STLB_entry *BX_CPU_C::STLB_lookup(bx_address lpf)
+{
+  Bit32u stamp = BX_CPU_THIS_PTR TLB.context[BX_CPU_THIS_PTR TLB.cur_context].stamp;
+  Bit32u global_stamp = BX_CPU_THIS_PTR TLB.context[BX_CPU_THIS_PTR TLB.cur_global_context].stamp;
+  bx_STLB_entry *set = BX_CPU_THIS_PTR TLB.stlb[BX_STLB_SET_OF(lpf)];
+
+  for (unsigned way=0; way < BX_STLB_WAYS; way++) {
+    if (TLB_LPFOf(set[way].tlb.lpf) == lpf &&
+          (set[way].stamp == stamp || set[way].stamp == global_stamp))
+      return &set[way];
+  }
+
+  return NULL;
+}
+
+void BX_CPU_C::STLB_insert(const bx_TLB_entry *tlbEntry)
 {
-#if InstrumentTLB
-  InstrTLB_Increment(tlbNonGlobalFlushes);
+  bx_address lpf = TLB_LPFOf(tlbEntry->lpf);
+  Bit32u stamp = BX_CPU_THIS_PTR TLB.context[BX_CPU_THIS_PTR TLB.cur_context].stamp;
+  Bit32u global_stamp = BX_CPU_THIS_PTR TLB.context[BX_CPU_THIS_PTR TLB.cur_global_context].stamp;
+  unsigned index = BX_STLB_SET_OF(lpf);
+  bx_STLB_entry *set = BX_CPU_THIS_PTR TLB.stlb[index], *victim = NULL;
+
+  for (unsigned way=0; way < BX_STLB_WAYS; way++) {
+    if (TLB_LPFOf(set[way].tlb.lpf) == lpf &&
+          (set[way].stamp == stamp || set[way].stamp == global_stamp)) {
+      victim = &set[way]; // replace the stale translation of this page
+      break;
+    }
+    if (set[way].stamp == 0 && ! victim)
+      victim = &set[way];
+  }
+
+  if (! victim) {
+    unsigned way = BX_CPU_THIS_PTR TLB.stlb_victim[index];
+    BX_CPU_THIS_PTR TLB.stlb_victim[index] = (way + 1) & (BX_STLB_WAYS-1);
+    victim = &set[way];
+
+    for (unsigned n=0; n < BX_STLB_CONTEXTS; n++) {
+      if (victim->stamp == BX_CPU_THIS_PTR TLB.context[n].stamp) {
+        BX_CPU_THIS_PTR TLB.stats.stlbEvictions++;
+        break;
+      }
+    }
+  }
+
+  victim->tlb = *tlbEntry;
+  victim->stamp = (tlbEntry->accessBits & TLB_GlobalPage) ? global_stamp : stamp;
+
+#if BX_CPU_LEVEL >= 5
+  if (tlbEntry->lpf_mask > 0xfff)
+    BX_CPU_THIS_PTR TLB.stlb_large = 1;
 #endif
+}
 
+// ==============================================================
+
+void BX_CPU_C::TLB_flushL1(bx_bool keep_global)
+{
   invalidate_prefetch_q();
 
   invalidate_stack_cache();
 
-  BX_CPU_THIS_PTR TLB.split_large = 0;
   Bit32u lpf_mask = 0;
 
   for (unsigned n=0; n<BX_TLB_SIZE; n++) {
     bx_TLB_entry *tlbEntry = &BX_CPU_THIS_PTR TLB.entry[n];
-    if (!(tlbEntry->accessBits & TLB_GlobalPage)) {
-      tlbEntry->lpf = BX_INVALID_TLB_ENTRY;
-      tlbEntry->accessBits = 0;
+    if (tlbEntry->lpf == BX_INVALID_TLB_ENTRY) continue;
+    if (keep_global && (tlbEntry->accessBits & TLB_GlobalPage)) {
+      lpf_mask |= tlbEntry->lpf_mask;
     }
     else {
-      lpf_mask |= tlbEntry->lpf_mask;
+      tlbEntry->lpf = BX_INVALID_TLB_ENTRY;
+      tlbEntry->accessBits = 0;
+      BX_CPU_THIS_PTR TLB.stats.flushedEntries++;
     }
   }
 
-  if (lpf_mask > 0xfff)
-    BX_CPU_THIS_PTR TLB.split_large = 1;
+#if BX_CPU_LEVEL >= 5
+  BX_CPU_THIS_PTR TLB.split_large = (lpf_mask > 0xfff);
+#endif
+
+#if BX_CPU_LEVEL >= 6
+  PSC_flush();
+#endif
 
 #if BX_SUPPORT_MONITOR_MWAIT
   // invalidating of the TLB might change translation for monitored page
@@ -435,8 +573,61 @@ void BX_CPU_C::TLB_flushNonGlobal(void)
   BX_CPU_THIS_PTR monitor.reset_monitor();
 #endif
 }
+
+void BX_CPU_C::TLB_flush(void)
+{
+  BX_CPU_THIS_PTR TLB.stats.flushes++;
+
+  TLB_flushL1(0);
+
+  for (unsigned n=0; n < BX_STLB_CONTEXTS; n++)
+    BX_CPU_THIS_PTR TLB.context[n].stamp = STLB_newStamp();
+
+#if BX_CPU_LEVEL >= 5
+  BX_CPU_THIS_PTR TLB.stlb_large = 0;
+#endif
+}
+
+#if BX_CPU_LEVEL >= 6
+void BX_CPU_C::TLB_flushNonGlobal(void)
+{
+  BX_CPU_THIS_PTR TLB.stats.nonGlobalFlushes++;
+
+  TLB_flushL1(1);
+
+  for (unsigned n=0; n < BX_STLB_CONTEXTS; n++) {
+    if (BX_CPU_THIS_PTR TLB.context[n].pcid != BX_STLB_GLOBAL_PCID)
+      BX_CPU_THIS_PTR TLB.context[n].stamp = STLB_newStamp();
+  }
+}
 #endif
 
+// Invalidate the non-global translations of the current address space
+// in the second level TLB, the caller takes care of the first level.
+void BX_CPU_C::TLB_flushContext(void)
+{
+  BX_CPU_THIS_PTR TLB.stats.contextFlushes++;
+
+  STLB_switchContext();
+
+  bx_STLB_context *ctx = &BX_CPU_THIS_PTR TLB.context[BX_CPU_THIS_PTR TLB.cur_context];
+  ctx->stamp = STLB_newStamp();
+}
+
+// Invalidate the second level translations of all address spaces of a
+// VPID or ASID, the caller takes care of the first level.
+void BX_CPU_C::TLB_flushASID(Bit32u asid, bx_bool keep_global)
+{
+  BX_CPU_THIS_PTR TLB.stats.contextFlushes++;
+
+  for (unsigned n=0; n < BX_STLB_CONTEXTS; n++) {
+    bx_STLB_context *ctx = &BX_CPU_THIS_PTR TLB.context[n];
+    if (ctx->asid != asid) continue;
+    if (keep_global && ctx->pcid == BX_STLB_GLOBAL_PCID) continue;
+    ctx->stamp = STLB_newStamp();
+  }
+}
+
 void BX_CPU_C::TLB_invlpg(bx_address laddr)
 {
   invalidate_prefetch_q();
@@ -445,6 +636,8 @@ void BX_CPU_C::TLB_invlpg(bx_address laddr)
 
   BX_DEBUG(("TLB_invlpg(0x"FMT_ADDRX"): invalidate TLB entry", laddr));
 
+  BX_CPU_THIS_PTR TLB.stats.invlpgs++;
+
 #if BX_CPU_LEVEL >= 5
   if (BX_CPU_THIS_PTR TLB.split_large)
   {
@@ -479,6 +672,35 @@ void BX_CPU_C::TLB_invlpg(bx_address laddr)
     }
   }
 
+#if BX_CPU_LEVEL >= 6
+  // INVLPG invalidates all paging-structure cache entries
+  PSC_flush();
+#endif
+
+  // drop the page from the second level TLB of all address spaces
+#if BX_CPU_LEVEL >= 5
+  if (BX_CPU_THIS_PTR TLB.stlb_large)
+  {
+    for (unsigned set=0; set < BX_STLB_SETS; set++) {
+      for (unsigned way=0; way < BX_STLB_WAYS; way++) {
+        bx_STLB_entry *stlbEntry = &BX_CPU_THIS_PTR TLB.stlb[set][way];
+        bx_address entry_lpf_mask = stlbEntry->tlb.lpf_mask;
+        if ((laddr & ~entry_lpf_mask) == (stlbEntry->tlb.lpf & ~entry_lpf_mask))
+          stlbEntry->stamp = 0;
+      }
+    }
+  }
+  else
+#endif
+  {
+    bx_address lpf = LPFOf(laddr);
+    bx_STLB_entry *set = BX_CPU_THIS_PTR TLB.stlb[BX_STLB_SET_OF(lpf)];
+    for (unsigned way=0; way < BX_STLB_WAYS; way++) {
+      if (TLB_LPFOf(set[way].tlb.lpf) == lpf)
+        set[way].stamp = 0;
+    }
+  }
+
 #if BX_SUPPORT_MONITOR_MWAIT
   // invalidating of the TLB entry might change translation for monitored
   // page and cause subsequent MWAIT instruction to wait forever
@@ -658,6 +880,64 @@ static const char *bx_paging_level[4] = { "PTE", "PDE", "PDPE", "PML4" }; // kee
 // 63    | Execute-Disable (XD) (if EFER.NXE=1, reserved otherwise)
 // -----------------------------------------------------------
 
+// === Paging-structure caches ==================================
+//
+// The PDE, PDPTE and PML4 caches remember the non-leaf entries of recent
+// PAE and long mode walks, keyed by the linear address bits the entry
+// translates. A walk starts below the lowest cached level, so a TLB
+// miss on a page whose page table is cached reads only the PTE. Entries
+// come from successful walks only, so their accessed bits are already
+// set. The caches are not tagged. Every TLB flush and every INVLPG
+// empties them, which covers the invalidation rules for CR3 and CR4
+// writes and INVPCID.
+
+#define BX_PSC_KEY_OF(laddr, level) ((laddr) >> (12 + 9*(level)))
+#define BX_PSC_INDEX_OF(key) ((unsigned)(key) & (BX_PSC_SIZE-1))
+#define BX_INVALID_PSC_KEY ((bx_address) -1)
+
+void BX_CPU_C::PSC_flush(void)
+{
+  if (! BX_CPU_THIS_PTR PSC.used) return;
+
+  for (unsigned level=0; level < 3; level++)
+    for (unsigned n=0; n < BX_PSC_SIZE; n++)
+      BX_CPU_THIS_PTR PSC.entry[level][n].key = BX_INVALID_PSC_KEY;
+
+  BX_CPU_THIS_PTR PSC.used = 0;
+}
+
+// Returns the level the walk has to continue with, max_level if none of
+// the levels below it is cached.
+int BX_CPU_C::PSC_lookup(bx_address laddr, int max_level, bx_phy_address &ppf, Bit32u &combined_access, Bit32u &nx)
+{
+  for (int level = BX_LEVEL_PDE; level <= max_level; level++) {
+    bx_address key = BX_PSC_KEY_OF(laddr, level);
+    bx_PSC_entry *psc = &BX_CPU_THIS_PTR PSC.entry[level-1][BX_PSC_INDEX_OF(key)];
+    if (psc->key == key) {
+      BX_CPU_THIS_PTR TLB.stats.pscHits[level-1]++;
+      ppf = psc->ppf;
+      combined_access = psc->combined_access;
+      nx = psc->nx;
+      return level - 1;
+    }
+  }
+
+  return max_level;
+}
+
+void BX_CPU_C::PSC_insert(bx_address laddr, int level, bx_phy_address ppf, Bit32u combined_access, Bit32u nx)
+{
+  bx_address key = BX_PSC_KEY_OF(laddr, level);
+  bx_PSC_entry *psc = &BX_CPU_THIS_PTR PSC.entry[level-1][BX_PSC_INDEX_OF(key)];
+
+  psc->key = key;
+  psc->ppf = ppf;
+  psc->combined_access = combined_access;
+  psc->nx = nx;
+
+  BX_CPU_THIS_PTR PSC.used = 1;
+}
+
 int BX_CPU_C::check_entry_PAE(const char *s, Bit64u entry, Bit64u reserved, unsigned rw, bx_bool *nx_fault)
 {
   if (!(entry & 0x1)) {
@@ -688,6 +968,7 @@ bx_phy_address BX_CPU_C::translate_linear_long_mode(bx_address laddr, Bit32u &lp
   bx_phy_address entry_addr[4];
   bx_phy_address ppf = BX_CPU_THIS_PTR cr3 & BX_CR3_PAGING_MASK;
   Bit64u entry[4];
+  Bit32u walk_access[4], walk_nx[4], nx = 0;
   bx_bool nx_fault = 0;
   int leaf;
 
@@ -699,7 +980,12 @@ bx_phy_address BX_CPU_C::translate_linear_long_mode(bx_address laddr, Bit32u &lp
   if (! BX_CPU_THIS_PTR efer.get_NXE())
     reserved |= PAGE_DIRECTORY_NX_BIT;
 
-  for (leaf = BX_LEVEL_PML4;; --leaf) {
+  // skip the levels found in the paging-structure caches
+  int start_leaf = PSC_lookup(laddr, BX_LEVEL_PML4, ppf, combined_access, nx);
+  if (nx && rw == BX_EXECUTE) nx_fault = 1;
+  offset_mask >>= 9 * (BX_LEVEL_PML4 - start_leaf);
+
+  for (leaf = start_leaf;; --leaf) {
     entry_addr[leaf] = ppf + ((laddr >> (9 + 9*leaf)) & 0xff8);
 #if BX_SUPPORT_VMX >= 2
     if (BX_CPU_THIS_PTR in_vmx_guest) {
@@ -723,6 +1009,9 @@ bx_phy_address BX_CPU_C::translate_linear_long_mode(bx_address laddr, Bit32u &lp
 
     combined_access &= curr_entry; // U/S and R/W
     ppf = curr_entry & BX_CONST64(0x000ffffffffff000);
+    if (curr_entry & PAGE_DIRECTORY_NX_BIT) nx = 1;
+    walk_access[leaf] = combined_access;
+    walk_nx[leaf] = nx;
 
     if (leaf == BX_LEVEL_PTE) break;
 
@@ -767,7 +1056,10 @@ bx_phy_address BX_CPU_C::translate_linear_long_mode(bx_address laddr, Bit32u &lp
     combined_access |= (entry[leaf] & 0x100); // G
 
   // Update A/D bits if needed
-  update_access_dirty_PAE(entry_addr, entry, BX_LEVEL_PML4, leaf, isWrite);
+  update_access_dirty_PAE(entry_addr, entry, start_leaf, leaf, isWrite);
+
+  for (int level = start_leaf; level > leaf; level--)
+    PSC_insert(laddr, level, entry[level] & BX_CONST64(0x000ffffffffff000), walk_access[level], walk_nx[level]);
 
   return ppf | (laddr & offset_mask);
 }
@@ -900,8 +1192,9 @@ bx_phy_address BX_CPU_C::translate_linear_load_PDPTR(bx_address laddr, unsigned
 // Translate a linear address to a physical address in PAE paging mode
 bx_phy_address BX_CPU_C::translate_linear_PAE(bx_address laddr, Bit32u &lpf_mask, Bit32u &combined_access, unsigned user, unsigned rw)
 {
-  bx_phy_address entry_addr[2];
+  bx_phy_address entry_addr[2], ppf;
   Bit64u entry[2];
+  Bit32u walk_access[2], walk_nx[2], nx = 0;
   bx_bool nx_fault = 0;
   int leaf;
 
@@ -912,10 +1205,15 @@ bx_phy_address BX_CPU_C::translate_linear_PAE(bx_address laddr, Bit32u &lpf_mask
   if (! BX_CPU_THIS_PTR efer.get_NXE())
     reserved |= PAGE_DIRECTORY_NX_BIT;
 
-  Bit64u pdpte = translate_linear_load_PDPTR(laddr, user, rw);
-  bx_phy_address ppf = pdpte & BX_CONST64(0x000ffffffffff000);
+  // the PDE cache spares the PDPTE and PDE accesses
+  int start_leaf = PSC_lookup(laddr, BX_LEVEL_PDE, ppf, combined_access, nx);
+  if (start_leaf == BX_LEVEL_PDE) {
+    Bit64u pdpte = translate_linear_load_PDPTR(laddr, user, rw);
+    ppf = pdpte & BX_CONST64(0x000ffffffffff000);
+  }
+  else if (nx && rw == BX_EXECUTE) nx_fault = 1;
 
-  for (leaf = BX_LEVEL_PDE;; --leaf) {
+  for (leaf = start_leaf;; --leaf) {
     entry_addr[leaf] = ppf + ((laddr >> (9 + 9*leaf)) & 0xff8);
 #if BX_SUPPORT_VMX >= 2
     if (BX_CPU_THIS_PTR in_vmx_guest) {
@@ -938,6 +1236,9 @@ bx_phy_address BX_CPU_C::translate_linear_PAE(bx_address laddr, Bit32u &lpf_mask
 
     combined_access &= curr_entry; // U/S and R/W
     ppf = curr_entry & BX_CONST64(0x000ffffffffff000);
+    if (curr_entry & PAGE_DIRECTORY_NX_BIT) nx = 1;
+    walk_access[leaf] = combined_access;
+    walk_nx[leaf] = nx;
 
     if (leaf == BX_LEVEL_PTE) break;
 
@@ -979,7 +1280,11 @@ bx_phy_address BX_CPU_C::translate_linear_PAE(bx_address laddr, Bit32u &lpf_mask
     combined_access |= (entry[leaf] & 0x100);     // G
 
   // Update A/D bits if needed
-  update_access_dirty_PAE(entry_addr, entry, BX_LEVEL_PDE, leaf, isWrite);
+  update_access_dirty_PAE(entry_addr, entry, start_leaf, leaf, isWrite);
+
+  if (leaf < start_leaf)
+    PSC_insert(laddr, BX_LEVEL_PDE, entry[BX_LEVEL_PDE] & BX_CONST64(0x000ffffffffff000),
+          walk_access[BX_LEVEL_PDE], walk_nx[BX_LEVEL_PDE]);
 
   return ppf | (laddr & lpf_mask);
 }
@@ -1129,9 +1434,6 @@ bx_phy_address BX_CPU_C::translate_linear(bx_TLB_entry *tlbEntry, bx_address lad
   unsigned isWrite = rw & 1; // write or r-m-w
   unsigned isExecute = (rw == BX_EXECUTE);
 
-  InstrTLB_Increment(tlbLookups);
-  InstrTLB_Stats();
-
   bx_address lpf = LPFOf(laddr);
 
   // already looked up TLB for code access
@@ -1148,7 +1450,26 @@ bx_phy_address BX_CPU_C::translate_linear(bx_TLB_entry *tlbEntry, bx_address lad
     // generate an exception if one is warranted.
   }
 
-  InstrTLB_Increment(tlbMisses);
+  BX_CPU_THIS_PTR TLB.stats.misses++;
+  if (tlbEntry->lpf != BX_INVALID_TLB_ENTRY && TLB_LPFOf(tlbEntry->lpf) != lpf)
+    BX_CPU_THIS_PTR TLB.stats.conflictMisses++;
+
+  // refill from the second level TLB if it has a translation of the page
+  // for the current address space which allows this access
+  STLB_switchContext();
+
+  bx_STLB_entry *stlbEntry = STLB_lookup(lpf);
+  if (stlbEntry && (stlbEntry->tlb.accessBits & (1 << ((isExecute<<2) | (isWrite<<1) | user)))) {
+    BX_CPU_THIS_PTR TLB.stats.stlbHits++;
+    *tlbEntry = stlbEntry->tlb;
+#if BX_CPU_LEVEL >= 5
+    if (tlbEntry->lpf_mask > 0xfff)
+      BX_CPU_THIS_PTR TLB.split_large = 1;
+#endif
+    return tlbEntry->ppf | poffset;
+  }
+
+  BX_CPU_THIS_PTR TLB.stats.pageWalks++;
 
   if(BX_CPU_THIS_PTR cr0.get_PG())
   {
@@ -1255,6 +1576,8 @@ bx_phy_address BX_CPU_C::translate_linear(bx_TLB_entry *tlbEntry, bx_address lad
        tlbEntry->lpf = lpf; // allow direct access with HostPtr
   }
 
+  STLB_insert(tlbEntry);
+
   return paddress;
 }
 
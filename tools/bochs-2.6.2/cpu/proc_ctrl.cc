@@ -54,6 +54,23 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::PAUSE(bxInstruction_c *i)
   }
 #endif
 
+#if BX_SUPPORT_SMP
+  if (BX_CPU_THIS_PTR spin_threshold) {
+    BX_CPU_THIS_PTR spin_stats.pauses++;
+    if ((BX_CPU_THIS_PTR icount - BX_CPU_THIS_PTR pause_icount) > BX_SPIN_LOOP_GAP)
+      BX_CPU_THIS_PTR pause_count = 0;
+    BX_CPU_THIS_PTR pause_icount = BX_CPU_THIS_PTR icount;
+
+    if (++BX_CPU_THIS_PTR pause_count >= BX_CPU_THIS_PTR spin_threshold) {
+      // spinning on a lock, let the scheduler run the other processors
+      BX_CPU_THIS_PTR pause_count = 0;
+      BX_CPU_THIS_PTR spin_stats.spinLoops++;
+      BX_CPU_THIS_PTR spin_loop = 1;
+      BX_CPU_THIS_PTR async_event |= BX_ASYNC_EVENT_STOP_TRACE;
+    }
+  }
+#endif
+
   BX_NEXT_INSTR(i);
 }
 
@@ -451,7 +468,9 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::BxNoAVX(bxInstruction_c *i)
 
 void BX_CPU_C::handleCpuContextChange(void)
 {
-  TLB_flush();
+  // translations of other address spaces stay in the tagged second level
+  // TLB, callers flush it when the context switch requires that
+  TLB_flushL1(0);
 
   invalidate_prefetch_q();
   invalidate_stack_cache();
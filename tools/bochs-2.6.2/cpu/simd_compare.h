@@ -24,34 +24,52 @@
 #ifndef BX_SIMD_INT_COMPARE_FUNCTIONS_H
 #define BX_SIMD_INT_COMPARE_FUNCTIONS_H
 
+#include "simd_host.h"
+
 // compare less than (signed)
 
 BX_CPP_INLINE void sse_pcmpltb(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_cmplt_epi8);
+#else
   for(unsigned n=0; n<16; n++) {
     op1->xmmubyte(n) = (op1->xmmsbyte(n) < op2->xmmsbyte(n)) ? 0xff : 0;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pcmpltw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_cmplt_epi16);
+#else
   for(unsigned n=0; n<8; n++) {
     op1->xmm16u(n) = (op1->xmm16s(n) < op2->xmm16s(n)) ? 0xffff : 0;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pcmpltd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_cmplt_epi32);
+#else
   for(unsigned n=0; n<4; n++) {
     op1->xmm32u(n) = (op1->xmm32s(n) < op2->xmm32s(n)) ? 0xffffffff : 0;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pcmpltq(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE4_2
+  xmm_host_store(op1, _mm_cmpgt_epi64(xmm_host_load(op2), xmm_host_load(op1)));
+#else
   for(unsigned n=0; n<2; n++) {
     op1->xmm64u(n) = (op1->xmm64s(n) < op2->xmm64s(n)) ? BX_CONST64(0xffffffffffffffff) : 0;
   }
+#endif
 }
 
 // compare less than (unsigned)
@@ -148,30 +166,46 @@ BX_CPP_INLINE void sse_pcmpleuq(BxPackedXmmRegister *op1, const BxPackedXmmRegis
 
 BX_CPP_INLINE void sse_pcmpgtb(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_cmpgt_epi8);
+#else
   for(unsigned n=0; n<16; n++) {
     op1->xmmubyte(n) = (op1->xmmsbyte(n) > op2->xmmsbyte(n)) ? 0xff : 0;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pcmpgtw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_cmpgt_epi16);
+#else
   for(unsigned n=0; n<8; n++) {
     op1->xmm16u(n) = (op1->xmm16s(n) > op2->xmm16s(n)) ? 0xffff : 0;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pcmpgtd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_cmpgt_epi32);
+#else
   for(unsigned n=0; n<4; n++) {
     op1->xmm32u(n) = (op1->xmm32s(n) > op2->xmm32s(n)) ? 0xffffffff : 0;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pcmpgtq(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE4_2
+  XMM_HOST_2OP(op1, op2, _mm_cmpgt_epi64);
+#else
   for(unsigned n=0; n<2; n++) {
     op1->xmm64u(n) = (op1->xmm64s(n) > op2->xmm64s(n)) ? BX_CONST64(0xffffffffffffffff) : 0;
   }
+#endif
 }
 
 // compare greater than (unsigned)
@@ -268,30 +302,46 @@ BX_CPP_INLINE void sse_pcmpgeuq(BxPackedXmmRegister *op1, const BxPackedXmmRegis
 
 BX_CPP_INLINE void sse_pcmpeqb(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_cmpeq_epi8);
+#else
   for(unsigned n=0; n<16; n++) {
     op1->xmmubyte(n) = (op1->xmmubyte(n) == op2->xmmubyte(n)) ? 0xff : 0;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pcmpeqw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_cmpeq_epi16);
+#else
   for(unsigned n=0; n<8; n++) {
     op1->xmm16u(n) = (op1->xmm16u(n) == op2->xmm16u(n)) ? 0xffff : 0;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pcmpeqd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_cmpeq_epi32);
+#else
   for(unsigned n=0; n<4; n++) {
     op1->xmm32u(n) = (op1->xmm32u(n) == op2->xmm32u(n)) ? 0xffffffff : 0;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pcmpeqq(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE4_1
+  XMM_HOST_2OP(op1, op2, _mm_cmpeq_epi64);
+#else
   for(unsigned n=0; n<2; n++) {
     op1->xmm64u(n) = (op1->xmm64u(n) == op2->xmm64u(n)) ? BX_CONST64(0xffffffffffffffff) : 0;
   }
+#endif
 }
 
 // compare not equal
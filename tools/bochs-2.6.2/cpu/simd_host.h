@@ -0,0 +1,340 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2013  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef BX_SIMD_HOST_FUNCTIONS_H
+#define BX_SIMD_HOST_FUNCTIONS_H
+
+// Host SIMD backend for the packed integer and floating point helpers.
+//
+// When BX_SUPPORT_HOST_SIMD is enabled and the compiler targets a little
+// endian x86 host with SSE2 (and optionally SSE3/SSSE3/SSE4.x), helpers in
+// simd_int.h and simd_compare.h execute the matching host instruction
+// instead of the per-lane loop. The scalar code stays the reference
+// implementation and is used for everything the host cannot do directly.
+// The instruction set levels follow the compiler target, so -msse4.1 or
+// -march=native enable the wider set. With -mavx2 the AVX/AVX2 handlers
+// also execute VL256 operations as a single host instruction.
+
+#if BX_SUPPORT_HOST_SIMD && !defined(BX_BIG_ENDIAN) && \
+   (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+  #include <emmintrin.h>
+  #define BX_HOST_SSE2 1
+  #if defined(__SSE3__)
+    #include <pmmintrin.h>
+    #define BX_HOST_SSE3 1
+  #endif
+  #if defined(__SSSE3__)
+    #include <tmmintrin.h>
+    #define BX_HOST_SSSE3 1
+  #endif
+  #if defined(__SSE4_1__)
+    #include <smmintrin.h>
+    #define BX_HOST_SSE4_1 1
+  #endif
+  #if defined(__SSE4_2__)
+    #include <nmmintrin.h>
+    #define BX_HOST_SSE4_2 1
+  #endif
+  #if defined(__AVX2__)
+    #include <immintrin.h>
+    #define BX_HOST_AVX2 1
+  #endif
+#endif
+
+#ifndef BX_HOST_SSE2
+  #define BX_HOST_SSE2 0
+#endif
+#ifndef BX_HOST_SSE3
+  #define BX_HOST_SSE3 0
+#endif
+#ifndef BX_HOST_SSSE3
+  #define BX_HOST_SSSE3 0
+#endif
+#ifndef BX_HOST_SSE4_1
+  #define BX_HOST_SSE4_1 0
+#endif
+#ifndef BX_HOST_SSE4_2
+  #define BX_HOST_SSE4_2 0
+#endif
+#ifndef BX_HOST_AVX2
+  #define BX_HOST_AVX2 0
+#endif
+
+#if BX_HOST_SSE2
+
+BX_CPP_INLINE __m128i xmm_host_load(const BxPackedXmmRegister *op)
+{
+  return _mm_loadu_si128((const __m128i *) op);
+}
+
+BX_CPP_INLINE void xmm_host_store(BxPackedXmmRegister *op, __m128i val)
+{
+  _mm_storeu_si128((__m128i *) op, val);
+}
+
+// op1 = f(op1, op2) for a two operand host intrinsic
+#define XMM_HOST_2OP(op1, op2, func) \
+  xmm_host_store((op1), func(xmm_host_load(op1), xmm_host_load(op2)))
+
+// op = f(op) for a one operand host intrinsic
+#define XMM_HOST_1OP(op, func) \
+  xmm_host_store((op), func(xmm_host_load(op)))
+
+// op = f(op, count) for the legacy shift-by-xmm-count host intrinsics,
+// the host instruction applies the full 64-bit count exactly as the guest
+#define XMM_HOST_SHIFT(op, shift_64, func) \
+  xmm_host_store((op), func(xmm_host_load(op), _mm_cvtsi32_si128((shift_64) > 255 ? 255 : (int)(shift_64))))
+
+#endif
+
+// Packed floating point arithmetic on the host unit.
+//
+// Softfloat stays the reference. The host unit is only used when the guest
+// MXCSR selects round to nearest with DAZ and FTZ clear and masks all
+// exceptions but precision, which matches the host default MXCSR state, so
+// both compute the same correctly rounded IEEE result. The host exception
+// flags are sampled after the operation: when nothing but precision was
+// raised the host result is committed, any other flag (NaN or denormal
+// operands, overflow, underflow, divide by zero) or an unmasked precision
+// exception discards it and the caller redoes the operation with softfloat,
+// which provides the exception priority and masked responses the guest
+// sees. The MXCSR of the host thread is restored after each operation.
+
+enum {
+  BX_HOST_FP_ADDPS,
+  BX_HOST_FP_ADDPD,
+  BX_HOST_FP_SUBPS,
+  BX_HOST_FP_SUBPD,
+  BX_HOST_FP_MULPS,
+  BX_HOST_FP_MULPD,
+  BX_HOST_FP_DIVPS,
+  BX_HOST_FP_DIVPD,
+  BX_HOST_FP_MINPS,
+  BX_HOST_FP_MINPD,
+  BX_HOST_FP_MAXPS,
+  BX_HOST_FP_MAXPD,
+  BX_HOST_FP_SQRTPS,
+  BX_HOST_FP_SQRTPD,
+  // SSE3 host instructions below
+  BX_HOST_FP_HADDPS,
+  BX_HOST_FP_HADDPD,
+  BX_HOST_FP_HSUBPS,
+  BX_HOST_FP_HSUBPD,
+  BX_HOST_FP_ADDSUBPS,
+  BX_HOST_FP_ADDSUBPD
+};
+
+#if BX_HOST_SSE2
+
+// host MXCSR: all exceptions masked, round to nearest, no DAZ/FTZ
+#define BX_HOST_MXCSR_DEFAULT (MXCSR_MASKED_EXCEPTIONS)
+
+// The compiler does not know that the host operation depends on the MXCSR
+// and moves it across _mm_setcsr()/_mm_getcsr() as it sees fit, e.g. into
+// the branch where the result is used. The operands are loaded after the
+// first fence and the result is computed before the second one.
+#if defined(__GNUC__)
+  #define BX_HOST_FP_FENCE_MEM() __asm__ __volatile__("" : : : "memory")
+  #define BX_HOST_FP_FENCE_REG(val) __asm__ __volatile__("" : "+x" (val))
+#else
+  #define BX_HOST_FP_FENCE_MEM()
+  #define BX_HOST_FP_FENCE_REG(val)
+#endif
+
+BX_CPP_INLINE bx_bool xmm_host_fp_allowed(const bx_mxcsr_t &mxcsr, unsigned op)
+{
+  if (! BX_HOST_SSE3 && op >= BX_HOST_FP_HADDPS) return 0;
+
+  // softfloat reports an unmasked underflow even for exact tiny results,
+  // the host only for inexact ones: all but precision must be masked
+  if ((mxcsr.mxcsr & MXCSR_MASKED_EXCEPTIONS & ~MXCSR_PM) != (MXCSR_MASKED_EXCEPTIONS & ~MXCSR_PM))
+    return 0;
+
+  return (mxcsr.mxcsr & (MXCSR_ROUNDING_CONTROL | MXCSR_DAZ | MXCSR_FLUSH_MASKED_UNDERFLOW)) == 0;
+}
+
+// op1 <op> op2 for a single 128-bit lane (op2 is ignored by square root)
+BX_CPP_INLINE __m128i xmm_host_fp_lane(unsigned op, const BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
+{
+  __m128i a = xmm_host_load(op1), b = xmm_host_load(op2);
+  __m128 a_ps = _mm_castsi128_ps(a), b_ps = _mm_castsi128_ps(b);
+  __m128d a_pd = _mm_castsi128_pd(a), b_pd = _mm_castsi128_pd(b);
+
+  switch(op) {
+    case BX_HOST_FP_ADDPS: return _mm_castps_si128(_mm_add_ps(a_ps, b_ps));
+    case BX_HOST_FP_ADDPD: return _mm_castpd_si128(_mm_add_pd(a_pd, b_pd));
+    case BX_HOST_FP_SUBPS: return _mm_castps_si128(_mm_sub_ps(a_ps, b_ps));
+    case BX_HOST_FP_SUBPD: return _mm_castpd_si128(_mm_sub_pd(a_pd, b_pd));
+    case BX_HOST_FP_MULPS: return _mm_castps_si128(_mm_mul_ps(a_ps, b_ps));
+    case BX_HOST_FP_MULPD: return _mm_castpd_si128(_mm_mul_pd(a_pd, b_pd));
+    case BX_HOST_FP_DIVPS: return _mm_castps_si128(_mm_div_ps(a_ps, b_ps));
+    case BX_HOST_FP_DIVPD: return _mm_castpd_si128(_mm_div_pd(a_pd, b_pd));
+    case BX_HOST_FP_MINPS: return _mm_castps_si128(_mm_min_ps(a_ps, b_ps));
+    case BX_HOST_FP_MINPD: return _mm_castpd_si128(_mm_min_pd(a_pd, b_pd));
+    case BX_HOST_FP_MAXPS: return _mm_castps_si128(_mm_max_ps(a_ps, b_ps));
+    case BX_HOST_FP_MAXPD: return _mm_castpd_si128(_mm_max_pd(a_pd, b_pd));
+    case BX_HOST_FP_SQRTPS: return _mm_castps_si128(_mm_sqrt_ps(a_ps));
+    case BX_HOST_FP_SQRTPD: return _mm_castpd_si128(_mm_sqrt_pd(a_pd));
+#if BX_HOST_SSE3
+    case BX_HOST_FP_HADDPS: return _mm_castps_si128(_mm_hadd_ps(a_ps, b_ps));
+    case BX_HOST_FP_HADDPD: return _mm_castpd_si128(_mm_hadd_pd(a_pd, b_pd));
+    case BX_HOST_FP_HSUBPS: return _mm_castps_si128(_mm_hsub_ps(a_ps, b_ps));
+    case BX_HOST_FP_HSUBPD: return _mm_castpd_si128(_mm_hsub_pd(a_pd, b_pd));
+    case BX_HOST_FP_ADDSUBPS: return _mm_castps_si128(_mm_addsub_ps(a_ps, b_ps));
+    case BX_HOST_FP_ADDSUBPD: return _mm_castpd_si128(_mm_addsub_pd(a_pd, b_pd));
+#endif
+    default: return a;
+  }
+}
+
+// op1 = op1 <op> op2 for 'lanes' consecutive 128-bit lanes (one or two).
+// Returns 1 and updates op1 only if the host raised nothing but a masked
+// precision exception, which is then set in the guest mxcsr.
+BX_CPP_INLINE bx_bool xmm_host_fp_2op(unsigned op, BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2, unsigned lanes, bx_mxcsr_t &mxcsr)
+{
+  __m128i result[2];
+  Bit32u host_mxcsr = _mm_getcsr();
+
+  _mm_setcsr(BX_HOST_MXCSR_DEFAULT);
+  BX_HOST_FP_FENCE_MEM();
+  result[0] = xmm_host_fp_lane(op, op1, op2);
+  BX_HOST_FP_FENCE_REG(result[0]);
+  if (lanes > 1) {
+    result[1] = xmm_host_fp_lane(op, op1 + 1, op2 + 1);
+    BX_HOST_FP_FENCE_REG(result[1]);
+  }
+  Bit32u flags = _mm_getcsr() & MXCSR_EXCEPTIONS;
+  _mm_setcsr(host_mxcsr);
+  if ((flags & ~MXCSR_PE) || (flags && ! mxcsr.get_PM()))
+    return 0;
+
+  xmm_host_store(op1, result[0]);
+  if (lanes > 1)
+    xmm_host_store(op1 + 1, result[1]);
+  mxcsr.set_exceptions(flags);
+  return 1;
+}
+
+// Evaluates to 1 when the host executed the operation
+#define SSE_HOST_FP_2OP(op1, op2, lanes, op) \
+  (xmm_host_fp_allowed(MXCSR, (op)) && xmm_host_fp_2op((op), (op1), (op2), (lanes), MXCSR))
+
+#else
+
+#define SSE_HOST_FP_2OP(op1, op2, lanes, op) 0
+
+#endif
+
+// 256-bit forms used by the AVX/AVX2 handlers for VL256 operations. They
+// expand to nothing without host AVX2 so that a handler can guard them
+// with a plain 'if (BX_HOST_AVX2 && len == BX_VL256)'.
+
+#if BX_HOST_AVX2 && BX_SUPPORT_AVX
+
+BX_CPP_INLINE __m256i ymm_host_load(const BxPackedAvxRegister *op)
+{
+  return _mm256_loadu_si256((const __m256i *) op);
+}
+
+BX_CPP_INLINE void ymm_host_store(BxPackedAvxRegister *op, __m256i val)
+{
+  _mm256_storeu_si256((__m256i *) op, val);
+}
+
+// dst = f(op1, op2)
+#define YMM_HOST_2OP(dst, op1, op2, func) \
+  ymm_host_store((dst), func(ymm_host_load(op1), ymm_host_load(op2)))
+
+// dst = f(op1, op2, op3)
+#define YMM_HOST_3OP(dst, op1, op2, op3, func) \
+  ymm_host_store((dst), func(ymm_host_load(op1), ymm_host_load(op2), ymm_host_load(op3)))
+
+// dst = f(op)
+#define YMM_HOST_1OP(dst, op, func) \
+  ymm_host_store((dst), func(ymm_host_load(op)))
+
+// dst = f(op, count) for the shift-by-xmm-count host intrinsics
+#define YMM_HOST_SHIFT(dst, op, shift_64, func) \
+  ymm_host_store((dst), func(ymm_host_load(op), _mm_cvtsi32_si128((shift_64) > 255 ? 255 : (int)(shift_64))))
+
+// integer views of the floating point blend and permute intrinsics
+
+BX_CPP_INLINE __m256i ymm_host_blendvps(__m256i op1, __m256i op2, __m256i mask)
+{
+  return _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(op1), _mm256_castsi256_ps(op2), _mm256_castsi256_ps(mask)));
+}
+
+BX_CPP_INLINE __m256i ymm_host_blendvpd(__m256i op1, __m256i op2, __m256i mask)
+{
+  return _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(op1), _mm256_castsi256_pd(op2), _mm256_castsi256_pd(mask)));
+}
+
+BX_CPP_INLINE __m256i ymm_host_permilps(__m256i op1, __m256i op2)
+{
+  return _mm256_castps_si256(_mm256_permutevar_ps(_mm256_castsi256_ps(op1), op2));
+}
+
+BX_CPP_INLINE __m256i ymm_host_permilpd(__m256i op1, __m256i op2)
+{
+  return _mm256_castpd_si256(_mm256_permutevar_pd(_mm256_castsi256_pd(op1), op2));
+}
+
+#else
+
+#define YMM_HOST_2OP(dst, op1, op2, func)
+#define YMM_HOST_3OP(dst, op1, op2, op3, func)
+#define YMM_HOST_1OP(dst, op, func)
+#define YMM_HOST_SHIFT(dst, op, shift_64, func)
+
+#endif
+
+// Host instruction set extensions selected at run time.
+//
+// Instructions with an exact host counterpart (AES-NI, PCLMULQDQ, CRC32)
+// use it whenever the host processor reports the feature through CPUID,
+// independent of the compiler target. The host code paths are compiled
+// with per function target attributes, so this needs a compiler which
+// allows intrinsics in such functions (GCC 4.9 or clang).
+
+#if BX_SUPPORT_HOST_SIMD && !defined(BX_BIG_ENDIAN) && \
+   (defined(__x86_64__) || defined(__i386__)) && \
+   (defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+  #include <cpuid.h>
+  #include <wmmintrin.h>
+  #include <nmmintrin.h>
+  #define BX_HOST_RUNTIME_ISA 1
+  #define BX_HOST_TARGET(isa) __attribute__((target(isa)))
+
+// CPUID.1:ECX feature bits of the host processor (BX_CPUID_EXT_xxx)
+BX_CPP_INLINE Bit32u bx_host_cpuid_ext_features(void)
+{
+  unsigned eax, ebx, ecx, edx;
+
+  if (! __get_cpuid(1, &eax, &ebx, &ecx, &edx)) return 0;
+  return ecx;
+}
+
+#else
+  #define BX_HOST_RUNTIME_ISA 0
+#endif
+
+#endif
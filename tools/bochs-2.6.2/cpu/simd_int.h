@@ -24,147 +24,228 @@
 #ifndef BX_SIMD_INT_FUNCTIONS_H
 #define BX_SIMD_INT_FUNCTIONS_H
 
+#include "simd_host.h"
+
 // absolute value
 
 BX_CPP_INLINE void sse_pabsb(BxPackedXmmRegister *op)
 {
+#if BX_HOST_SSSE3
+  XMM_HOST_1OP(op, _mm_abs_epi8);
+#else
   for(unsigned n=0; n<16; n++) {
     if(op->xmmsbyte(n) < 0) op->xmmubyte(n) = -op->xmmsbyte(n);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pabsw(BxPackedXmmRegister *op)
 {
+#if BX_HOST_SSSE3
+  XMM_HOST_1OP(op, _mm_abs_epi16);
+#else
   for(unsigned n=0; n<8; n++) {
     if(op->xmm16s(n) < 0) op->xmm16u(n) = -op->xmm16s(n);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pabsd(BxPackedXmmRegister *op)
 {
+#if BX_HOST_SSSE3
+  XMM_HOST_1OP(op, _mm_abs_epi32);
+#else
   for(unsigned n=0; n<4; n++) {
     if(op->xmm32s(n) < 0) op->xmm32u(n) = -op->xmm32s(n);
   }
+#endif
 }
 
 // min/max
 
 BX_CPP_INLINE void sse_pminsb(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE4_1
+  XMM_HOST_2OP(op1, op2, _mm_min_epi8);
+#else
   for(unsigned n=0; n<16; n++) {
     if(op2->xmmsbyte(n) < op1->xmmsbyte(n)) op1->xmmubyte(n) = op2->xmmubyte(n);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pminub(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_min_epu8);
+#else
   for(unsigned n=0; n<16; n++) {
     if(op2->xmmubyte(n) < op1->xmmubyte(n)) op1->xmmubyte(n) = op2->xmmubyte(n);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pminsw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_min_epi16);
+#else
   for(unsigned n=0; n<8; n++) {
     if(op2->xmm16s(n) < op1->xmm16s(n)) op1->xmm16s(n) = op2->xmm16s(n);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pminuw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE4_1
+  XMM_HOST_2OP(op1, op2, _mm_min_epu16);
+#else
   for(unsigned n=0; n<8; n++) {
     if(op2->xmm16u(n) < op1->xmm16u(n)) op1->xmm16s(n) = op2->xmm16s(n);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pminsd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE4_1
+  XMM_HOST_2OP(op1, op2, _mm_min_epi32);
+#else
   for(unsigned n=0; n<4; n++) {
     if(op2->xmm32s(n) < op1->xmm32s(n)) op1->xmm32u(n) = op2->xmm32u(n);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pminud(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE4_1
+  XMM_HOST_2OP(op1, op2, _mm_min_epu32);
+#else
   for(unsigned n=0; n<4; n++) {
     if(op2->xmm32u(n) < op1->xmm32u(n)) op1->xmm32u(n) = op2->xmm32u(n);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pmaxsb(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE4_1
+  XMM_HOST_2OP(op1, op2, _mm_max_epi8);
+#else
   for(unsigned n=0; n<16; n++) {
     if(op2->xmmsbyte(n) > op1->xmmsbyte(n)) op1->xmmubyte(n) = op2->xmmubyte(n);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pmaxub(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_max_epu8);
+#else
   for(unsigned n=0; n<16; n++) {
     if(op2->xmmubyte(n) > op1->xmmubyte(n)) op1->xmmubyte(n) = op2->xmmubyte(n);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pmaxsw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_max_epi16);
+#else
   for(unsigned n=0; n<8; n++) {
     if(op2->xmm16s(n) > op1->xmm16s(n)) op1->xmm16s(n) = op2->xmm16s(n);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pmaxuw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE4_1
+  XMM_HOST_2OP(op1, op2, _mm_max_epu16);
+#else
   for(unsigned n=0; n<8; n++) {
     if(op2->xmm16u(n) > op1->xmm16u(n)) op1->xmm16s(n) = op2->xmm16s(n);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pmaxsd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE4_1
+  XMM_HOST_2OP(op1, op2, _mm_max_epi32);
+#else
   for(unsigned n=0; n<4; n++) {
     if(op2->xmm32s(n) > op1->xmm32s(n)) op1->xmm32u(n) = op2->xmm32u(n);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pmaxud(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE4_1
+  XMM_HOST_2OP(op1, op2, _mm_max_epu32);
+#else
   for(unsigned n=0; n<4; n++) {
     if(op2->xmm32u(n) > op1->xmm32u(n)) op1->xmm32u(n) = op2->xmm32u(n);
   }
+#endif
 }
 
 // unpack
 
 BX_CPP_INLINE void sse_unpcklps(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_unpacklo_epi32);
+#else
   op1->xmm32u(3) = op2->xmm32u(1);
   op1->xmm32u(2) = op1->xmm32u(1);
   op1->xmm32u(1) = op2->xmm32u(0);
 //op1->xmm32u(0) = op1->xmm32u(0);
+#endif
 }
 
 BX_CPP_INLINE void sse_unpckhps(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_unpackhi_epi32);
+#else
   op1->xmm32u(0) = op1->xmm32u(2);
   op1->xmm32u(1) = op2->xmm32u(2);
   op1->xmm32u(2) = op1->xmm32u(3);
   op1->xmm32u(3) = op2->xmm32u(3);
+#endif
 }
 
 BX_CPP_INLINE void sse_unpcklpd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_unpacklo_epi64);
+#else
 //op1->xmm64u(0) = op1->xmm64u(0);
   op1->xmm64u(1) = op2->xmm64u(0);
+#endif
 }
 
 BX_CPP_INLINE void sse_unpckhpd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_unpackhi_epi64);
+#else
   op1->xmm64u(0) = op1->xmm64u(1);
   op1->xmm64u(1) = op2->xmm64u(1);
+#endif
 }
 
 BX_CPP_INLINE void sse_punpcklbw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_unpacklo_epi8);
+#else
   op1->xmmubyte(0xF) = op2->xmmubyte(7);
   op1->xmmubyte(0xE) = op1->xmmubyte(7);
   op1->xmmubyte(0xD) = op2->xmmubyte(6);
@@ -181,10 +262,14 @@ BX_CPP_INLINE void sse_punpcklbw(BxPackedXmmRegister *op1, const BxPackedXmmRegi
   op1->xmmubyte(0x2) = op1->xmmubyte(1);
   op1->xmmubyte(0x1) = op2->xmmubyte(0);
 //op1->xmmubyte(0x0) = op1->xmmubyte(0);
+#endif
 }
 
 BX_CPP_INLINE void sse_punpckhbw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_unpackhi_epi8);
+#else
   op1->xmmubyte(0x0) = op1->xmmubyte(0x8);
   op1->xmmubyte(0x1) = op2->xmmubyte(0x8);
   op1->xmmubyte(0x2) = op1->xmmubyte(0x9);
@@ -201,10 +286,14 @@ BX_CPP_INLINE void sse_punpckhbw(BxPackedXmmRegister *op1, const BxPackedXmmRegi
   op1->xmmubyte(0xD) = op2->xmmubyte(0xE);
   op1->xmmubyte(0xE) = op1->xmmubyte(0xF);
   op1->xmmubyte(0xF) = op2->xmmubyte(0xF);
+#endif
 }
 
 BX_CPP_INLINE void sse_punpcklwd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_unpacklo_epi16);
+#else
   op1->xmm16u(7) = op2->xmm16u(3);
   op1->xmm16u(6) = op1->xmm16u(3);
   op1->xmm16u(5) = op2->xmm16u(2);
@@ -213,10 +302,14 @@ BX_CPP_INLINE void sse_punpcklwd(BxPackedXmmRegister *op1, const BxPackedXmmRegi
   op1->xmm16u(2) = op1->xmm16u(1);
   op1->xmm16u(1) = op2->xmm16u(0);
 //op1->xmm16u(0) = op1->xmm16u(0);
+#endif
 }
 
 BX_CPP_INLINE void sse_punpckhwd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_unpackhi_epi16);
+#else
   op1->xmm16u(0) = op1->xmm16u(4);
   op1->xmm16u(1) = op2->xmm16u(4);
   op1->xmm16u(2) = op1->xmm16u(5);
@@ -225,12 +318,16 @@ BX_CPP_INLINE void sse_punpckhwd(BxPackedXmmRegister *op1, const BxPackedXmmRegi
   op1->xmm16u(5) = op2->xmm16u(6);
   op1->xmm16u(6) = op1->xmm16u(7);
   op1->xmm16u(7) = op2->xmm16u(7);
+#endif
 }
  
 // pack
 
 BX_CPP_INLINE void sse_packuswb(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_packus_epi16);
+#else
   op1->xmmubyte(0x0) = SaturateWordSToByteU(op1->xmm16s(0));
   op1->xmmubyte(0x1) = SaturateWordSToByteU(op1->xmm16s(1));
   op1->xmmubyte(0x2) = SaturateWordSToByteU(op1->xmm16s(2));
@@ -248,10 +345,14 @@ BX_CPP_INLINE void sse_packuswb(BxPackedXmmRegister *op1, const BxPackedXmmRegis
   op1->xmmubyte(0xD) = SaturateWordSToByteU(op2->xmm16s(5));
   op1->xmmubyte(0xE) = SaturateWordSToByteU(op2->xmm16s(6));
   op1->xmmubyte(0xF) = SaturateWordSToByteU(op2->xmm16s(7));
+#endif
 }
 
 BX_CPP_INLINE void sse_packsswb(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_packs_epi16);
+#else
   op1->xmmsbyte(0x0) = SaturateWordSToByteS(op1->xmm16s(0));
   op1->xmmsbyte(0x1) = SaturateWordSToByteS(op1->xmm16s(1));
   op1->xmmsbyte(0x2) = SaturateWordSToByteS(op1->xmm16s(2));
@@ -269,10 +370,14 @@ BX_CPP_INLINE void sse_packsswb(BxPackedXmmRegister *op1, const BxPackedXmmRegis
   op1->xmmsbyte(0xD) = SaturateWordSToByteS(op2->xmm16s(5));
   op1->xmmsbyte(0xE) = SaturateWordSToByteS(op2->xmm16s(6));
   op1->xmmsbyte(0xF) = SaturateWordSToByteS(op2->xmm16s(7));
+#endif
 }
 
 BX_CPP_INLINE void sse_packusdw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE4_1
+  XMM_HOST_2OP(op1, op2, _mm_packus_epi32);
+#else
   op1->xmm16u(0) = SaturateDwordSToWordU(op1->xmm32s(0));
   op1->xmm16u(1) = SaturateDwordSToWordU(op1->xmm32s(1));
   op1->xmm16u(2) = SaturateDwordSToWordU(op1->xmm32s(2));
@@ -282,10 +387,14 @@ BX_CPP_INLINE void sse_packusdw(BxPackedXmmRegister *op1, const BxPackedXmmRegis
   op1->xmm16u(5) = SaturateDwordSToWordU(op2->xmm32s(1));
   op1->xmm16u(6) = SaturateDwordSToWordU(op2->xmm32s(2));
   op1->xmm16u(7) = SaturateDwordSToWordU(op2->xmm32s(3));
+#endif
 }
 
 BX_CPP_INLINE void sse_packssdw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_packs_epi32);
+#else
   op1->xmm16s(0) = SaturateDwordSToWordS(op1->xmm32s(0));
   op1->xmm16s(1) = SaturateDwordSToWordS(op1->xmm32s(1));
   op1->xmm16s(2) = SaturateDwordSToWordS(op1->xmm32s(2));
@@ -295,12 +404,16 @@ BX_CPP_INLINE void sse_packssdw(BxPackedXmmRegister *op1, const BxPackedXmmRegis
   op1->xmm16s(5) = SaturateDwordSToWordS(op2->xmm32s(1));
   op1->xmm16s(6) = SaturateDwordSToWordS(op2->xmm32s(2));
   op1->xmm16s(7) = SaturateDwordSToWordS(op2->xmm32s(3));
+#endif
 }
 
 // shuffle
 
 BX_CPP_INLINE void sse_pshufb(BxPackedXmmRegister *r, const BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSSE3
+  xmm_host_store(r, _mm_shuffle_epi8(xmm_host_load(op1), xmm_host_load(op2)));
+#else
   for(unsigned n=0; n<16; n++)
   {
     unsigned mask = op2->xmmubyte(n);
@@ -309,6 +422,7 @@ BX_CPP_INLINE void sse_pshufb(BxPackedXmmRegister *r, const BxPackedXmmRegister
     else
       r->xmmubyte(n) = op1->xmmubyte(mask & 0xf);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pshufhw(BxPackedXmmRegister *r, const BxPackedXmmRegister *op, Bit8u order)
@@ -345,16 +459,24 @@ BX_CPP_INLINE void sse_shufpd(BxPackedXmmRegister *r, const BxPackedXmmRegister
 
 BX_CPP_INLINE void sse_permilps(BxPackedXmmRegister *r, const BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_AVX2
+  xmm_host_store(r, _mm_castps_si128(_mm_permutevar_ps(_mm_castsi128_ps(xmm_host_load(op1)), xmm_host_load(op2))));
+#else
   r->xmm32u(0) = op1->xmm32u(op2->xmm32u(0) & 0x3);
   r->xmm32u(1) = op1->xmm32u(op2->xmm32u(1) & 0x3);
   r->xmm32u(2) = op1->xmm32u(op2->xmm32u(2) & 0x3);
   r->xmm32u(3) = op1->xmm32u(op2->xmm32u(3) & 0x3);
+#endif
 }
 
 BX_CPP_INLINE void sse_permilpd(BxPackedXmmRegister *r, const BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_AVX2
+  xmm_host_store(r, _mm_castpd_si128(_mm_permutevar_pd(_mm_castsi128_pd(xmm_host_load(op1)), xmm_host_load(op2))));
+#else
   r->xmm64u(0) = op1->xmm64u((op2->xmm32u(0) >> 1) & 0x1);
   r->xmm64u(1) = op1->xmm64u((op2->xmm32u(2) >> 1) & 0x1);
+#endif
 }
 
 BX_CPP_INLINE void sse_permil2ps(BxPackedXmmRegister *r, const BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2, const BxPackedXmmRegister *op3, unsigned m2z)
@@ -383,32 +505,47 @@ BX_CPP_INLINE void sse_permil2pd(BxPackedXmmRegister *r, const BxPackedXmmRegist
 
 BX_CPP_INLINE void sse_psignb(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSSE3
+  XMM_HOST_2OP(op1, op2, _mm_sign_epi8);
+#else
   for(unsigned n=0; n<16; n++) {
     int sign = (op2->xmmsbyte(n) > 0) - (op2->xmmsbyte(n) < 0);
     op1->xmmsbyte(n) *= sign;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_psignw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSSE3
+  XMM_HOST_2OP(op1, op2, _mm_sign_epi16);
+#else
   for(unsigned n=0; n<8; n++) {
     int sign = (op2->xmm16s(n) > 0) - (op2->xmm16s(n) < 0);
     op1->xmm16s(n) *= sign;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_psignd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSSE3
+  XMM_HOST_2OP(op1, op2, _mm_sign_epi32);
+#else
   for(unsigned n=0; n<4; n++) {
     int sign = (op2->xmm32s(n) > 0) - (op2->xmm32s(n) < 0);
     op1->xmm32s(n) *= sign;
   }
+#endif
 }
 
 // mask creation
 
 BX_CPP_INLINE Bit32u sse_pmovmskb(const BxPackedXmmRegister *op)
 {
+#if BX_HOST_SSE2
+  return _mm_movemask_epi8(xmm_host_load(op));
+#else
   unsigned mask = 0;
 
   if(op->xmmubyte(0x0) & 0x80) mask |= 0x0001;
@@ -429,10 +566,14 @@ BX_CPP_INLINE Bit32u sse_pmovmskb(const BxPackedXmmRegister *op)
   if(op->xmmubyte(0xF) & 0x80) mask |= 0x8000;
 
   return mask;
+#endif
 }
 
 BX_CPP_INLINE Bit32u sse_pmovmskd(const BxPackedXmmRegister *op)
 {
+#if BX_HOST_SSE2
+  return _mm_movemask_ps(_mm_castsi128_ps(xmm_host_load(op)));
+#else
   unsigned mask = 0;
 
   if(op->xmm32u(0) & 0x80000000) mask |= 0x1;
@@ -441,16 +582,21 @@ BX_CPP_INLINE Bit32u sse_pmovmskd(const BxPackedXmmRegister *op)
   if(op->xmm32u(3) & 0x80000000) mask |= 0x8;
 
   return mask;
+#endif
 }
 
 BX_CPP_INLINE Bit32u sse_pmovmskq(const BxPackedXmmRegister *op)
 {
+#if BX_HOST_SSE2
+  return _mm_movemask_pd(_mm_castsi128_pd(xmm_host_load(op)));
+#else
   unsigned mask = 0;
 
   if(op->xmm32u(1) & 0x80000000) mask |= 0x1;
   if(op->xmm32u(3) & 0x80000000) mask |= 0x2;
 
   return mask;
+#endif
 }
 
 // blend
@@ -483,9 +629,13 @@ BX_CPP_INLINE void sse_blendpd(BxPackedXmmRegister *op1, const BxPackedXmmRegist
 
 BX_CPP_INLINE void sse_pblendvb(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2, const BxPackedXmmRegister *mask)
 {
+#if BX_HOST_SSE4_1
+  xmm_host_store(op1, _mm_blendv_epi8(xmm_host_load(op1), xmm_host_load(op2), xmm_host_load(mask)));
+#else
   for(unsigned n=0; n<16; n++) {
     if (mask->xmmubyte(n) & 0x80) op1->xmmubyte(n) = op2->xmmubyte(n);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_blendvps(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2, const BxPackedXmmRegister *mask)
@@ -505,132 +655,207 @@ BX_CPP_INLINE void sse_blendvpd(BxPackedXmmRegister *op1, const BxPackedXmmRegis
 
 BX_CPP_INLINE void sse_andps(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_and_si128);
+#else
   op1->xmm64u(0) &= op2->xmm64u(0);
   op1->xmm64u(1) &= op2->xmm64u(1);
+#endif
 }
 
 BX_CPP_INLINE void sse_andnps(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_andnot_si128);
+#else
   op1->xmm64u(0) = ~(op1->xmm64u(0)) & op2->xmm64u(0);
   op1->xmm64u(1) = ~(op1->xmm64u(1)) & op2->xmm64u(1);
+#endif
 }
 
 BX_CPP_INLINE void sse_orps(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_or_si128);
+#else
   op1->xmm64u(0) |= op2->xmm64u(0);
   op1->xmm64u(1) |= op2->xmm64u(1);
+#endif
 }
 
 BX_CPP_INLINE void sse_xorps(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_xor_si128);
+#else
   op1->xmm64u(0) ^= op2->xmm64u(0);
   op1->xmm64u(1) ^= op2->xmm64u(1);
+#endif
 }
 
 // arithmetic (add/sub)
 
 BX_CPP_INLINE void sse_paddb(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_add_epi8);
+#else
   for(unsigned n=0; n<16; n++) {
     op1->xmmubyte(n) += op2->xmmubyte(n);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_paddw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_add_epi16);
+#else
   for(unsigned n=0; n<8; n++) {
     op1->xmm16u(n) += op2->xmm16u(n);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_paddd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_add_epi32);
+#else
   for(unsigned n=0; n<4; n++) {
     op1->xmm32u(n) += op2->xmm32u(n);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_paddq(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_add_epi64);
+#else
   for(unsigned n=0; n<2; n++) {
     op1->xmm64u(n) += op2->xmm64u(n);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_psubb(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_sub_epi8);
+#else
   for(unsigned n=0; n<16; n++) {
     op1->xmmubyte(n) -= op2->xmmubyte(n);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_psubw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_sub_epi16);
+#else
   for(unsigned n=0; n<8; n++) {
     op1->xmm16u(n) -= op2->xmm16u(n);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_psubd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_sub_epi32);
+#else
   for(unsigned n=0; n<4; n++) {
     op1->xmm32u(n) -= op2->xmm32u(n);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_psubq(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_sub_epi64);
+#else
   for(unsigned n=0; n<2; n++) {
     op1->xmm64u(n) -= op2->xmm64u(n);
   }
+#endif
 }
 
 // arithmetic (add/sub with saturation)
 
 BX_CPP_INLINE void sse_paddsb(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_adds_epi8);
+#else
   for(unsigned n=0; n<16; n++) {
     op1->xmmsbyte(n) = SaturateWordSToByteS(Bit16s(op1->xmmsbyte(n)) + Bit16s(op2->xmmsbyte(n)));
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_paddsw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_adds_epi16);
+#else
   for(unsigned n=0; n<8; n++) {
     op1->xmm16s(n) = SaturateDwordSToWordS(Bit32s(op1->xmm16s(n)) + Bit32s(op2->xmm16s(n)));
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_paddusb(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_adds_epu8);
+#else
   for(unsigned n=0; n<16; n++) {
     op1->xmmubyte(n) = SaturateWordSToByteU(Bit16s(op1->xmmubyte(n)) + Bit16s(op2->xmmubyte(n)));
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_paddusw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_adds_epu16);
+#else
   for(unsigned n=0; n<8; n++) {
     op1->xmm16u(n) = SaturateDwordSToWordU(Bit32s(op1->xmm16u(n)) + Bit32s(op2->xmm16u(n)));
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_psubsb(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_subs_epi8);
+#else
   for(unsigned n=0; n<16; n++) {
     op1->xmmsbyte(n) = SaturateWordSToByteS(Bit16s(op1->xmmsbyte(n)) - Bit16s(op2->xmmsbyte(n)));
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_psubsw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_subs_epi16);
+#else
   for(unsigned n=0; n<8; n++) {
     op1->xmm16s(n) = SaturateDwordSToWordS(Bit32s(op1->xmm16s(n)) - Bit32s(op2->xmm16s(n)));
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_psubusb(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_subs_epu8);
+#else
   for(unsigned n=0; n<16; n++)
   {
     if(op1->xmmubyte(n) > op2->xmmubyte(n))
@@ -638,10 +863,14 @@ BX_CPP_INLINE void sse_psubusb(BxPackedXmmRegister *op1, const BxPackedXmmRegist
     else
       op1->xmmubyte(n) = 0;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_psubusw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_subs_epu16);
+#else
   for(unsigned n=0; n<8; n++)
   {
     if(op1->xmm16u(n) > op2->xmm16u(n))
@@ -649,12 +878,16 @@ BX_CPP_INLINE void sse_psubusw(BxPackedXmmRegister *op1, const BxPackedXmmRegist
     else
       op1->xmm16u(n) = 0;
   }
+#endif
 }
 
 // arithmetic (horizontal add/sub)
 
 BX_CPP_INLINE void sse_phaddw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSSE3
+  XMM_HOST_2OP(op1, op2, _mm_hadd_epi16);
+#else
   op1->xmm16u(0) = op1->xmm16u(0) + op1->xmm16u(1);
   op1->xmm16u(1) = op1->xmm16u(2) + op1->xmm16u(3);
   op1->xmm16u(2) = op1->xmm16u(4) + op1->xmm16u(5);
@@ -664,18 +897,26 @@ BX_CPP_INLINE void sse_phaddw(BxPackedXmmRegister *op1, const BxPackedXmmRegiste
   op1->xmm16u(5) = op2->xmm16u(2) + op2->xmm16u(3);
   op1->xmm16u(6) = op2->xmm16u(4) + op2->xmm16u(5);
   op1->xmm16u(7) = op2->xmm16u(6) + op2->xmm16u(7);
+#endif
 }
 
 BX_CPP_INLINE void sse_phaddd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSSE3
+  XMM_HOST_2OP(op1, op2, _mm_hadd_epi32);
+#else
   op1->xmm32u(0) = op1->xmm32u(0) + op1->xmm32u(1);
   op1->xmm32u(1) = op1->xmm32u(2) + op1->xmm32u(3);
   op1->xmm32u(2) = op2->xmm32u(0) + op2->xmm32u(1);
   op1->xmm32u(3) = op2->xmm32u(2) + op2->xmm32u(3);
+#endif
 }
 
 BX_CPP_INLINE void sse_phaddsw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSSE3
+  XMM_HOST_2OP(op1, op2, _mm_hadds_epi16);
+#else
   op1->xmm16s(0) = SaturateDwordSToWordS(Bit32s(op1->xmm16s(0)) + Bit32s(op1->xmm16s(1)));
   op1->xmm16s(1) = SaturateDwordSToWordS(Bit32s(op1->xmm16s(2)) + Bit32s(op1->xmm16s(3)));
   op1->xmm16s(2) = SaturateDwordSToWordS(Bit32s(op1->xmm16s(4)) + Bit32s(op1->xmm16s(5)));
@@ -685,10 +926,14 @@ BX_CPP_INLINE void sse_phaddsw(BxPackedXmmRegister *op1, const BxPackedXmmRegist
   op1->xmm16s(5) = SaturateDwordSToWordS(Bit32s(op2->xmm16s(2)) + Bit32s(op2->xmm16s(3)));
   op1->xmm16s(6) = SaturateDwordSToWordS(Bit32s(op2->xmm16s(4)) + Bit32s(op2->xmm16s(5)));
   op1->xmm16s(7) = SaturateDwordSToWordS(Bit32s(op2->xmm16s(6)) + Bit32s(op2->xmm16s(7)));
+#endif
 }
 
 BX_CPP_INLINE void sse_phsubw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSSE3
+  XMM_HOST_2OP(op1, op2, _mm_hsub_epi16);
+#else
   op1->xmm16u(0) = op1->xmm16u(0) - op1->xmm16u(1);
   op1->xmm16u(1) = op1->xmm16u(2) - op1->xmm16u(3);
   op1->xmm16u(2) = op1->xmm16u(4) - op1->xmm16u(5);
@@ -698,18 +943,26 @@ BX_CPP_INLINE void sse_phsubw(BxPackedXmmRegister *op1, const BxPackedXmmRegiste
   op1->xmm16u(5) = op2->xmm16u(2) - op2->xmm16u(3);
   op1->xmm16u(6) = op2->xmm16u(4) - op2->xmm16u(5);
   op1->xmm16u(7) = op2->xmm16u(6) - op2->xmm16u(7);
+#endif
 }
 
 BX_CPP_INLINE void sse_phsubd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSSE3
+  XMM_HOST_2OP(op1, op2, _mm_hsub_epi32);
+#else
   op1->xmm32u(0) = op1->xmm32u(0) - op1->xmm32u(1);
   op1->xmm32u(1) = op1->xmm32u(2) - op1->xmm32u(3);
   op1->xmm32u(2) = op2->xmm32u(0) - op2->xmm32u(1);
   op1->xmm32u(3) = op2->xmm32u(2) - op2->xmm32u(3);
+#endif
 }
 
 BX_CPP_INLINE void sse_phsubsw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSSE3
+  XMM_HOST_2OP(op1, op2, _mm_hsubs_epi16);
+#else
   op1->xmm16s(0) = SaturateDwordSToWordS(Bit32s(op1->xmm16s(0)) - Bit32s(op1->xmm16s(1)));
   op1->xmm16s(1) = SaturateDwordSToWordS(Bit32s(op1->xmm16s(2)) - Bit32s(op1->xmm16s(3)));
   op1->xmm16s(2) = SaturateDwordSToWordS(Bit32s(op1->xmm16s(4)) - Bit32s(op1->xmm16s(5)));
@@ -719,81 +972,121 @@ BX_CPP_INLINE void sse_phsubsw(BxPackedXmmRegister *op1, const BxPackedXmmRegist
   op1->xmm16s(5) = SaturateDwordSToWordS(Bit32s(op2->xmm16s(2)) - Bit32s(op2->xmm16s(3)));
   op1->xmm16s(6) = SaturateDwordSToWordS(Bit32s(op2->xmm16s(4)) - Bit32s(op2->xmm16s(5)));
   op1->xmm16s(7) = SaturateDwordSToWordS(Bit32s(op2->xmm16s(6)) - Bit32s(op2->xmm16s(7)));
+#endif
 }
 
 // average
 
 BX_CPP_INLINE void sse_pavgb(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_avg_epu8);
+#else
   for(unsigned n=0; n<16; n++) {
     op1->xmmubyte(n) = (op1->xmmubyte(n) + op2->xmmubyte(n) + 1) >> 1;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pavgw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_avg_epu16);
+#else
   for(unsigned n=0; n<8; n++) {
     op1->xmm16u(n) = (op1->xmm16u(n) + op2->xmm16u(n) + 1) >> 1;
   }
+#endif
 }
 
 // multiply
 
 BX_CPP_INLINE void sse_pmullw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_mullo_epi16);
+#else
   for(unsigned n=0; n<8; n++) {
     Bit32u product = Bit32u(op1->xmm16u(n)) * Bit32u(op2->xmm16u(n));
     op1->xmm16u(n) = product & 0xffff;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pmulhw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_mulhi_epi16);
+#else
   for(unsigned n=0; n<8; n++) {
     Bit32s product = Bit32s(op1->xmm16s(n)) * Bit32s(op2->xmm16s(n));
     op1->xmm16u(n) = (Bit16u)(product >> 16);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pmulhuw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_mulhi_epu16);
+#else
   for(unsigned n=0; n<8; n++) {
     Bit32u product = Bit32u(op1->xmm16u(n)) * Bit32u(op2->xmm16u(n));
     op1->xmm16u(n) = (Bit16u)(product >> 16);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pmulld(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE4_1
+  XMM_HOST_2OP(op1, op2, _mm_mullo_epi32);
+#else
   for(unsigned n=0; n<4; n++) {
     Bit64s product = Bit64s(op1->xmm32s(n)) * Bit64s(op2->xmm32s(n));
     op1->xmm32u(n) = (Bit32u)(product & 0xffffffff);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pmuldq(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE4_1
+  XMM_HOST_2OP(op1, op2, _mm_mul_epi32);
+#else
   op1->xmm64s(0) = Bit64s(op1->xmm32s(0)) * Bit64s(op2->xmm32s(0));
   op1->xmm64s(1) = Bit64s(op1->xmm32s(2)) * Bit64s(op2->xmm32s(2));
+#endif
 }
 
 BX_CPP_INLINE void sse_pmuludq(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_mul_epu32);
+#else
   op1->xmm64u(0) = Bit64u(op1->xmm32u(0)) * Bit64u(op2->xmm32u(0));
   op1->xmm64u(1) = Bit64u(op1->xmm32u(2)) * Bit64u(op2->xmm32u(2));
+#endif
 }
 
 BX_CPP_INLINE void sse_pmulhrsw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSSE3
+  XMM_HOST_2OP(op1, op2, _mm_mulhrs_epi16);
+#else
   for(unsigned n=0; n<8; n++) {
     op1->xmm16u(n) = (((op1->xmm16s(n) * op2->xmm16s(n)) >> 14) + 1) >> 1;
   }
+#endif
 }
 
 // multiply/add
 
 BX_CPP_INLINE void sse_pmaddubsw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSSE3
+  XMM_HOST_2OP(op1, op2, _mm_maddubs_epi16);
+#else
   for(unsigned n=0; n<8; n++)
   {
     Bit32s temp = Bit32s(op1->xmmubyte(n*2))   * Bit32s(op2->xmmsbyte(n*2)) +
@@ -801,13 +1094,17 @@ BX_CPP_INLINE void sse_pmaddubsw(BxPackedXmmRegister *op1, const BxPackedXmmRegi
 
     op1->xmm16s(n) = SaturateDwordSToWordS(temp);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pmaddwd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_madd_epi16);
+#else
   for(unsigned n=0; n<4; n++)
   {
-    if((op1->xmm32u(n) & op2->xmm32u(n)) == 0x80008000) {
+    if(op1->xmm32u(n) == 0x80008000 && op2->xmm32u(n) == 0x80008000) {
       op1->xmm32u(n) = 0x80000000;
     }
     else {
@@ -815,29 +1112,42 @@ BX_CPP_INLINE void sse_pmaddwd(BxPackedXmmRegister *op1, const BxPackedXmmRegist
                        Bit32s(op1->xmm16s(n*2+1)) * Bit32s(op2->xmm16s(n*2+1));
     }
   }
+#endif
 }
 
 // broadcast
 
 BX_CPP_INLINE void sse_pbroadcastb(BxPackedXmmRegister *op, Bit8u val_8)
 {
+#if BX_HOST_SSE2
+  xmm_host_store(op, _mm_set1_epi8((char) val_8));
+#else
   for(unsigned n=0; n<16; n++) {
     op->xmmubyte(n) = val_8;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pbroadcastw(BxPackedXmmRegister *op, Bit16u val_16)
 {
+#if BX_HOST_SSE2
+  xmm_host_store(op, _mm_set1_epi16((short) val_16));
+#else
   for(unsigned n=0; n<8; n++) {
     op->xmm16u(n) = val_16;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pbroadcastd(BxPackedXmmRegister *op, Bit32u val_32)
 {
+#if BX_HOST_SSE2
+  xmm_host_store(op, _mm_set1_epi32((int) val_32));
+#else
   for(unsigned n=0; n<4; n++) {
     op->xmm32u(n) = val_32;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pbroadcastq(BxPackedXmmRegister *op, Bit64u val_64)
@@ -851,6 +1161,9 @@ BX_CPP_INLINE void sse_pbroadcastq(BxPackedXmmRegister *op, Bit64u val_64)
 
 BX_CPP_INLINE void sse_psadbw(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_2OP(op1, op2, _mm_sad_epu8);
+#else
   Bit16u temp1 = 0, temp2 = 0;
 
   temp1 += abs(op1->xmmubyte(0x0) - op2->xmmubyte(0x0));
@@ -873,6 +1186,7 @@ BX_CPP_INLINE void sse_psadbw(BxPackedXmmRegister *op1, const BxPackedXmmRegiste
 
   op1->xmm64u(0) = Bit64u(temp1);
   op1->xmm64u(1) = Bit64u(temp2);
+#endif
 }
 
 // multiple sum of absolute differences (MSAD)
@@ -901,15 +1215,23 @@ BX_CPP_INLINE void sse_mpsadbw(BxPackedXmmRegister *r, const BxPackedXmmRegister
 
 BX_CPP_INLINE void sse_pselect(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2, const BxPackedXmmRegister *op3)
 {
+#if BX_HOST_SSE2
+  __m128i mask = xmm_host_load(op3);
+  xmm_host_store(op1, _mm_or_si128(_mm_and_si128(mask, xmm_host_load(op1)), _mm_andnot_si128(mask, xmm_host_load(op2))));
+#else
   for(unsigned n=0;n < 2;n++) {
     op1->xmm64u(n) = (op3->xmm64u(n) & op1->xmm64u(n)) | (~op3->xmm64u(n) & op2->xmm64u(n));
   }
+#endif
 }
 
 // shift
 
 BX_CPP_INLINE void sse_psravd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_AVX2
+  XMM_HOST_2OP(op1, op2, _mm_srav_epi32);
+#else
   for (unsigned n=0; n < 4; n++) {
     Bit32u shift = op2->xmm32u(n);
     if(shift > 31)
@@ -917,10 +1239,14 @@ BX_CPP_INLINE void sse_psravd(BxPackedXmmRegister *op1, const BxPackedXmmRegiste
     else    
       op1->xmm32u(n) = (Bit32u)(op1->xmm32s(n) >> shift);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_psllvd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_AVX2
+  XMM_HOST_2OP(op1, op2, _mm_sllv_epi32);
+#else
   for (unsigned n=0; n < 4; n++) {
     Bit32u shift = op2->xmm32u(n);
     if(shift > 31)
@@ -928,10 +1254,14 @@ BX_CPP_INLINE void sse_psllvd(BxPackedXmmRegister *op1, const BxPackedXmmRegiste
     else    
       op1->xmm32u(n) <<= shift;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_psllvq(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_AVX2
+  XMM_HOST_2OP(op1, op2, _mm_sllv_epi64);
+#else
   for (unsigned n=0; n < 2; n++) {
     Bit64u shift = op2->xmm64u(n);
     if(shift > 63)
@@ -939,10 +1269,14 @@ BX_CPP_INLINE void sse_psllvq(BxPackedXmmRegister *op1, const BxPackedXmmRegiste
     else    
       op1->xmm64u(n) <<= shift;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_psrlvd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_AVX2
+  XMM_HOST_2OP(op1, op2, _mm_srlv_epi32);
+#else
   for (unsigned n=0; n < 4; n++) {
     Bit32u shift = op2->xmm32u(n);
     if(shift > 31)
@@ -950,10 +1284,14 @@ BX_CPP_INLINE void sse_psrlvd(BxPackedXmmRegister *op1, const BxPackedXmmRegiste
     else    
       op1->xmm32u(n) >>= shift;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_psrlvq(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2)
 {
+#if BX_HOST_AVX2
+  XMM_HOST_2OP(op1, op2, _mm_srlv_epi64);
+#else
   for (unsigned n=0; n < 2; n++) {
     Bit64u shift = op2->xmm64u(n);
     if(shift > 63)
@@ -961,10 +1299,14 @@ BX_CPP_INLINE void sse_psrlvq(BxPackedXmmRegister *op1, const BxPackedXmmRegiste
     else    
       op1->xmm64u(n) >>= shift;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_psraw(BxPackedXmmRegister *op, Bit64u shift_64)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_SHIFT(op, shift_64, _mm_sra_epi16);
+#else
   if(shift_64 > 15) {
     for (unsigned n=0; n < 8; n++)
       op->xmm16u(n) = (op->xmm16u(n) & 0x8000) ? 0xffff : 0;
@@ -976,10 +1318,14 @@ BX_CPP_INLINE void sse_psraw(BxPackedXmmRegister *op, Bit64u shift_64)
     for (unsigned n=0; n < 8; n++)
       op->xmm16u(n) = (Bit16u)(op->xmm16s(n) >> shift);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_psrad(BxPackedXmmRegister *op, Bit64u shift_64)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_SHIFT(op, shift_64, _mm_sra_epi32);
+#else
   if(shift_64 > 31) {
     for (unsigned n=0; n < 4; n++)
       op->xmm32u(n) = (op->xmm32u(n) & 0x80000000) ? 0xffffffff : 0;
@@ -991,10 +1337,14 @@ BX_CPP_INLINE void sse_psrad(BxPackedXmmRegister *op, Bit64u shift_64)
     for (unsigned n=0; n < 4; n++)
       op->xmm32u(n) = (Bit32u)(op->xmm32s(n) >> shift);
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_psrlw(BxPackedXmmRegister *op, Bit64u shift_64)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_SHIFT(op, shift_64, _mm_srl_epi16);
+#else
   if(shift_64 > 15) {
     op->xmm64u(0) = 0;
     op->xmm64u(1) = 0;
@@ -1006,10 +1356,14 @@ BX_CPP_INLINE void sse_psrlw(BxPackedXmmRegister *op, Bit64u shift_64)
     for (unsigned n=0; n < 8; n++)
       op->xmm16u(n) >>= shift;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_psrld(BxPackedXmmRegister *op, Bit64u shift_64)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_SHIFT(op, shift_64, _mm_srl_epi32);
+#else
   if(shift_64 > 31) {
     op->xmm64u(0) = 0;
     op->xmm64u(1) = 0;
@@ -1021,11 +1375,15 @@ BX_CPP_INLINE void sse_psrld(BxPackedXmmRegister *op, Bit64u shift_64)
     for (unsigned n=0; n < 4; n++)
       op->xmm32u(n) >>= shift;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_psrlq(BxPackedXmmRegister *op, Bit64u shift_64)
 {
-  if(shift_64 > 64) {
+#if BX_HOST_SSE2
+  XMM_HOST_SHIFT(op, shift_64, _mm_srl_epi64);
+#else
+  if(shift_64 > 63) {
     op->xmm64u(0) = 0;
     op->xmm64u(1) = 0;
   }
@@ -1036,10 +1394,14 @@ BX_CPP_INLINE void sse_psrlq(BxPackedXmmRegister *op, Bit64u shift_64)
     for (unsigned n=0; n < 2; n++)
       op->xmm64u(n) >>= shift;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_psllw(BxPackedXmmRegister *op, Bit64u shift_64)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_SHIFT(op, shift_64, _mm_sll_epi16);
+#else
   if(shift_64 > 15) {
     op->xmm64u(0) = 0;
     op->xmm64u(1) = 0;
@@ -1051,10 +1413,14 @@ BX_CPP_INLINE void sse_psllw(BxPackedXmmRegister *op, Bit64u shift_64)
     for (unsigned n=0; n < 8; n++)
       op->xmm16u(n) <<= shift;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_pslld(BxPackedXmmRegister *op, Bit64u shift_64)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_SHIFT(op, shift_64, _mm_sll_epi32);
+#else
   if(shift_64 > 31) {
     op->xmm64u(0) = 0;
     op->xmm64u(1) = 0;
@@ -1066,10 +1432,14 @@ BX_CPP_INLINE void sse_pslld(BxPackedXmmRegister *op, Bit64u shift_64)
     for (unsigned n=0; n < 4; n++)
       op->xmm32u(n) <<= shift;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_psllq(BxPackedXmmRegister *op, Bit64u shift_64)
 {
+#if BX_HOST_SSE2
+  XMM_HOST_SHIFT(op, shift_64, _mm_sll_epi64);
+#else
   if(shift_64 > 63) {
     op->xmm64u(0) = 0;
     op->xmm64u(1) = 0;
@@ -1081,6 +1451,7 @@ BX_CPP_INLINE void sse_psllq(BxPackedXmmRegister *op, Bit64u shift_64)
     for (unsigned n=0; n < 2; n++)
       op->xmm64u(n) <<= shift;
   }
+#endif
 }
 
 BX_CPP_INLINE void sse_psrldq(BxPackedXmmRegister *op, Bit8u shift)
@@ -24,6 +24,8 @@
 #ifndef BX_SIMD_PFP_FUNCTIONS_H
 #define BX_SIMD_PFP_FUNCTIONS_H
 
+#include "simd_host.h"
+
 // arithmetic add/sub/mul/div
 
 BX_CPP_INLINE void sse_addps(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2, float_status_t &status)
@@ -197,6 +197,7 @@ void BX_CPU_C::enter_system_management_mode(void)
   BX_CPU_THIS_PTR sregs[BX_SEG_REG_FS] = BX_CPU_THIS_PTR sregs[BX_SEG_REG_DS];
   BX_CPU_THIS_PTR sregs[BX_SEG_REG_GS] = BX_CPU_THIS_PTR sregs[BX_SEG_REG_DS];
 
+  TLB_flush();
   handleCpuContextChange();
 
 #if BX_SUPPORT_MONITOR_MWAIT
@@ -805,6 +806,7 @@ bx_bool BX_CPU_C::resume_from_system_management_mode(BX_SMM_State *smm_state)
 #endif
   }
 
+  TLB_flush();
   handleCpuContextChange();
 
 #if BX_SUPPORT_MONITOR_MWAIT
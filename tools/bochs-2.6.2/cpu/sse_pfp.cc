@@ -914,15 +914,17 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::SQRTPS_VpsWpsR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  if (! SSE_HOST_FP_2OP(&op, &op, 1, BX_HOST_FP_SQRTPS)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  op.xmm32u(0) = float32_sqrt(op.xmm32u(0), status);
-  op.xmm32u(1) = float32_sqrt(op.xmm32u(1), status);
-  op.xmm32u(2) = float32_sqrt(op.xmm32u(2), status);
-  op.xmm32u(3) = float32_sqrt(op.xmm32u(3), status);
+    op.xmm32u(0) = float32_sqrt(op.xmm32u(0), status);
+    op.xmm32u(1) = float32_sqrt(op.xmm32u(1), status);
+    op.xmm32u(2) = float32_sqrt(op.xmm32u(2), status);
+    op.xmm32u(3) = float32_sqrt(op.xmm32u(3), status);
 
-  check_exceptionsSSE(status.float_exception_flags);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
   BX_WRITE_XMM_REG(i->dst(), op);
 #endif
 
@@ -939,13 +941,15 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::SQRTPD_VpdWpdR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
+  if (! SSE_HOST_FP_2OP(&op, &op, 1, BX_HOST_FP_SQRTPD)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
 
-  op.xmm64u(0) = float64_sqrt(op.xmm64u(0), status);
-  op.xmm64u(1) = float64_sqrt(op.xmm64u(1), status);
+    op.xmm64u(0) = float64_sqrt(op.xmm64u(0), status);
+    op.xmm64u(1) = float64_sqrt(op.xmm64u(1), status);
 
-  check_exceptionsSSE(status.float_exception_flags);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
   BX_WRITE_XMM_REG(i->dst(), op);
 #endif
 
@@ -1002,10 +1006,12 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::ADDPS_VpsWpsR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_addps(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  if (! SSE_HOST_FP_2OP(&op1, &op2, 1, BX_HOST_FP_ADDPS)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_addps(&op1, &op2, status);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1023,10 +1029,12 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::ADDPD_VpdWpdR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_addpd(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  if (! SSE_HOST_FP_2OP(&op1, &op2, 1, BX_HOST_FP_ADDPD)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_addpd(&op1, &op2, status);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1084,10 +1092,12 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::MULPS_VpsWpsR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_mulps(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  if (! SSE_HOST_FP_2OP(&op1, &op2, 1, BX_HOST_FP_MULPS)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_mulps(&op1, &op2, status);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1105,10 +1115,12 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::MULPD_VpdWpdR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_mulpd(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  if (! SSE_HOST_FP_2OP(&op1, &op2, 1, BX_HOST_FP_MULPD)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_mulpd(&op1, &op2, status);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1166,10 +1178,12 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::SUBPS_VpsWpsR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_subps(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  if (! SSE_HOST_FP_2OP(&op1, &op2, 1, BX_HOST_FP_SUBPS)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_subps(&op1, &op2, status);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1187,10 +1201,12 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::SUBPD_VpdWpdR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_subpd(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  if (! SSE_HOST_FP_2OP(&op1, &op2, 1, BX_HOST_FP_SUBPD)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_subpd(&op1, &op2, status);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1248,10 +1264,12 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::MINPS_VpsWpsR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_minps(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  if (! SSE_HOST_FP_2OP(&op1, &op2, 1, BX_HOST_FP_MINPS)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_minps(&op1, &op2, status);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1269,10 +1287,12 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::MINPD_VpdWpdR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_minpd(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  if (! SSE_HOST_FP_2OP(&op1, &op2, 1, BX_HOST_FP_MINPD)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_minpd(&op1, &op2, status);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1330,10 +1350,12 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::DIVPS_VpsWpsR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_divps(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  if (! SSE_HOST_FP_2OP(&op1, &op2, 1, BX_HOST_FP_DIVPS)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_divps(&op1, &op2, status);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1351,10 +1373,12 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::DIVPD_VpdWpdR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_divpd(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  if (! SSE_HOST_FP_2OP(&op1, &op2, 1, BX_HOST_FP_DIVPD)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_divpd(&op1, &op2, status);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1412,10 +1436,12 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::MAXPS_VpsWpsR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_maxps(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  if (! SSE_HOST_FP_2OP(&op1, &op2, 1, BX_HOST_FP_MAXPS)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_maxps(&op1, &op2, status);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1433,10 +1459,12 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::MAXPD_VpdWpdR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_maxpd(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  if (! SSE_HOST_FP_2OP(&op1, &op2, 1, BX_HOST_FP_MAXPD)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_maxpd(&op1, &op2, status);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1494,10 +1522,12 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::HADDPD_VpdWpdR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_haddpd(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  if (! SSE_HOST_FP_2OP(&op1, &op2, 1, BX_HOST_FP_HADDPD)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_haddpd(&op1, &op2, status);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1515,10 +1545,12 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::HADDPS_VpsWpsR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_haddps(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  if (! SSE_HOST_FP_2OP(&op1, &op2, 1, BX_HOST_FP_HADDPS)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_haddps(&op1, &op2, status);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1536,10 +1568,12 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::HSUBPD_VpdWpdR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_hsubpd(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  if (! SSE_HOST_FP_2OP(&op1, &op2, 1, BX_HOST_FP_HSUBPD)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_hsubpd(&op1, &op2, status);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1557,10 +1591,12 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::HSUBPS_VpsWpsR(bxInstruction_c *i)
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_hsubps(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  if (! SSE_HOST_FP_2OP(&op1, &op2, 1, BX_HOST_FP_HSUBPS)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_hsubps(&op1, &op2, status);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1680,10 +1716,12 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::ADDSUBPD_VpdWpdR(bxInstruction_c *
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_addsubpd(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  if (! SSE_HOST_FP_2OP(&op1, &op2, 1, BX_HOST_FP_ADDSUBPD)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_addsubpd(&op1, &op2, status);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
@@ -1701,10 +1739,12 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::ADDSUBPS_VpsWpsR(bxInstruction_c *
 #if BX_CPU_LEVEL >= 6
   BxPackedXmmRegister op1 = BX_READ_XMM_REG(i->dst()), op2 = BX_READ_XMM_REG(i->src());
 
-  float_status_t status;
-  mxcsr_to_softfloat_status_word(status, MXCSR);
-  sse_addsubps(&op1, &op2, status);
-  check_exceptionsSSE(status.float_exception_flags);
+  if (! SSE_HOST_FP_2OP(&op1, &op2, 1, BX_HOST_FP_ADDSUBPS)) {
+    float_status_t status;
+    mxcsr_to_softfloat_status_word(status, MXCSR);
+    sse_addsubps(&op1, &op2, status);
+    check_exceptionsSSE(status.float_exception_flags);
+  }
 
   BX_WRITE_XMM_REG(i->dst(), op1);
 #endif
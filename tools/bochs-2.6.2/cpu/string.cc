@@ -29,387 +29,396 @@
 //
 
 #if BX_SUPPORT_REPEAT_SPEEDUPS
-Bit32u BX_CPU_C::FastRepMOVSB(bxInstruction_c *i, unsigned srcSeg, bx_address srcOff, unsigned dstSeg, bx_address dstOff, Bit32u count)
-{
-  Bit32u bytesFitSrc, bytesFitDst;
-  signed int pointerDelta;
-  bx_address laddrDst, laddrSrc;
-  Bit8u *hostAddrSrc, *hostAddrDst;
-
-  BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
-
-  bx_segment_reg_t *srcSegPtr = &BX_CPU_THIS_PTR sregs[srcSeg];
-  if (!(srcSegPtr->cache.valid & SegAccessROK))
-    return 0;
-  if ((srcOff | 0xfff) > srcSegPtr->cache.u.segment.limit_scaled)
-    return 0;
-
-  bx_segment_reg_t *dstSegPtr = &BX_CPU_THIS_PTR sregs[dstSeg];
-  if (!(dstSegPtr->cache.valid & SegAccessWOK))
-    return 0;
-  if ((dstOff | 0xfff) > dstSegPtr->cache.u.segment.limit_scaled)
-    return 0;
-
-  laddrSrc = get_laddr32(srcSeg, srcOff);
-
-  hostAddrSrc = v2h_read_byte(laddrSrc, BX_CPU_THIS_PTR user_pl);
-  if (! hostAddrSrc) return 0;
 
-  laddrDst = get_laddr32(dstSeg, dstOff);
-
-  hostAddrDst = v2h_write_byte(laddrDst, BX_CPU_THIS_PTR user_pl);
-  // Check that native host access was not vetoed for that page
-  if (!hostAddrDst) return 0;
-
-  // See how many bytes can fit in the rest of this page.
-  if (BX_CPU_THIS_PTR get_DF()) {
-    // Counting downward.
-    bytesFitSrc = 1 + PAGE_OFFSET(laddrSrc);
-    bytesFitDst = 1 + PAGE_OFFSET(laddrDst);
-    pointerDelta = (signed int) -1;
-  }
-  else {
-    // Counting upward.
-    bytesFitSrc = 0x1000 - PAGE_OFFSET(laddrSrc);
-    bytesFitDst = 0x1000 - PAGE_OFFSET(laddrDst);
-    pointerDelta = (signed int)  1;
-  }
-
-  // Restrict word count to the number that will fit in either
-  // source or dest pages.
-  if (count > bytesFitSrc)
-    count = bytesFitSrc;
-  if (count > bytesFitDst)
-    count = bytesFitDst;
-  if (count > bx_pc_system.getNumCpuTicksLeftNextEvent())
-    count = bx_pc_system.getNumCpuTicksLeftNextEvent();
-
-  // If after all the restrictions, there is anything left to do...
-  if (count) {
-    // Transfer data directly using host addresses
-    for (unsigned j=0; j<count; j++) {
-      * (Bit8u *) hostAddrDst = * (Bit8u *) hostAddrSrc;
-      hostAddrDst += pointerDelta;
-      hostAddrSrc += pointerDelta;
+static BX_CPP_INLINE Bit64u FastRepReadHost(const Bit8u *hostAddr, unsigned len)
+{
+  switch(len) {
+    case 1:
+      return *hostAddr;
+    case 2: {
+      Bit16u val16;
+      ReadHostWordFromLittleEndian(hostAddr, val16);
+      return val16;
+    }
+    case 4: {
+      Bit32u val32;
+      ReadHostDWordFromLittleEndian(hostAddr, val32);
+      return val32;
+    }
+    default: {
+      Bit64u val64;
+      ReadHostQWordFromLittleEndian(hostAddr, val64);
+      return val64;
     }
-
-    return count;
   }
+}
 
-  return 0;
+static BX_CPP_INLINE void FastRepWriteHost(Bit8u *hostAddr, Bit64u val, unsigned len)
+{
+  switch(len) {
+    case 1:
+      *hostAddr = (Bit8u) val;
+      break;
+    case 2:
+      WriteHostWordToLittleEndian(hostAddr, (Bit16u) val);
+      break;
+    case 4:
+      WriteHostDWordToLittleEndian(hostAddr, (Bit32u) val);
+      break;
+    default:
+      WriteHostQWordToLittleEndian(hostAddr, val);
+      break;
+  }
 }
 
-Bit32u BX_CPU_C::FastRepMOVSW(bxInstruction_c *i, unsigned srcSeg, bx_address srcOff, unsigned dstSeg, bx_address dstOff, Bit32u count)
+// Translates string element seg:offset of 'len' bytes to a host address
+// usable for a batched access, 'offset' is the value of the index register.
+// Returns number of elements which could be accessed in the current page in
+// direction of DF without crossing the segment limit or wrapping around the
+// address size, or 0 if the access has to go through the regular path
+// (segment checks, unaligned access with alignment check enabled or page not
+// directly accessible).
+Bit32u BX_CPU_C::FastRepGetHostAddr(bxInstruction_c *i, unsigned seg, bx_address offset, unsigned len, unsigned rw, Bit8u **hostAddr)
 {
-  Bit32u wordsFitSrc, wordsFitDst;
-  signed int pointerDelta;
-  bx_address laddrDst, laddrSrc;
-  Bit8u *hostAddrSrc, *hostAddrDst;
+  bx_address laddr;
+  bx_address limit = FastRepAsizeMask(i);
 
-  BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
+  offset &= limit;
 
-  bx_segment_reg_t *srcSegPtr = &BX_CPU_THIS_PTR sregs[srcSeg];
-  if (!(srcSegPtr->cache.valid & SegAccessROK))
-    return 0;
-  if ((srcOff | 0xfff) > srcSegPtr->cache.u.segment.limit_scaled)
-    return 0;
+#if BX_SUPPORT_X86_64
+  if (BX_CPU_THIS_PTR cpu_mode == BX_MODE_LONG_64) {
+    laddr = get_laddr64(seg, offset);
+    // canonical boundary is page aligned
+    if (! IsCanonical(laddr)) return 0;
+  }
+  else
+#endif
+  {
+    bx_segment_reg_t *segPtr = &BX_CPU_THIS_PTR sregs[seg];
+    if (!(segPtr->cache.valid & ((rw == BX_READ) ? SegAccessROK : SegAccessWOK)))
+      return 0;
+    if ((offset | 0xfff) > segPtr->cache.u.segment.limit_scaled)
+      return 0;
+    if (limit > segPtr->cache.u.segment.limit_scaled)
+      limit = segPtr->cache.u.segment.limit_scaled;
 
-  bx_segment_reg_t *dstSegPtr = &BX_CPU_THIS_PTR sregs[dstSeg];
-  if (!(dstSegPtr->cache.valid & SegAccessWOK))
-    return 0;
-  if ((dstOff | 0xfff) > dstSegPtr->cache.u.segment.limit_scaled)
-    return 0;
+    laddr = get_laddr32(seg, (Bit32u) offset);
+  }
 
-  laddrSrc = get_laddr32(srcSeg, srcOff);
+  // With a segment base (or FS/GS base) which is not page aligned the
+  // linear page may extend past the segment limit or the wrap around of
+  // a 16-bit or 32-bit address, the batch has to stop there
+  bx_address maxCount;
+  if (limit - offset < len - 1) return 0;
+  if (BX_CPU_THIS_PTR get_DF())
+    maxCount = offset / len + 1;
+  else
+    maxCount = (limit - offset - (len - 1)) / len + 1;
 
-  hostAddrSrc = v2h_read_byte(laddrSrc, BX_CPU_THIS_PTR user_pl);
-  if (! hostAddrSrc) return 0;
+#if BX_CPU_LEVEL >= 4
+  if (BX_CPU_THIS_PTR alignment_check() && (laddr & (len-1)))
+    return 0;
+#endif
 
-  laddrDst = get_laddr32(dstSeg, dstOff);
+  for (unsigned n=0; ; n++) {
+    if (rw == BX_READ)
+      *hostAddr = v2h_read_byte(laddr, BX_CPU_THIS_PTR user_pl);
+    else
+      *hostAddr = v2h_write_byte(laddr, BX_CPU_THIS_PTR user_pl);
 
-  hostAddrDst = v2h_write_byte(laddrDst, BX_CPU_THIS_PTR user_pl);
-  // Check that native host access was not vetoed for that page
-  if (!hostAddrDst) return 0;
+    if (*hostAddr) break;
+    // Check that native host access was not vetoed for that page
+    if (n > 0) return 0;
 
-  // See how many words can fit in the rest of this page.
-  if (BX_CPU_THIS_PTR get_DF()) {
-    // Counting downward.
-    // Note: 1st word must not cross page boundary.
-    if (((laddrSrc & 0xfff) > 0xffe) || ((laddrDst & 0xfff) > 0xffe))
-       return 0;
-    wordsFitSrc = (2 + PAGE_OFFSET(laddrSrc)) >> 1;
-    wordsFitDst = (2 + PAGE_OFFSET(laddrDst)) >> 1;
-    pointerDelta = (signed int) -2;
-  }
-  else {
-    // Counting upward.
-    wordsFitSrc = (0x1000 - PAGE_OFFSET(laddrSrc)) >> 1;
-    wordsFitDst = (0x1000 - PAGE_OFFSET(laddrDst)) >> 1;
-    pointerDelta = (signed int)  2;
-  }
-
-  // Restrict word count to the number that will fit in either
-  // source or dest pages.
-  if (count > wordsFitSrc)
-    count = wordsFitSrc;
-  if (count > wordsFitDst)
-    count = wordsFitDst;
-  if (count > bx_pc_system.getNumCpuTicksLeftNextEvent())
-    count = bx_pc_system.getNumCpuTicksLeftNextEvent();
-
-  // If after all the restrictions, there is anything left to do...
-  if (count) {
-    // Transfer data directly using host addresses
-    for (unsigned j=0; j<count; j++) {
-      CopyHostWordLittleEndian(hostAddrDst, hostAddrSrc);
-      hostAddrDst += pointerDelta;
-      hostAddrSrc += pointerDelta;
-    }
+    // The page is not in the TLB. Translate it exactly as the next
+    // iteration would do, raising the page fault if there is one.
+    bx_TLB_entry *tlbEntry = &BX_CPU_THIS_PTR TLB.entry[BX_TLB_INDEX_OF(laddr, 0)];
+    translate_linear(tlbEntry, laddr, BX_CPU_THIS_PTR user_pl, rw);
+  }
 
-    return count;
+  Bit32u count;
+  unsigned pageOffset = PAGE_OFFSET(laddr);
+  if (BX_CPU_THIS_PTR get_DF()) {
+    // Counting downward, 1st element must not cross page boundary
+    if (pageOffset + len > 0x1000) return 0;
+    count = (pageOffset + len) / len;
+  }
+  else {
+    // Counting upward
+    count = (0x1000 - pageOffset) / len;
   }
 
-  return 0;
+  return (count > maxCount) ? (Bit32u) maxCount : count;
 }
 
-Bit32u BX_CPU_C::FastRepMOVSD(bxInstruction_c *i, unsigned srcSeg, bx_address srcOff, unsigned dstSeg, bx_address dstOff, Bit32u count)
+// Returns the number of iterations a batch may do: limited by the count
+// register and, with a single processor, by the time left to the next
+// timer event
+Bit32u BX_CPU_C::FastRepLimitCount(bxInstruction_c *i, Bit32u count)
 {
-  Bit32u dwordsFitSrc, dwordsFitDst;
-  signed int pointerDelta;
-  bx_address laddrDst, laddrSrc;
-  Bit8u *hostAddrSrc, *hostAddrDst;
+  bx_address rcx = RCX & FastRepAsizeMask(i);
+  if (count > rcx)
+    count = (Bit32u) rcx;
+
+  if (BX_SMP_PROCESSORS == 1) {
+    Bit32u ticksLeft = bx_pc_system.getNumCpuTicksLeftNextEvent();
+    if (ticksLeft && count > ticksLeft)
+      count = ticksLeft;
+  }
 
-  BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
+  return count;
+}
 
-  bx_segment_reg_t *srcSegPtr = &BX_CPU_THIS_PTR sregs[srcSeg];
-  if (!(srcSegPtr->cache.valid & SegAccessROK))
-    return 0;
-  if ((srcOff | 0xfff) > srcSegPtr->cache.u.segment.limit_scaled)
-    return 0;
+// Completes a batch of 'count' iterations: advances the index registers
+// and retires all iterations but the last one, which is finished by the
+// repeat loop as a regular iteration (decrementing rCX and counting it).
+void BX_CPU_C::FastRepAdvance(bxInstruction_c *i, Bit32u count, unsigned len, unsigned regs)
+{
+  bx_address mask = FastRepAsizeMask(i);
+  bx_address delta = (bx_address) count * len;
+  if (BX_CPU_THIS_PTR get_DF())
+    delta = (bx_address) 0 - delta;
 
-  bx_segment_reg_t *dstSegPtr = &BX_CPU_THIS_PTR sregs[dstSeg];
-  if (!(dstSegPtr->cache.valid & SegAccessWOK))
-    return 0;
-  if ((dstOff | 0xfff) > dstSegPtr->cache.u.segment.limit_scaled)
-    return 0;
+  if (regs & BX_FAST_REP_RSI)
+    FAST_REP_ADVANCE(RSI, delta, mask);
+  if (regs & BX_FAST_REP_RDI)
+    FAST_REP_ADVANCE(RDI, delta, mask);
+  FAST_REP_ADVANCE(RCX, (bx_address) 0 - (count - 1), mask);
+
+  BX_CPU_THIS_PTR icount += count - 1;
+#if BX_SUPPORT_HANDLERS_CHAINING_SPEEDUPS == 0
+  // time is advanced by one tick per instruction
+  if (BX_SMP_PROCESSORS == 1) BX_TICKN(count - 1);
+#endif
+}
 
-  laddrSrc = get_laddr32(srcSeg, srcOff);
+// The FastRep methods below are called by the string instruction
+// iteration handlers when a repeat prefix is used. If conditions are
+// right they do a batch of iterations directly in host memory, up to the
+// end of the current page, and return the number of iterations done.
+// Otherwise they return 0 and the iteration is done the regular way.
 
-  hostAddrSrc = v2h_read_byte(laddrSrc, BX_CPU_THIS_PTR user_pl);
-  if (! hostAddrSrc) return 0;
+Bit32u BX_CPU_C::FastRepMOVS(bxInstruction_c *i, unsigned len)
+{
+  Bit8u *hostAddrSrc, *hostAddrDst;
 
-  laddrDst = get_laddr32(dstSeg, dstOff);
+  if (BX_CPU_THIS_PTR async_event) return 0;
 
-  hostAddrDst = v2h_write_byte(laddrDst, BX_CPU_THIS_PTR user_pl);
-  // Check that native host access was not vetoed for that page
-  if (!hostAddrDst) return 0;
+  Bit32u count = FastRepGetHostAddr(i, i->seg(), RSI, len, BX_READ, &hostAddrSrc);
+  if (! count) return 0;
+  Bit32u countDst = FastRepGetHostAddr(i, BX_SEG_REG_ES, RDI, len, BX_WRITE, &hostAddrDst);
+  if (count > countDst)
+    count = countDst;
+  count = FastRepLimitCount(i, count);
+  if (count < 2) return 0;
 
-  // See how many dwords can fit in the rest of this page.
+  Bit32u bytes = count * len;
+  int pointerDelta = len;
   if (BX_CPU_THIS_PTR get_DF()) {
-    // Counting downward.
-    // Note: 1st dword must not cross page boundary.
-    if (((laddrSrc & 0xfff) > 0xffc) || ((laddrDst & 0xfff) > 0xffc))
-      return 0;
-    dwordsFitSrc = (4 + PAGE_OFFSET(laddrSrc)) >> 2;
-    dwordsFitDst = (4 + PAGE_OFFSET(laddrDst)) >> 2;
-    pointerDelta = (signed int) -4;
-  }
-  else {
-    // Counting upward.
-    dwordsFitSrc = (0x1000 - PAGE_OFFSET(laddrSrc)) >> 2;
-    dwordsFitDst = (0x1000 - PAGE_OFFSET(laddrDst)) >> 2;
-    pointerDelta = (signed int)  4;
+    pointerDelta = -pointerDelta;
+    hostAddrSrc -= bytes - len;
+    hostAddrDst -= bytes - len;
   }
 
-  // Restrict dword count to the number that will fit in either
-  // source or dest pages.
-  if (count > dwordsFitSrc)
-    count = dwordsFitSrc;
-  if (count > dwordsFitDst)
-    count = dwordsFitDst;
-  if (count > bx_pc_system.getNumCpuTicksLeftNextEvent())
-    count = bx_pc_system.getNumCpuTicksLeftNextEvent();
-
-  // If after all the restrictions, there is anything left to do...
-  if (count) {
-    // Transfer data directly using host addresses
+  if (hostAddrDst + bytes <= hostAddrSrc || hostAddrSrc + bytes <= hostAddrDst) {
+    // no overlap, copy the whole block at once
+    memcpy(hostAddrDst, hostAddrSrc, bytes);
+  }
+  else {
+    // overlapping strings are copied element by element in direction of
+    // DF to get the same result as the original instruction sequence
+    if (pointerDelta < 0) {
+      hostAddrSrc += bytes - len;
+      hostAddrDst += bytes - len;
+    }
     for (unsigned j=0; j<count; j++) {
-      CopyHostDWordLittleEndian(hostAddrDst, hostAddrSrc);
+      FastRepWriteHost(hostAddrDst, FastRepReadHost(hostAddrSrc, len), len);
       hostAddrDst += pointerDelta;
       hostAddrSrc += pointerDelta;
     }
-
-    return count;
   }
 
-  return 0;
+  FastRepAdvance(i, count, len, BX_FAST_REP_RSI | BX_FAST_REP_RDI);
+  return count;
 }
 
-Bit32u BX_CPU_C::FastRepSTOSB(bxInstruction_c *i, unsigned dstSeg, bx_address dstOff, Bit8u val, Bit32u count)
+Bit32u BX_CPU_C::FastRepSTOS(bxInstruction_c *i, unsigned len)
 {
-  Bit32u bytesFitDst;
-  signed int pointerDelta;
-  bx_address laddrDst;
   Bit8u *hostAddrDst;
 
-  BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
+  if (BX_CPU_THIS_PTR async_event) return 0;
 
-  bx_segment_reg_t *dstSegPtr = &BX_CPU_THIS_PTR sregs[dstSeg];
-  if (!(dstSegPtr->cache.valid & SegAccessWOK))
-    return 0;
-  if ((dstOff | 0xfff) > dstSegPtr->cache.u.segment.limit_scaled)
-    return 0;
-
-  laddrDst = get_laddr32(dstSeg, dstOff);
+  Bit32u count = FastRepGetHostAddr(i, BX_SEG_REG_ES, RDI, len, BX_WRITE, &hostAddrDst);
+  count = FastRepLimitCount(i, count);
+  if (count < 2) return 0;
 
-  hostAddrDst = v2h_write_byte(laddrDst, BX_CPU_THIS_PTR user_pl);
-  // Check that native host access was not vetoed for that page
-  if (!hostAddrDst) return 0;
+  Bit32u bytes = count * len;
+  if (BX_CPU_THIS_PTR get_DF())
+    hostAddrDst -= bytes - len;
 
-  // See how many bytes can fit in the rest of this page.
-  if (BX_CPU_THIS_PTR get_DF()) {
-    // Counting downward.
-    bytesFitDst = 1 + PAGE_OFFSET(laddrDst);
-    pointerDelta = (signed int) -1;
+  Bit64u val = RAX;
+  if (len == 1) {
+    memset(hostAddrDst, (Bit8u) val, bytes);
   }
   else {
-    // Counting upward.
-    bytesFitDst = 0x1000 - PAGE_OFFSET(laddrDst);
-    pointerDelta = (signed int)  1;
-  }
-
-  // Restrict word count to the number that will fit in either
-  // source or dest pages.
-  if (count > bytesFitDst)
-    count = bytesFitDst;
-  if (count > bx_pc_system.getNumCpuTicksLeftNextEvent())
-    count = bx_pc_system.getNumCpuTicksLeftNextEvent();
-
-  // If after all the restrictions, there is anything left to do...
-  if (count) {
-    // Transfer data directly using host addresses
     for (unsigned j=0; j<count; j++) {
-      * (Bit8u *) hostAddrDst = val;
-      hostAddrDst += pointerDelta;
+      FastRepWriteHost(hostAddrDst, val, len);
+      hostAddrDst += len;
     }
-
-    return count;
   }
 
-  return 0;
+  FastRepAdvance(i, count, len, BX_FAST_REP_RDI);
+  return count;
 }
 
-Bit32u BX_CPU_C::FastRepSTOSW(bxInstruction_c *i, unsigned dstSeg, bx_address dstOff, Bit16u val, Bit32u count)
+Bit32u BX_CPU_C::FastRepLODS(bxInstruction_c *i, unsigned len)
 {
-  Bit32u wordsFitDst;
-  signed int pointerDelta;
-  bx_address laddrDst;
-  Bit8u *hostAddrDst;
+  Bit8u *hostAddrSrc;
 
-  BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
+  if (BX_CPU_THIS_PTR async_event) return 0;
 
-  bx_segment_reg_t *dstSegPtr = &BX_CPU_THIS_PTR sregs[dstSeg];
-  if (!(dstSegPtr->cache.valid & SegAccessWOK))
-    return 0;
-  if ((dstOff | 0xfff) > dstSegPtr->cache.u.segment.limit_scaled)
-    return 0;
-
-  laddrDst = get_laddr32(dstSeg, dstOff);
+  Bit32u count = FastRepGetHostAddr(i, i->seg(), RSI, len, BX_READ, &hostAddrSrc);
+  count = FastRepLimitCount(i, count);
+  if (count < 2) return 0;
 
-  hostAddrDst = v2h_write_byte(laddrDst, BX_CPU_THIS_PTR user_pl);
-  // Check that native host access was not vetoed for that page
-  if (!hostAddrDst) return 0;
+  // only the last element loaded is visible
+  Bit32u lastOffset = (count - 1) * len;
+  Bit64u val = FastRepReadHost(BX_CPU_THIS_PTR get_DF() ?
+       hostAddrSrc - lastOffset : hostAddrSrc + lastOffset, len);
 
-  // See how many words can fit in the rest of this page.
-  if (BX_CPU_THIS_PTR get_DF()) {
-    // Counting downward.
-    // Note: 1st word must not cross page boundary.
-    if ((laddrDst & 0xfff) > 0xffe) return 0;
-    wordsFitDst = (2 + PAGE_OFFSET(laddrDst)) >> 1;
-    pointerDelta = (signed int) -2;
-  }
-  else {
-    // Counting upward.
-    wordsFitDst = (0x1000 - PAGE_OFFSET(laddrDst)) >> 1;
-    pointerDelta = (signed int)  2;
+  switch(len) {
+    case 1:
+      AL = (Bit8u) val;
+      break;
+    case 2:
+      AX = (Bit16u) val;
+      break;
+    case 4:
+      RAX = (Bit32u) val;
+      break;
+#if BX_SUPPORT_X86_64
+    default:
+      RAX = val;
+      break;
+#endif
   }
 
-  // Restrict word count to the number that will fit in either
-  // source or dest pages.
-  if (count > wordsFitDst)
-    count = wordsFitDst;
-  if (count > bx_pc_system.getNumCpuTicksLeftNextEvent())
-    count = bx_pc_system.getNumCpuTicksLeftNextEvent();
+  FastRepAdvance(i, count, len, BX_FAST_REP_RSI);
+  return count;
+}
 
-  // If after all the restrictions, there is anything left to do...
-  if (count) {
-    // Transfer data directly using host addresses
-    for (unsigned j=0; j<count; j++) {
-      WriteHostWordToLittleEndian(hostAddrDst, val);
-      hostAddrDst += pointerDelta;
+// Sets arithmetic flags of the last compared string element
+void BX_CPU_C::FastRepCompareFlags(Bit64u op1, Bit64u op2, unsigned len)
+{
+  switch(len) {
+    case 1: {
+      Bit8u op1_8 = (Bit8u) op1, op2_8 = (Bit8u) op2, diff_8 = op1_8 - op2_8;
+      SET_FLAGS_OSZAPC_SUB_8(op1_8, op2_8, diff_8);
+      break;
     }
-
-    return count;
+    case 2: {
+      Bit16u op1_16 = (Bit16u) op1, op2_16 = (Bit16u) op2, diff_16 = op1_16 - op2_16;
+      SET_FLAGS_OSZAPC_SUB_16(op1_16, op2_16, diff_16);
+      break;
+    }
+    case 4: {
+      Bit32u op1_32 = (Bit32u) op1, op2_32 = (Bit32u) op2, diff_32 = op1_32 - op2_32;
+      SET_FLAGS_OSZAPC_SUB_32(op1_32, op2_32, diff_32);
+      break;
+    }
+#if BX_SUPPORT_X86_64
+    default: {
+      Bit64u diff_64 = op1 - op2;
+      SET_FLAGS_OSZAPC_SUB_64(op1, op2, diff_64);
+      break;
+    }
+#endif
   }
+}
 
-  return 0;
+// REPE/REPNE CMPS: the batch ends with the first element terminating the
+// repeat condition, the flags are set by the last compared element
+Bit32u BX_CPU_C::FastRepCMPS(bxInstruction_c *i, unsigned len)
+{
+  Bit8u *hostAddrSrc, *hostAddrDst;
+
+  if (BX_CPU_THIS_PTR async_event) return 0;
+
+  Bit32u count = FastRepGetHostAddr(i, i->seg(), RSI, len, BX_READ, &hostAddrSrc);
+  if (! count) return 0;
+  Bit32u countDst = FastRepGetHostAddr(i, BX_SEG_REG_ES, RDI, len, BX_READ, &hostAddrDst);
+  if (count > countDst)
+    count = countDst;
+  count = FastRepLimitCount(i, count);
+  if (count < 2) return 0;
+
+  bx_bool repe = (i->repUsedValue() == 3);
+  int pointerDelta = BX_CPU_THIS_PTR get_DF() ? -(int) len : (int) len;
+  Bit64u op1, op2;
+  Bit32u n = 0;
+
+  do {
+    op1 = FastRepReadHost(hostAddrSrc, len);
+    op2 = FastRepReadHost(hostAddrDst, len);
+    hostAddrSrc += pointerDelta;
+    hostAddrDst += pointerDelta;
+    n++;
+  } while (n < count && (op1 == op2) == repe);
+
+  FastRepCompareFlags(op1, op2, len);
+
+  FastRepAdvance(i, n, len, BX_FAST_REP_RSI | BX_FAST_REP_RDI);
+  return n;
 }
 
-Bit32u BX_CPU_C::FastRepSTOSD(bxInstruction_c *i, unsigned dstSeg, bx_address dstOff, Bit32u val, Bit32u count)
+// REPE/REPNE SCAS: the batch ends with the first element terminating the
+// repeat condition, the flags are set by the last compared element
+Bit32u BX_CPU_C::FastRepSCAS(bxInstruction_c *i, unsigned len)
 {
-  Bit32u dwordsFitDst;
-  signed int pointerDelta;
-  bx_address laddrDst;
   Bit8u *hostAddrDst;
 
-  BX_ASSERT(BX_CPU_THIS_PTR cpu_mode != BX_MODE_LONG_64);
+  if (BX_CPU_THIS_PTR async_event) return 0;
 
-  bx_segment_reg_t *dstSegPtr = &BX_CPU_THIS_PTR sregs[dstSeg];
-  if (!(dstSegPtr->cache.valid & SegAccessWOK))
-    return 0;
-  if ((dstOff | 0xfff) > dstSegPtr->cache.u.segment.limit_scaled)
-    return 0;
+  Bit32u count = FastRepGetHostAddr(i, BX_SEG_REG_ES, RDI, len, BX_READ, &hostAddrDst);
+  count = FastRepLimitCount(i, count);
+  if (count < 2) return 0;
 
-  laddrDst = get_laddr32(dstSeg, dstOff);
+  bx_bool repe = (i->repUsedValue() == 3);
+  bx_bool df = BX_CPU_THIS_PTR get_DF();
+  Bit64u op1 = RAX, op2;
+  Bit32u n;
 
-  hostAddrDst = v2h_write_byte(laddrDst, BX_CPU_THIS_PTR user_pl);
-  // Check that native host access was not vetoed for that page
-  if (!hostAddrDst) return 0;
+  if (len < 8)
+    op1 &= (BX_CONST64(1) << (len*8)) - 1;
 
-  // See how many dwords can fit in the rest of this page.
-  if (BX_CPU_THIS_PTR get_DF()) {
-    // Counting downward.
-    // Note: 1st dword must not cross page boundary.
-    if ((laddrDst & 0xfff) > 0xffc) return 0;
-    dwordsFitDst = (4 + PAGE_OFFSET(laddrDst)) >> 2;
-    pointerDelta = (signed int) -4;
+  if (len == 1 && !repe && !df) {
+    // REPNE SCASB searching forward, the most common form
+    Bit8u *found = (Bit8u *) memchr(hostAddrDst, (Bit8u) op1, count);
+    if (found) {
+      n = (Bit32u)(found - hostAddrDst) + 1;
+      op2 = op1;
+    }
+    else {
+      n = count;
+      op2 = hostAddrDst[count - 1];
+    }
   }
   else {
-    // Counting upward.
-    dwordsFitDst = (0x1000 - PAGE_OFFSET(laddrDst)) >> 2;
-    pointerDelta = (signed int)  4;
-  }
-
-  // Restrict dword count to the number that will fit in either
-  // source or dest pages.
-  if (count > dwordsFitDst)
-    count = dwordsFitDst;
-  if (count > bx_pc_system.getNumCpuTicksLeftNextEvent())
-    count = bx_pc_system.getNumCpuTicksLeftNextEvent();
-
-  // If after all the restrictions, there is anything left to do...
-  if (count) {
-    // Transfer data directly using host addresses
-    for (unsigned j=0; j<count; j++) {
-      WriteHostDWordToLittleEndian(hostAddrDst, val);
+    int pointerDelta = df ? -(int) len : (int) len;
+    n = 0;
+    do {
+      op2 = FastRepReadHost(hostAddrDst, len);
       hostAddrDst += pointerDelta;
-    }
-
-    return count;
+      n++;
+    } while (n < count && (op1 == op2) == repe);
   }
 
-  return 0;
+  FastRepCompareFlags(op1, op2, len);
+
+  FastRepAdvance(i, n, len, BX_FAST_REP_RDI);
+  return n;
 }
+
 #endif
 
 //
@@ -496,6 +505,10 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::REP_MOVSQ_XqYq(bxInstruction_c *i)
 // 16 bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSB16_XbYb(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepMOVS(i, 1)) return;
+#endif
+
   Bit8u temp8 = read_virtual_byte_32(i->seg(), SI);
   write_virtual_byte_32(BX_SEG_REG_ES, DI, temp8);
 
@@ -514,48 +527,22 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSB16_XbYb(bxInstruction_c *i)
 // 32 bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSB32_XbYb(bxInstruction_c *i)
 {
-  Bit8u temp8;
-
-  Bit32u incr = 1;
-
 #if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
-  /* If conditions are right, we can transfer IO to physical memory
-   * in a batch, rather than one instruction at a time */
-  if (i->repUsedL() && !BX_CPU_THIS_PTR async_event)
-  {
-    Bit32u byteCount = FastRepMOVSB(i, i->seg(), ESI, BX_SEG_REG_ES, EDI, ECX);
-    if (byteCount) {
-      // Decrement the ticks count by the number of iterations, minus
-      // one, since the main cpu loop will decrement one.  Also,
-      // the count is predecremented before examined, so defintely
-      // don't roll it under zero.
-      BX_TICKN(byteCount-1);
-
-      // Decrement eCX. Note, the main loop will decrement 1 also, so
-      // decrement by one less than expected, like the case above.
-      RCX = ECX - (byteCount-1);
-
-      incr = byteCount;
-    }
-    else {
-      temp8 = read_virtual_byte(i->seg(), ESI);
-      write_virtual_byte(BX_SEG_REG_ES, EDI, temp8);
-    }
-  }
-  else
+  if (i->repUsedL() && FastRepMOVS(i, 1)) return;
 #endif
-  {
-    temp8 = read_virtual_byte(i->seg(), ESI);
-    write_virtual_byte(BX_SEG_REG_ES, EDI, temp8);
-  }
+
+  Bit8u temp8 = read_virtual_byte(i->seg(), ESI);
+  write_virtual_byte(BX_SEG_REG_ES, EDI, temp8);
 
   if (BX_CPU_THIS_PTR get_DF()) {
-    RSI = ESI - incr;
-    RDI = EDI - incr;
+    /* decrement ESI, EDI */
+    RSI = ESI - 1;
+    RDI = EDI - 1;
   }
   else {
-    RSI = ESI + incr;
-    RDI = EDI + incr;
+    /* increment ESI, EDI */
+    RSI = ESI + 1;
+    RDI = EDI + 1;
   }
 }
 
@@ -563,6 +550,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSB32_XbYb(bxInstruction_c *i)
 // 64 bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSB64_XbYb(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepMOVS(i, 1)) return;
+#endif
+
   Bit8u temp8;
 
   Bit64u rsi = RSI;
@@ -590,6 +581,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSB64_XbYb(bxInstruction_c *i)
 /* 16 bit opsize mode, 16 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSW16_XwYw(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepMOVS(i, 2)) return;
+#endif
+
   Bit16u si = SI;
   Bit16u di = DI;
 
@@ -614,6 +609,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSW16_XwYw(bxInstruction_c *i)
 /* 16 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSW32_XwYw(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepMOVS(i, 2)) return;
+#endif
+
   Bit16u temp16;
 
   Bit32u esi = ESI;
@@ -640,6 +639,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSW32_XwYw(bxInstruction_c *i)
 /* 16 bit opsize mode, 64 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSW64_XwYw(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepMOVS(i, 2)) return;
+#endif
+
   Bit16u temp16;
 
   Bit64u rsi = RSI;
@@ -665,6 +668,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSW64_XwYw(bxInstruction_c *i)
 /* 32 bit opsize mode, 16 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSD16_XdYd(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepMOVS(i, 4)) return;
+#endif
+
   Bit32u temp32;
 
   Bit16u si = SI;
@@ -689,52 +696,23 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSD16_XdYd(bxInstruction_c *i)
 /* 32 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSD32_XdYd(bxInstruction_c *i)
 {
-  Bit32u temp32;
-
-  Bit32u incr = 4;
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepMOVS(i, 4)) return;
+#endif
 
   Bit32u esi = ESI;
   Bit32u edi = EDI;
 
-#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
-  /* If conditions are right, we can transfer IO to physical memory
-   * in a batch, rather than one instruction at a time.
-   */
-  if (i->repUsedL() && !BX_CPU_THIS_PTR async_event)
-  {
-    Bit32u dwordCount = FastRepMOVSD(i, i->seg(), esi, BX_SEG_REG_ES, edi, ECX);
-    if (dwordCount) {
-      // Decrement the ticks count by the number of iterations, minus
-      // one, since the main cpu loop will decrement one.  Also,
-      // the count is predecremented before examined, so defintely
-      // don't roll it under zero.
-      BX_TICKN(dwordCount-1);
-
-      // Decrement eCX. Note, the main loop will decrement 1 also, so
-      // decrement by one less than expected, like the case above.
-      RCX = ECX - (dwordCount-1);
-
-      incr = dwordCount << 2; // count * 4
-    }
-    else {
-      temp32 = read_virtual_dword(i->seg(), esi);
-      write_virtual_dword(BX_SEG_REG_ES, edi, temp32);
-    }
-  }
-  else
-#endif
-  {
-    temp32 = read_virtual_dword(i->seg(), esi);
-    write_virtual_dword(BX_SEG_REG_ES, edi, temp32);
-  }
+  Bit32u temp32 = read_virtual_dword(i->seg(), esi);
+  write_virtual_dword(BX_SEG_REG_ES, edi, temp32);
 
   if (BX_CPU_THIS_PTR get_DF()) {
-    esi -= incr;
-    edi -= incr;
+    esi -= 4;
+    edi -= 4;
   }
   else {
-    esi += incr;
-    edi += incr;
+    esi += 4;
+    edi += 4;
   }
 
   // zero extension of RSI/RDI
@@ -747,6 +725,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSD32_XdYd(bxInstruction_c *i)
 /* 32 bit opsize mode, 64 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSD64_XdYd(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepMOVS(i, 4)) return;
+#endif
+
   Bit32u temp32;
 
   Bit64u rsi = RSI;
@@ -771,6 +753,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSD64_XdYd(bxInstruction_c *i)
 /* 64 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSQ32_XqYq(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepMOVS(i, 8)) return;
+#endif
+
   Bit64u temp64;
 
   Bit32u esi = ESI;
@@ -796,6 +782,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSQ32_XqYq(bxInstruction_c *i)
 /* 64 bit opsize mode, 64 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::MOVSQ64_XqYq(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepMOVS(i, 8)) return;
+#endif
+
   Bit64u temp64;
 
   Bit64u rsi = RSI;
@@ -906,6 +896,10 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::REP_CMPSQ_XqYq(bxInstruction_c *i)
 /* 16 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPSB16_XbYb(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepCMPS(i, 1)) return;
+#endif
+
   Bit8u op1_8, op2_8, diff_8;
 
   Bit16u si = SI;
@@ -934,6 +928,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPSB16_XbYb(bxInstruction_c *i)
 /* 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPSB32_XbYb(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepCMPS(i, 1)) return;
+#endif
+
   Bit8u op1_8, op2_8, diff_8;
 
   Bit32u esi = ESI;
@@ -964,6 +962,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPSB32_XbYb(bxInstruction_c *i)
 /* 64 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPSB64_XbYb(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepCMPS(i, 1)) return;
+#endif
+
   Bit8u op1_8, op2_8, diff_8;
 
   Bit64u rsi = RSI;
@@ -993,6 +995,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPSB64_XbYb(bxInstruction_c *i)
 /* 16 bit opsize mode, 16 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPSW16_XwYw(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepCMPS(i, 2)) return;
+#endif
+
   Bit16u op1_16, op2_16, diff_16;
 
   Bit16u si = SI;
@@ -1021,6 +1027,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPSW16_XwYw(bxInstruction_c *i)
 /* 16 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPSW32_XwYw(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepCMPS(i, 2)) return;
+#endif
+
   Bit16u op1_16, op2_16, diff_16;
 
   Bit32u esi = ESI;
@@ -1051,6 +1061,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPSW32_XwYw(bxInstruction_c *i)
 /* 16 bit opsize mode, 64 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPSW64_XwYw(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepCMPS(i, 2)) return;
+#endif
+
   Bit16u op1_16, op2_16, diff_16;
 
   Bit64u rsi = RSI;
@@ -1080,6 +1094,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPSW64_XwYw(bxInstruction_c *i)
 /* 32 bit opsize mode, 16 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPSD16_XdYd(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepCMPS(i, 4)) return;
+#endif
+
   Bit32u op1_32, op2_32, diff_32;
 
   Bit16u si = SI;
@@ -1108,6 +1126,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPSD16_XdYd(bxInstruction_c *i)
 /* 32 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPSD32_XdYd(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepCMPS(i, 4)) return;
+#endif
+
   Bit32u op1_32, op2_32, diff_32;
 
   Bit32u esi = ESI;
@@ -1139,6 +1161,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPSD32_XdYd(bxInstruction_c *i)
 /* 32 bit opsize mode, 64 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPSD64_XdYd(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepCMPS(i, 4)) return;
+#endif
+
   Bit32u op1_32, op2_32, diff_32;
 
   Bit64u rsi = RSI;
@@ -1167,6 +1193,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPSD64_XdYd(bxInstruction_c *i)
 /* 64 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPSQ32_XqYq(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepCMPS(i, 8)) return;
+#endif
+
   Bit64u op1_64, op2_64, diff_64;
 
   Bit32u esi = ESI;
@@ -1196,6 +1226,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPSQ32_XqYq(bxInstruction_c *i)
 /* 64 bit opsize mode, 64 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::CMPSQ64_XqYq(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepCMPS(i, 8)) return;
+#endif
+
   Bit64u op1_64, op2_64, diff_64;
 
   Bit64u rsi = RSI;
@@ -1306,6 +1340,10 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::REP_SCASQ_RAXXq(bxInstruction_c *i
 /* 16 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::SCASB16_ALXb(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepSCAS(i, 1)) return;
+#endif
+
   Bit8u op1_8 = AL, op2_8, diff_8;
 
   Bit16u di = DI;
@@ -1329,6 +1367,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::SCASB16_ALXb(bxInstruction_c *i)
 /* 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::SCASB32_ALXb(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepSCAS(i, 1)) return;
+#endif
+
   Bit8u op1_8 = AL, op2_8, diff_8;
 
   Bit32u edi = EDI;
@@ -1353,6 +1395,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::SCASB32_ALXb(bxInstruction_c *i)
 /* 64 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::SCASB64_ALXb(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepSCAS(i, 1)) return;
+#endif
+
   Bit8u op1_8 = AL, op2_8, diff_8;
 
   Bit64u rdi = RDI;
@@ -1377,6 +1423,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::SCASB64_ALXb(bxInstruction_c *i)
 /* 16 bit opsize mode, 16 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::SCASW16_AXXw(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepSCAS(i, 2)) return;
+#endif
+
   Bit16u op1_16 = AX, op2_16, diff_16;
 
   Bit16u di = DI;
@@ -1399,6 +1449,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::SCASW16_AXXw(bxInstruction_c *i)
 /* 16 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::SCASW32_AXXw(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepSCAS(i, 2)) return;
+#endif
+
   Bit16u op1_16 = AX, op2_16, diff_16;
 
   Bit32u edi = EDI;
@@ -1423,6 +1477,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::SCASW32_AXXw(bxInstruction_c *i)
 /* 16 bit opsize mode, 64 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::SCASW64_AXXw(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepSCAS(i, 2)) return;
+#endif
+
   Bit16u op1_16 = AX, op2_16, diff_16;
 
   Bit64u rdi = RDI;
@@ -1447,6 +1505,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::SCASW64_AXXw(bxInstruction_c *i)
 /* 32 bit opsize mode, 16 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::SCASD16_EAXXd(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepSCAS(i, 4)) return;
+#endif
+
   Bit32u op1_32 = EAX, op2_32, diff_32;
 
   Bit16u di = DI;
@@ -1469,6 +1531,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::SCASD16_EAXXd(bxInstruction_c *i)
 /* 32 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::SCASD32_EAXXd(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepSCAS(i, 4)) return;
+#endif
+
   Bit32u op1_32 = EAX, op2_32, diff_32;
 
   Bit32u edi = EDI;
@@ -1494,6 +1560,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::SCASD32_EAXXd(bxInstruction_c *i)
 /* 32 bit opsize mode, 64 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::SCASD64_EAXXd(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepSCAS(i, 4)) return;
+#endif
+
   Bit32u op1_32 = EAX, op2_32, diff_32;
 
   Bit64u rdi = RDI;
@@ -1517,6 +1587,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::SCASD64_EAXXd(bxInstruction_c *i)
 /* 64 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::SCASQ32_RAXXq(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepSCAS(i, 8)) return;
+#endif
+
   Bit64u op1_64 = RAX, op2_64, diff_64;
 
   Bit32u edi = EDI;
@@ -1541,6 +1615,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::SCASQ32_RAXXq(bxInstruction_c *i)
 /* 64 bit opsize mode, 64 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::SCASQ64_RAXXq(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepSCAS(i, 8)) return;
+#endif
+
   Bit64u op1_64 = RAX, op2_64, diff_64;
 
   Bit64u rdi = RDI;
@@ -1643,6 +1721,10 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::REP_STOSQ_YqRAX(bxInstruction_c *i
 // 16 bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSB16_YbAL(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepSTOS(i, 1)) return;
+#endif
+
   Bit16u di = DI;
 
   write_virtual_byte_32(BX_SEG_REG_ES, di, AL);
@@ -1660,44 +1742,19 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSB16_YbAL(bxInstruction_c *i)
 // 32 bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSB32_YbAL(bxInstruction_c *i)
 {
-  Bit32u incr = 1;
-  Bit32u edi = EDI;
-
 #if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
-  /* If conditions are right, we can transfer IO to physical memory
-   * in a batch, rather than one instruction at a time.
-   */
-  if (i->repUsedL() && !BX_CPU_THIS_PTR async_event)
-  {
-    Bit32u byteCount = FastRepSTOSB(i, BX_SEG_REG_ES, edi, AL, ECX);
-    if (byteCount) {
-      // Decrement the ticks count by the number of iterations, minus
-      // one, since the main cpu loop will decrement one.  Also,
-      // the count is predecremented before examined, so defintely
-      // don't roll it under zero.
-      BX_TICKN(byteCount-1);
-
-      // Decrement eCX.  Note, the main loop will decrement 1 also, so
-      // decrement by one less than expected, like the case above.
-      RCX = ECX - (byteCount-1);
-
-      incr = byteCount;
-    }
-    else {
-      write_virtual_byte(BX_SEG_REG_ES, edi, AL);
-    }
-  }
-  else
+  if (i->repUsedL() && FastRepSTOS(i, 1)) return;
 #endif
-  {
-    write_virtual_byte(BX_SEG_REG_ES, edi, AL);
-  }
+
+  Bit32u edi = EDI;
+
+  write_virtual_byte(BX_SEG_REG_ES, edi, AL);
 
   if (BX_CPU_THIS_PTR get_DF()) {
-    edi -= incr;
+    edi--;
   }
   else {
-    edi += incr;
+    edi++;
   }
 
   // zero extension of RDI
@@ -1708,6 +1765,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSB32_YbAL(bxInstruction_c *i)
 // 64 bit address size
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSB64_YbAL(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepSTOS(i, 1)) return;
+#endif
+
   Bit64u rdi = RDI;
 
   write_virtual_byte_64(BX_SEG_REG_ES, rdi, AL);
@@ -1726,6 +1787,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSB64_YbAL(bxInstruction_c *i)
 /* 16 bit opsize mode, 16 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSW16_YwAX(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepSTOS(i, 2)) return;
+#endif
+
   Bit16u di = DI;
 
   write_virtual_word_32(BX_SEG_REG_ES, di, AX);
@@ -1743,6 +1808,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSW16_YwAX(bxInstruction_c *i)
 /* 16 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSW32_YwAX(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepSTOS(i, 2)) return;
+#endif
+
   Bit32u edi = EDI;
 
   write_virtual_word(BX_SEG_REG_ES, edi, AX);
@@ -1762,6 +1831,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSW32_YwAX(bxInstruction_c *i)
 /* 16 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSW64_YwAX(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepSTOS(i, 2)) return;
+#endif
+
   Bit64u rdi = RDI;
 
   write_virtual_word_64(BX_SEG_REG_ES, rdi, AX);
@@ -1780,6 +1853,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSW64_YwAX(bxInstruction_c *i)
 /* 32 bit opsize mode, 16 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSD16_YdEAX(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepSTOS(i, 4)) return;
+#endif
+
   Bit16u di = DI;
 
   write_virtual_dword_32(BX_SEG_REG_ES, di, EAX);
@@ -1797,6 +1874,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSD16_YdEAX(bxInstruction_c *i)
 /* 32 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSD32_YdEAX(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepSTOS(i, 4)) return;
+#endif
+
   Bit32u edi = EDI;
 
   write_virtual_dword(BX_SEG_REG_ES, edi, EAX);
@@ -1817,6 +1898,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSD32_YdEAX(bxInstruction_c *i)
 /* 32 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSD64_YdEAX(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepSTOS(i, 4)) return;
+#endif
+
   Bit64u rdi = RDI;
 
   write_virtual_dword_64(BX_SEG_REG_ES, rdi, EAX);
@@ -1834,6 +1919,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSD64_YdEAX(bxInstruction_c *i)
 /* 64 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSQ32_YqRAX(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepSTOS(i, 8)) return;
+#endif
+
   Bit32u edi = EDI;
 
   write_virtual_qword_64(BX_SEG_REG_ES, edi, RAX);
@@ -1852,6 +1941,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSQ32_YqRAX(bxInstruction_c *i)
 /* 64 bit opsize mode, 64 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::STOSQ64_YqRAX(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepSTOS(i, 8)) return;
+#endif
+
   Bit64u rdi = RDI;
 
   write_virtual_qword_64(BX_SEG_REG_ES, rdi, RAX);
@@ -1948,6 +2041,10 @@ BX_INSF_TYPE BX_CPP_AttrRegparmN(1) BX_CPU_C::REP_LODSQ_RAXXq(bxInstruction_c *i
 /* 16 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::LODSB16_ALXb(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepLODS(i, 1)) return;
+#endif
+
   Bit16u si = SI;
 
   AL = read_virtual_byte_32(i->seg(), si);
@@ -1965,6 +2062,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::LODSB16_ALXb(bxInstruction_c *i)
 /* 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::LODSB32_ALXb(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepLODS(i, 1)) return;
+#endif
+
   Bit32u esi = ESI;
 
   AL = read_virtual_byte(i->seg(), esi);
@@ -1984,6 +2085,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::LODSB32_ALXb(bxInstruction_c *i)
 /* 64 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::LODSB64_ALXb(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepLODS(i, 1)) return;
+#endif
+
   Bit64u rsi = RSI;
 
   AL = read_virtual_byte_64(i->seg(), rsi);
@@ -2002,6 +2107,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::LODSB64_ALXb(bxInstruction_c *i)
 /* 16 bit opsize mode, 16 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::LODSW16_AXXw(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepLODS(i, 2)) return;
+#endif
+
   Bit16u si = SI;
 
   AX = read_virtual_word_32(i->seg(), si);
@@ -2019,6 +2128,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::LODSW16_AXXw(bxInstruction_c *i)
 /* 16 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::LODSW32_AXXw(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepLODS(i, 2)) return;
+#endif
+
   Bit32u esi = ESI;
 
   AX = read_virtual_word(i->seg(), esi);
@@ -2038,6 +2151,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::LODSW32_AXXw(bxInstruction_c *i)
 /* 16 bit opsize mode, 64 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::LODSW64_AXXw(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepLODS(i, 2)) return;
+#endif
+
   Bit64u rsi = RSI;
 
   AX = read_virtual_word_64(i->seg(), rsi);
@@ -2056,6 +2173,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::LODSW64_AXXw(bxInstruction_c *i)
 /* 32 bit opsize mode, 16 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::LODSD16_EAXXd(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepLODS(i, 4)) return;
+#endif
+
   Bit16u si = SI;
 
   RAX = read_virtual_dword_32(i->seg(), si);
@@ -2073,6 +2194,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::LODSD16_EAXXd(bxInstruction_c *i)
 /* 32 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::LODSD32_EAXXd(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepLODS(i, 4)) return;
+#endif
+
   Bit32u esi = ESI;
 
   RAX = read_virtual_dword(i->seg(), esi);
@@ -2093,6 +2218,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::LODSD32_EAXXd(bxInstruction_c *i)
 /* 32 bit opsize mode, 64 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::LODSD64_EAXXd(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepLODS(i, 4)) return;
+#endif
+
   Bit64u rsi = RSI;
 
   RAX = read_virtual_dword_64(i->seg(), rsi);
@@ -2110,6 +2239,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::LODSD64_EAXXd(bxInstruction_c *i)
 /* 64 bit opsize mode, 32 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::LODSQ32_RAXXq(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepLODS(i, 8)) return;
+#endif
+
   Bit32u esi = ESI;
 
   RAX = read_virtual_qword_64(i->seg(), esi);
@@ -2128,6 +2261,10 @@ void BX_CPP_AttrRegparmN(1) BX_CPU_C::LODSQ32_RAXXq(bxInstruction_c *i)
 /* 64 bit opsize mode, 64 bit address size */
 void BX_CPP_AttrRegparmN(1) BX_CPU_C::LODSQ64_RAXXq(bxInstruction_c *i)
 {
+#if (BX_SUPPORT_REPEAT_SPEEDUPS) && (BX_DEBUGGER == 0)
+  if (i->repUsedL() && FastRepLODS(i, 8)) return;
+#endif
+
   Bit64u rsi = RSI;
 
   RAX = read_virtual_qword_64(i->seg(), rsi);
@@ -335,8 +335,8 @@ bx_bool BX_CPU_C::SvmEnterLoadCheckControls(SVM_CONTROLS *ctrls)
     return 0;
   }
 
-  Bit32u guest_asid = vmcb_read32(SVM_CONTROL32_GUEST_ASID);
-  if (guest_asid == 0) {
+  ctrls->guest_asid = vmcb_read32(SVM_CONTROL32_GUEST_ASID);
+  if (ctrls->guest_asid == 0) {
     BX_ERROR(("VMRUN: attempt to run guest with host ASID !"));
     return 0;
   }
@@ -564,6 +564,20 @@ bx_bool BX_CPU_C::SvmEnterLoadCheckGuestState(void)
   if (v_irq)
     signal_event(BX_EVENT_SVM_VIRQ_PENDING);
 
+  // the guest translations are tagged with its ASID and survive VMRUN
+  // unless the hypervisor asks for a flush
+  Bit8u tlb_control = vmcb_read8(SVM_CONTROL32_TLB_CONTROL);
+  if (tlb_control != SVM_TLB_CONTROL_NOTHING) {
+    if (! BX_SUPPORT_SVM_EXTENSION(BX_CPUID_SVM_FLUSH_BY_ASID) || tlb_control == SVM_TLB_CONTROL_FLUSH_ALL)
+      TLB_flush();
+    else if (tlb_control == SVM_TLB_CONTROL_FLUSH_ASID)
+      TLB_flushASID(BX_CPU_THIS_PTR vmcb.ctrls.guest_asid, 0);
+    else if (tlb_control == SVM_TLB_CONTROL_FLUSH_ASID_NON_GLOBAL)
+      TLB_flushASID(BX_CPU_THIS_PTR vmcb.ctrls.guest_asid, 1);
+    else
+      TLB_flush(); // reserved encoding
+  }
+
   handleCpuContextChange();
 
 #if BX_SUPPORT_MONITOR_MWAIT
@@ -1237,6 +1251,7 @@ void BX_CPU_C::register_svm_state(bx_param_c *parent)
   BXRS_HEX_PARAM_FIELD(vmcb_ctrls, v_intr_vector, BX_CPU_THIS_PTR vmcb.ctrls.v_intr_vector);
   BXRS_PARAM_BOOL(vmcb_ctrls, nested_paging, BX_CPU_THIS_PTR vmcb.ctrls.nested_paging);
   BXRS_HEX_PARAM_FIELD(vmcb_ctrls, ncr3, BX_CPU_THIS_PTR vmcb.ctrls.ncr3);
+  BXRS_HEX_PARAM_FIELD(vmcb_ctrls, guest_asid, BX_CPU_THIS_PTR vmcb.ctrls.guest_asid);
 
   //
   // VMCB Host State
@@ -144,6 +144,12 @@ enum SVM_intercept_codes {
 #define SVM_AVIC_LOGICAL_TABLE_PTR              (0x0f0)
 #define SVM_AVIC_PHYSICAL_TABLE_PTR             (0x0f8)
 
+// TLB_CONTROL field encodings
+#define SVM_TLB_CONTROL_NOTHING                 (0x0)
+#define SVM_TLB_CONTROL_FLUSH_ALL               (0x1)
+#define SVM_TLB_CONTROL_FLUSH_ASID              (0x3)
+#define SVM_TLB_CONTROL_FLUSH_ASID_NON_GLOBAL   (0x7)
+
 // ======================
 //  VMCB save state area
 // ======================
@@ -309,6 +315,8 @@ typedef struct bx_SVM_CONTROLS
   bx_bool nested_paging;
   Bit64u ncr3;
 
+  Bit32u guest_asid;
+
   Bit16u pause_filter_count;
 //Bit16u pause_filter_threshold;
 
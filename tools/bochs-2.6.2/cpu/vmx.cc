@@ -1919,6 +1919,14 @@ Bit32u BX_CPU_C::VMenterLoadCheckGuestState(Bit64u *qualification)
   if (vm->vmexec_ctrls2 & VMX_VM_EXEC_CTRL2_INTERRUPT_WINDOW_VMEXIT)
     signal_event(BX_EVENT_VMX_INTERRUPT_WINDOW_EXITING);
 
+  // the guest translations are tagged with its VPID, without VPID they
+  // are not told apart from the host ones and have to be invalidated
+#if BX_SUPPORT_VMX >= 2
+  if (! SECONDARY_VMEXEC_CONTROL(VMX_VM_EXEC_CTRL3_VPID_ENABLE) ||
+        SECONDARY_VMEXEC_CONTROL(VMX_VM_EXEC_CTRL3_VIRTUALIZE_APIC_ACCESSES))
+#endif
+    TLB_flush();
+
   handleCpuContextChange();
 
 #if BX_SUPPORT_MONITOR_MWAIT
@@ -2390,6 +2398,11 @@ void BX_CPU_C::VMexitLoadHostState(void)
 
   BX_CPU_THIS_PTR activity_state = BX_ACTIVITY_STATE_ACTIVE;
 
+#if BX_SUPPORT_VMX >= 2
+  if (! SECONDARY_VMEXEC_CONTROL(VMX_VM_EXEC_CTRL3_VPID_ENABLE))
+#endif
+    TLB_flush();
+
   handleCpuContextChange();
 
 #if BX_SUPPORT_MONITOR_MWAIT
@@ -470,7 +470,9 @@ static void debug_loop(void)
         }
 
         stub_trace_flag = 0;
-        bx_cpu.cpu_loop();
+        do {
+          bx_cpu.cpu_loop();
+        } while (bx_pc_system.handle_snapshot_request());
 
         SIM->refresh_vga();
 
@@ -505,6 +507,7 @@ static void debug_loop(void)
         BX_INFO(("stepping"));
         stub_trace_flag = 1;
         bx_cpu.cpu_loop();
+        bx_pc_system.handle_snapshot_request();
         SIM->refresh_vga();
         stub_trace_flag = 0;
         BX_INFO(("stopped with %x", last_stop_reason));
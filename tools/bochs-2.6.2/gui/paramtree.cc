@@ -850,6 +850,7 @@ bx_shadow_data_c::bx_shadow_data_c(bx_param_c *parent,
   set_type(BXT_PARAM_DATA);
   this->data_ptr = ptr_to_data;
   this->data_size = data_size;
+  this->dirty_map = NULL;
   if (parent) {
     BX_ASSERT(parent->get_type() == BXT_LIST);
     this->parent = (bx_list_c *)parent;
@@ -408,6 +408,7 @@ public:
 class BOCHSAPI bx_shadow_data_c : public bx_param_c {
   Bit32u data_size;
   Bit8u *data_ptr;
+  Bit8u *dirty_map;
 public:
   bx_shadow_data_c(bx_param_c *parent,
       const char *name,
@@ -415,6 +416,9 @@ public:
       Bit32u data_size);
   Bit8u *getptr() {return data_ptr;}
   Bit32u get_size() const {return data_size;}
+  // optional: one byte per 4K page of the data, set by the owner on writes
+  void set_dirty_map(Bit8u *map) {dirty_map = map;}
+  Bit8u *get_dirty_map() const {return dirty_map;}
 };
 
 typedef void (*filedata_save_handler)(void *devptr, FILE *save_fp);
@@ -422,7 +426,8 @@ typedef void (*filedata_restore_handler)(void *devptr, FILE *save_fp);
 
 class BOCHSAPI bx_shadow_filedata_c : public bx_param_c {
 protected:
-  FILE **scratch_fpp;       // Point to scratch file used for backing store
+  FILE **scratch_fpp;       // Point to scratch file used for backing store, or NULL if
+                            // the handlers deal with the data file themselves
   void *sr_devptr;
   filedata_save_handler    save_handler;
   filedata_restore_handler restore_handler;
@@ -491,6 +496,8 @@ public:
   bx_param_c *get(int index);
   bx_param_c *get_by_name(const char *name);
   int get_size() const { return size; }
+  // for walking the list without the linear search of get()
+  bx_listitem_t *get_list() const { return list; }
   int get_choice() const { return choice; }
   void set_choice(int new_choice) { choice = new_choice; }
   char *get_title() { return title; }
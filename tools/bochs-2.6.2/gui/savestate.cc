@@ -0,0 +1,850 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2013  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+
+// Binary save/restore format. The state file starts with a header, followed
+// by the chunks of the data blobs, the param tree and the chunk index:
+//
+//   sr_file_header_t
+//   chunk data
+//   param tree records
+//   sr_blob_t  [blobs]
+//   sr_chunk_t [chunks]
+//
+// The param tree is a sequence of records in the order of the save/restore
+// tree: a type byte, the name (length byte and characters) and the value.
+// A list starts with a SR_REC_LIST record and ends with a SR_REC_END record
+// without a name. Data params refer to a blob, which is split into chunks of
+// SR_CHUNK_SIZE bytes. The chunks are compressed independently on worker
+// threads (see gui/sr_codec.h) and checked with an Adler-32 checksum of the
+// uncompressed data on restore before any of them is written to the live
+// state; chunks with all bytes zero are not stored at all. The values are
+// stored in host byte order, the header has a byte order mark to reject
+// files written on a host with a different one.
+
+#include "bochs.h"
+#include "bxthread.h"
+#include "gui/savestate.h"
+#include "gui/sr_codec.h"
+
+#ifndef WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+extern logfunctions *siminterface_log;
+#define LOG_THIS siminterface_log->
+
+#define SR_MAGIC       "Bochs state"
+#define SR_VERSION     0x00020000
+#define SR_BYTE_ORDER  0x01020304
+
+typedef struct {
+  char   magic[16];
+  Bit32u version;
+  Bit32u byte_order;
+  Bit32u chunk_size;
+  Bit32u blobs;
+  Bit32u chunks;
+  Bit32u tree_checksum;
+  Bit64u tree_offset;
+  Bit64u tree_size;
+  Bit64u index_offset;
+} sr_file_header_t;
+
+typedef struct {
+  Bit64u size;
+  Bit32u first_chunk;
+  Bit32u chunks;
+} sr_blob_t;
+
+typedef struct {
+  Bit64u offset;
+  Bit32u size;     // stored size
+  Bit32u checksum; // of the uncompressed data
+  Bit32u method;
+  Bit32u reserved;
+} sr_chunk_t;
+
+// param tree record types
+#define SR_REC_LIST     'L'
+#define SR_REC_END      'E'
+#define SR_REC_NUM      'N'
+#define SR_REC_BOOL     'B'
+#define SR_REC_ENUM     'M'
+#define SR_REC_STRING   'S'
+#define SR_REC_DATA     'D'
+#define SR_REC_FILEDATA 'F'
+
+// the data slots of the save pipeline per worker thread
+#define SR_SLOTS_PER_THREAD 4
+#define SR_MAX_THREADS      64
+
+/////////////////////////////////////////////////////////////////////////
+// save
+/////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+  const Bit8u *src;
+  Bit32u size;
+  // result of the compression
+  const Bit8u *out;
+  sr_chunk_t chunk;
+} sr_save_job_t;
+
+typedef struct {
+  const char *path;
+  // param tree records
+  Bit8u *tree;
+  Bit32u tree_size, tree_alloc;
+  // data blobs
+  sr_blob_t *blobs;
+  const Bit8u **blob_data;
+  Bit32u nblobs, blobs_alloc;
+  Bit32u nchunks;
+  // compression pipeline
+  sr_save_job_t *jobs;
+  Bit8u **slot_buf;
+  Bit32u slots;
+#if BX_HAVE_THREADS
+  bx_thread_sem_t window, *slot_done;
+  volatile Bit32u next_job;
+#endif
+} sr_save_t;
+
+static void sr_put(sr_save_t *s, const void *data, Bit32u len)
+{
+  if ((s->tree_size + len) > s->tree_alloc) {
+    s->tree_alloc = (s->tree_size + len) * 2;
+    s->tree = (Bit8u*) realloc(s->tree, s->tree_alloc);
+    if (s->tree == NULL)
+      BX_PANIC(("save_state: out of memory"));
+  }
+  memcpy(s->tree + s->tree_size, data, len);
+  s->tree_size += len;
+}
+
+static bx_bool sr_put_record(sr_save_t *s, Bit8u type, bx_param_c *param)
+{
+  const char *name = param->get_name();
+  size_t len = strlen(name);
+
+  if (len > 255) {
+    BX_ERROR(("save_state: parameter name '%s' too long", name));
+    return 0;
+  }
+  Bit8u namelen = (Bit8u) len;
+  sr_put(s, &type, 1);
+  sr_put(s, &namelen, 1);
+  sr_put(s, name, namelen);
+  return 1;
+}
+
+static Bit32u sr_add_blob(sr_save_t *s, const Bit8u *data, Bit64u size)
+{
+  if (s->nblobs == s->blobs_alloc) {
+    s->blobs_alloc = s->blobs_alloc * 2 + 16;
+    s->blobs = (sr_blob_t*) realloc(s->blobs, s->blobs_alloc * sizeof(sr_blob_t));
+    s->blob_data = (const Bit8u**) realloc(s->blob_data, s->blobs_alloc * sizeof(Bit8u*));
+    if ((s->blobs == NULL) || (s->blob_data == NULL))
+      BX_PANIC(("save_state: out of memory"));
+  }
+  sr_blob_t *blob = &s->blobs[s->nblobs];
+  blob->size = size;
+  blob->first_chunk = s->nchunks;
+  blob->chunks = (Bit32u)((size + SR_CHUNK_SIZE - 1) / SR_CHUNK_SIZE);
+  s->blob_data[s->nblobs] = data;
+  s->nchunks += blob->chunks;
+  return s->nblobs++;
+}
+
+// the contents of the scratch file and the data written by the save handler
+// go to a separate file, like in the text format
+static bx_bool sr_save_filedata(sr_save_t *s, bx_shadow_filedata_c *param)
+{
+  char fname[BX_PATHNAME_LEN];
+
+  sprintf(fname, "%s/%s.%s", s->path, param->get_parent()->get_name(), param->get_name());
+  FILE *fp = fopen(fname, "wb");
+  if (fp == NULL) {
+    BX_ERROR(("save_state: cannot create '%s'", fname));
+    return 0;
+  }
+  FILE **fpp = param->get_fpp();
+  if ((fpp != NULL) && (*fpp != NULL)) {
+    char *buffer = new char[SR_CHUNK_SIZE];
+    size_t n;
+    rewind(*fpp);
+    while ((n = fread(buffer, 1, SR_CHUNK_SIZE, *fpp)) > 0) {
+      fwrite(buffer, 1, n, fp);
+    }
+    delete [] buffer;
+    fflush(*fpp);
+  }
+  param->save(fp);
+  fclose(fp);
+  return 1;
+}
+
+static bx_bool sr_save_param(sr_save_t *s, bx_param_c *node)
+{
+  Bit64s num;
+  Bit8u b;
+  Bit16u len;
+  Bit32u blob;
+
+  switch (node->get_type()) {
+    case BXT_PARAM_NUM:
+      num = ((bx_param_num_c*)node)->get64();
+      // like the text format, the value of a 32-bit param is truncated to
+      // the type of its range (the save handlers return -1 for 0xffffffff)
+      if ((Bit64u)((bx_param_num_c*)node)->get_max() <= BX_MAX_BIT32U) {
+        if (((bx_param_num_c*)node)->get_min() >= 0)
+          num = (Bit32u) num;
+        else
+          num = (Bit32s) num;
+      }
+      if (!sr_put_record(s, SR_REC_NUM, node)) return 0;
+      sr_put(s, &num, 8);
+      break;
+    case BXT_PARAM_BOOL:
+      b = (Bit8u) ((bx_param_bool_c*)node)->get();
+      if (!sr_put_record(s, SR_REC_BOOL, node)) return 0;
+      sr_put(s, &b, 1);
+      break;
+    case BXT_PARAM_ENUM:
+      {
+        const char *choice = ((bx_param_enum_c*)node)->get_selected();
+        b = (Bit8u) strlen(choice);
+        if (!sr_put_record(s, SR_REC_ENUM, node)) return 0;
+        sr_put(s, &b, 1);
+        sr_put(s, choice, b);
+      }
+      break;
+    case BXT_PARAM_STRING:
+      {
+        bx_param_string_c *str = (bx_param_string_c*)node;
+        if (str->get_options() & bx_param_string_c::RAW_BYTES) {
+          len = str->get_maxsize();
+        } else {
+          len = strlen(str->getptr());
+        }
+        if (!sr_put_record(s, SR_REC_STRING, node)) return 0;
+        sr_put(s, &len, 2);
+        sr_put(s, str->getptr(), len);
+      }
+      break;
+    case BXT_PARAM_DATA:
+      blob = sr_add_blob(s, ((bx_shadow_data_c*)node)->getptr(), ((bx_shadow_data_c*)node)->get_size());
+      if (!sr_put_record(s, SR_REC_DATA, node)) return 0;
+      sr_put(s, &blob, 4);
+      break;
+    case BXT_PARAM_FILEDATA:
+      if (!sr_save_filedata(s, (bx_shadow_filedata_c*)node)) return 0;
+      if (!sr_put_record(s, SR_REC_FILEDATA, node)) return 0;
+      break;
+    case BXT_LIST:
+      if (!sr_put_record(s, SR_REC_LIST, node)) return 0;
+      for (bx_listitem_t *item = ((bx_list_c*)node)->get_list(); item != NULL; item = item->next) {
+        if (!sr_save_param(s, item->param)) return 0;
+      }
+      b = SR_REC_END;
+      sr_put(s, &b, 1);
+      break;
+    default:
+      BX_ERROR(("save_state: unknown parameter type"));
+      return 0;
+  }
+  return 1;
+}
+
+static void sr_compress_job(sr_save_job_t *job, Bit8u *buf)
+{
+  job->chunk.reserved = 0;
+  job->out = sr_pack_chunk(job->src, job->size, buf, &job->chunk.method,
+                           &job->chunk.size, &job->chunk.checksum);
+}
+
+#if BX_HAVE_THREADS
+// The jobs are taken in order. A worker needs a token of the window before
+// taking a job and the main thread returns it after writing a job, so the
+// jobs not written yet are always less than the data slots.
+static BX_THREAD_FUNC(sr_save_worker, arg)
+{
+  sr_save_t *s = (sr_save_t*) arg;
+  Bit32u i;
+
+  for (;;) {
+    bx_wait_sem(&s->window);
+    if ((i = bx_atomic_add32(&s->next_job, 1)) >= s->nchunks) break;
+    Bit32u slot = i % s->slots;
+    sr_compress_job(&s->jobs[i], s->slot_buf[slot]);
+    bx_set_sem(&s->slot_done[slot]);
+  }
+  BX_THREAD_EXIT;
+}
+#endif
+
+static bx_bool sr_write_chunks(sr_save_t *s, FILE *fp, unsigned threads, Bit64u *offset)
+{
+  Bit32u i, j, n = 0, zero = 0, slot;
+  bx_bool ok = 1;
+
+  s->jobs = new sr_save_job_t[s->nchunks + 1];
+  for (i = 0; i < s->nblobs; i++) {
+    for (j = 0; j < s->blobs[i].chunks; j++, n++) {
+      Bit64u pos = (Bit64u) j * SR_CHUNK_SIZE;
+      s->jobs[n].src = s->blob_data[i] + pos;
+      s->jobs[n].size = (Bit32u) BX_MIN(s->blobs[i].size - pos, SR_CHUNK_SIZE);
+    }
+  }
+#if BX_HAVE_THREADS
+  BX_THREAD_ID(worker[SR_MAX_THREADS]);
+  if (threads > SR_MAX_THREADS) threads = SR_MAX_THREADS;
+  if (threads > s->nchunks) threads = s->nchunks;
+  if (threads > 1) {
+    s->slots = threads * SR_SLOTS_PER_THREAD;
+    s->slot_done = new bx_thread_sem_t[s->slots];
+    if (!bx_create_sem(&s->window))
+      BX_PANIC(("save_state: cannot create semaphores"));
+    for (slot = 0; slot < s->slots; slot++) {
+      if (!bx_create_sem(&s->slot_done[slot]))
+        BX_PANIC(("save_state: cannot create semaphores"));
+      bx_set_sem(&s->window);
+    }
+    s->next_job = 0;
+  } else
+#endif
+  {
+    threads = 0;
+    s->slots = 1;
+  }
+  s->slot_buf = new Bit8u*[s->slots];
+  for (slot = 0; slot < s->slots; slot++) {
+    s->slot_buf[slot] = new Bit8u[SR_CHUNK_SIZE];
+  }
+#if BX_HAVE_THREADS
+  for (i = 0; i < threads; i++) {
+    BX_THREAD_CREATE(sr_save_worker, s, worker[i]);
+  }
+#endif
+
+  for (i = 0; i < s->nchunks; i++) {
+    sr_save_job_t *job = &s->jobs[i];
+    slot = i % s->slots;
+#if BX_HAVE_THREADS
+    if (threads > 0)
+      bx_wait_sem(&s->slot_done[slot]);
+    else
+#endif
+      sr_compress_job(job, s->slot_buf[slot]);
+    job->chunk.offset = *offset;
+    if (job->chunk.method == SR_CHUNK_ZERO) {
+      zero++;
+    } else if (ok) {
+      ok = (fwrite(job->out, 1, job->chunk.size, fp) == job->chunk.size);
+      *offset += job->chunk.size;
+    }
+#if BX_HAVE_THREADS
+    // the remaining jobs are still taken from the workers after an error
+    if (threads > 0)
+      bx_set_sem(&s->window);
+#endif
+  }
+
+#if BX_HAVE_THREADS
+  for (i = 0; i < threads; i++) {
+    bx_thread_join(worker[i]);
+  }
+  if (threads > 0) {
+    bx_destroy_sem(&s->window);
+    for (slot = 0; slot < s->slots; slot++) {
+      bx_destroy_sem(&s->slot_done[slot]);
+    }
+    delete [] s->slot_done;
+  }
+#endif
+  for (slot = 0; slot < s->slots; slot++) {
+    delete [] s->slot_buf[slot];
+  }
+  delete [] s->slot_buf;
+  BX_DEBUG(("save_state: %u chunks, %u of them zero", s->nchunks, zero));
+  return ok;
+}
+
+bx_bool bx_save_state_file(const char *checkpoint_path, bx_list_c *root, unsigned threads)
+{
+  char fname[BX_PATHNAME_LEN];
+  sr_file_header_t header;
+  sr_save_t s;
+  Bit64u offset = sizeof(header);
+  Bit32u i;
+  bx_bool ok = 1;
+
+  memset(&s, 0, sizeof(s));
+  s.path = checkpoint_path;
+  for (bx_listitem_t *item = root->get_list(); item != NULL; item = item->next) {
+    if (!sr_save_param(&s, item->param)) {
+      ok = 0;
+      break;
+    }
+  }
+  sprintf(fname, "%s/%s", checkpoint_path, BX_STATE_FILE);
+  FILE *fp = ok ? fopen(fname, "wb") : NULL;
+  if (fp != NULL) {
+    memset(&header, 0, sizeof(header));
+    ok = (fwrite(&header, sizeof(header), 1, fp) == 1);
+    if (ok && !sr_write_chunks(&s, fp, threads, &offset)) {
+      BX_ERROR(("save_state: cannot write '%s'", fname));
+      ok = 0;
+    }
+    if (ok) {
+      strcpy(header.magic, SR_MAGIC);
+      header.version = SR_VERSION;
+      header.byte_order = SR_BYTE_ORDER;
+      header.chunk_size = SR_CHUNK_SIZE;
+      header.blobs = s.nblobs;
+      header.chunks = s.nchunks;
+      header.tree_checksum = sr_adler32(s.tree, s.tree_size);
+      header.tree_offset = offset;
+      header.tree_size = s.tree_size;
+      header.index_offset = offset + s.tree_size;
+      ok = (fwrite(s.tree, 1, s.tree_size, fp) == s.tree_size);
+      if (ok && (s.nblobs > 0))
+        ok = (fwrite(s.blobs, sizeof(sr_blob_t), s.nblobs, fp) == s.nblobs);
+      for (i = 0; ok && (i < s.nchunks); i++) {
+        ok = (fwrite(&s.jobs[i].chunk, sizeof(sr_chunk_t), 1, fp) == 1);
+      }
+      if (ok) {
+        rewind(fp);
+        ok = (fwrite(&header, sizeof(header), 1, fp) == 1);
+      }
+    }
+    if ((fclose(fp) != 0) || !ok) {
+      BX_ERROR(("save_state: error writing '%s'", fname));
+      remove(fname);
+      ok = 0;
+    }
+  } else if (ok) {
+    BX_ERROR(("save_state: cannot create '%s'", fname));
+    ok = 0;
+  }
+  delete [] s.jobs;
+  free(s.tree);
+  free(s.blobs);
+  free(s.blob_data);
+  return ok;
+}
+
+/////////////////////////////////////////////////////////////////////////
+// restore
+/////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+  bx_param_c *param;
+  const Bit8u *value;
+} sr_item_t;
+
+typedef struct {
+  const sr_chunk_t *chunk;
+  Bit8u *dst;
+  Bit32u size;
+} sr_load_job_t;
+
+typedef struct {
+  const char *path;
+  const Bit8u *file;
+  Bit64u file_size;
+  const sr_file_header_t *header;
+  const sr_blob_t *blobs;
+  const sr_chunk_t *chunks;
+  // param tree parser
+  const Bit8u *p, *end;
+  sr_item_t *items;
+  Bit32u nitems, items_alloc;
+  sr_load_job_t *jobs;
+  Bit32u njobs;
+  // chunk decompression
+  bx_bool commit;
+  volatile Bit32u next_job;
+  volatile Bit32u failed;
+} sr_restore_t;
+
+// the state file is mapped to memory where possible, read otherwise
+static const Bit8u *sr_map_file(const char *fname, Bit64u *size, bx_bool *mapped)
+{
+  Bit8u *data = NULL;
+
+  *mapped = 0;
+#ifndef WIN32
+  struct stat st;
+  int fd = ::open(fname, O_RDONLY);
+  if (fd < 0) return NULL;
+  if ((fstat(fd, &st) == 0) && (st.st_size > 0) && ((Bit64u) st.st_size == (size_t) st.st_size)) {
+    void *ptr = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (ptr != MAP_FAILED) {
+      ::close(fd);
+      *size = st.st_size;
+      *mapped = 1;
+      return (const Bit8u*) ptr;
+    }
+  }
+  ::close(fd);
+#endif
+  FILE *fp = fopen(fname, "rb");
+  if (fp == NULL) return NULL;
+  if ((fseek(fp, 0, SEEK_END) == 0) && (ftell(fp) > 0)) {
+    *size = ftell(fp);
+    rewind(fp);
+    data = new Bit8u[(size_t) *size];
+    if (fread(data, 1, (size_t) *size, fp) != *size) {
+      delete [] data;
+      data = NULL;
+    }
+  }
+  fclose(fp);
+  return data;
+}
+
+static void sr_unmap_file(const Bit8u *data, Bit64u size, bx_bool mapped)
+{
+#ifndef WIN32
+  if (mapped) {
+    munmap((void*) data, (size_t) size);
+    return;
+  }
+#endif
+  delete [] data;
+}
+
+static bx_bool sr_get(sr_restore_t *r, void *data, Bit32u len)
+{
+  if ((Bit32u)(r->end - r->p) < len) return 0;
+  memcpy(data, r->p, len);
+  r->p += len;
+  return 1;
+}
+
+static bx_bool sr_skip(sr_restore_t *r, Bit32u len)
+{
+  if ((Bit32u)(r->end - r->p) < len) return 0;
+  r->p += len;
+  return 1;
+}
+
+static bx_bool sr_add_data_jobs(sr_restore_t *r, bx_shadow_data_c *param, Bit32u index)
+{
+  if (index >= r->header->blobs) return 0;
+  const sr_blob_t *blob = &r->blobs[index];
+  if ((blob->size != param->get_size()) ||
+      ((Bit64u) blob->first_chunk + blob->chunks > r->header->chunks) ||
+      ((Bit64u) r->njobs + blob->chunks > r->header->chunks) ||
+      (blob->chunks != (blob->size + SR_CHUNK_SIZE - 1) / SR_CHUNK_SIZE)) {
+    BX_ERROR(("restore_state: data of '%s' does not match", param->get_name()));
+    return 0;
+  }
+  for (Bit32u i = 0; i < blob->chunks; i++) {
+    const sr_chunk_t *chunk = &r->chunks[blob->first_chunk + i];
+    Bit64u pos = (Bit64u) i * SR_CHUNK_SIZE;
+    if ((chunk->offset > r->file_size) || (chunk->size > r->file_size - chunk->offset))
+      return 0;
+    sr_load_job_t *job = &r->jobs[r->njobs++];
+    job->chunk = chunk;
+    job->dst = param->getptr() + pos;
+    job->size = (Bit32u) BX_MIN(blob->size - pos, SR_CHUNK_SIZE);
+  }
+  return 1;
+}
+
+// looks up the params of the records and checks the values, nothing is
+// changed before all of the tree is known to be valid
+static bx_bool sr_parse_list(sr_restore_t *r, bx_list_c *list, int depth, int *found)
+{
+  bx_listitem_t *next = list->get_list();
+  bx_param_c *param;
+  char name[256];
+  Bit8u type, len;
+  Bit16u slen;
+  Bit32u index;
+
+  while (r->p < r->end) {
+    type = *r->p++;
+    if (type == SR_REC_END)
+      return (depth > 0);
+    if (!sr_get(r, &len, 1) || !sr_get(r, name, len))
+      return 0;
+    name[len] = 0;
+    // the records are in the order of the list, unless the tree changed
+    if ((next != NULL) && !strcmp(next->param->get_name(), name)) {
+      param = next->param;
+      next = next->next;
+    } else {
+      param = list->get_by_name(name);
+    }
+    if (param == NULL) {
+      BX_ERROR(("restore_state: unknown parameter '%s'", name));
+      return 0;
+    }
+    if (depth == 0) (*found)++;
+    if (r->nitems == r->items_alloc) {
+      r->items_alloc = r->items_alloc * 2 + 256;
+      r->items = (sr_item_t*) realloc(r->items, r->items_alloc * sizeof(sr_item_t));
+      if (r->items == NULL)
+        BX_PANIC(("restore_state: out of memory"));
+    }
+    r->items[r->nitems].param = param;
+    r->items[r->nitems].value = r->p;
+    r->nitems++;
+    switch (type) {
+      case SR_REC_NUM:
+        if ((param->get_type() != BXT_PARAM_NUM) || !sr_skip(r, 8)) goto mismatch;
+        break;
+      case SR_REC_BOOL:
+        if ((param->get_type() != BXT_PARAM_BOOL) || !sr_skip(r, 1)) goto mismatch;
+        break;
+      case SR_REC_ENUM:
+        if ((param->get_type() != BXT_PARAM_ENUM) || !sr_get(r, &len, 1) || !sr_get(r, name, len))
+          goto mismatch;
+        name[len] = 0;
+        if (((bx_param_enum_c*)param)->find_by_name(name) < 0) {
+          BX_ERROR(("restore_state: invalid choice '%s' for '%s'", name, param->get_name()));
+          return 0;
+        }
+        break;
+      case SR_REC_STRING:
+        if ((param->get_type() != BXT_PARAM_STRING) || !sr_get(r, &slen, 2) || !sr_skip(r, slen))
+          goto mismatch;
+        break;
+      case SR_REC_DATA:
+        if ((param->get_type() != BXT_PARAM_DATA) || !sr_get(r, &index, 4) ||
+            !sr_add_data_jobs(r, (bx_shadow_data_c*)param, index))
+          goto mismatch;
+        break;
+      case SR_REC_FILEDATA:
+        if (param->get_type() != BXT_PARAM_FILEDATA) goto mismatch;
+        break;
+      case SR_REC_LIST:
+        if (param->get_type() != BXT_LIST) goto mismatch;
+        if (!sr_parse_list(r, (bx_list_c*)param, depth + 1, found)) return 0;
+        break;
+      default:
+        goto mismatch;
+    }
+  }
+  return (depth == 0);
+
+mismatch:
+  BX_ERROR(("restore_state: invalid record for parameter '%s'", name));
+  return 0;
+}
+
+static void sr_load_chunks(sr_restore_t *r)
+{
+  Bit8u *scratch = r->commit ? NULL : new Bit8u[SR_CHUNK_SIZE];
+  Bit32u i;
+
+  while ((i = bx_atomic_add32(&r->next_job, 1)) < r->njobs) {
+    const sr_load_job_t *job = &r->jobs[i];
+    // the first pass unpacks to the scratch buffer, the second one
+    // to the destination once all chunks are known to be valid
+    if (!sr_unpack_chunk(job->chunk->method, r->file + job->chunk->offset, job->chunk->size,
+                         job->chunk->checksum, r->commit ? job->dst : scratch, job->size))
+      bx_atomic_add32(&r->failed, 1);
+  }
+  delete [] scratch;
+}
+
+#if BX_HAVE_THREADS
+static BX_THREAD_FUNC(sr_restore_worker, arg)
+{
+  sr_load_chunks((sr_restore_t*) arg);
+  BX_THREAD_EXIT;
+}
+#endif
+
+static void sr_run_load_jobs(sr_restore_t *r, unsigned threads)
+{
+  r->next_job = 0;
+  r->failed = 0;
+#if BX_HAVE_THREADS
+  BX_THREAD_ID(worker[SR_MAX_THREADS]);
+  unsigned i;
+  if (threads > SR_MAX_THREADS) threads = SR_MAX_THREADS;
+  if (threads > r->njobs) threads = r->njobs;
+  for (i = 1; i < threads; i++) {
+    BX_THREAD_CREATE(sr_restore_worker, r, worker[i]);
+  }
+  sr_load_chunks(r);
+  for (i = 1; i < threads; i++) {
+    bx_thread_join(worker[i]);
+  }
+#else
+  sr_load_chunks(r);
+#endif
+}
+
+static bx_bool sr_restore_filedata(sr_restore_t *r, bx_shadow_filedata_c *param)
+{
+  char fname[BX_PATHNAME_LEN];
+
+  sprintf(fname, "%s/%s.%s", r->path, param->get_parent()->get_name(), param->get_name());
+  FILE *fp = fopen(fname, "rb");
+  if (fp == NULL) {
+    BX_ERROR(("restore_state: cannot open '%s'", fname));
+    return 0;
+  }
+  FILE **fpp = param->get_fpp();
+  // If the temporary backing store file wasn't created, do it now.
+  if ((fpp != NULL) && (*fpp == NULL))
+    *fpp = tmpfile();
+  if ((fpp != NULL) && (*fpp != NULL)) {
+    char *buffer = new char[SR_CHUNK_SIZE];
+    size_t n;
+    rewind(*fpp);
+    while ((n = fread(buffer, 1, SR_CHUNK_SIZE, fp)) > 0) {
+      fwrite(buffer, 1, n, *fpp);
+    }
+    delete [] buffer;
+    fflush(*fpp);
+  }
+  param->restore(fp);
+  fclose(fp);
+  return 1;
+}
+
+static bx_bool sr_restore_values(sr_restore_t *r)
+{
+  char buf[BX_PATHNAME_LEN];
+  Bit64s num;
+  Bit8u len;
+  Bit16u slen;
+
+  for (Bit32u i = 0; i < r->nitems; i++) {
+    bx_param_c *param = r->items[i].param;
+    const Bit8u *value = r->items[i].value;
+    switch (param->get_type()) {
+      case BXT_PARAM_NUM:
+        memcpy(&num, value, 8);
+        ((bx_param_num_c*)param)->set(num);
+        break;
+      case BXT_PARAM_BOOL:
+        ((bx_param_bool_c*)param)->set(*value);
+        break;
+      case BXT_PARAM_ENUM:
+        len = *value;
+        memcpy(buf, value + 1, len);
+        buf[len] = 0;
+        if (!((bx_param_enum_c*)param)->set_by_name(buf)) {
+          BX_ERROR(("restore_state: invalid choice '%s' for '%s'", buf, param->get_name()));
+          return 0;
+        }
+        break;
+      case BXT_PARAM_STRING:
+        {
+          bx_param_string_c *str = (bx_param_string_c*)param;
+          memcpy(&slen, value, 2);
+          char *tmp = new char[BX_MAX(slen, str->get_maxsize()) + 1];
+          memset(tmp, 0, BX_MAX(slen, str->get_maxsize()) + 1);
+          memcpy(tmp, value + 2, slen);
+          str->set(tmp);
+          delete [] tmp;
+        }
+        break;
+      case BXT_PARAM_FILEDATA:
+        if (!sr_restore_filedata(r, (bx_shadow_filedata_c*)param))
+          return 0;
+        break;
+      default:
+        // lists and the data blobs, which are already restored
+        break;
+    }
+  }
+  return 1;
+}
+
+bx_bool bx_restore_state_file(const char *checkpoint_path, bx_list_c *root, unsigned threads)
+{
+  char fname[BX_PATHNAME_LEN];
+  sr_restore_t r;
+  bx_bool mapped, ok = 0;
+  int found = 0;
+
+  memset(&r, 0, sizeof(r));
+  r.path = checkpoint_path;
+  sprintf(fname, "%s/%s", checkpoint_path, BX_STATE_FILE);
+  BX_INFO(("restoring '%s'", fname));
+  r.file = sr_map_file(fname, &r.file_size, &mapped);
+  if (r.file == NULL) {
+    BX_ERROR(("restore_state: cannot read '%s'", fname));
+    return 0;
+  }
+  r.header = (const sr_file_header_t*) r.file;
+  if ((r.file_size < sizeof(sr_file_header_t)) || memcmp(r.header->magic, SR_MAGIC, sizeof(SR_MAGIC)) ||
+      (r.header->version != SR_VERSION) || (r.header->byte_order != SR_BYTE_ORDER) ||
+      (r.header->chunk_size != SR_CHUNK_SIZE)) {
+    BX_ERROR(("restore_state: '%s' is not a supported state file", fname));
+    goto done;
+  }
+  if ((r.header->tree_offset > r.file_size) ||
+      (r.header->tree_size > r.file_size - r.header->tree_offset) ||
+      (r.header->index_offset > r.file_size) ||
+      (((Bit64u) r.header->blobs * sizeof(sr_blob_t) + (Bit64u) r.header->chunks * sizeof(sr_chunk_t))
+        > r.file_size - r.header->index_offset) ||
+      (sr_adler32(r.file + r.header->tree_offset, (Bit32u) r.header->tree_size) != r.header->tree_checksum)) {
+    BX_ERROR(("restore_state: '%s' is corrupted", fname));
+    goto done;
+  }
+  r.blobs = (const sr_blob_t*)(r.file + r.header->index_offset);
+  r.chunks = (const sr_chunk_t*)(r.file + r.header->index_offset + r.header->blobs * sizeof(sr_blob_t));
+  r.p = r.file + r.header->tree_offset;
+  r.end = r.p + r.header->tree_size;
+  r.jobs = new sr_load_job_t[r.header->chunks + 1];
+  if (!sr_parse_list(&r, root, 0, &found))
+    goto done;
+  if (found != root->get_size()) {
+    BX_ERROR(("restore_state: '%s' does not have the state of all devices", fname));
+    goto done;
+  }
+
+  // the live state is only touched once all chunks are known to be valid
+  r.commit = 0;
+  sr_run_load_jobs(&r, threads);
+  if (r.failed > 0) {
+    BX_ERROR(("restore_state: %u chunks of '%s' are corrupted", r.failed, fname));
+    goto done;
+  }
+  r.commit = 1;
+  sr_run_load_jobs(&r, threads);
+  if (r.failed > 0) {
+    BX_PANIC(("restore_state: cannot unpack '%s'", fname));
+    goto done;
+  }
+  ok = sr_restore_values(&r);
+
+done:
+  delete [] r.jobs;
+  free(r.items);
+  sr_unmap_file(r.file, r.file_size, mapped);
+  return ok;
+}
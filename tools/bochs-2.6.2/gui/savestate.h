@@ -0,0 +1,36 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2013  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+
+// Binary save/restore format: the save/restore param tree and the data
+// blobs of a checkpoint are stored in a single file, see savestate.cc.
+// The bochsrc, the log options and the files written by the save handlers
+// of filedata params stay separate files in the checkpoint folder.
+
+#ifndef BX_SAVESTATE_H
+#define BX_SAVESTATE_H
+
+#define BX_STATE_FILE "state.bin"
+
+bx_bool bx_save_state_file(const char *checkpoint_path, bx_list_c *root, unsigned threads);
+bx_bool bx_restore_state_file(const char *checkpoint_path, bx_list_c *root, unsigned threads);
+
+#endif
@@ -27,6 +27,7 @@
 #include "param_names.h"
 #include "iodev.h"
 #include "virt_timer.h"
+#include "gui/savestate.h"
 
 bx_simulator_interface_c *SIM = NULL;
 logfunctions *siminterface_log = NULL;
@@ -59,6 +60,12 @@ typedef struct _addon_option_t {
   struct _addon_option_t *next;
 } addon_option_t;
 
+typedef struct {
+  bx_param_c *param;
+  Bit64s value;  // numeric, bool and enum params
+  Bit8u *data;   // copy of string and data params
+} snapshot_param_t;
+
 class bx_real_sim_c : public bx_simulator_interface_c {
   bxevent_handler bxevent_callback;
   void *bxevent_callback_data;
@@ -75,6 +82,9 @@ class bx_real_sim_c : public bx_simulator_interface_c {
   unsigned param_id;
   bx_bool bx_debug_gui;
   bx_bool wxsel;
+  snapshot_param_t *snapshot_params;
+  int snapshot_size;
+  int snapshot_count;
 public:
   bx_real_sim_c();
   virtual ~bx_real_sim_c() {}
@@ -193,6 +203,9 @@ public:
     return (bx_list_c*)get_param("bochs", NULL);
   }
   virtual bx_bool restore_bochs_param(bx_list_c *root, const char *sr_path, const char *restore_name);
+  virtual bx_bool snapshot_take();
+  virtual bx_bool snapshot_restore();
+  virtual void snapshot_discard();
   // special config parameter and options functions for plugins
   virtual bx_bool opt_plugin_ctrl(const char *plugname, bx_bool load);
   virtual void init_std_nic_options(const char *name, bx_list_c *menu);
@@ -206,6 +219,8 @@ public:
 
 private:
   bx_bool save_sr_param(FILE *fp, bx_param_c *node, const char *sr_path, int level);
+  void snapshot_add_param(bx_param_c *node);
+  bx_bool snapshot_check_param(bx_param_c *node, int *n);
 };
 
 // recursive function to find parameters from the path
@@ -340,6 +355,9 @@ bx_real_sim_c::bx_real_sim_c()
   param_id = BXP_NEW_PARAM_ID;
   rt_conf_entries = NULL;
   addon_options = NULL;
+  snapshot_params = NULL;
+  snapshot_size = 0;
+  snapshot_count = 0;
 }
 
 void bx_real_sim_c::reset_all_param()
@@ -526,6 +544,7 @@ const char *hdimage_mode_names[] = {
   "volatile",
   "vvfat",
   "vpc",
+  "qcow2",
   NULL
 };
 
@@ -1008,6 +1027,7 @@ void bx_real_sim_c::cleanup_save_restore()
 {
   bx_list_c *list;
 
+  snapshot_discard();
   if ((list = get_bochs_root()) != NULL) {
     list->clear();
   }
@@ -1021,6 +1041,7 @@ bx_bool bx_real_sim_c::save_state(const char *checkpoint_path)
   int type, ntype = SIM->get_max_log_level();
 
   get_param_string(BXPN_RESTORE_PATH)->set(checkpoint_path);
+  bx_sr_before_save_state();
   sprintf(sr_file, "%s/config", checkpoint_path);
   if (write_rc(sr_file, 1) < 0)
     return 0;
@@ -1047,6 +1068,14 @@ bx_bool bx_real_sim_c::save_state(const char *checkpoint_path)
     return 0;
   }
   bx_list_c *sr_list = get_bochs_root();
+  sprintf(sr_file, "%s/%s", checkpoint_path, BX_STATE_FILE);
+  if (get_param_enum(BXPN_SR_FORMAT)->get() == BX_SR_FORMAT_BINARY) {
+    bx_bool ret = bx_save_state_file(checkpoint_path, sr_list, get_param_num(BXPN_SR_THREADS)->get());
+    get_param_string(BXPN_RESTORE_PATH)->set("none");
+    return ret;
+  }
+  // the binary state file would be restored instead of the text files
+  remove(sr_file);
   ndev = sr_list->get_size();
   for (dev=0; dev<ndev; dev++) {
     sprintf(sr_file, "%s/%s", checkpoint_path, sr_list->get(dev)->get_name());
@@ -1234,9 +1263,9 @@ bx_bool bx_real_sim_c::restore_bochs_param(bx_list_c *root, const char *sr_path,
                   if (fp2 != NULL) {
                     FILE **fpp = ((bx_shadow_filedata_c*)param)->get_fpp();
                     // If the temporary backing store file wasn't created, do it now.
-                    if (*fpp == NULL)
+                    if ((fpp != NULL) && (*fpp == NULL))
                       *fpp = tmpfile();
-                    if (*fpp != NULL) {
+                    if ((fpp != NULL) && (*fpp != NULL)) {
                       while (!feof(fp2)) {
                         char buffer[64];
                         size_t chars = fread(buffer, 1, sizeof(buffer), fp2);
@@ -1272,8 +1301,17 @@ bx_bool bx_real_sim_c::restore_bochs_param(bx_list_c *root, const char *sr_path,
 
 bx_bool bx_real_sim_c::restore_hardware()
 {
+  char sr_file[BX_PATHNAME_LEN];
   bx_list_c *sr_list = get_bochs_root();
   int ndev = sr_list->get_size();
+  FILE *fp;
+
+  sprintf(sr_file, "%s/%s", get_param_string(BXPN_RESTORE_PATH)->getptr(), BX_STATE_FILE);
+  if ((fp = fopen(sr_file, "rb")) != NULL) {
+    fclose(fp);
+    return bx_restore_state_file(get_param_string(BXPN_RESTORE_PATH)->getptr(), sr_list,
+                                 get_param_num(BXPN_SR_THREADS)->get());
+  }
   for (int dev=0; dev<ndev; dev++) {
     if (!restore_bochs_param(sr_list, get_param_string(BXPN_RESTORE_PATH)->getptr(), sr_list->get(dev)->get_name()))
       return 0;
@@ -1357,7 +1395,7 @@ bx_bool bx_real_sim_c::save_sr_param(FILE *fp, bx_param_c *node, const char *sr_
       if (fp2 != NULL) {
         FILE **fpp = ((bx_shadow_filedata_c*)node)->get_fpp();
         // If the backing store hasn't been created, just save an empty 0 byte placeholder file.
-        if (*fpp != NULL) {
+        if ((fpp != NULL) && (*fpp != NULL)) {
           while (!feof(*fpp)) {
             char buffer[64];
             size_t chars = fread (buffer, 1, sizeof(buffer), *fpp);
@@ -1389,6 +1427,169 @@ bx_bool bx_real_sim_c::save_sr_param(FILE *fp, bx_param_c *node, const char *sr_
   return 1;
 }
 
+// In-memory snapshot of the simulation state, meant for restoring the same
+// state many times (e.g. for fuzzing). The values of the save/restore params
+// are copied to memory, the guest RAM is saved copy-on-write by the memory
+// object. The snapshot functions must be called with all processors at an
+// instruction boundary, e.g. from the simulation loop in between cpu_loop()
+// calls (see bx_pc_system_c::handle_snapshot_request()).
+
+bx_bool bx_real_sim_c::snapshot_take()
+{
+  bx_listitem_t *item;
+
+  snapshot_discard();
+  if (!BX_MEM(0)->snapshot_take())
+    return 0;
+  for (item = get_bochs_root()->get_list(); item; item = item->next) {
+    // guest RAM is handled by the memory object
+    if (!strcmp(item->param->get_name(), "memory")) continue;
+    snapshot_add_param(item->param);
+  }
+  BX_INFO(("snapshot: %d parameters saved", snapshot_count));
+  return 1;
+}
+
+bx_bool bx_real_sim_c::snapshot_restore()
+{
+  bx_listitem_t *item;
+  int n = 0;
+  snapshot_param_t *entry;
+  bx_shadow_data_c *data;
+  Bit8u *dirty;
+
+  if (snapshot_params == NULL) {
+    BX_ERROR(("snapshot: no snapshot taken"));
+    return 0;
+  }
+  // devices (e.g. USB) could have been connected or removed since the take
+  for (item = get_bochs_root()->get_list(); item; item = item->next) {
+    if (!strcmp(item->param->get_name(), "memory")) continue;
+    if (!snapshot_check_param(item->param, &n)) break;
+  }
+  if ((item != NULL) || (n != snapshot_count)) {
+    BX_ERROR(("snapshot: the state tree has changed, snapshot discarded"));
+    snapshot_discard();
+    return 0;
+  }
+
+  // the after_restore_state() handlers expect the devices in reset state,
+  // same as when restoring from files
+  DEV_reset_devices(BX_RESET_HARDWARE);
+  BX_MEM(0)->snapshot_restore();
+  for (n=0; n<snapshot_count; n++) {
+    entry = &snapshot_params[n];
+    switch (entry->param->get_type()) {
+      case BXT_PARAM_NUM:
+      case BXT_PARAM_BOOL:
+      case BXT_PARAM_ENUM:
+        ((bx_param_num_c*)entry->param)->set(entry->value);
+        break;
+      case BXT_PARAM_STRING:
+        ((bx_param_string_c*)entry->param)->set((const char*)entry->data);
+        break;
+      case BXT_PARAM_DATA:
+        data = (bx_shadow_data_c*)entry->param;
+        dirty = data->get_dirty_map();
+        if (dirty != NULL) {
+          // only copy back the pages written since the take
+          for (Bit32u off=0; off < data->get_size(); off += 4096) {
+            if (dirty[off >> 12]) {
+              memcpy(data->getptr() + off, entry->data + off,
+                     BX_MIN(4096, data->get_size() - off));
+              dirty[off >> 12] = 0;
+            }
+          }
+        } else {
+          memcpy(data->getptr(), entry->data, data->get_size());
+        }
+        break;
+    }
+  }
+  bx_sr_after_restore_state();
+  return 1;
+}
+
+void bx_real_sim_c::snapshot_discard()
+{
+  if (snapshot_params == NULL)
+    return;
+
+  BX_MEM(0)->snapshot_discard();
+  for (int n=0; n<snapshot_count; n++)
+    delete [] snapshot_params[n].data;
+  delete [] snapshot_params;
+  snapshot_params = NULL;
+  snapshot_size = 0;
+  snapshot_count = 0;
+}
+
+void bx_real_sim_c::snapshot_add_param(bx_param_c *node)
+{
+  snapshot_param_t *entry;
+  bx_listitem_t *item;
+  char pname[BX_PATHNAME_LEN];
+  int size;
+
+  if (node->get_type() == BXT_LIST) {
+    for (item = ((bx_list_c*)node)->get_list(); item; item = item->next) {
+      snapshot_add_param(item->param);
+    }
+    return;
+  }
+  if (snapshot_count == snapshot_size) {
+    snapshot_size = snapshot_size ? snapshot_size * 2 : 1024;
+    entry = new snapshot_param_t[snapshot_size];
+    if (snapshot_params != NULL) {
+      memcpy(entry, snapshot_params, snapshot_count * sizeof(snapshot_param_t));
+      delete [] snapshot_params;
+    }
+    snapshot_params = entry;
+  }
+  entry = &snapshot_params[snapshot_count++];
+  entry->param = node;
+  entry->value = 0;
+  entry->data = NULL;
+  switch (node->get_type()) {
+    case BXT_PARAM_NUM:
+    case BXT_PARAM_BOOL:
+    case BXT_PARAM_ENUM:
+      entry->value = ((bx_param_num_c*)node)->get64();
+      break;
+    case BXT_PARAM_STRING:
+      size = ((bx_param_string_c*)node)->get_maxsize();
+      entry->data = new Bit8u[size];
+      memcpy(entry->data, ((bx_param_string_c*)node)->getptr(), size);
+      break;
+    case BXT_PARAM_DATA:
+      size = ((bx_shadow_data_c*)node)->get_size();
+      entry->data = new Bit8u[size];
+      memcpy(entry->data, ((bx_shadow_data_c*)node)->getptr(), size);
+      if (((bx_shadow_data_c*)node)->get_dirty_map() != NULL)
+        memset(((bx_shadow_data_c*)node)->get_dirty_map(), 0, (size + 4095) >> 12);
+      break;
+    default:
+      // e.g. the hard disk image contents
+      node->get_param_path(pname, BX_PATHNAME_LEN);
+      BX_INFO(("snapshot: parameter '%s' is not restored", pname));
+  }
+}
+
+bx_bool bx_real_sim_c::snapshot_check_param(bx_param_c *node, int *n)
+{
+  if (node->get_type() == BXT_LIST) {
+    bx_listitem_t *item;
+    for (item = ((bx_list_c*)node)->get_list(); item; item = item->next) {
+      if (!snapshot_check_param(item->param, n)) return 0;
+    }
+    return 1;
+  }
+  if ((*n >= snapshot_count) || (snapshot_params[*n].param != node))
+    return 0;
+  (*n)++;
+  return 1;
+}
+
 bx_bool bx_real_sim_c::opt_plugin_ctrl(const char *plugname, bx_bool load)
 {
   bx_list_c *plugin_ctrl = (bx_list_c*)SIM->get_param(BXPN_PLUGIN_CTRL);
@@ -544,9 +544,10 @@ enum {
   BX_HDIMAGE_MODE_GROWING,
   BX_HDIMAGE_MODE_VOLATILE,
   BX_HDIMAGE_MODE_VVFAT,
-  BX_HDIMAGE_MODE_VPC
+  BX_HDIMAGE_MODE_VPC,
+  BX_HDIMAGE_MODE_QCOW2
 };
-#define BX_HDIMAGE_MODE_LAST     BX_HDIMAGE_MODE_VPC
+#define BX_HDIMAGE_MODE_LAST     BX_HDIMAGE_MODE_QCOW2
 #define BX_HDIMAGE_MODE_UNKNOWN  -1
 
 enum {
@@ -557,6 +558,22 @@ enum {
 };
 #define BX_CLOCK_SYNC_LAST       BX_CLOCK_SYNC_BOTH
 
+enum {
+  BX_MEM_BACKEND_HEAP,
+  BX_MEM_BACKEND_MMAP
+};
+
+enum {
+  BX_MEM_RESTORE_EAGER,
+  BX_MEM_RESTORE_LAZY,
+  BX_MEM_RESTORE_PREFETCH
+};
+
+enum {
+  BX_SR_FORMAT_TEXT,
+  BX_SR_FORMAT_BINARY
+};
+
 enum {
   BX_PCI_CHIPSET_I430FX,
   BX_PCI_CHIPSET_I440FX
@@ -760,6 +777,10 @@ public:
   virtual bx_bool restore_hardware() {return 0;}
   virtual bx_list_c *get_bochs_root() {return NULL;}
   virtual bx_bool restore_bochs_param(bx_list_c *root, const char *sr_path, const char *restore_name) { return 0; }
+  // in-memory snapshot support
+  virtual bx_bool snapshot_take() {return 0;}
+  virtual bx_bool snapshot_restore() {return 0;}
+  virtual void snapshot_discard() {}
   // special config parameter and options functions for plugins
   virtual bx_bool opt_plugin_ctrl(const char *plugname, bx_bool load) {return 0;}
   virtual void init_std_nic_options(const char *name, bx_list_c *menu) {}
@@ -0,0 +1,136 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2013  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef BX_SR_CODEC_H
+#define BX_SR_CODEC_H
+
+// Chunk codec of the binary save/restore format (see gui/savestate.cc).
+// A chunk is stored in one of three ways: not at all if all bytes are
+// zero, as a zlib stream if zlib is available and the data shrinks, or
+// as is. The Adler-32 checksum of the uncompressed data is kept with the
+// chunk and verified by sr_unpack_chunk(). Only depends on config.h, so
+// misc/test-savestate.cc can check the format on its own.
+
+#include <string.h>
+#if BX_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#define SR_CHUNK_SIZE  0x10000
+
+enum {
+  SR_CHUNK_ZERO,
+  SR_CHUNK_RAW,
+  SR_CHUNK_ZLIB
+};
+
+BX_CPP_INLINE Bit32u sr_adler32(const Bit8u *data, Bit32u len)
+{
+  Bit32u a = 1, b = 0;
+
+  while (len > 0) {
+    // largest n that can not overflow b
+    Bit32u n = (len < 5552) ? len : 5552;
+    len -= n;
+    while (n--) {
+      a += *data++;
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+  }
+  return (b << 16) | a;
+}
+
+BX_CPP_INLINE bx_bool sr_is_zero(const Bit8u *data, Bit32u len)
+{
+  Bit64u val;
+
+  for (; len >= 8; len -= 8, data += 8) {
+    memcpy(&val, data, 8);
+    if (val != 0) return 0;
+  }
+  while (len--) {
+    if (*data++ != 0) return 0;
+  }
+  return 1;
+}
+
+// Packs size bytes (at most SR_CHUNK_SIZE) of src. buf takes the
+// compressed data and must hold SR_CHUNK_SIZE bytes. Returns the data to
+// store (NULL for a zero chunk, src or buf) and sets the method, the
+// stored size and the checksum.
+BX_CPP_INLINE const Bit8u *sr_pack_chunk(const Bit8u *src, Bit32u size, Bit8u *buf,
+                                         Bit32u *method, Bit32u *csize, Bit32u *checksum)
+{
+  if (sr_is_zero(src, size)) {
+    *method = SR_CHUNK_ZERO;
+    *csize = 0;
+    *checksum = 0;
+    return NULL;
+  }
+  *checksum = sr_adler32(src, size);
+#if BX_HAVE_ZLIB
+  uLongf len = size - 1;
+  if (compress2(buf, &len, src, size, Z_BEST_SPEED) == Z_OK) {
+    *method = SR_CHUNK_ZLIB;
+    *csize = (Bit32u) len;
+    return buf;
+  }
+#endif
+  *method = SR_CHUNK_RAW;
+  *csize = size;
+  return src;
+}
+
+// Unpacks a chunk stored with sr_pack_chunk() to size bytes at dst.
+// Returns 0 if the stored data is invalid or does not match the checksum.
+BX_CPP_INLINE bx_bool sr_unpack_chunk(Bit32u method, const Bit8u *data, Bit32u csize,
+                                      Bit32u checksum, Bit8u *dst, Bit32u size)
+{
+  switch (method) {
+    case SR_CHUNK_ZERO:
+      if (csize != 0) return 0;
+      // reading untouched memory does not allocate it, unlike the memset
+      if (!sr_is_zero(dst, size))
+        memset(dst, 0, size);
+      return 1;
+    case SR_CHUNK_RAW:
+      if (csize != size) return 0;
+      memcpy(dst, data, size);
+      break;
+#if BX_HAVE_ZLIB
+    case SR_CHUNK_ZLIB:
+      {
+        uLongf len = size;
+        if ((uncompress(dst, &len, data, csize) != Z_OK) || (len != size))
+          return 0;
+      }
+      break;
+#endif
+    default:
+      return 0;
+  }
+  return (sr_adler32(dst, size) == checksum);
+}
+
+#endif
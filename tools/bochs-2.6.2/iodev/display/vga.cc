@@ -216,6 +216,11 @@ void bx_vga_c::register_state(void)
 {
   bx_list_c *list = new bx_list_c(SIM->get_bochs_root(), "vga", "VGA Adapter State");
   bx_vgacore_c::register_state(list);
+  // the in-memory snapshots only copy back the video memory pages written
+  if (BX_VGA_THIS s.memory_dirty == NULL)
+    BX_VGA_THIS s.memory_dirty = new Bit8u[BX_VGA_THIS s.memsize >> 12];
+  memset(BX_VGA_THIS s.memory_dirty, 0, BX_VGA_THIS s.memsize >> 12);
+  ((bx_shadow_data_c*)SIM->get_param("vgacore.memory", list))->set_dirty_map(BX_VGA_THIS s.memory_dirty);
 #if BX_SUPPORT_PCI
   if (BX_VGA_THIS pci_enabled) {
     register_pci_state(list);
@@ -894,6 +899,7 @@ bx_vga_c::vbe_mem_write(bx_phy_address addr, Bit8u value)
   if (offset < VBE_DISPI_TOTAL_VIDEO_MEMORY_BYTES)
   {
     BX_VGA_THIS s.memory[offset]=value;
+    BX_VGA_THIS mark_memory_dirty(offset);
   }
   else
   {
@@ -1220,6 +1226,9 @@ Bit32u bx_vga_c::vbe_write(Bit32u address, Bit32u value, unsigned io_len)
               BX_VGA_THIS vbe.lfb_enabled = (bx_bool)((value & VBE_DISPI_LFB_ENABLED) != 0);
               if ((value & VBE_DISPI_NOCLEARMEM) == 0) {
                 memset(BX_VGA_THIS s.memory, 0, BX_VGA_THIS vbe.visible_screen_size);
+                for (Bit32u i = 0; i < BX_VGA_THIS vbe.visible_screen_size; i += 4096) {
+                  BX_VGA_THIS mark_memory_dirty(i);
+                }
               }
               bx_gui->dimension_update(BX_VGA_THIS vbe.xres, BX_VGA_THIS vbe.yres, 0, 0, depth);
               BX_VGA_THIS s.last_bpp = depth;
@@ -89,6 +89,10 @@ bx_vgacore_c::~bx_vgacore_c()
     delete [] s.memory;
     s.memory = NULL;
   }
+  if (s.memory_dirty != NULL) {
+    delete [] s.memory_dirty;
+    s.memory_dirty = NULL;
+  }
   if (s.vga_tile_updated != NULL) {
     delete [] s.vga_tile_updated;
     s.vga_tile_updated = NULL;
@@ -1902,6 +1906,7 @@ void bx_vgacore_c::mem_write(bx_phy_address addr, Bit8u value)
 
       /* CGA 320x200x4 / 640x200x2 start */
       BX_VGA_THIS s.memory[offset] = value;
+      BX_VGA_THIS mark_memory_dirty(offset);
       offset -= start_addr;
       if (offset>=0x2000) {
         y_tileno = offset - 0x2000;
@@ -1955,6 +1960,7 @@ void bx_vgacore_c::mem_write(bx_phy_address addr, Bit8u value)
 
       // 320 x 200 256 color mode: chained pixel representation
       BX_VGA_THIS s.memory[(offset & ~0x03) + (offset % 4)*65536] = value;
+      BX_VGA_THIS mark_memory_dirty((offset & ~0x03) + (offset % 4)*65536);
       if (BX_VGA_THIS s.line_offset > 0) {
         offset -= start_addr;
         x_tileno = (offset % BX_VGA_THIS s.line_offset) / (X_TILESIZE/2);
@@ -2222,18 +2228,25 @@ void bx_vgacore_c::mem_write(bx_phy_address addr, Bit8u value)
 
   if (BX_VGA_THIS s.sequencer.map_mask & 0x0f) {
     BX_VGA_THIS s.vga_mem_updated = 1;
-    if (BX_VGA_THIS s.sequencer.map_mask & 0x01)
+    if (BX_VGA_THIS s.sequencer.map_mask & 0x01) {
       plane0[offset] = new_val[0];
-    if (BX_VGA_THIS s.sequencer.map_mask & 0x02)
+      BX_VGA_THIS mark_memory_dirty((Bit32u)(plane0 - BX_VGA_THIS s.memory) + offset);
+    }
+    if (BX_VGA_THIS s.sequencer.map_mask & 0x02) {
       plane1[offset] = new_val[1];
+      BX_VGA_THIS mark_memory_dirty((Bit32u)(plane1 - BX_VGA_THIS s.memory) + offset);
+    }
     if (BX_VGA_THIS s.sequencer.map_mask & 0x04) {
       if ((offset & 0xe000) == BX_VGA_THIS s.charmap_address) {
         bx_gui->set_text_charbyte((offset & 0x1fff), new_val[2]);
       }
       plane2[offset] = new_val[2];
+      BX_VGA_THIS mark_memory_dirty((Bit32u)(plane2 - BX_VGA_THIS s.memory) + offset);
     }
-    if (BX_VGA_THIS s.sequencer.map_mask & 0x08)
+    if (BX_VGA_THIS s.sequencer.map_mask & 0x08) {
       plane3[offset] = new_val[3];
+      BX_VGA_THIS mark_memory_dirty((Bit32u)(plane3 - BX_VGA_THIS s.memory) + offset);
+    }
 
     unsigned x_tileno, y_tileno;
 
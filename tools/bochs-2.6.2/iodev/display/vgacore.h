@@ -96,6 +96,10 @@ protected:
   Bit32u read(Bit32u address, unsigned io_len);
   void   write(Bit32u address, Bit32u value, unsigned io_len, bx_bool no_log);
 
+  void mark_memory_dirty(Bit32u offset) {
+    if (s.memory_dirty != NULL) s.memory_dirty[offset >> 12] = 1;
+  }
+
   Bit8u get_vga_pixel(Bit16u x, Bit16u y, Bit16u saddr, Bit16u lc, bx_bool bs, Bit8u **plane);
   void update(void);
   void determine_screen_dimensions(unsigned *piHeight, unsigned *piWidth);
@@ -205,6 +209,7 @@ protected:
     bx_bool  *vga_tile_updated;
     Bit8u *memory;
     Bit32u memsize;
+    Bit8u *memory_dirty; // optional map of written 4K pages
     Bit8u text_snapshot[128 * 1024]; // current text snapshot
     Bit8u tile[X_TILESIZE * Y_TILESIZE * 4]; /**< Currently allocates the tile as large as needed. */
     Bit16u charmap_address;
@@ -29,8 +29,8 @@
 #define BX_PLUGGABLE
 
 #include "iodev.h"
-#include "harddrv.h"
 #include "hdimage/hdimage.h"
+#include "harddrv.h"
 #include "hdimage/cdrom.h"
 
 #define LOG_THIS theHardDrive->
@@ -125,12 +125,15 @@ bx_hard_drive_c::bx_hard_drive_c()
   for (Bit8u channel=0; channel<BX_MAX_ATA_CHANNEL; channel++) {
     for (Bit8u device=0; device<2; device ++) {
       channels[channel].drives[device].hdimage =  NULL;
+      channels[channel].drives[device].async = 0;
+      channels[channel].drives[device].aio.busy = 0;
 #ifdef LOWLEVEL_CDROM
       channels[channel].drives[device].cdrom.cd =  NULL;
 #endif
     }
   }
   seek_timer_index = BX_NULL_TIMER_HANDLE;
+  aio_timer_index = BX_NULL_TIMER_HANDLE;
 }
 
 bx_hard_drive_c::~bx_hard_drive_c()
@@ -141,6 +144,7 @@ bx_hard_drive_c::~bx_hard_drive_c()
   for (Bit8u channel=0; channel<BX_MAX_ATA_CHANNEL; channel++) {
     for (Bit8u device=0; device<2; device ++) {
       if (channels[channel].drives[device].hdimage != NULL) {
+        aio_cancel(channel, device);
         channels[channel].drives[device].hdimage->close();
         delete channels[channel].drives[device].hdimage;
         channels[channel].drives[device].hdimage = NULL;
@@ -345,6 +349,16 @@ void bx_hard_drive_c::init(void)
             BX_INFO(("ata%d-%d: extra data outside of CHS address range", channel, device));
           }
         }
+#if BX_SUPPORT_PCI
+        if (SIM->get_param_bool("async", base)->get()) {
+          BX_HD_THIS channels[channel].drives[device].async = 1;
+          if (BX_HD_THIS aio_timer_index == BX_NULL_TIMER_HANDLE) {
+            BX_HD_THIS aio_timer_index =
+              DEV_register_timer(this, aio_timer_handler, 1, 0, 0, "HD async I/O");
+          }
+          BX_INFO(("ata%d-%d: asynchronous bus master transfers enabled", channel, device));
+        }
+#endif
       } else if (SIM->get_param_enum("type", base)->get() == BX_ATA_DEVICE_CDROM) {
         bx_list_c *cdrom_rt = (bx_list_c*)SIM->get_param(BXPN_MENU_RUNTIME_CDROM);
         cdrom_rt->add(base);
@@ -570,6 +584,10 @@ void bx_hard_drive_c::reset(unsigned type)
   for (unsigned channel=0; channel<BX_MAX_ATA_CHANNEL; channel++) {
     if (BX_HD_THIS channels[channel].irq)
       DEV_pic_lower_irq(BX_HD_THIS channels[channel].irq);
+    // a transfer still running on an image I/O thread must not complete
+    // into the reset (or restored) state
+    for (Bit8u device=0; device<2; device++)
+      aio_cancel(channel, device);
   }
 }
 
@@ -638,6 +656,27 @@ void bx_hard_drive_c::seek_timer_handler(void *this_ptr)
   class_ptr->seek_timer();
 }
 
+void bx_hard_drive_c::aio_timer_handler(void *this_ptr)
+{
+  bx_hard_drive_c *class_ptr = (bx_hard_drive_c *) this_ptr;
+  class_ptr->aio_timer();
+}
+
+// An image I/O thread finished a request, let the bus master continue
+void bx_hard_drive_c::aio_timer()
+{
+#if BX_SUPPORT_PCI
+  for (Bit8u channel=0; channel<BX_MAX_ATA_CHANNEL; channel++) {
+    for (Bit8u device=0; device<2; device++) {
+      if (BX_DRIVE(channel, device).aio.busy &&
+          hdimage_aio_done(&BX_DRIVE(channel, device).aio.req)) {
+        DEV_ide_bmdma_resume(channel);
+      }
+    }
+  }
+#endif
+}
+
 void bx_hard_drive_c::seek_timer()
 {
   for (unsigned channel=0; channel<BX_MAX_ATA_CHANNEL; channel++) {
@@ -2304,11 +2343,16 @@ void bx_hard_drive_c::write(Bit32u address, Bit32u value, unsigned io_len)
           }
           break;
 
-        // power management & flush cache stubs
-        case 0xE0: // STANDBY NOW
-        case 0xE1: // IDLE IMMEDIATE
+        // flush cache & power management stubs
         case 0xE7: // FLUSH CACHE
         case 0xEA: // FLUSH CACHE EXT
+          if (BX_SELECTED_IS_HD(channel)) {
+            aio_cancel(channel, BX_SLAVE_SELECTED(channel));
+            BX_SELECTED_DRIVE(channel).hdimage->flush();
+          }
+          // fall through
+        case 0xE0: // STANDBY NOW
+        case 0xE1: // IDLE IMMEDIATE
           controller->status.busy = 0;
           controller->status.drive_ready = 1;
           controller->status.write_fault = 0;
@@ -2353,6 +2397,7 @@ void bx_hard_drive_c::write(Bit32u address, Bit32u value, unsigned io_len)
           lba48 = 1;
         case 0xC8: // READ DMA
           if (BX_SELECTED_IS_HD(channel) && BX_HD_THIS bmdma_present()) {
+            aio_cancel(channel, BX_SLAVE_SELECTED(channel));
             lba48_transform(controller, lba48);
             controller->status.drive_ready = 1;
             controller->status.seek_complete = 1;
@@ -2368,6 +2413,7 @@ void bx_hard_drive_c::write(Bit32u address, Bit32u value, unsigned io_len)
           lba48 = 1;
         case 0xCA: // WRITE DMA
           if (BX_SELECTED_IS_HD(channel) && BX_HD_THIS bmdma_present()) {
+            aio_cancel(channel, BX_SLAVE_SELECTED(channel));
             lba48_transform(controller, lba48);
             controller->status.drive_ready = 1;
             controller->status.seek_complete = 1;
@@ -3223,11 +3269,19 @@ bx_bool bx_hard_drive_c::bmdma_present(void)
 bx_bool bx_hard_drive_c::bmdma_read_sector(Bit8u channel, Bit8u *buffer, Bit32u *sector_size)
 {
   controller_t *controller = &BX_SELECTED_CONTROLLER(channel);
+#ifdef LOWLEVEL_CDROM
+  int blocks;
+#endif
 
   if ((controller->current_command == 0xC8) ||
       (controller->current_command == 0x25)) {
-    *sector_size = 512;
-    if (!ide_read_sector(channel, buffer, 512)) {
+    // transfer all sectors needed for the requested size at once
+    *sector_size = (*sector_size + 511) & ~0x1ff;
+    if (*sector_size == 0) *sector_size = 512;
+    if (BX_SELECTED_DRIVE(channel).async) {
+      return bmdma_aio_transfer(channel, 0, buffer, sector_size);
+    }
+    if (!ide_read_sector(channel, buffer, *sector_size)) {
       return 0;
     }
   } else if (controller->current_command == 0xA0) {
@@ -3236,7 +3290,6 @@ bx_bool bx_hard_drive_c::bmdma_read_sector(Bit8u channel, Bit8u *buffer, Bit32u
         case 0x28: // read (10)
         case 0xa8: // read (12)
         case 0xbe: // read cd
-          *sector_size = controller->buffer_size;
           if (!BX_SELECTED_DRIVE(channel).cdrom.ready) {
             BX_PANIC(("Read with CDROM not ready"));
             return 0;
@@ -3244,15 +3297,25 @@ bx_bool bx_hard_drive_c::bmdma_read_sector(Bit8u channel, Bit8u *buffer, Bit32u
           /* set status bar conditions for device */
           bx_gui->statusbar_setitem(BX_SELECTED_DRIVE(channel).statusbar_id, 1);
 #ifdef LOWLEVEL_CDROM
-          if (!BX_SELECTED_DRIVE(channel).cdrom.cd->read_block(buffer, BX_SELECTED_DRIVE(channel).cdrom.next_lba,
-                                                               controller->buffer_size))
-          {
-            BX_PANIC(("CDROM: read block %d failed", BX_SELECTED_DRIVE(channel).cdrom.next_lba));
-            return 0;
+          // transfer as many of the remaining blocks as the request holds
+          blocks = (int)((*sector_size + controller->buffer_size - 1) / controller->buffer_size);
+          if (blocks > BX_SELECTED_DRIVE(channel).cdrom.remaining_blocks)
+            blocks = BX_SELECTED_DRIVE(channel).cdrom.remaining_blocks;
+          if (blocks == 0) blocks = 1;
+          *sector_size = blocks * controller->buffer_size;
+          while (blocks-- > 0) {
+            if (!BX_SELECTED_DRIVE(channel).cdrom.cd->read_block(buffer, BX_SELECTED_DRIVE(channel).cdrom.next_lba,
+                                                                 controller->buffer_size))
+            {
+              BX_PANIC(("CDROM: read block %d failed", BX_SELECTED_DRIVE(channel).cdrom.next_lba));
+              return 0;
+            }
+            BX_SELECTED_DRIVE(channel).cdrom.next_lba++;
+            BX_SELECTED_DRIVE(channel).cdrom.remaining_blocks--;
+            buffer += controller->buffer_size;
           }
-          BX_SELECTED_DRIVE(channel).cdrom.next_lba++;
-          BX_SELECTED_DRIVE(channel).cdrom.remaining_blocks--;
 #else
+          *sector_size = controller->buffer_size;
           BX_PANIC(("BM-DMA read with no LOWLEVEL_CDROM"));
 #endif
           break;
@@ -3273,7 +3336,7 @@ bx_bool bx_hard_drive_c::bmdma_read_sector(Bit8u channel, Bit8u *buffer, Bit32u
   return 1;
 }
 
-bx_bool bx_hard_drive_c::bmdma_write_sector(Bit8u channel, Bit8u *buffer)
+bx_bool bx_hard_drive_c::bmdma_write_sector(Bit8u channel, Bit8u *buffer, Bit32u *sector_size)
 {
   controller_t *controller = &BX_SELECTED_CONTROLLER(channel);
 
@@ -3283,12 +3346,87 @@ bx_bool bx_hard_drive_c::bmdma_write_sector(Bit8u channel, Bit8u *buffer)
     command_aborted (channel, controller->current_command);
     return 0;
   }
-  if (!ide_write_sector(channel, buffer, 512)) {
+  *sector_size &= ~0x1ff;
+  if (*sector_size == 0) *sector_size = 512;
+  if (BX_SELECTED_DRIVE(channel).async) {
+    return bmdma_aio_transfer(channel, 1, buffer, sector_size);
+  }
+  if (!ide_write_sector(channel, buffer, *sector_size)) {
     return 0;
   }
   return 1;
 }
 
+// Hand a bus master chunk to an image I/O thread. The thread reads or
+// writes the caller's buffer directly. While the request is in flight
+// *sector_size is returned as 0 and the bus master retries with the same
+// chunk once the thread signalled the aio timer; the task file registers
+// only advance once the data has landed, like they do for the synchronous
+// path.
+bx_bool bx_hard_drive_c::bmdma_aio_transfer(Bit8u channel, bx_bool write, Bit8u *buffer, Bit32u *sector_size)
+{
+  controller_t *controller = &BX_SELECTED_CONTROLLER(channel);
+  hdimage_aio_t *req = &BX_SELECTED_DRIVE(channel).aio.req;
+  Bit64s logical_sector = 0, last_sector;
+  Bit32u count = *sector_size / 512, i;
+
+  if (BX_SELECTED_DRIVE(channel).aio.busy && (req->buf != buffer)) {
+    // the bus master has moved on to another buffer, start over with it
+    aio_cancel(channel, BX_SLAVE_SELECTED(channel));
+  }
+  if (!BX_SELECTED_DRIVE(channel).aio.busy) {
+    if (count > BX_HD_AIO_MAX_SECTORS)
+      count = BX_HD_AIO_MAX_SECTORS;
+    // only a chunk of consecutive sectors inside the disk goes to the
+    // thread, anything else is left to the synchronous path
+    last_sector = BX_SELECTED_DRIVE(channel).hdimage->hd_size / 512;
+    if (!controller->lba_mode) {
+      Bit64s chs_sectors = (Bit64s)BX_SELECTED_DRIVE(channel).hdimage->cylinders *
+        BX_SELECTED_DRIVE(channel).hdimage->heads * BX_SELECTED_DRIVE(channel).hdimage->spt;
+      if (chs_sectors < last_sector) last_sector = chs_sectors;
+    } else if (!controller->lba48 && (last_sector > (1 << 28))) {
+      last_sector = 1 << 28;
+    }
+    if (!calculate_logical_address(channel, &logical_sector) ||
+        ((logical_sector + count) > last_sector)) {
+      *sector_size = count * 512;
+      if (write) {
+        return ide_write_sector(channel, buffer, *sector_size);
+      } else {
+        return ide_read_sector(channel, buffer, *sector_size);
+      }
+    }
+    req->image = BX_SELECTED_DRIVE(channel).hdimage;
+    req->type = write ? HDIMAGE_AIO_WRITE : HDIMAGE_AIO_READ;
+    req->offset = logical_sector * 512;
+    req->buf = buffer;
+    req->count = count * 512;
+    req->timer = BX_HD_THIS aio_timer_index;
+    /* set status bar conditions for device */
+    bx_gui->statusbar_setitem(BX_SELECTED_DRIVE(channel).statusbar_id, 1, write);
+    BX_SELECTED_DRIVE(channel).aio.busy = 1;
+    hdimage_aio_submit(req);
+  }
+  if (!hdimage_aio_done(req)) {
+    *sector_size = 0;
+    return 1;
+  }
+  BX_SELECTED_DRIVE(channel).aio.busy = 0;
+  if (req->result < (ssize_t)req->count) {
+    BX_ERROR(("could not %s() hard drive image file at byte %lu", write ? "write" : "read",
+              (unsigned long)req->offset));
+    command_aborted(channel, controller->current_command);
+    return 0;
+  }
+  count = (Bit32u)(req->count / 512);
+  for (i = 0; i < count; i++) {
+    calculate_logical_address(channel, &logical_sector);
+    increment_address(channel, &logical_sector);
+  }
+  *sector_size = (Bit32u)req->count;
+  return 1;
+}
+
 void bx_hard_drive_c::bmdma_complete(Bit8u channel)
 {
   controller_t *controller = &BX_SELECTED_CONTROLLER(channel);
@@ -3308,8 +3446,32 @@ void bx_hard_drive_c::bmdma_complete(Bit8u channel)
   }
   raise_interrupt(channel);
 }
+
+// Transfer unit of the active DMA command if the bus master may split the
+// data anywhere at multiples of it, 0 if the drive decides the chunk size
+Bit32u bx_hard_drive_c::bmdma_block_size(Bit8u channel)
+{
+  switch (BX_SELECTED_CONTROLLER(channel).current_command) {
+    case 0x25: // READ DMA EXT
+    case 0x35: // WRITE DMA EXT
+    case 0xC8: // READ DMA
+    case 0xCA: // WRITE DMA
+      return 512;
+    default:
+      return 0;
+  }
+}
 #endif
 
+// Wait for a transfer still owned by an image I/O thread and drop it
+void bx_hard_drive_c::aio_cancel(Bit8u channel, Bit8u device)
+{
+  if (BX_DRIVE(channel, device).aio.busy) {
+    hdimage_aio_wait(&BX_DRIVE(channel, device).aio.req);
+    BX_DRIVE(channel, device).aio.busy = 0;
+  }
+}
+
 void bx_hard_drive_c::set_signature(Bit8u channel, Bit8u id)
 {
   // Device signature
@@ -3330,34 +3492,39 @@ bx_bool bx_hard_drive_c::ide_read_sector(Bit8u channel, Bit8u *buffer, Bit32u bu
 {
   controller_t *controller = &BX_SELECTED_CONTROLLER(channel);
 
-  Bit64s logical_sector = 0;
-  Bit64s ret;
+  Bit64s logical_sector = 0, run_start;
+  Bit32u run_count;
+  ssize_t ret;
+  bx_bool valid;
 
   int sector_count = (buffer_size / 512);
   Bit8u *bufptr = buffer;
-  do {
-    if (!calculate_logical_address(channel, &logical_sector)) {
+  aio_cancel(channel, BX_SLAVE_SELECTED(channel));
+  /* set status bar conditions for device */
+  bx_gui->statusbar_setitem(BX_SELECTED_DRIVE(channel).statusbar_id, 1);
+  valid = calculate_logical_address(channel, &logical_sector);
+  while (sector_count > 0) {
+    if (!valid) {
       BX_ERROR(("ide_read_sector() reached invalid sector %lu, aborting", (unsigned long)logical_sector));
       command_aborted(channel, controller->current_command);
       return 0;
     }
-    ret = BX_SELECTED_DRIVE(channel).hdimage->lseek(logical_sector * 512, SEEK_SET);
-    if (ret < 0) {
-      BX_ERROR(("could not lseek() hard drive image file"));
-      command_aborted(channel, controller->current_command);
-      return 0;
-    }
-    /* set status bar conditions for device */
-    bx_gui->statusbar_setitem(BX_SELECTED_DRIVE(channel).statusbar_id, 1);
-    ret = BX_SELECTED_DRIVE(channel).hdimage->read((bx_ptr_t)bufptr, 512);
-    if (ret < 512) {
-      BX_ERROR(("could not read() hard drive image file at byte %lu", (unsigned long)logical_sector*512));
+    // sectors at consecutive addresses are read with one image access
+    run_start = logical_sector;
+    run_count = 0;
+    do {
+      increment_address(channel, &logical_sector);
+      run_count++;
+    } while ((--sector_count > 0) && (valid = calculate_logical_address(channel, &logical_sector)) &&
+             (logical_sector == (run_start + run_count)));
+    ret = BX_SELECTED_DRIVE(channel).hdimage->pread(run_start * 512, bufptr, run_count * 512);
+    if (ret < (ssize_t)(run_count * 512)) {
+      BX_ERROR(("could not read() hard drive image file at byte %lu", (unsigned long)run_start*512));
       command_aborted(channel, controller->current_command);
       return 0;
     }
-    increment_address(channel, &logical_sector);
-    bufptr += 512;
-  } while (--sector_count > 0);
+    bufptr += run_count * 512;
+  }
 
   return 1;
 }
@@ -3366,34 +3533,39 @@ bx_bool bx_hard_drive_c::ide_write_sector(Bit8u channel, Bit8u *buffer, Bit32u b
 {
   controller_t *controller = &BX_SELECTED_CONTROLLER(channel);
 
-  Bit64s logical_sector = 0;
-  Bit64s ret;
+  Bit64s logical_sector = 0, run_start;
+  Bit32u run_count;
+  ssize_t ret;
+  bx_bool valid;
 
   int sector_count = (buffer_size / 512);
   Bit8u *bufptr = buffer;
-  do {
-    if (!calculate_logical_address(channel, &logical_sector)) {
+  aio_cancel(channel, BX_SLAVE_SELECTED(channel));
+  /* set status bar conditions for device */
+  bx_gui->statusbar_setitem(BX_SELECTED_DRIVE(channel).statusbar_id, 1, 1 /* write */);
+  valid = calculate_logical_address(channel, &logical_sector);
+  while (sector_count > 0) {
+    if (!valid) {
       BX_ERROR(("ide_write_sector() reached invalid sector %lu, aborting", (unsigned long)logical_sector));
       command_aborted(channel, controller->current_command);
       return 0;
     }
-    ret = BX_SELECTED_DRIVE(channel).hdimage->lseek(logical_sector * 512, SEEK_SET);
-    if (ret < 0) {
-      BX_ERROR(("could not lseek() hard drive image file at byte %lu", (unsigned long)logical_sector * 512));
+    // sectors at consecutive addresses are written with one image access
+    run_start = logical_sector;
+    run_count = 0;
+    do {
+      increment_address(channel, &logical_sector);
+      run_count++;
+    } while ((--sector_count > 0) && (valid = calculate_logical_address(channel, &logical_sector)) &&
+             (logical_sector == (run_start + run_count)));
+    ret = BX_SELECTED_DRIVE(channel).hdimage->pwrite(run_start * 512, bufptr, run_count * 512);
+    if (ret < (ssize_t)(run_count * 512)) {
+      BX_ERROR(("could not write() hard drive image file at byte %lu", (unsigned long)run_start*512));
       command_aborted(channel, controller->current_command);
       return 0;
     }
-    /* set status bar conditions for device */
-    bx_gui->statusbar_setitem(BX_SELECTED_DRIVE(channel).statusbar_id, 1, 1 /* write */);
-    ret = BX_SELECTED_DRIVE(channel).hdimage->write((bx_ptr_t)bufptr, 512);
-    if (ret < 512) {
-      BX_ERROR(("could not write() hard drive image file at byte %lu", (unsigned long)logical_sector*512));
-      command_aborted(channel, controller->current_command);
-      return 0;
-    }
-    increment_address(channel, &logical_sector);
-    bufptr += 512;
-  } while (--sector_count > 0);
+    bufptr += run_count * 512;
+  }
 
   return 1;
 }
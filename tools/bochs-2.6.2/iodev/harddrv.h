@@ -22,6 +22,8 @@
 #define BX_IODEV_HDDRIVE_H
 
 #define MAX_MULTIPLE_SECTORS 16
+// largest bus master chunk handed to an I/O thread at once
+#define BX_HD_AIO_MAX_SECTORS 128
 
 typedef enum _sense {
       SENSE_NONE = 0, SENSE_NOT_READY = 2, SENSE_ILLEGAL_REQUEST = 5,
@@ -175,8 +177,9 @@ public:
   virtual bx_bool  set_cd_media_status(Bit32u handle, bx_bool status);
 #if BX_SUPPORT_PCI
   virtual bx_bool  bmdma_read_sector(Bit8u channel, Bit8u *buffer, Bit32u *sector_size);
-  virtual bx_bool  bmdma_write_sector(Bit8u channel, Bit8u *buffer);
+  virtual bx_bool  bmdma_write_sector(Bit8u channel, Bit8u *buffer, Bit32u *sector_size);
   virtual void     bmdma_complete(Bit8u channel);
+  virtual Bit32u   bmdma_block_size(Bit8u channel);
 #endif
   virtual void     register_state(void);
 
@@ -199,6 +202,8 @@ public:
 
   static void seek_timer_handler(void *);
   BX_HD_SMF void seek_timer(void);
+  static void aio_timer_handler(void *);
+  BX_HD_SMF void aio_timer(void);
 
   static void runtime_config_handler(void *);
   void runtime_config(void);
@@ -221,6 +226,10 @@ private:
   BX_HD_SMF void set_signature(Bit8u channel, Bit8u id);
   BX_HD_SMF bx_bool ide_read_sector(Bit8u channel, Bit8u *buffer, Bit32u buffer_size);
   BX_HD_SMF bx_bool ide_write_sector(Bit8u channel, Bit8u *buffer, Bit32u buffer_size);
+#if BX_SUPPORT_PCI
+  BX_HD_SMF bx_bool bmdma_aio_transfer(Bit8u channel, bx_bool write, Bit8u *buffer, Bit32u *sector_size);
+#endif
+  BX_HD_SMF void aio_cancel(Bit8u channel, Bit8u device);
   BX_HD_SMF void lba48_transform(controller_t *controller, bx_bool lba48);
 
   static Bit64s cdrom_status_handler(bx_param_c *param, int set, Bit64s val);
@@ -250,6 +259,13 @@ private:
       int statusbar_id;
       Bit8u device_num; // for ATAPI identify & inquiry
       bx_bool status_changed;
+
+      // bus master transfers run on the image I/O threads
+      bx_bool async;
+      struct {
+        hdimage_aio_t req;
+        bx_bool busy;
+      } aio;
     } drives[2];
     unsigned drive_select;
 
@@ -260,6 +276,7 @@ private:
   } channels[BX_MAX_ATA_CHANNEL];
 
   int seek_timer_index;
+  int aio_timer_index;
   Bit8u cdrom_count;
   bx_bool pci_enabled;
 };
@@ -31,6 +31,8 @@
 #include "vmware4.h"
 #include "vvfat.h"
 #include "vpc-img.h"
+#include "qcow2.h"
+#include "bxthread.h"
 
 #if BX_HAVE_SYS_MMAN_H
 #include <sys/mman.h>
@@ -57,6 +59,7 @@ int libhdimage_LTX_plugin_init(plugin_t *plugin, plugintype_t type, int argc, ch
 
 void libhdimage_LTX_plugin_fini(void)
 {
+  hdimage_aio_stop();
   delete theHDImageCtl;
 }
 
@@ -124,6 +127,10 @@ device_image_t* bx_hdimage_ctl_c::init_image(Bit8u image_mode, Bit64u disk_size,
       hdimage = new vpc_image_t();
       break;
 
+    case BX_HDIMAGE_MODE_QCOW2:
+      hdimage = new qcow2_image_t();
+      break;
+
     default:
       BX_PANIC(("unsupported HD mode : '%s'", hdimage_mode_names[image_mode]));
       break;
@@ -139,20 +146,188 @@ LOWLEVEL_CDROM* bx_hdimage_ctl_c::init_cdrom(const char *dev)
 #endif
 
 // helper functions
+// The file position is undefined after these calls
 int bx_read_image(int fd, Bit64s offset, void *buf, int count)
 {
+#if BX_HAVE_PREAD
+  return ::pread(fd, buf, count, (off_t)offset);
+#else
   if (lseek(fd, offset, SEEK_SET) == -1) {
     return -1;
   }
   return read(fd, buf, count);
+#endif
 }
 
 int bx_write_image(int fd, Bit64s offset, void *buf, int count)
 {
+#if BX_HAVE_PREAD
+  return ::pwrite(fd, buf, count, (off_t)offset);
+#else
   if (lseek(fd, offset, SEEK_SET) == -1) {
     return -1;
   }
   return write(fd, buf, count);
+#endif
+}
+
+// asynchronous requests
+
+#if BX_HAVE_THREADS
+static struct {
+  BX_MUTEX(lock);
+  BX_COND(done);                // broadcast when a request has finished
+  bx_thread_sem_t pending;      // one count per queued request
+  hdimage_aio_t *head, *tail;
+  Bit32u inflight;
+  BX_THREAD_ID(thread[HDIMAGE_AIO_THREADS]);
+} hdimage_aio;
+
+// number of I/O threads running, -1 if not started yet
+static int hdimage_aio_threads = -1;
+
+static BX_THREAD_FUNC(hdimage_aio_worker, arg)
+{
+  hdimage_aio_t *req;
+  int timer;
+
+  while (1) {
+    bx_wait_sem(&hdimage_aio.pending);
+    BX_LOCK(hdimage_aio.lock);
+    req = hdimage_aio.head;
+    if (req == NULL) {
+      // woken up by hdimage_aio_stop()
+      BX_UNLOCK(hdimage_aio.lock);
+      break;
+    }
+    hdimage_aio.head = req->next;
+    if (hdimage_aio.head == NULL) hdimage_aio.tail = NULL;
+    BX_UNLOCK(hdimage_aio.lock);
+
+    if (req->type == HDIMAGE_AIO_WRITE) {
+      req->result = req->image->pwrite(req->offset, req->buf, req->count);
+    } else {
+      req->result = req->image->pread(req->offset, req->buf, req->count);
+    }
+
+    // the request could be reused once done is set
+    timer = req->timer;
+    BX_LOCK(hdimage_aio.lock);
+    req->done = 1;
+    hdimage_aio.inflight--;
+    BX_BROADCAST_COND(hdimage_aio.done);
+    BX_UNLOCK(hdimage_aio.lock);
+    if (timer != BX_NULL_TIMER_HANDLE)
+      bx_pc_system.signal_timer(timer);
+  }
+  BX_THREAD_EXIT;
+}
+
+static void hdimage_aio_start(void)
+{
+  hdimage_aio_threads = 0;
+  BX_INIT_MUTEX(hdimage_aio.lock);
+  BX_INIT_COND(hdimage_aio.done);
+  if (!bx_create_sem(&hdimage_aio.pending))
+    return;
+  hdimage_aio.head = hdimage_aio.tail = NULL;
+  hdimage_aio.inflight = 0;
+  for (int i = 0; i < HDIMAGE_AIO_THREADS; i++) {
+    if (BX_THREAD_CREATE(hdimage_aio_worker, NULL, hdimage_aio.thread[hdimage_aio_threads]) == 0)
+      hdimage_aio_threads++;
+  }
+  if (hdimage_aio_threads == 0) {
+    BX_ERROR(("hdimage: could not start I/O threads, using synchronous access"));
+    bx_destroy_sem(&hdimage_aio.pending);
+    return;
+  }
+  BX_INFO(("hdimage: %d I/O threads started", hdimage_aio_threads));
+}
+
+// Stop and join the I/O threads, all requests must be done
+void hdimage_aio_stop(void)
+{
+  int i;
+
+  if (hdimage_aio_threads <= 0) return;
+  hdimage_aio_flush();
+  for (i = 0; i < hdimage_aio_threads; i++)
+    bx_set_sem(&hdimage_aio.pending);
+  for (i = 0; i < hdimage_aio_threads; i++)
+    bx_thread_join(hdimage_aio.thread[i]);
+  bx_destroy_sem(&hdimage_aio.pending);
+  BX_FINI_COND(hdimage_aio.done);
+  BX_FINI_MUTEX(hdimage_aio.lock);
+  hdimage_aio_threads = -1;
+}
+#else
+void hdimage_aio_stop(void) {}
+#endif
+
+void hdimage_aio_submit(hdimage_aio_t *req)
+{
+  req->done = 0;
+  req->next = NULL;
+#if BX_HAVE_THREADS
+  if (hdimage_aio_threads < 0) hdimage_aio_start();
+  if (hdimage_aio_threads > 0) {
+    BX_LOCK(hdimage_aio.lock);
+    if (hdimage_aio.tail != NULL) {
+      hdimage_aio.tail->next = req;
+    } else {
+      hdimage_aio.head = req;
+    }
+    hdimage_aio.tail = req;
+    hdimage_aio.inflight++;
+    BX_UNLOCK(hdimage_aio.lock);
+    bx_set_sem(&hdimage_aio.pending);
+    return;
+  }
+#endif
+  // no I/O threads, serve the request right now
+  if (req->type == HDIMAGE_AIO_WRITE) {
+    req->result = req->image->pwrite(req->offset, req->buf, req->count);
+  } else {
+    req->result = req->image->pread(req->offset, req->buf, req->count);
+  }
+  req->done = 1;
+}
+
+bx_bool hdimage_aio_done(hdimage_aio_t *req)
+{
+#if BX_HAVE_THREADS
+  if (hdimage_aio_threads > 0) {
+    BX_LOCK(hdimage_aio.lock);
+    bx_bool done = req->done;
+    BX_UNLOCK(hdimage_aio.lock);
+    return done;
+  }
+#endif
+  return req->done;
+}
+
+void hdimage_aio_wait(hdimage_aio_t *req)
+{
+#if BX_HAVE_THREADS
+  if (hdimage_aio_threads > 0) {
+    BX_LOCK(hdimage_aio.lock);
+    while (!req->done)
+      BX_WAIT_COND(hdimage_aio.done, hdimage_aio.lock);
+    BX_UNLOCK(hdimage_aio.lock);
+  }
+#endif
+}
+
+void hdimage_aio_flush(void)
+{
+#if BX_HAVE_THREADS
+  if (hdimage_aio_threads > 0) {
+    BX_LOCK(hdimage_aio.lock);
+    while (hdimage_aio.inflight != 0)
+      BX_WAIT_COND(hdimage_aio.done, hdimage_aio.lock);
+    BX_UNLOCK(hdimage_aio.lock);
+  }
+#endif
 }
 
 #ifndef WIN32
@@ -234,6 +409,8 @@ int hdimage_detect_image_mode(const char *pathname)
     result = BX_HDIMAGE_MODE_VMWARE4;
   } else if (growing_image_t::check_format(fd, image_size) == HDIMAGE_FORMAT_OK) {
     result = BX_HDIMAGE_MODE_GROWING;
+  } else if (qcow2_image_t::check_format(fd, image_size) == HDIMAGE_FORMAT_OK) {
+    result = BX_HDIMAGE_MODE_QCOW2;
   } else if (vpc_image_t::check_format(fd, image_size) >= HDIMAGE_FORMAT_OK) {
     result = BX_HDIMAGE_MODE_VPC;
   } else if (default_image_t::check_format(fd, image_size) == HDIMAGE_FORMAT_OK) {
@@ -258,6 +435,8 @@ Bit64s hdimage_save_handler(void *class_ptr, bx_param_c *param)
     return 0;
   }
   sprintf(path, "%s/%s", SIM->get_param_string(BXPN_RESTORE_PATH)->getptr(), imgname);
+  // writes still owned by the I/O threads must be in the saved image
+  hdimage_aio_flush();
   return ((device_image_t*)class_ptr)->save_state(path);
 }
 
@@ -384,6 +563,34 @@ Bit32u device_image_t::get_capabilities()
   return (cylinders == 0) ? HDIMAGE_AUTO_GEOMETRY : 0;
 }
 
+ssize_t device_image_t::pread(Bit64s offset, void* buf, size_t count)
+{
+  size_t n = 0;
+  ssize_t ret;
+
+  while (n < count) {
+    if (lseek(offset + n, SEEK_SET) < 0) return -1;
+    ret = read((Bit8u*)buf + n, 512);
+    if (ret < 512) return (ret < 0) ? ret : (ssize_t)(n + ret);
+    n += 512;
+  }
+  return count;
+}
+
+ssize_t device_image_t::pwrite(Bit64s offset, const void* buf, size_t count)
+{
+  size_t n = 0;
+  ssize_t ret;
+
+  while (n < count) {
+    if (lseek(offset + n, SEEK_SET) < 0) return -1;
+    ret = write((const Bit8u*)buf + n, 512);
+    if (ret < 512) return (ret < 0) ? ret : (ssize_t)(n + ret);
+    n += 512;
+  }
+  return count;
+}
+
 Bit32u device_image_t::get_timestamp()
 {
   return (fat_datetime(mtime, 1) | (fat_datetime(mtime, 0) << 16));
@@ -431,6 +638,24 @@ ssize_t default_image_t::write(const void* buf, size_t count)
   return ::write(fd, (char*) buf, count);
 }
 
+ssize_t default_image_t::pread(Bit64s offset, void* buf, size_t count)
+{
+#if BX_HAVE_PREAD
+  return ::pread(fd, (char*) buf, count, (off_t)offset);
+#else
+  return bx_read_image(fd, offset, buf, (int)count);
+#endif
+}
+
+ssize_t default_image_t::pwrite(Bit64s offset, const void* buf, size_t count)
+{
+#if BX_HAVE_PREAD
+  return ::pwrite(fd, (char*) buf, count, (off_t)offset);
+#else
+  return bx_write_image(fd, offset, (void*)buf, (int)count);
+#endif
+}
+
 int default_image_t::check_format(int fd, Bit64u imgsize)
 {
   char buffer[512];
@@ -743,7 +968,7 @@ int sparse_image_t::read_header()
       panic("could not allocate memory for sparse disk block table");
     }
 
-    ret = ::read(fd, pagetable, sizeof(Bit32u) * numpages);
+    ret = bx_read_image(fd, sizeof(header), pagetable, sizeof(Bit32u) * numpages);
 
     if (ret < 0) {
       panic(strerror(errno));
@@ -967,6 +1192,12 @@ ssize_t sparse_image_t::read(void* buf, size_t count)
   return total_read;
 }
 
+ssize_t sparse_image_t::pread(Bit64s offset, void* buf, size_t count)
+{
+  if (lseek(offset, SEEK_SET) < 0) return -1;
+  return read(buf, count);
+}
+
 void sparse_image_t::panic(const char * message)
 {
   char buffer[1024];
@@ -1154,6 +1385,12 @@ ssize_t sparse_image_t::write(const void* buf, size_t count)
   return total_written;
 }
 
+ssize_t sparse_image_t::pwrite(Bit64s offset, const void* buf, size_t count)
+{
+  if (lseek(offset, SEEK_SET) < 0) return -1;
+  return write(buf, count);
+}
+
 int sparse_image_t::check_format(int fd, Bit64u imgsize)
 {
   sparse_header_t temp_header;
@@ -1308,9 +1545,12 @@ redolog_t::redolog_t()
   fd = -1;
   catalog = NULL;
   bitmap = NULL;
+  bitmap_dirty = NULL;
+  dirty = 0;
   extent_index = (Bit32u)0;
   extent_offset = (Bit32u)0;
   extent_next = (Bit32u)0;
+  extent_avail = (Bit32u)0;
 }
 
 void redolog_t::print_header()
@@ -1375,13 +1615,19 @@ int redolog_t::make_header(const char* type, Bit64u size)
   print_header();
 
   catalog = (Bit32u*)malloc(dtoh32(header.specific.catalog) * sizeof(Bit32u));
-  bitmap = (Bit8u*)malloc(dtoh32(header.specific.bitmap));
+  bitmap = (Bit8u**)calloc(dtoh32(header.specific.catalog), sizeof(Bit8u*));
+  bitmap_dirty = (Bit8u*)calloc(dtoh32(header.specific.catalog), 1);
 
-  if ((catalog == NULL) || (bitmap==NULL))
+  if ((catalog == NULL) || (bitmap == NULL) || (bitmap_dirty == NULL))
     BX_PANIC(("redolog : could not malloc catalog or bitmap"));
 
   for (Bit32u i=0; i<dtoh32(header.specific.catalog); i++)
     catalog[i] = htod32(REDOLOG_PAGE_NOT_ALLOCATED);
+  catalog_dirty_first = dtoh32(header.specific.catalog);
+  catalog_dirty_last = 0;
+  dirty = 0;
+  extent_next = 0;
+  extent_avail = 0;
 
   bitmap_blocks = 1 + (dtoh32(header.specific.bitmap) - 1) / 512;
   extent_blocks = 1 + (dtoh32(header.specific.extent) - 1) / 512;
@@ -1508,8 +1754,16 @@ int redolog_t::open(const char* filename, const char *type, int flags)
   }
   BX_INFO(("redolog : next extent will be at index %d",extent_next));
 
-  // memory used for storing bitmaps
-  bitmap = (Bit8u *)malloc(dtoh32(header.specific.bitmap));
+  // bitmaps are loaded when the extent is accessed first
+  bitmap = (Bit8u**)calloc(dtoh32(header.specific.catalog), sizeof(Bit8u*));
+  bitmap_dirty = (Bit8u*)calloc(dtoh32(header.specific.catalog), 1);
+  if ((bitmap == NULL) || (bitmap_dirty == NULL)) {
+    BX_PANIC(("redolog : could not malloc bitmap"));
+    return -1;
+  }
+  catalog_dirty_first = dtoh32(header.specific.catalog);
+  catalog_dirty_last = 0;
+  dirty = 0;
 
   bitmap_blocks = 1 + (dtoh32(header.specific.bitmap) - 1) / 512;
   extent_blocks = 1 + (dtoh32(header.specific.extent) - 1) / 512;
@@ -1517,22 +1771,46 @@ int redolog_t::open(const char* filename, const char *type, int flags)
   BX_DEBUG(("redolog : each bitmap is %d blocks", bitmap_blocks));
   BX_DEBUG(("redolog : each extent is %d blocks", extent_blocks));
 
+  // extents preallocated in an earlier session can be reused
+  Bit64u data_start = STANDARD_HEADER_SIZE + dtoh32(header.specific.catalog) * sizeof(Bit32u);
+  extent_avail = 0;
+  if (imgsize > data_start) {
+    extent_avail = (Bit32u)((imgsize - data_start) / (512 * (bitmap_blocks + extent_blocks)));
+  }
+  if (extent_avail < extent_next)
+    extent_avail = extent_next;
+
   imagepos = 0;
-  bitmap_update = 1;
 
   return 0;
 }
 
 void redolog_t::close()
 {
-  if (fd >= 0)
+  if (fd >= 0) {
+    flush();
     ::close(fd);
+    fd = -1;
+  }
 
-  if (catalog != NULL)
-    free(catalog);
-
-  if (bitmap != NULL)
+  if (bitmap != NULL) {
+    for (Bit32u i=0; i<dtoh32(header.specific.catalog); i++) {
+      if (bitmap[i] != NULL)
+        free(bitmap[i]);
+    }
     free(bitmap);
+    bitmap = NULL;
+  }
+
+  if (bitmap_dirty != NULL) {
+    free(bitmap_dirty);
+    bitmap_dirty = NULL;
+  }
+
+  if (catalog != NULL) {
+    free(catalog);
+    catalog = NULL;
+  }
 }
 
 Bit64u redolog_t::get_size()
@@ -1572,11 +1850,7 @@ Bit64s redolog_t::lseek(Bit64s offset, int whence)
     return -1;
   }
 
-  Bit32u old_extent_index = extent_index;
   extent_index = (Bit32u)(imagepos / dtoh32(header.specific.extent));
-  if (extent_index != old_extent_index) {
-    bitmap_update = 1;
-  }
   extent_offset = (Bit32u)((imagepos % dtoh32(header.specific.extent)) / 512);
 
   BX_DEBUG(("redolog : lseeking extent index %d, offset %d",extent_index, extent_offset));
@@ -1586,7 +1860,7 @@ Bit64s redolog_t::lseek(Bit64s offset, int whence)
 
 ssize_t redolog_t::read(void* buf, size_t count)
 {
-  Bit64s block_offset, bitmap_offset;
+  bx_bool present;
   ssize_t ret;
 
   if (count != 512) {
@@ -1594,126 +1868,257 @@ ssize_t redolog_t::read(void* buf, size_t count)
     return -1;
   }
 
+  ret = read_run(imagepos, buf, count, &present);
+  if ((ret > 0) && !present) {
+    BX_DEBUG(("read not in redolog"));
+    return 0;
+  }
+  return ret;
+}
+
+ssize_t redolog_t::write(const void* buf, size_t count)
+{
+  if (count != 512) {
+    BX_PANIC(("redolog : write() with count not 512"));
+    return -1;
+  }
+
+  return write_run(imagepos, buf, count);
+}
+
+Bit64s redolog_t::get_bitmap_offset(Bit32u index)
+{
+  Bit64s offset = (Bit64s)STANDARD_HEADER_SIZE + (dtoh32(header.specific.catalog) * sizeof(Bit32u));
+  return offset + (Bit64s)512 * dtoh32(catalog[index]) * (extent_blocks + bitmap_blocks);
+}
+
+// Return the in-memory bitmap of an allocated extent, reading it from
+// the file on first use.
+Bit8u *redolog_t::get_bitmap(Bit32u index)
+{
+  Bit32u size = dtoh32(header.specific.bitmap);
+
+  if (bitmap[index] == NULL) {
+    bitmap[index] = (Bit8u*)malloc(size);
+    if (bitmap[index] == NULL) {
+      BX_PANIC(("redolog : could not malloc bitmap"));
+      return NULL;
+    }
+    if (bx_read_image(fd, (off_t)get_bitmap_offset(index), bitmap[index], size) != (ssize_t)size) {
+      BX_PANIC(("redolog : failed to read bitmap for extent %d", index));
+      free(bitmap[index]);
+      bitmap[index] = NULL;
+      return NULL;
+    }
+  }
+  return bitmap[index];
+}
+
+// Map the next free extent of the file to the image extent index. The
+// file is grown by a run of zeroed extents when no preallocated one is
+// left. The new bitmap and catalog entry only exist in memory until the
+// next flush().
+int redolog_t::alloc_extent(Bit32u index)
+{
+  Bit32u entries = dtoh32(header.specific.catalog);
+
+  if (extent_next >= entries) {
+    BX_PANIC(("redolog : can't allocate new extent... catalog is full"));
+    return -1;
+  }
+
+  if (extent_next >= extent_avail) {
+    Bit32u extent_size = 512 * (bitmap_blocks + extent_blocks);
+    Bit32u count = REDOLOG_PREALLOC_SIZE / extent_size;
+    if (count == 0) count = 1;
+    if (count > (entries - extent_avail)) count = entries - extent_avail;
+
+    Bit64s offset = (Bit64s)STANDARD_HEADER_SIZE + (entries * sizeof(Bit32u));
+    offset += (Bit64s)extent_size * extent_avail;
+    Bit64u total = (Bit64u)extent_size * count;
+    size_t chunk = (total < REDOLOG_PREALLOC_SIZE) ? (size_t)total : REDOLOG_PREALLOC_SIZE;
+
+    BX_DEBUG(("redolog : preallocating %d extents at %d", count, extent_avail));
+
+    Bit8u *zerobuffer = (Bit8u*)calloc(1, chunk);
+    if (zerobuffer == NULL) {
+      BX_PANIC(("redolog : could not malloc extent buffer"));
+      return -1;
+    }
+    for (Bit64u n = 0; n < total; n += chunk) {
+      size_t len = ((total - n) < chunk) ? (size_t)(total - n) : chunk;
+      if (bx_write_image(fd, (off_t)(offset + n), zerobuffer, len) != (ssize_t)len) {
+        BX_PANIC(("redolog : failed to allocate new extent"));
+        free(zerobuffer);
+        return -1;
+      }
+    }
+    free(zerobuffer);
+    extent_avail += count;
+  }
+
+  BX_DEBUG(("redolog : allocating new extent at %d", extent_next));
+
+  catalog[index] = htod32(extent_next);
+  extent_next += 1;
+  if (index < catalog_dirty_first) catalog_dirty_first = index;
+  if (index > catalog_dirty_last) catalog_dirty_last = index;
+
+  // a preallocated extent may hold a stale bitmap on disk
+  if (bitmap[index] == NULL) {
+    bitmap[index] = (Bit8u*)malloc(dtoh32(header.specific.bitmap));
+    if (bitmap[index] == NULL) {
+      BX_PANIC(("redolog : could not malloc bitmap"));
+      return -1;
+    }
+  }
+  memset(bitmap[index], 0, dtoh32(header.specific.bitmap));
+  bitmap_dirty[index] = 1;
+  dirty = 1;
+
+  return 0;
+}
+
+// Handle the run of blocks starting at offset that are either all
+// present in the redolog or all missing from it. The run ends at the
+// end of the extent or after count bytes. Present blocks are contiguous
+// in the redolog file and are read with a single host access, missing
+// ones are left for the caller to fill. Returns the length of the run.
+ssize_t redolog_t::read_run(Bit64s offset, void* buf, size_t count, bx_bool *present)
+{
+  Bit64s block_offset;
+  Bit32u i, blocks;
+  Bit8u *bmap;
+  ssize_t ret;
+
+  if (lseek(offset, SEEK_SET) < 0) {
+    return -1;
+  }
+
+  blocks = (Bit32u)(count / 512);
+  if (blocks > (extent_blocks - extent_offset))
+    blocks = extent_blocks - extent_offset;
+
   BX_DEBUG(("redolog : reading index %d, mapping to %d", extent_index, dtoh32(catalog[extent_index])));
 
   if (dtoh32(catalog[extent_index]) == REDOLOG_PAGE_NOT_ALLOCATED) {
     // page not allocated
-    return 0;
+    *present = 0;
+    lseek(512 * blocks, SEEK_CUR);
+    return 512 * blocks;
   }
 
-  bitmap_offset  = (Bit64s)STANDARD_HEADER_SIZE + (dtoh32(header.specific.catalog) * sizeof(Bit32u));
-  bitmap_offset += (Bit64s)512 * dtoh32(catalog[extent_index]) * (extent_blocks + bitmap_blocks);
-  block_offset    = bitmap_offset + ((Bit64s)512 * (bitmap_blocks + extent_offset));
+  block_offset = get_bitmap_offset(extent_index) + ((Bit64s)512 * (bitmap_blocks + extent_offset));
 
-  BX_DEBUG(("redolog : bitmap offset is %x", (Bit32u)bitmap_offset));
   BX_DEBUG(("redolog : block offset is %x", (Bit32u)block_offset));
 
-  if (bitmap_update) {
-    if (bx_read_image(fd, (off_t)bitmap_offset, bitmap,  dtoh32(header.specific.bitmap)) != (ssize_t)dtoh32(header.specific.bitmap)) {
-      BX_PANIC(("redolog : failed to read bitmap for extent %d", extent_index));
-      return -1;
-    }
-    bitmap_update = 0;
+  bmap = get_bitmap(extent_index);
+  if (bmap == NULL) {
+    return -1;
   }
 
-  if (((bitmap[extent_offset/8] >> (extent_offset%8)) & 0x01) == 0x00) {
-    BX_DEBUG(("read not in redolog"));
-
-    // bitmap says block not in redolog
-    return 0;
+  *present = (bmap[extent_offset/8] >> (extent_offset%8)) & 0x01;
+  for (i = 1; i < blocks; i++) {
+    Bit32u block = extent_offset + i;
+    if (((bmap[block/8] >> (block%8)) & 0x01) != *present) break;
   }
+  blocks = i;
 
-  ret = bx_read_image(fd, (off_t)block_offset, buf, count);
-  if (ret >= 0) lseek(512, SEEK_CUR);
+  if (*present) {
+    ret = bx_read_image(fd, (off_t)block_offset, buf, 512 * blocks);
+    if (ret < (ssize_t)(512 * blocks)) return -1;
+  }
+  lseek(512 * blocks, SEEK_CUR);
 
-  return ret;
+  return 512 * blocks;
 }
 
-ssize_t redolog_t::write(const void* buf, size_t count)
+// Write up to count bytes at offset, stopping at the end of the extent.
+// The data goes out with a single host access. The bitmap and catalog
+// are only updated in memory and written by the next flush(). Returns
+// the number of bytes written.
+ssize_t redolog_t::write_run(Bit64s offset, const void* buf, size_t count)
 {
-  Bit32u i;
-  Bit64s block_offset, bitmap_offset, catalog_offset;
+  Bit32u i, blocks;
+  Bit64s block_offset;
+  Bit8u *bmap;
   ssize_t written;
-  bx_bool update_catalog = 0;
 
-  if (count != 512) {
-    BX_PANIC(("redolog : write() with count not 512"));
+  if (lseek(offset, SEEK_SET) < 0) {
     return -1;
   }
 
+  blocks = (Bit32u)(count / 512);
+  if (blocks > (extent_blocks - extent_offset))
+    blocks = extent_blocks - extent_offset;
+
   BX_DEBUG(("redolog : writing index %d, mapping to %d", extent_index, dtoh32(catalog[extent_index])));
 
   if (dtoh32(catalog[extent_index]) == REDOLOG_PAGE_NOT_ALLOCATED) {
-    if (extent_next >= dtoh32(header.specific.catalog)) {
-      BX_PANIC(("redolog : can't allocate new extent... catalog is full"));
+    if (alloc_extent(extent_index) < 0) {
       return -1;
     }
+  }
 
-    BX_DEBUG(("redolog : allocating new extent at %d", extent_next));
+  block_offset = get_bitmap_offset(extent_index) + ((Bit64s)512 * (bitmap_blocks + extent_offset));
 
-    // Extent not allocated, allocate new
-    catalog[extent_index] = htod32(extent_next);
+  BX_DEBUG(("redolog : block offset is %x", (Bit32u)block_offset));
 
-    extent_next += 1;
+  bmap = get_bitmap(extent_index);
+  if (bmap == NULL) {
+    return -1;
+  }
 
-    char *zerobuffer = (char*)malloc(512);
-    memset(zerobuffer, 0, 512);
+  // Write blocks
+  written = bx_write_image(fd, (off_t)block_offset, (void*)buf, 512 * blocks);
+  if (written < (ssize_t)(512 * blocks)) {
+    return -1;
+  }
 
-    // Write bitmap
-    bitmap_offset  = (Bit64s)STANDARD_HEADER_SIZE + (dtoh32(header.specific.catalog) * sizeof(Bit32u));
-    bitmap_offset += (Bit64s)512 * dtoh32(catalog[extent_index]) * (extent_blocks + bitmap_blocks);
-    ::lseek(fd, (off_t)bitmap_offset, SEEK_SET);
-    for (i=0; i<bitmap_blocks; i++) {
-      ::write(fd, zerobuffer, 512);
-    }
-    // Write extent
-    for (i=0; i<extent_blocks; i++) {
-      ::write(fd, zerobuffer, 512);
+  // If blocks do not belong to extent yet
+  for (i = extent_offset; i < (extent_offset + blocks); i++) {
+    if (((bmap[i/8] >> (i%8)) & 0x01) == 0x00) {
+      bmap[i/8] |= 1 << (i%8);
+      bitmap_dirty[extent_index] = 1;
+      dirty = 1;
     }
-
-    free(zerobuffer);
-
-    update_catalog = 1;
   }
 
-  bitmap_offset  = (Bit64s)STANDARD_HEADER_SIZE + (dtoh32(header.specific.catalog) * sizeof(Bit32u));
-  bitmap_offset += (Bit64s)512 * dtoh32(catalog[extent_index]) * (extent_blocks + bitmap_blocks);
-  block_offset    = bitmap_offset + ((Bit64s)512 * (bitmap_blocks + extent_offset));
+  lseek(512 * blocks, SEEK_CUR);
 
-  BX_DEBUG(("redolog : bitmap offset is %x", (Bit32u)bitmap_offset));
-  BX_DEBUG(("redolog : block offset is %x", (Bit32u)block_offset));
+  return written;
+}
 
-  // Write block
-  written = bx_write_image(fd, (off_t)block_offset, (void*)buf, count);
+// The bitmaps go out before the catalog, so that the catalog never maps
+// an extent whose bitmap has not been written yet.
+void redolog_t::flush()
+{
+  Bit32u i, size = dtoh32(header.specific.bitmap);
+  Bit64s catalog_offset;
 
-  // Write bitmap
-  if (bitmap_update) {
-    if (bx_read_image(fd, (off_t)bitmap_offset, bitmap,  dtoh32(header.specific.bitmap)) != (ssize_t)dtoh32(header.specific.bitmap)) {
-      BX_PANIC(("redolog : failed to read bitmap for extent %d", extent_index));
-      return 0;
-    }
-    bitmap_update = 0;
-  }
+  if (!dirty) return;
 
-  // If bloc does not belong to extent yet
-  if (((bitmap[extent_offset/8] >> (extent_offset%8)) & 0x01) == 0x00) {
-    bitmap[extent_offset/8] |= 1 << (extent_offset%8);
-    bx_write_image(fd, (off_t)bitmap_offset, bitmap,  dtoh32(header.specific.bitmap));
+  for (i = 0; i < dtoh32(header.specific.catalog); i++) {
+    if (bitmap_dirty[i]) {
+      if (bx_write_image(fd, (off_t)get_bitmap_offset(i), bitmap[i], size) != (ssize_t)size) {
+        BX_ERROR(("redolog : failed to write bitmap for extent %d", i));
+      }
+      bitmap_dirty[i] = 0;
+    }
   }
 
-  // Write catalog
-  if (update_catalog) {
-    // FIXME if mmap
-    catalog_offset  = (Bit64s)STANDARD_HEADER_SIZE + (extent_index * sizeof(Bit32u));
+  if (catalog_dirty_first <= catalog_dirty_last) {
+    catalog_offset = (Bit64s)STANDARD_HEADER_SIZE + (catalog_dirty_first * sizeof(Bit32u));
 
     BX_DEBUG(("redolog : writing catalog at offset %x", (Bit32u)catalog_offset));
 
-    bx_write_image(fd, (off_t)catalog_offset, &catalog[extent_index], sizeof(Bit32u));
+    bx_write_image(fd, (off_t)catalog_offset, &catalog[catalog_dirty_first],
+                   (catalog_dirty_last - catalog_dirty_first + 1) * sizeof(Bit32u));
+    catalog_dirty_first = dtoh32(header.specific.catalog);
+    catalog_dirty_last = 0;
   }
 
-  if (written >= 0) lseek(512, SEEK_CUR);
-
-  return written;
+  dirty = 0;
 }
 
 int redolog_t::check_format(int fd, const char *subtype)
@@ -1745,6 +2150,7 @@ int redolog_t::check_format(int fd, const char *subtype)
 
 bx_bool redolog_t::save_state(const char *backup_fname)
 {
+  flush();
   return hdimage_backup_file(fd, backup_fname);
 }
 
@@ -1806,6 +2212,39 @@ ssize_t growing_image_t::write(const void* buf, size_t count)
   return (ret < 0) ? ret : count;
 }
 
+ssize_t growing_image_t::pread(Bit64s offset, void* buf, size_t count)
+{
+  size_t n = 0;
+  ssize_t ret;
+  bx_bool present;
+
+  while (n < count) {
+    ret = redolog->read_run(offset + n, (Bit8u*)buf + n, count - n, &present);
+    if (ret <= 0) return -1;
+    if (!present) memset((Bit8u*)buf + n, 0, ret);
+    n += ret;
+  }
+  return count;
+}
+
+ssize_t growing_image_t::pwrite(Bit64s offset, const void* buf, size_t count)
+{
+  size_t n = 0;
+  ssize_t ret;
+
+  while (n < count) {
+    ret = redolog->write_run(offset + n, (const Bit8u*)buf + n, count - n);
+    if (ret <= 0) return -1;
+    n += ret;
+  }
+  return count;
+}
+
+void growing_image_t::flush()
+{
+  redolog->flush();
+}
+
 int growing_image_t::check_format(int fd, Bit64u imgsize)
 {
   return redolog_t::check_format(fd, REDOLOG_SUBTYPE_GROWING);
@@ -1965,6 +2404,41 @@ ssize_t undoable_image_t::write(const void* buf, size_t count)
   return (ret < 0) ? ret : count;
 }
 
+ssize_t undoable_image_t::pread(Bit64s offset, void* buf, size_t count)
+{
+  size_t n = 0;
+  ssize_t ret;
+  bx_bool present;
+
+  while (n < count) {
+    ret = redolog->read_run(offset + n, (Bit8u*)buf + n, count - n, &present);
+    if (ret <= 0) return -1;
+    if (!present) {
+      if (ro_disk->pread(offset + n, (Bit8u*)buf + n, ret) != ret) return -1;
+    }
+    n += ret;
+  }
+  return count;
+}
+
+ssize_t undoable_image_t::pwrite(Bit64s offset, const void* buf, size_t count)
+{
+  size_t n = 0;
+  ssize_t ret;
+
+  while (n < count) {
+    ret = redolog->write_run(offset + n, (const Bit8u*)buf + n, count - n);
+    if (ret <= 0) return -1;
+    n += ret;
+  }
+  return count;
+}
+
+void undoable_image_t::flush()
+{
+  redolog->flush();
+}
+
 bx_bool undoable_image_t::save_state(const char *backup_fname)
 {
   return redolog->save_state(backup_fname);
@@ -2117,6 +2591,41 @@ ssize_t volatile_image_t::write(const void* buf, size_t count)
   return (ret < 0) ? ret : count;
 }
 
+ssize_t volatile_image_t::pread(Bit64s offset, void* buf, size_t count)
+{
+  size_t n = 0;
+  ssize_t ret;
+  bx_bool present;
+
+  while (n < count) {
+    ret = redolog->read_run(offset + n, (Bit8u*)buf + n, count - n, &present);
+    if (ret <= 0) return -1;
+    if (!present) {
+      if (ro_disk->pread(offset + n, (Bit8u*)buf + n, ret) != ret) return -1;
+    }
+    n += ret;
+  }
+  return count;
+}
+
+ssize_t volatile_image_t::pwrite(Bit64s offset, const void* buf, size_t count)
+{
+  size_t n = 0;
+  ssize_t ret;
+
+  while (n < count) {
+    ret = redolog->write_run(offset + n, (const Bit8u*)buf + n, count - n);
+    if (ret <= 0) return -1;
+    n += ret;
+  }
+  return count;
+}
+
+void volatile_image_t::flush()
+{
+  redolog->flush();
+}
+
 bx_bool volatile_image_t::save_state(const char *backup_fname)
 {
   return redolog->save_state(backup_fname);
@@ -75,6 +75,9 @@
 
 #define REDOLOG_PAGE_NOT_ALLOCATED (0xffffffff)
 
+// new extents are appended to the redolog file in runs of this size
+#define REDOLOG_PREALLOC_SIZE (1 << 20)
+
 #define UNDOABLE_REDOLOG_EXTENSION ".redolog"
 #define UNDOABLE_REDOLOG_EXTENSION_LENGTH (strlen(UNDOABLE_REDOLOG_EXTENSION))
 #define VOLATILE_REDOLOG_EXTENSION ".XXXXXX"
@@ -140,6 +143,38 @@ int hdimage_open_file(const char *pathname, int flags, Bit64u *fsize, FILETIME *
 #endif
 bx_bool hdimage_backup_file(int fd, const char *backup_fname);
 bx_bool hdimage_copy_file(const char *src, const char *dst);
+int hdimage_detect_image_mode(const char *pathname);
+
+// Asynchronous image access: requests are queued to a small pool of host
+// worker threads. Without host thread support they are served at submit
+// time. The caller owns the request and its buffer until it is done and
+// must not access the image itself while a request is in flight. If the
+// request names a timer, the worker signals it once the request is done
+// (see bx_pc_system_c::signal_timer()).
+#define HDIMAGE_AIO_READ    0
+#define HDIMAGE_AIO_WRITE   1
+
+#define HDIMAGE_AIO_THREADS 2
+
+class device_image_t;
+
+typedef struct hdimage_aio_t {
+  device_image_t *image;
+  int     type;
+  Bit64s  offset;
+  Bit8u  *buf;
+  size_t  count;
+  int     timer;                // BX_NULL_TIMER_HANDLE: no notification
+  ssize_t result;               // valid once done is set
+  bx_bool done;
+  struct hdimage_aio_t *next;
+} hdimage_aio_t;
+
+void hdimage_aio_submit(hdimage_aio_t *req);
+bx_bool hdimage_aio_done(hdimage_aio_t *req);
+void hdimage_aio_wait(hdimage_aio_t *req);
+void hdimage_aio_flush(void);
+void hdimage_aio_stop(void);
 
 // base class
 class device_image_t
@@ -170,6 +205,21 @@ class device_image_t
       // written (count).
       virtual ssize_t write(const void* buf, size_t count) = 0;
 
+      // Read count bytes (a multiple of 512) at the byte offset to the
+      // buffer buf. Return the number of bytes read (count). The image
+      // position is undefined afterwards. The default implementation
+      // seeks and reads one sector at a time.
+      virtual ssize_t pread(Bit64s offset, void* buf, size_t count);
+
+      // Write count bytes (a multiple of 512) from buf at the byte
+      // offset. Return the number of bytes written (count). The image
+      // position is undefined afterwards.
+      virtual ssize_t pwrite(Bit64s offset, const void* buf, size_t count);
+
+      // Write metadata cached in memory back to the image file. Called
+      // at guest FLUSH CACHE commands.
+      virtual void flush() {}
+
       // Get image capabilities
       virtual Bit32u get_capabilities();
 
@@ -218,6 +268,10 @@ class default_image_t : public device_image_t
       // written (count).
       ssize_t write(const void* buf, size_t count);
 
+      // Read/write count bytes at the byte offset with one host access.
+      ssize_t pread(Bit64s offset, void* buf, size_t count);
+      ssize_t pwrite(Bit64s offset, const void* buf, size_t count);
+
       // Check image format
       static int check_format(int fd, Bit64u imgsize);
 
@@ -312,6 +366,11 @@ class sparse_image_t : public device_image_t
     // written (count).
     ssize_t write(const void* buf, size_t count);
 
+    // Read/write count bytes at the byte offset, one host access per
+    // page touched.
+    ssize_t pread(Bit64s offset, void* buf, size_t count);
+    ssize_t pwrite(Bit64s offset, const void* buf, size_t count);
+
     // Check image format
     static int check_format(int fd, Bit64u imgsize);
 
@@ -415,21 +474,35 @@ class redolog_t
       Bit64s lseek(Bit64s offset, int whence);
       ssize_t read(void* buf, size_t count);
       ssize_t write(const void* buf, size_t count);
+      ssize_t read_run(Bit64s offset, void* buf, size_t count, bx_bool *present);
+      ssize_t write_run(Bit64s offset, const void* buf, size_t count);
 
       static int check_format(int fd, const char *subtype);
 
+      // Write the dirty bitmaps and catalog entries to the file
+      void flush();
+
       bx_bool save_state(const char *backup_fname);
 
   private:
       void             print_header();
+      Bit8u           *get_bitmap(Bit32u index);
+      int              alloc_extent(Bit32u index);
+      Bit64s           get_bitmap_offset(Bit32u index);
       int              fd;
       redolog_header_t header;     // Header is kept in x86 (little) endianness
       Bit32u          *catalog;
-      Bit8u           *bitmap;
-      bx_bool          bitmap_update;
+      Bit32u           catalog_dirty_first;
+      Bit32u           catalog_dirty_last;
+      // bitmaps of the allocated extents, indexed like the catalog and
+      // loaded on first use. Changes are written back by flush().
+      Bit8u          **bitmap;
+      Bit8u           *bitmap_dirty;
+      bx_bool          dirty;
       Bit32u           extent_index;
       Bit32u           extent_offset;
       Bit32u           extent_next;
+      Bit32u           extent_avail;  // extents already present in the file
 
       Bit32u           bitmap_blocks;
       Bit32u           extent_blocks;
@@ -463,6 +536,14 @@ class growing_image_t : public device_image_t
       // written (count).
       ssize_t write(const void* buf, size_t count);
 
+      // Read/write count bytes at the byte offset, one redolog extent
+      // run at a time.
+      ssize_t pread(Bit64s offset, void* buf, size_t count);
+      ssize_t pwrite(Bit64s offset, const void* buf, size_t count);
+
+      // Write the redolog metadata to the file
+      void flush();
+
       // Check image format
       static int check_format(int fd, Bit64u imgsize);
 
@@ -501,6 +582,14 @@ class undoable_image_t : public device_image_t
       // written (count).
       ssize_t write(const void* buf, size_t count);
 
+      // Read/write count bytes at the byte offset, one redolog extent
+      // run at a time.
+      ssize_t pread(Bit64s offset, void* buf, size_t count);
+      ssize_t pwrite(Bit64s offset, const void* buf, size_t count);
+
+      // Write the redolog metadata to the file
+      void flush();
+
       // Save/restore support
       bx_bool save_state(const char *backup_fname);
       void restore_state(const char *backup_fname);
@@ -538,6 +627,14 @@ class volatile_image_t : public device_image_t
       // written (count).
       ssize_t write(const void* buf, size_t count);
 
+      // Read/write count bytes at the byte offset, one redolog extent
+      // run at a time.
+      ssize_t pread(Bit64s offset, void* buf, size_t count);
+      ssize_t pwrite(Bit64s offset, const void* buf, size_t count);
+
+      // Write the redolog metadata to the file
+      void flush();
+
       // Save/restore support
       bx_bool save_state(const char *backup_fname);
       void restore_state(const char *backup_fname);
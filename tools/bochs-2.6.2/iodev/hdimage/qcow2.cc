@@ -0,0 +1,911 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2013  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+
+// QEMU copy-on-write image format (qcow2), version 2 and 3.
+//
+// Clusters are always allocated at the end of the image file and the
+// refcounts are kept up to date with every allocation, so the image stays
+// consistent for the QEMU tools. Clusters given up by copy-on-write are
+// not reused. Encrypted images, external data files and the lazy refcount
+// (dirty) mode are not supported. Compressed clusters can be read if
+// Bochs is built with zlib. Snapshots stored in the image are preserved,
+// clusters shared with them are copied on write.
+
+// Define BX_PLUGGABLE in files that can be compiled into plugins.  For
+// platforms that require a special tag on exported symbols, BX_PLUGGABLE
+// is used to know when we are exporting symbols and when we are importing.
+#define BX_PLUGGABLE
+
+#include "iodev.h"
+#include "hdimage.h"
+#include "qcow2.h"
+
+#if BX_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#define LOG_THIS bx_devices.pluginHDImageCtl->
+
+// be*_to_cpu : convert disk (big) to host endianness
+#if defined (BX_LITTLE_ENDIAN)
+#define be32_to_cpu(val) bx_bswap32(val)
+#define be64_to_cpu(val) bx_bswap64(val)
+#define cpu_to_be32(val) bx_bswap32(val)
+#define cpu_to_be64(val) bx_bswap64(val)
+#else
+#define be32_to_cpu(val) (val)
+#define be64_to_cpu(val) (val)
+#define cpu_to_be32(val) (val)
+#define cpu_to_be64(val) (val)
+#endif
+
+qcow2_image_t::qcow2_image_t()
+{
+  fd = -1;
+  pathname = NULL;
+  l1_table = NULL;
+  for (int i = 0; i < QCOW2_L2_CACHE_SIZE; i++) {
+    l2_cache[i].table = NULL;
+  }
+  refcount_table = NULL;
+  refcount_block = NULL;
+  cluster_cache = NULL;
+  cluster_data = NULL;
+  backing = NULL;
+  backing_name = NULL;
+  cur_offset = 0;
+}
+
+qcow2_image_t::~qcow2_image_t()
+{
+  close();
+}
+
+int qcow2_image_t::check_format(int fd, Bit64u imgsize)
+{
+  qcow2_header_t temp_header;
+  Bit32u version;
+
+  if (imgsize < QCOW2_V2_HEADER_SIZE) {
+    return HDIMAGE_SIZE_ERROR;
+  }
+  if (bx_read_image(fd, 0, &temp_header, QCOW2_V2_HEADER_SIZE) != QCOW2_V2_HEADER_SIZE) {
+    return HDIMAGE_READ_ERROR;
+  }
+  if (be32_to_cpu(temp_header.magic) != QCOW2_MAGIC) {
+    return HDIMAGE_NO_SIGNATURE;
+  }
+  version = be32_to_cpu(temp_header.version);
+  if ((version != 2) && (version != 3)) {
+    return HDIMAGE_VERSION_ERROR;
+  }
+  return HDIMAGE_FORMAT_OK;
+}
+
+int qcow2_image_t::read_header()
+{
+  Bit32u refcount_order, ext[2];
+  Bit64u features, l1_needed, ext_offset, i;
+  char backing_fmt[16];
+
+  memset(&header, 0, sizeof(header));
+  if (bx_read_image(fd, 0, &header, QCOW2_V2_HEADER_SIZE) != QCOW2_V2_HEADER_SIZE) {
+    return -1;
+  }
+  version = be32_to_cpu(header.version);
+  if (version >= 3) {
+    if (bx_read_image(fd, 0, &header, QCOW2_V3_HEADER_SIZE) != QCOW2_V3_HEADER_SIZE) {
+      return -1;
+    }
+    header_length = be32_to_cpu(header.header_length);
+    refcount_order = be32_to_cpu(header.refcount_order);
+    features = be64_to_cpu(header.incompatible_features);
+    if ((header_length < QCOW2_V3_HEADER_SIZE) || (refcount_order > 6)) {
+      BX_ERROR(("QCOW2: invalid version 3 header in '%s'", pathname));
+      return -1;
+    }
+    if (features & ~QCOW2_INCOMPAT_MASK) {
+      BX_ERROR(("QCOW2: unsupported incompatible features 0x" FMT_LL "x in '%s'",
+                features & ~QCOW2_INCOMPAT_MASK, pathname));
+      return -1;
+    }
+    if ((features & QCOW2_INCOMPAT_MASK) && !readonly) {
+      BX_ERROR(("QCOW2: '%s' is marked %s, repair it with 'qemu-img check -r all'",
+                pathname, (features & QCOW2_INCOMPAT_CORRUPT) ? "corrupt" : "dirty"));
+      return -1;
+    }
+  } else {
+    header_length = QCOW2_V2_HEADER_SIZE;
+    refcount_order = 4;
+  }
+
+  cluster_bits = be32_to_cpu(header.cluster_bits);
+  if ((cluster_bits < QCOW2_MIN_CLUSTER_BITS) || (cluster_bits > QCOW2_MAX_CLUSTER_BITS)) {
+    BX_ERROR(("QCOW2: unsupported cluster size (%d bits) in '%s'", cluster_bits, pathname));
+    return -1;
+  }
+  if (be32_to_cpu(header.crypt_method) != 0) {
+    BX_ERROR(("QCOW2: encrypted image '%s' not supported", pathname));
+    return -1;
+  }
+  cluster_size = 1 << cluster_bits;
+  l2_bits = cluster_bits - 3;
+  l2_size = 1 << l2_bits;
+  csize_shift = 62 - (cluster_bits - 8);
+  csize_mask = (1 << (cluster_bits - 8)) - 1;
+  refcount_bits = 1 << refcount_order;
+  refcount_block_bits = cluster_bits + 3 - refcount_order;
+  hd_size = be64_to_cpu(header.size);
+
+  // the L1 table has to cover the whole disk
+  l1_size = be32_to_cpu(header.l1_size);
+  l1_needed = (hd_size + ((Bit64u)cluster_size << l2_bits) - 1) >> (cluster_bits + l2_bits);
+  if (l1_size < l1_needed) {
+    BX_ERROR(("QCOW2: L1 table too small in '%s'", pathname));
+    return -1;
+  }
+  l1_table = new Bit64u[l1_size];
+  if (bx_read_image(fd, be64_to_cpu(header.l1_table_offset), l1_table, l1_size * 8) != (int)(l1_size * 8)) {
+    BX_ERROR(("QCOW2: cannot read L1 table of '%s'", pathname));
+    return -1;
+  }
+  for (i = 0; i < l1_size; i++) {
+    l1_table[i] = be64_to_cpu(l1_table[i]);
+  }
+
+  refcount_table_size = ((Bit64u)be32_to_cpu(header.refcount_table_clusters) << cluster_bits) / 8;
+  refcount_table = new Bit64u[(size_t)refcount_table_size];
+  if (bx_read_image(fd, be64_to_cpu(header.refcount_table_offset), refcount_table,
+                    (int)(refcount_table_size * 8)) != (int)(refcount_table_size * 8)) {
+    BX_ERROR(("QCOW2: cannot read refcount table of '%s'", pathname));
+    return -1;
+  }
+  for (i = 0; i < refcount_table_size; i++) {
+    refcount_table[i] = be64_to_cpu(refcount_table[i]);
+  }
+
+  // header extensions follow the header up to the end of the first cluster
+  backing_fmt[0] = 0;
+  ext_offset = header_length;
+  while ((ext_offset + 8) <= cluster_size) {
+    if (bx_read_image(fd, ext_offset, ext, 8) != 8) {
+      return -1;
+    }
+    ext[0] = be32_to_cpu(ext[0]);
+    ext[1] = be32_to_cpu(ext[1]);
+    if (ext[0] == QCOW2_EXT_END) break;
+    if ((ext[0] == QCOW2_EXT_BACKING_FMT) && (ext[1] < sizeof(backing_fmt))) {
+      if (bx_read_image(fd, ext_offset + 8, backing_fmt, ext[1]) != (int)ext[1]) {
+        return -1;
+      }
+      backing_fmt[ext[1]] = 0;
+    }
+    ext_offset += 8 + ((ext[1] + 7) & ~7);
+  }
+
+  if (be64_to_cpu(header.backing_file_offset) != 0) {
+    Bit32u len = be32_to_cpu(header.backing_file_size);
+    if (len >= BX_PATHNAME_LEN) {
+      BX_ERROR(("QCOW2: backing file name too long in '%s'", pathname));
+      return -1;
+    }
+    backing_name = new char[len + 1];
+    if (bx_read_image(fd, be64_to_cpu(header.backing_file_offset), backing_name, len) != (int)len) {
+      return -1;
+    }
+    backing_name[len] = 0;
+    if (open_backing_file(backing_fmt) < 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// The backing file name is relative to the directory of the image unless
+// it is an absolute path. Its format comes from the header extension or
+// is detected like the base image of an undoable disk.
+int qcow2_image_t::open_backing_file(const char *backing_fmt)
+{
+  char path[BX_PATHNAME_LEN];
+  const char *sep;
+  int mode, len = 0;
+
+#ifdef WIN32
+  bx_bool absolute = (backing_name[0] == '/') || (backing_name[0] == '\\') ||
+                     ((backing_name[0] != 0) && (backing_name[1] == ':'));
+#else
+  bx_bool absolute = (backing_name[0] == '/');
+#endif
+  if (!absolute) {
+    sep = strrchr(pathname, '/');
+#ifdef WIN32
+    const char *sep2 = strrchr(pathname, '\\');
+    if (sep2 > sep) sep = sep2;
+#endif
+    if (sep != NULL) {
+      len = (int)(sep - pathname) + 1;
+    }
+  }
+  if ((len + strlen(backing_name)) >= BX_PATHNAME_LEN) {
+    BX_ERROR(("QCOW2: backing file path too long"));
+    return -1;
+  }
+  memcpy(path, pathname, len);
+  strcpy(path + len, backing_name);
+
+  if (!strcmp(backing_fmt, "raw")) {
+    mode = BX_HDIMAGE_MODE_FLAT;
+  } else if (!strcmp(backing_fmt, "qcow2")) {
+    mode = BX_HDIMAGE_MODE_QCOW2;
+  } else {
+    mode = hdimage_detect_image_mode(path);
+  }
+  if (mode == BX_HDIMAGE_MODE_UNKNOWN) {
+    BX_ERROR(("QCOW2: format of backing file '%s' not detected", path));
+    return -1;
+  }
+  backing = DEV_hdimage_init_image(mode, 0, NULL);
+  if ((backing == NULL) || (backing->open(path, O_RDONLY) < 0)) {
+    BX_ERROR(("QCOW2: cannot open backing file '%s'", path));
+    delete backing;
+    backing = NULL;
+    return -1;
+  }
+  return 0;
+}
+
+int qcow2_image_t::open(const char* _pathname, int flags)
+{
+  Bit64u imgsize = 0;
+
+  pathname = _pathname;
+  readonly = ((flags & (O_WRONLY | O_RDWR)) == 0);
+  if ((fd = hdimage_open_file(pathname, flags, &imgsize, &mtime)) < 0) {
+    BX_ERROR(("QCOW2: cannot open hdimage file '%s'", pathname));
+    return -1;
+  }
+  if (check_format(fd, imgsize) != HDIMAGE_FORMAT_OK) {
+    BX_ERROR(("QCOW2: '%s' is not a supported qcow2 image", pathname));
+    close();
+    return -1;
+  }
+  if (read_header() < 0) {
+    close();
+    return -1;
+  }
+
+  for (int i = 0; i < QCOW2_L2_CACHE_SIZE; i++) {
+    l2_cache[i].offset = 0;
+    l2_cache[i].table = new Bit64u[l2_size];
+    l2_cache[i].used = 0;
+  }
+  l2_cache_counter = 0;
+  refcount_block = new Bit8u[cluster_size];
+  refcount_block_offset = 0;
+  cluster_cache = new Bit8u[cluster_size];
+  cluster_cache_offset = 0;
+  cluster_data = new Bit8u[cluster_size * 2];
+  run.count = 0;
+  free_cluster_offset = (imgsize + cluster_size - 1) & ~((Bit64u)cluster_size - 1);
+
+  // features we don't know about must be cleared if the image changes
+  if (!readonly && (header.autoclear_features != 0)) {
+    header.autoclear_features = 0;
+    bx_write_image(fd, 88, &header.autoclear_features, 8);
+  }
+  cur_offset = 0;
+
+  if (backing != NULL) {
+    BX_INFO(("'qcow2' disk image opened: path is '%s', backing file is '%s'", pathname, backing_name));
+  } else {
+    BX_INFO(("'qcow2' disk image opened: path is '%s'", pathname));
+  }
+  return 0;
+}
+
+void qcow2_image_t::close()
+{
+  if (fd > -1) {
+    ::close(fd);
+    fd = -1;
+  }
+  if (backing != NULL) {
+    backing->close();
+    delete backing;
+    backing = NULL;
+  }
+  delete [] backing_name;
+  backing_name = NULL;
+  delete [] l1_table;
+  l1_table = NULL;
+  for (int i = 0; i < QCOW2_L2_CACHE_SIZE; i++) {
+    delete [] l2_cache[i].table;
+    l2_cache[i].table = NULL;
+  }
+  delete [] refcount_table;
+  refcount_table = NULL;
+  delete [] refcount_block;
+  refcount_block = NULL;
+  delete [] cluster_cache;
+  cluster_cache = NULL;
+  delete [] cluster_data;
+  cluster_data = NULL;
+}
+
+Bit64s qcow2_image_t::lseek(Bit64s offset, int whence)
+{
+  if (whence == SEEK_SET) {
+    cur_offset = offset;
+  } else if (whence == SEEK_CUR) {
+    cur_offset += offset;
+  } else {
+    BX_ERROR(("lseek: mode not supported yet"));
+    return -1;
+  }
+  if ((cur_offset < 0) || ((Bit64u)cur_offset >= hd_size))
+    return -1;
+  return cur_offset;
+}
+
+ssize_t qcow2_image_t::read(void* buf, size_t count)
+{
+  ssize_t ret = pread(cur_offset, buf, count);
+  if (ret > 0) {
+    cur_offset += ret;
+  }
+  return ret;
+}
+
+ssize_t qcow2_image_t::write(const void* buf, size_t count)
+{
+  ssize_t ret = pwrite(cur_offset, buf, count);
+  if (ret > 0) {
+    cur_offset += ret;
+  }
+  return ret;
+}
+
+// Return the L2 table at l2_offset from the cache. On a miss the least
+// recently used slot is replaced and the table is read from the image if
+// load is set. The pointer is valid until the next call.
+Bit64u* qcow2_image_t::get_l2_table(Bit64u l2_offset, bx_bool load)
+{
+  int i, victim = 0;
+
+  for (i = 0; i < QCOW2_L2_CACHE_SIZE; i++) {
+    if (l2_cache[i].offset == l2_offset) {
+      l2_cache[i].used = ++l2_cache_counter;
+      return l2_cache[i].table;
+    }
+    if (l2_cache[i].used < l2_cache[victim].used) {
+      victim = i;
+    }
+  }
+  l2_cache[victim].offset = 0;
+  if (load && (bx_read_image(fd, l2_offset, l2_cache[victim].table, cluster_size) != (int)cluster_size)) {
+    BX_ERROR(("QCOW2: cannot read L2 table at offset " FMT_LL "d", l2_offset));
+    return NULL;
+  }
+  l2_cache[victim].offset = l2_offset;
+  l2_cache[victim].used = ++l2_cache_counter;
+  return l2_cache[victim].table;
+}
+
+// Look up the L2 entry of the cluster containing guest_offset. Unallocated
+// L2 tables read as zero entries.
+int qcow2_image_t::get_l2_entry(Bit64u guest_offset, Bit64u *l2_entry)
+{
+  Bit64u l1_index = guest_offset >> (cluster_bits + l2_bits);
+  Bit64u l2_offset, *l2_table;
+
+  *l2_entry = 0;
+  if (l1_index >= l1_size) {
+    return 0;
+  }
+  l2_offset = l1_table[l1_index] & QCOW2_OFFSET_MASK;
+  if (l2_offset == 0) {
+    return 0;
+  }
+  if ((l2_table = get_l2_table(l2_offset, 1)) == NULL) {
+    return -1;
+  }
+  *l2_entry = be64_to_cpu(l2_table[(guest_offset >> cluster_bits) & (l2_size - 1)]);
+  return 0;
+}
+
+// Store a new L2 entry for the cluster containing guest_offset. An L2
+// table that does not exist yet or is shared with a snapshot is replaced
+// by a new one first.
+int qcow2_image_t::set_l2_entry(Bit64u guest_offset, Bit64u l2_entry)
+{
+  Bit64u l1_index = guest_offset >> (cluster_bits + l2_bits);
+  Bit32u l2_index = (Bit32u)((guest_offset >> cluster_bits) & (l2_size - 1));
+  Bit64u old_offset = l1_table[l1_index] & QCOW2_OFFSET_MASK;
+  Bit64u l2_offset, entry, *l2_table, *old_table;
+  Bit64s new_offset;
+
+  if ((old_offset != 0) && (l1_table[l1_index] & QCOW2_OFLAG_COPIED)) {
+    l2_offset = old_offset;
+    if ((l2_table = get_l2_table(l2_offset, 1)) == NULL) {
+      return -1;
+    }
+  } else {
+    if ((new_offset = alloc_clusters(1)) < 0) {
+      return -1;
+    }
+    l2_offset = (Bit64u)new_offset;
+    // the new table is most recently used, loading the old one keeps it
+    l2_table = get_l2_table(l2_offset, 0);
+    if (old_offset != 0) {
+      if ((old_table = get_l2_table(old_offset, 1)) == NULL) {
+        return -1;
+      }
+      memcpy(l2_table, old_table, cluster_size);
+    } else {
+      memset(l2_table, 0, cluster_size);
+    }
+    if (bx_write_image(fd, l2_offset, l2_table, cluster_size) != (int)cluster_size) {
+      return -1;
+    }
+    l1_table[l1_index] = l2_offset | QCOW2_OFLAG_COPIED;
+    entry = cpu_to_be64(l1_table[l1_index]);
+    if (bx_write_image(fd, be64_to_cpu(header.l1_table_offset) + l1_index * 8, &entry, 8) != 8) {
+      return -1;
+    }
+    if (old_offset != 0) {
+      update_refcount(old_offset, -1);
+    }
+  }
+  l2_table[l2_index] = cpu_to_be64(l2_entry);
+  return (bx_write_image(fd, l2_offset + l2_index * 8, &l2_table[l2_index], 8) == 8) ? 0 : -1;
+}
+
+// Fill buf with the whole guest cluster described by l2_entry
+int qcow2_image_t::read_cluster(Bit64u guest_offset, Bit64u l2_entry, Bit8u *buf)
+{
+  Bit64u host_offset = l2_entry & QCOW2_OFFSET_MASK;
+  int ret;
+
+  if (l2_entry & QCOW2_OFLAG_COMPRESSED) {
+    if (read_compressed(l2_entry) < 0) {
+      return -1;
+    }
+    memcpy(buf, cluster_cache, cluster_size);
+  } else if ((l2_entry & QCOW2_OFLAG_ZERO) && (version >= 3)) {
+    memset(buf, 0, cluster_size);
+  } else if (host_offset != 0) {
+    // the last cluster of the file may be short
+    ret = bx_read_image(fd, host_offset, buf, cluster_size);
+    if (ret < 0) {
+      return -1;
+    }
+    memset(buf + ret, 0, cluster_size - ret);
+  } else {
+    return read_backing(guest_offset, buf, cluster_size);
+  }
+  return 0;
+}
+
+// Decompress the cluster into cluster_cache. The last one is kept since
+// guest reads of a compressed cluster usually come in several pieces.
+int qcow2_image_t::read_compressed(Bit64u l2_entry)
+{
+  Bit64u coffset = l2_entry & ((BX_CONST64(1) << csize_shift) - 1);
+  Bit32u csize = (Bit32u)((((l2_entry >> csize_shift) & csize_mask) + 1) * 512 - (coffset & 511));
+
+  if ((cluster_cache_offset == coffset) && (coffset != 0)) {
+    return 0;
+  }
+#if BX_HAVE_ZLIB
+  z_stream strm;
+  int ret = bx_read_image(fd, coffset, cluster_data, csize);
+  if (ret <= 0) {
+    return -1;
+  }
+  memset(&strm, 0, sizeof(strm));
+  strm.next_in = cluster_data;
+  strm.avail_in = ret;
+  strm.next_out = cluster_cache;
+  strm.avail_out = cluster_size;
+  if (inflateInit2(&strm, -12) != Z_OK) {
+    return -1;
+  }
+  ret = inflate(&strm, Z_FINISH);
+  inflateEnd(&strm);
+  if (((ret != Z_STREAM_END) && (ret != Z_BUF_ERROR)) || (strm.avail_out != 0)) {
+    BX_ERROR(("QCOW2: cannot decompress cluster at offset " FMT_LL "d", coffset));
+    cluster_cache_offset = 0;
+    return -1;
+  }
+  cluster_cache_offset = coffset;
+  return 0;
+#else
+  BX_ERROR(("QCOW2: compressed clusters not supported (built without zlib)"));
+  return -1;
+#endif
+}
+
+// Data of unallocated clusters comes from the backing file, zeroes
+// beyond its end
+int qcow2_image_t::read_backing(Bit64u guest_offset, Bit8u *buf, Bit32u count)
+{
+  Bit32u n = 0;
+
+  if ((backing != NULL) && (guest_offset < backing->hd_size)) {
+    n = count;
+    if ((guest_offset + n) > backing->hd_size) {
+      n = (Bit32u)(backing->hd_size - guest_offset) & ~511;
+    }
+    if ((n > 0) && (backing->pread(guest_offset, buf, n) != (ssize_t)n)) {
+      return -1;
+    }
+  }
+  memset(buf + n, 0, count - n);
+  return 0;
+}
+
+// Reserve count clusters at the end of the image file
+Bit64s qcow2_image_t::alloc_clusters(Bit32u count)
+{
+  Bit64u offset = free_cluster_offset;
+
+  free_cluster_offset += (Bit64u)count << cluster_bits;
+  for (Bit32u i = 0; i < count; i++) {
+    if (update_refcount(offset + ((Bit64u)i << cluster_bits), 1) < 0) {
+      return -1;
+    }
+  }
+  return (Bit64s)offset;
+}
+
+int qcow2_image_t::update_refcount(Bit64u host_offset, int addend)
+{
+  Bit64u cluster_index = host_offset >> cluster_bits;
+  Bit64u table_index = cluster_index >> refcount_block_bits;
+  Bit32u block_index = (Bit32u)(cluster_index & ((1 << refcount_block_bits) - 1));
+  Bit64u block_offset, refcount, entry;
+  Bit32u byte_offset, nbytes, shift = 0;
+  Bit8u *ptr;
+  unsigned i;
+
+  if (table_index >= refcount_table_size) {
+    if (grow_refcount_table(table_index + 1) < 0) {
+      return -1;
+    }
+  }
+  if (refcount_table[table_index] == 0) {
+    // a new refcount block at the end of the image, counting itself
+    block_offset = free_cluster_offset;
+    free_cluster_offset += cluster_size;
+    memset(refcount_block, 0, cluster_size);
+    if (bx_write_image(fd, block_offset, refcount_block, cluster_size) != (int)cluster_size) {
+      return -1;
+    }
+    refcount_block_offset = block_offset;
+    refcount_table[table_index] = block_offset;
+    entry = cpu_to_be64(block_offset);
+    if (bx_write_image(fd, be64_to_cpu(header.refcount_table_offset) + table_index * 8, &entry, 8) != 8) {
+      return -1;
+    }
+    if (update_refcount(block_offset, 1) < 0) {
+      return -1;
+    }
+  }
+  block_offset = refcount_table[table_index] & ~BX_CONST64(0x1ff);
+  if (refcount_block_offset != block_offset) {
+    if (bx_read_image(fd, block_offset, refcount_block, cluster_size) != (int)cluster_size) {
+      refcount_block_offset = 0;
+      return -1;
+    }
+    refcount_block_offset = block_offset;
+  }
+
+  // entries narrower than a byte are packed starting at the low bits
+  if (refcount_bits >= 8) {
+    nbytes = refcount_bits / 8;
+    byte_offset = block_index * nbytes;
+    refcount = 0;
+    for (i = 0, ptr = refcount_block + byte_offset; i < nbytes; i++) {
+      refcount = (refcount << 8) | ptr[i];
+    }
+  } else {
+    nbytes = 1;
+    byte_offset = block_index / (8 / refcount_bits);
+    shift = (block_index % (8 / refcount_bits)) * refcount_bits;
+    refcount = (refcount_block[byte_offset] >> shift) & ((1 << refcount_bits) - 1);
+  }
+  if (((addend < 0) && (refcount == 0)) ||
+      ((addend > 0) && (refcount_bits < 64) && (refcount == ((BX_CONST64(1) << refcount_bits) - 1)))) {
+    BX_ERROR(("QCOW2: refcount of cluster at offset " FMT_LL "d out of range", host_offset));
+    return -1;
+  }
+  refcount += addend;
+  if (refcount_bits >= 8) {
+    for (i = nbytes, ptr = refcount_block + byte_offset; i > 0; i--) {
+      ptr[i - 1] = (Bit8u)refcount;
+      refcount >>= 8;
+    }
+  } else {
+    refcount_block[byte_offset] &= ~(((1 << refcount_bits) - 1) << shift);
+    refcount_block[byte_offset] |= (Bit8u)(refcount << shift);
+  }
+  return (bx_write_image(fd, block_offset + byte_offset, refcount_block + byte_offset, nbytes) == (int)nbytes) ? 0 : -1;
+}
+
+// Move the refcount table to a larger place at the end of the image
+int qcow2_image_t::grow_refcount_table(Bit64u min_entries)
+{
+  Bit64u entries_per_cluster = cluster_size / 8;
+  Bit64u new_size = refcount_table_size * 2, i;
+  Bit64u old_offset = be64_to_cpu(header.refcount_table_offset);
+  Bit32u old_clusters = be32_to_cpu(header.refcount_table_clusters), new_clusters;
+  Bit64u *new_table, *disk_table;
+
+  if (new_size < min_entries) {
+    new_size = min_entries;
+  }
+  new_size = (new_size + entries_per_cluster - 1) & ~(entries_per_cluster - 1);
+  new_clusters = (Bit32u)(new_size / entries_per_cluster);
+  new_table = new Bit64u[(size_t)new_size];
+  disk_table = new Bit64u[(size_t)new_size];
+  memset(new_table, 0, (size_t)new_size * 8);
+  memcpy(new_table, refcount_table, (size_t)refcount_table_size * 8);
+  for (i = 0; i < new_size; i++) {
+    disk_table[i] = cpu_to_be64(new_table[i]);
+  }
+  Bit64u new_offset = free_cluster_offset;
+  free_cluster_offset += (Bit64u)new_clusters << cluster_bits;
+  int ret = bx_write_image(fd, new_offset, disk_table, (int)(new_size * 8));
+  delete [] disk_table;
+  if (ret != (int)(new_size * 8)) {
+    delete [] new_table;
+    return -1;
+  }
+  header.refcount_table_offset = cpu_to_be64(new_offset);
+  header.refcount_table_clusters = cpu_to_be32(new_clusters);
+  if ((bx_write_image(fd, 48, &header.refcount_table_offset, 8) != 8) ||
+      (bx_write_image(fd, 56, &header.refcount_table_clusters, 4) != 4)) {
+    delete [] new_table;
+    return -1;
+  }
+  delete [] refcount_table;
+  refcount_table = new_table;
+  refcount_table_size = new_size;
+
+  for (i = 0; i < new_clusters; i++) {
+    if (update_refcount(new_offset + (i << cluster_bits), 1) < 0) return -1;
+  }
+  for (i = 0; i < old_clusters; i++) {
+    if (update_refcount(old_offset + (i << cluster_bits), -1) < 0) return -1;
+  }
+  return 0;
+}
+
+// Drop the reference of a replaced L2 entry to its host cluster(s)
+void qcow2_image_t::free_clusters(Bit64u l2_entry)
+{
+  Bit64u offset, last;
+
+  if (l2_entry & QCOW2_OFLAG_COMPRESSED) {
+    offset = l2_entry & ((BX_CONST64(1) << csize_shift) - 1);
+    last = offset + (((l2_entry >> csize_shift) & csize_mask) + 1) * 512 - (offset & 511) - 1;
+    if (cluster_cache_offset == offset) {
+      cluster_cache_offset = 0;
+    }
+    offset &= ~((Bit64u)cluster_size - 1);
+    for (; offset <= last; offset += cluster_size) {
+      update_refcount(offset, -1);
+    }
+  } else if ((l2_entry & QCOW2_OFFSET_MASK) != 0) {
+    update_refcount(l2_entry & QCOW2_OFFSET_MASK, -1);
+  }
+}
+
+// Guest data of consecutive clusters that are contiguous in the image
+// file as well is transferred with one host access
+int qcow2_image_t::flush_run()
+{
+  Bit32u count = run.count;
+  int ret;
+
+  if (count == 0) {
+    return 0;
+  }
+  run.count = 0;
+  if (run.write) {
+    ret = bx_write_image(fd, run.host_offset, run.buf, count);
+  } else {
+    ret = bx_read_image(fd, run.host_offset, run.buf, count);
+    // the last cluster of the file may be short
+    if ((ret >= 0) && (ret < (int)count)) {
+      memset(run.buf + ret, 0, count - ret);
+      ret = count;
+    }
+  }
+  return (ret == (int)count) ? 0 : -1;
+}
+
+int qcow2_image_t::add_run(Bit64u host_offset, Bit8u *buf, Bit32u count, bx_bool write)
+{
+  if ((run.count > 0) && (run.write == write) &&
+      ((run.host_offset + run.count) == host_offset) && ((run.buf + run.count) == buf)) {
+    run.count += count;
+    return 0;
+  }
+  if (flush_run() < 0) {
+    return -1;
+  }
+  run.host_offset = host_offset;
+  run.buf = buf;
+  run.count = count;
+  run.write = write;
+  return 0;
+}
+
+ssize_t qcow2_image_t::pread(Bit64s offset, void* buf, size_t count)
+{
+  Bit8u *cbuf = (Bit8u*)buf;
+  Bit64u guest_offset = (Bit64u)offset, l2_entry;
+  Bit32u in_offset, n;
+  size_t done = 0;
+
+  if ((offset < 0) || ((guest_offset + count) > hd_size)) {
+    return -1;
+  }
+  while (done < count) {
+    in_offset = (Bit32u)(guest_offset & (cluster_size - 1));
+    n = cluster_size - in_offset;
+    if (n > (count - done)) {
+      n = (Bit32u)(count - done);
+    }
+    if (get_l2_entry(guest_offset, &l2_entry) < 0) {
+      run.count = 0;
+      return -1;
+    }
+    if (l2_entry & QCOW2_OFLAG_COMPRESSED) {
+      if (read_compressed(l2_entry) < 0) {
+        run.count = 0;
+        return -1;
+      }
+      memcpy(cbuf, cluster_cache + in_offset, n);
+    } else if ((l2_entry & QCOW2_OFLAG_ZERO) && (version >= 3)) {
+      memset(cbuf, 0, n);
+    } else if ((l2_entry & QCOW2_OFFSET_MASK) != 0) {
+      if (add_run((l2_entry & QCOW2_OFFSET_MASK) + in_offset, cbuf, n, 0) < 0) {
+        return -1;
+      }
+    } else if (read_backing(guest_offset, cbuf, n) < 0) {
+      run.count = 0;
+      return -1;
+    }
+    cbuf += n;
+    guest_offset += n;
+    done += n;
+  }
+  if (flush_run() < 0) {
+    return -1;
+  }
+  return count;
+}
+
+ssize_t qcow2_image_t::pwrite(Bit64s offset, const void* buf, size_t count)
+{
+  Bit8u *cbuf = (Bit8u*)buf;
+  Bit64u guest_offset = (Bit64u)offset, cluster_offset, l2_entry;
+  Bit64s new_offset;
+  Bit32u in_offset, n;
+  size_t done = 0;
+
+  if (readonly) {
+    BX_ERROR(("QCOW2: write to read-only image '%s'", pathname));
+    return -1;
+  }
+  if ((offset < 0) || ((guest_offset + count) > hd_size)) {
+    return -1;
+  }
+  while (done < count) {
+    in_offset = (Bit32u)(guest_offset & (cluster_size - 1));
+    cluster_offset = guest_offset - in_offset;
+    n = cluster_size - in_offset;
+    if (n > (count - done)) {
+      n = (Bit32u)(count - done);
+    }
+    if (get_l2_entry(guest_offset, &l2_entry) < 0) {
+      run.count = 0;
+      return -1;
+    }
+    if ((l2_entry & QCOW2_OFLAG_COPIED) && !(l2_entry & QCOW2_OFLAG_COMPRESSED) &&
+        !((l2_entry & QCOW2_OFLAG_ZERO) && (version >= 3)) &&
+        ((l2_entry & QCOW2_OFFSET_MASK) != 0)) {
+      // cluster owned by the active image only, update in place
+      if (add_run((l2_entry & QCOW2_OFFSET_MASK) + in_offset, cbuf, n, 1) < 0) {
+        return -1;
+      }
+    } else {
+      // copy on write: the cluster moves to a newly allocated place. The
+      // data must be there before the L2 entry points to it, and the old
+      // cluster is released only once the entry does not refer to it.
+      if ((new_offset = alloc_clusters(1)) < 0) {
+        run.count = 0;
+        return -1;
+      }
+      if (n == cluster_size) {
+        if ((add_run(new_offset, cbuf, n, 1) < 0) || (flush_run() < 0)) {
+          update_refcount(new_offset, -1);
+          return -1;
+        }
+      } else {
+        if (read_cluster(cluster_offset, l2_entry, cluster_data) < 0) {
+          run.count = 0;
+          return -1;
+        }
+        memcpy(cluster_data + in_offset, cbuf, n);
+        if (bx_write_image(fd, new_offset, cluster_data, cluster_size) != (int)cluster_size) {
+          run.count = 0;
+          update_refcount(new_offset, -1);
+          return -1;
+        }
+      }
+      if (set_l2_entry(cluster_offset, (Bit64u)new_offset | QCOW2_OFLAG_COPIED) < 0) {
+        run.count = 0;
+        update_refcount(new_offset, -1);
+        return -1;
+      }
+      free_clusters(l2_entry);
+    }
+    cbuf += n;
+    guest_offset += n;
+    done += n;
+  }
+  if (flush_run() < 0) {
+    return -1;
+  }
+  return count;
+}
+
+bx_bool qcow2_image_t::save_state(const char *backup_fname)
+{
+  return hdimage_backup_file(fd, backup_fname);
+}
+
+void qcow2_image_t::restore_state(const char *backup_fname)
+{
+  int temp_fd;
+  Bit64u imgsize;
+
+  if ((temp_fd = hdimage_open_file(backup_fname, O_RDONLY, &imgsize, NULL)) < 0) {
+    BX_PANIC(("cannot open qcow2 image backup '%s'", backup_fname));
+    return;
+  }
+  if (check_format(temp_fd, imgsize) != HDIMAGE_FORMAT_OK) {
+    ::close(temp_fd);
+    BX_PANIC(("Could not detect qcow2 image header"));
+    return;
+  }
+  ::close(temp_fd);
+  close();
+  if (!hdimage_copy_file(backup_fname, pathname)) {
+    BX_PANIC(("Failed to restore qcow2 image '%s'", pathname));
+    return;
+  }
+  device_image_t::open(pathname);
+}
@@ -0,0 +1,184 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2013  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+
+// QEMU copy-on-write image format, version 2 and 3
+
+#ifndef BX_QCOW2_H
+#define BX_QCOW2_H
+
+#define QCOW2_MAGIC            0x514649fb // 'Q' 'F' 'I' 0xfb
+#define QCOW2_V2_HEADER_SIZE   72
+#define QCOW2_V3_HEADER_SIZE   104
+
+#define QCOW2_MIN_CLUSTER_BITS 9
+#define QCOW2_MAX_CLUSTER_BITS 21
+
+// L1 / L2 table entries
+#define QCOW2_OFLAG_COPIED     BX_CONST64(0x8000000000000000)
+#define QCOW2_OFLAG_COMPRESSED BX_CONST64(0x4000000000000000)
+#define QCOW2_OFLAG_ZERO       BX_CONST64(0x0000000000000001)
+#define QCOW2_OFFSET_MASK      BX_CONST64(0x00fffffffffffe00)
+
+// incompatible feature bits
+#define QCOW2_INCOMPAT_DIRTY   BX_CONST64(0x0000000000000001)
+#define QCOW2_INCOMPAT_CORRUPT BX_CONST64(0x0000000000000002)
+#define QCOW2_INCOMPAT_MASK    (QCOW2_INCOMPAT_DIRTY | QCOW2_INCOMPAT_CORRUPT)
+
+// header extensions
+#define QCOW2_EXT_END          0x00000000
+#define QCOW2_EXT_BACKING_FMT  0xe2792aca
+
+// number of L2 tables kept in memory
+#define QCOW2_L2_CACHE_SIZE    16
+
+#if defined(_MSC_VER)
+#pragma pack(push, 1)
+#elif defined(__MWERKS__) && defined(macintosh)
+#pragma options align=packed
+#endif
+
+ typedef struct
+ {
+   // the fields in the header are kept in big endian
+   Bit32u  magic;
+   Bit32u  version;
+   Bit64u  backing_file_offset;
+   Bit32u  backing_file_size;
+   Bit32u  cluster_bits;
+   Bit64u  size;
+   Bit32u  crypt_method;
+   Bit32u  l1_size;
+   Bit64u  l1_table_offset;
+   Bit64u  refcount_table_offset;
+   Bit32u  refcount_table_clusters;
+   Bit32u  nb_snapshots;
+   Bit64u  snapshots_offset;
+   // version 3 only
+   Bit64u  incompatible_features;
+   Bit64u  compatible_features;
+   Bit64u  autoclear_features;
+   Bit32u  refcount_order;
+   Bit32u  header_length;
+ }
+#if !defined(_MSC_VER)
+ GCC_ATTRIBUTE((packed))
+#endif
+ qcow2_header_t;
+
+#if defined(_MSC_VER)
+#pragma pack(pop)
+#elif defined(__MWERKS__) && defined(macintosh)
+#pragma options align=reset
+#endif
+
+class qcow2_image_t : public device_image_t
+{
+  public:
+    qcow2_image_t();
+    virtual ~qcow2_image_t();
+
+    int open(const char* pathname, int flags);
+    void close();
+    Bit64s lseek(Bit64s offset, int whence);
+    ssize_t read(void* buf, size_t count);
+    ssize_t write(const void* buf, size_t count);
+    ssize_t pread(Bit64s offset, void* buf, size_t count);
+    ssize_t pwrite(Bit64s offset, const void* buf, size_t count);
+
+    static int check_format(int fd, Bit64u imgsize);
+
+    bx_bool save_state(const char *backup_fname);
+    void restore_state(const char *backup_fname);
+
+  private:
+    int read_header(void);
+    int open_backing_file(const char *backing_fmt);
+
+    Bit64u *get_l2_table(Bit64u l2_offset, bx_bool load);
+    int get_l2_entry(Bit64u guest_offset, Bit64u *l2_entry);
+    int set_l2_entry(Bit64u guest_offset, Bit64u l2_entry);
+
+    int read_cluster(Bit64u guest_offset, Bit64u l2_entry, Bit8u *buf);
+    int read_compressed(Bit64u l2_entry);
+    int read_backing(Bit64u guest_offset, Bit8u *buf, Bit32u count);
+
+    Bit64s alloc_clusters(Bit32u count);
+    int update_refcount(Bit64u host_offset, int addend);
+    int grow_refcount_table(Bit64u min_entries);
+    void free_clusters(Bit64u l2_entry);
+    int add_run(Bit64u host_offset, Bit8u *buf, Bit32u count, bx_bool write);
+    int flush_run(void);
+
+    int fd;
+    const char *pathname;
+    bx_bool readonly;
+    qcow2_header_t header;
+    Bit32u version;
+    Bit32u header_length;
+
+    Bit32u cluster_bits;
+    Bit32u cluster_size;
+    Bit32u l2_bits;
+    Bit32u l2_size;
+    Bit32u csize_shift;
+    Bit64u csize_mask;
+
+    Bit64u *l1_table;
+    Bit32u l1_size;
+
+    // LRU cache of L2 tables (entries kept in disk byte order)
+    struct {
+      Bit64u offset;
+      Bit64u *table;
+      Bit32u used;
+    } l2_cache[QCOW2_L2_CACHE_SIZE];
+    Bit32u l2_cache_counter;
+
+    Bit64u *refcount_table;
+    Bit64u refcount_table_size;
+    Bit32u refcount_bits;
+    Bit32u refcount_block_bits;
+    Bit8u *refcount_block;
+    Bit64u refcount_block_offset;
+
+    Bit64u free_cluster_offset;
+
+    // last decompressed cluster
+    Bit8u *cluster_cache;
+    Bit64u cluster_cache_offset;
+    Bit8u *cluster_data;
+
+    // contiguous host run collected while walking the clusters
+    struct {
+      Bit64u host_offset;
+      Bit8u *buf;
+      Bit32u count;
+      bx_bool write;
+    } run;
+
+    device_image_t *backing;
+    char *backing_name;
+
+    Bit64s cur_offset;
+};
+
+#endif
@@ -162,12 +162,15 @@ public:
   virtual bx_bool bmdma_read_sector(Bit8u channel, Bit8u *buffer, Bit32u *sector_size) {
     STUBFUNC(HD, bmdma_read_sector); return 0;
   }
-  virtual bx_bool bmdma_write_sector(Bit8u channel, Bit8u *buffer) {
+  virtual bx_bool bmdma_write_sector(Bit8u channel, Bit8u *buffer, Bit32u *sector_size) {
     STUBFUNC(HD, bmdma_write_sector); return 0;
   }
   virtual void bmdma_complete(Bit8u channel) {
     STUBFUNC(HD, bmdma_complete);
   }
+  virtual Bit32u bmdma_block_size(Bit8u channel) {
+    return 0;
+  }
 };
 
 class BOCHSAPI bx_floppy_stub_c : public bx_devmodel_c {
@@ -278,6 +281,7 @@ public:
     return 0;
   }
   virtual void bmdma_set_irq(Bit8u channel) {}
+  virtual void bmdma_resume(Bit8u channel) {}
 };
 
 class BOCHSAPI bx_speaker_stub_c : public bx_devmodel_c {
@@ -602,14 +606,7 @@ BX_CPP_INLINE void DEV_MEM_READ_PHYSICAL(bx_phy_address phy_addr, unsigned len,
 
 BX_CPP_INLINE void DEV_MEM_READ_PHYSICAL_DMA(bx_phy_address phy_addr, unsigned len, Bit8u *ptr)
 {
-  while(len > 0) { 
-    unsigned remainingInPage = 0x1000 - (phy_addr & 0xfff);
-    if (len < remainingInPage) remainingInPage = len;
-    BX_MEM(0)->dmaReadPhysicalPage(phy_addr, remainingInPage, ptr);
-    ptr += remainingInPage;
-    phy_addr += remainingInPage;
-    len -= remainingInPage;
-  }
+  BX_MEM(0)->dmaReadPhysical(phy_addr, len, ptr);
 }
 
 // memory stub has an assumption that there are no memory accesses splitting 4K page
@@ -630,14 +627,7 @@ BX_CPP_INLINE void DEV_MEM_WRITE_PHYSICAL(bx_phy_address phy_addr, unsigned len,
 
 BX_CPP_INLINE void DEV_MEM_WRITE_PHYSICAL_DMA(bx_phy_address phy_addr, unsigned len, Bit8u *ptr)
 {
-  while(len > 0) { 
-    unsigned remainingInPage = 0x1000 - (phy_addr & 0xfff);
-    if (len < remainingInPage) remainingInPage = len;
-    BX_MEM(0)->dmaWritePhysicalPage(phy_addr, remainingInPage, ptr);
-    ptr += remainingInPage;
-    phy_addr += remainingInPage;
-    len -= remainingInPage;
-  }
+  BX_MEM(0)->dmaWritePhysical(phy_addr, len, ptr);
 }
 
 BOCHSAPI extern bx_devices_c bx_devices;
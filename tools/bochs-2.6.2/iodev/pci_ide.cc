@@ -33,6 +33,7 @@
 
 #include "pci.h"
 #include "pci_ide.h"
+#include "hdimage/hdimage.h"
 
 #define LOG_THIS thePciIdeController->
 
@@ -60,10 +61,15 @@ bx_pci_ide_c::bx_pci_ide_c()
   s.bmdma[1].timer_index = BX_NULL_TIMER_HANDLE;
   s.bmdma[0].buffer = NULL;
   s.bmdma[1].buffer = NULL;
+  s.bmdma[0].dma_nseg = 0;
+  s.bmdma[1].dma_nseg = 0;
 }
 
 bx_pci_ide_c::~bx_pci_ide_c()
 {
+  hdimage_aio_flush();
+  bmdma_release(0);
+  bmdma_release(1);
   if (s.bmdma[0].buffer != NULL) {
     delete [] s.bmdma[0].buffer;
   }
@@ -128,12 +134,17 @@ void bx_pci_ide_c::reset(unsigned type)
     BX_PIDE_THIS pci_conf[0x43] = 0x80;
   }
   BX_PIDE_THIS pci_conf[0x44] = 0x00;
+  hdimage_aio_flush();
   for (unsigned i=0; i<2; i++) {
+    bmdma_release(i);
+    BX_PIDE_THIS s.bmdma[i].aio_wait = 0;
     BX_PIDE_THIS s.bmdma[i].cmd_ssbm = 0;
     BX_PIDE_THIS s.bmdma[i].cmd_rwcon = 0;
     BX_PIDE_THIS s.bmdma[i].status = 0;
     BX_PIDE_THIS s.bmdma[i].dtpr = 0;
     BX_PIDE_THIS s.bmdma[i].prd_current = 0;
+    BX_PIDE_THIS s.bmdma[i].prd_fetched = 0;
+    BX_PIDE_THIS s.bmdma[i].prd_done = 0;
     BX_PIDE_THIS s.bmdma[i].buffer_top = BX_PIDE_THIS s.bmdma[i].buffer;
     BX_PIDE_THIS s.bmdma[i].buffer_idx = BX_PIDE_THIS s.bmdma[i].buffer;
   }
@@ -159,6 +170,9 @@ void bx_pci_ide_c::register_state(void)
     BXRS_HEX_PARAM_FIELD(ctrl, status, BX_PIDE_THIS s.bmdma[i].status);
     BXRS_HEX_PARAM_FIELD(ctrl, dtpr, BX_PIDE_THIS s.bmdma[i].dtpr);
     BXRS_HEX_PARAM_FIELD(ctrl, prd_current, BX_PIDE_THIS s.bmdma[i].prd_current);
+    BXRS_PARAM_BOOL(ctrl, prd_fetched, BX_PIDE_THIS s.bmdma[i].prd_fetched);
+    BXRS_HEX_PARAM_FIELD(ctrl, prd_done, BX_PIDE_THIS s.bmdma[i].prd_done);
+    BXRS_PARAM_BOOL(ctrl, aio_wait, BX_PIDE_THIS s.bmdma[i].aio_wait);
     BXRS_PARAM_SPECIAL32(ctrl, buffer_top,
        BX_PIDE_THIS param_save_handler, BX_PIDE_THIS param_restore_handler);
     BXRS_PARAM_SPECIAL32(ctrl, buffer_idx,
@@ -174,6 +188,15 @@ void bx_pci_ide_c::after_restore_state(void)
   {
     BX_INFO(("new BM-DMA address: 0x%04x", BX_PIDE_THIS pci_base_address[4]));
   }
+  // a transfer interrupted by the save is retried from the start of the
+  // chunk, the drive does not know about it anymore
+  hdimage_aio_flush();
+  for (unsigned i=0; i<2; i++) {
+    bmdma_release(i);
+    if (BX_PIDE_THIS s.bmdma[i].aio_wait) {
+      bx_pc_system.activate_timer(BX_PIDE_THIS s.bmdma[i].timer_index, 1000, 0);
+    }
+  }
 }
 
 Bit64s bx_pci_ide_c::param_save_handler(void *devptr, bx_param_c *param)
@@ -231,6 +254,26 @@ void bx_pci_ide_c::bmdma_set_irq(Bit8u channel)
   }
 }
 
+// The drive's I/O thread is done with the current chunk
+void bx_pci_ide_c::bmdma_resume(Bit8u channel)
+{
+  if ((channel < 2) && BX_PIDE_THIS s.bmdma[channel].aio_wait) {
+    bmdma_release(channel);
+    if (BX_PIDE_THIS s.bmdma[channel].status & 0x01) {
+      bx_pc_system.activate_timer(BX_PIDE_THIS s.bmdma[channel].timer_index, 1, 0);
+    }
+  }
+}
+
+void bx_pci_ide_c::bmdma_release(Bit8u channel)
+{
+  if (BX_PIDE_THIS s.bmdma[channel].dma_nseg > 0) {
+    BX_MEM(0)->dmaUnmapPhysical(BX_PIDE_THIS s.bmdma[channel].dma_seg,
+                                BX_PIDE_THIS s.bmdma[channel].dma_nseg);
+    BX_PIDE_THIS s.bmdma[channel].dma_nseg = 0;
+  }
+}
+
 void bx_pci_ide_c::timer_handler(void *this_ptr)
 {
   bx_pci_ide_c *class_ptr = (bx_pci_ide_c *) this_ptr;
@@ -241,7 +284,10 @@ void bx_pci_ide_c::timer()
 {
   int timer_id, count;
   Bit8u channel;
-  Bit32u size, sector_size;
+  Bit32u addr, size, sector_size, block_size, len;
+  bx_dma_seg_t seg[BX_PIDE_DMA_SEGS];
+  unsigned nseg = 0, i;
+  bx_bool direct = 0, ok;
   struct {
     Bit32u addr;
     Bit32u size;
@@ -253,6 +299,7 @@ void bx_pci_ide_c::timer()
   } else {
     channel = 1;
   }
+  BX_PIDE_THIS s.bmdma[channel].aio_wait = 0;
   if (((BX_PIDE_THIS s.bmdma[channel].status & 0x01) == 0) ||
       (BX_PIDE_THIS s.bmdma[channel].prd_current == 0)) {
     return;
@@ -263,12 +310,75 @@ void bx_pci_ide_c::timer()
   if (size == 0) {
     size = 0x10000;
   }
-  if (BX_PIDE_THIS s.bmdma[channel].cmd_rwcon) {
-    BX_DEBUG(("READ DMA to addr=0x%08x, size=0x%08x", prd.addr, size));
+  // skip the part of the PRD already moved by an earlier direct transfer
+  addr = prd.addr + BX_PIDE_THIS s.bmdma[channel].prd_done;
+  size -= BX_PIDE_THIS s.bmdma[channel].prd_done;
+  // If the PRD covers guest RAM in whole blocks of the drive, the drive reads
+  // and writes the guest pages directly. MMIO targets and partial blocks left
+  // over from the previous PRD go through the bounce buffer.
+  if ((BX_PIDE_THIS s.bmdma[channel].buffer_top == BX_PIDE_THIS s.bmdma[channel].buffer_idx) &&
+      !BX_PIDE_THIS s.bmdma[channel].prd_fetched) {
+    block_size = DEV_hd_bmdma_block_size(channel);
+    if ((block_size > 0) && ((size % block_size) == 0)) {
+      nseg = BX_MEM(0)->dmaMapPhysical(addr, size,
+               BX_PIDE_THIS s.bmdma[channel].cmd_rwcon ? BX_WRITE : BX_READ, seg, BX_PIDE_DMA_SEGS);
+      for (i = 0, len = 0; i < nseg; i++) {
+        if ((seg[i].host == NULL) || ((seg[i].len % block_size) != 0)) break;
+        len += seg[i].len;
+      }
+      direct = ((i == nseg) && (len == size));
+      if (!direct) {
+        BX_MEM(0)->dmaUnmapPhysical(seg, nseg);
+      }
+    }
+  }
+  if (direct) {
+    BX_DEBUG(("%s DMA direct at addr=0x%08x, size=0x%08x",
+              BX_PIDE_THIS s.bmdma[channel].cmd_rwcon ? "READ" : "WRITE", addr, size));
+    ok = 1;
+    sector_size = 0;
+    for (i = 0; ok && i < nseg; i++) {
+      for (len = 0; len < seg[i].len; len += sector_size) {
+        sector_size = seg[i].len - len;
+        if (BX_PIDE_THIS s.bmdma[channel].cmd_rwcon) {
+          ok = DEV_hd_bmdma_read_sector(channel, seg[i].host + len, &sector_size);
+        } else {
+          ok = DEV_hd_bmdma_write_sector(channel, seg[i].host + len, &sector_size);
+        }
+        if (!ok || (sector_size == 0)) break;
+        BX_PIDE_THIS s.bmdma[channel].prd_done += sector_size;
+      }
+      if (sector_size == 0) break;
+    }
+    // the mapping of an earlier attempt is not needed anymore, the drive
+    // has either finished with it or works on the new one now
+    bmdma_release(channel);
+    if (ok && (sector_size == 0)) {
+      // the drive is busy in the background and owns the guest pages
+      // until it calls bmdma_resume()
+      memcpy(BX_PIDE_THIS s.bmdma[channel].dma_seg, seg, nseg * sizeof(bx_dma_seg_t));
+      BX_PIDE_THIS s.bmdma[channel].dma_nseg = nseg;
+      BX_PIDE_THIS s.bmdma[channel].aio_wait = 1;
+      return;
+    }
+    BX_MEM(0)->dmaUnmapPhysical(seg, nseg);
+    if (!ok) {
+      BX_PIDE_THIS s.bmdma[channel].prd_done = 0;
+      BX_PIDE_THIS s.bmdma[channel].status &= ~0x01;
+      BX_PIDE_THIS s.bmdma[channel].status |= 0x06;
+      return;
+    }
+  } else if (BX_PIDE_THIS s.bmdma[channel].cmd_rwcon) {
+    BX_DEBUG(("READ DMA to addr=0x%08x, size=0x%08x", addr, size));
     count = size - (BX_PIDE_THIS s.bmdma[channel].buffer_top - BX_PIDE_THIS s.bmdma[channel].buffer_idx);
     while (count > 0) {
       sector_size = count;
       if (DEV_hd_bmdma_read_sector(channel, BX_PIDE_THIS s.bmdma[channel].buffer_top, &sector_size)) {
+        if (sector_size == 0) {
+          // data not there yet, the drive is reading it in the background
+          BX_PIDE_THIS s.bmdma[channel].aio_wait = 1;
+          return;
+        }
         BX_PIDE_THIS s.bmdma[channel].buffer_top += sector_size;
         count -= sector_size;
       } else {
@@ -280,28 +390,40 @@ void bx_pci_ide_c::timer()
       BX_PIDE_THIS s.bmdma[channel].status |= 0x06;
       return;
     } else {
-      DEV_MEM_WRITE_PHYSICAL_DMA(prd.addr, size, BX_PIDE_THIS s.bmdma[channel].buffer_idx);
+      DEV_MEM_WRITE_PHYSICAL_DMA(addr, size, BX_PIDE_THIS s.bmdma[channel].buffer_idx);
       BX_PIDE_THIS s.bmdma[channel].buffer_idx += size;
     }
   } else {
-    BX_DEBUG(("WRITE DMA from addr=0x%08x, size=0x%08x", prd.addr, size));
-    DEV_MEM_READ_PHYSICAL_DMA(prd.addr, size, BX_PIDE_THIS s.bmdma[channel].buffer_top);
-    BX_PIDE_THIS s.bmdma[channel].buffer_top += size;
+    if (!BX_PIDE_THIS s.bmdma[channel].prd_fetched) {
+      BX_DEBUG(("WRITE DMA from addr=0x%08x, size=0x%08x", addr, size));
+      DEV_MEM_READ_PHYSICAL_DMA(addr, size, BX_PIDE_THIS s.bmdma[channel].buffer_top);
+      BX_PIDE_THIS s.bmdma[channel].buffer_top += size;
+    }
     count = BX_PIDE_THIS s.bmdma[channel].buffer_top - BX_PIDE_THIS s.bmdma[channel].buffer_idx;
     while (count > 511) {
-      if (DEV_hd_bmdma_write_sector(channel, BX_PIDE_THIS s.bmdma[channel].buffer_idx)) {
-        BX_PIDE_THIS s.bmdma[channel].buffer_idx += 512;
-        count -= 512;
+      sector_size = count & ~0x1ff;
+      if (DEV_hd_bmdma_write_sector(channel, BX_PIDE_THIS s.bmdma[channel].buffer_idx, &sector_size)) {
+        if (sector_size == 0) {
+          // the drive is still writing the data in the background, the
+          // PRD has been fetched already
+          BX_PIDE_THIS s.bmdma[channel].prd_fetched = 1;
+          BX_PIDE_THIS s.bmdma[channel].aio_wait = 1;
+          return;
+        }
+        BX_PIDE_THIS s.bmdma[channel].buffer_idx += sector_size;
+        count -= sector_size;
       } else {
         break;
       }
     };
+    BX_PIDE_THIS s.bmdma[channel].prd_fetched = 0;
     if (count > 511) {
       BX_PIDE_THIS s.bmdma[channel].status &= ~0x01;
       BX_PIDE_THIS s.bmdma[channel].status |= 0x06;
       return;
     }
   }
+  BX_PIDE_THIS s.bmdma[channel].prd_done = 0;
   if (prd.size & 0x80000000) {
     BX_PIDE_THIS s.bmdma[channel].status &= ~0x01;
     BX_PIDE_THIS s.bmdma[channel].status |= 0x04;
@@ -398,6 +520,8 @@ void bx_pci_ide_c::write(Bit32u address, Bit32u value, unsigned io_len)
         BX_PIDE_THIS s.bmdma[channel].cmd_ssbm = 1;
         BX_PIDE_THIS s.bmdma[channel].status |= 0x01;
         BX_PIDE_THIS s.bmdma[channel].prd_current = BX_PIDE_THIS s.bmdma[channel].dtpr;
+        BX_PIDE_THIS s.bmdma[channel].prd_fetched = 0;
+        BX_PIDE_THIS s.bmdma[channel].prd_done = 0;
         BX_PIDE_THIS s.bmdma[channel].buffer_top = BX_PIDE_THIS s.bmdma[channel].buffer;
         BX_PIDE_THIS s.bmdma[channel].buffer_idx = BX_PIDE_THIS s.bmdma[channel].buffer;
         bx_pc_system.activate_timer(BX_PIDE_THIS s.bmdma[channel].timer_index, 1000, 0);
@@ -31,6 +31,9 @@
 #  define BX_PIDE_THIS_PTR this
 #endif
 
+// max. number of host memory segments a PRD is split into for direct transfer
+#define BX_PIDE_DMA_SEGS 16
+
 class bx_pci_ide_c : public bx_pci_ide_stub_c {
 public:
   bx_pci_ide_c();
@@ -39,6 +42,7 @@ public:
   virtual void reset(unsigned type);
   virtual bx_bool bmdma_present(void);
   virtual void bmdma_set_irq(Bit8u channel);
+  virtual void bmdma_resume(Bit8u channel);
   virtual void register_state(void);
   virtual void after_restore_state(void);
   static Bit64s param_save_handler(void *devptr, bx_param_c *param);
@@ -55,6 +59,7 @@ public:
   BX_PIDE_SMF void timer(void);
 
 private:
+  BX_PIDE_SMF void bmdma_release(Bit8u channel);
 
   struct {
     unsigned chipset;
@@ -64,6 +69,12 @@ private:
       Bit8u  status;
       Bit32u dtpr;
       Bit32u prd_current;
+      bx_bool prd_fetched;
+      Bit32u prd_done;
+      bx_bool aio_wait;  // waiting for the drive's I/O thread
+      // guest pages the drive's I/O thread works on
+      bx_dma_seg_t dma_seg[BX_PIDE_DMA_SEGS];
+      unsigned dma_nseg;
       int timer_index;
       Bit8u *buffer;
       Bit8u *buffer_top;
@@ -62,6 +62,7 @@ void bx_unmapped_c::init(void)
   s.port8e = 0x00;
   s.shutdown = 0;
   s.port_e9_hack = SIM->get_param_bool(BXPN_PORT_E9_HACK)->get();
+  s.snapshot_port = SIM->get_param_bool(BXPN_SR_SNAPSHOT_PORT)->get();
 }
 
 // static IO port read callback handler
@@ -248,6 +249,19 @@ void bx_unmapped_c::write(Bit32u address, Bit32u value, unsigned io_len)
         // output 'D' to port 8900, and bochs quits to debugger
         case 'D': bx_debug_break(); break;
 #endif
+        // output 'T' to port 8900 to take an in-memory snapshot of the
+        // simulation state and 'R' to restore it. Both are done after
+        // completion of the current instruction.
+        case 'T':
+          if (BX_UM_THIS s.snapshot_port)
+            bx_pc_system.request_snapshot(BX_SNAPSHOT_TAKE);
+          BX_UM_THIS s.shutdown = 0;
+          break;
+        case 'R':
+          if (BX_UM_THIS s.snapshot_port)
+            bx_pc_system.request_snapshot(BX_SNAPSHOT_RESTORE);
+          BX_UM_THIS s.shutdown = 0;
+          break;
         default : BX_UM_THIS s.shutdown = 0; break;
       }
       if (BX_UM_THIS s.shutdown == 8) {
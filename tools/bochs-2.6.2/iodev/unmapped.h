@@ -50,6 +50,7 @@ private:
     Bit8u port8e;
     Bit8u shutdown;
     bx_bool port_e9_hack;
+    bx_bool snapshot_port;
   } s;  // state information
 };
 
@@ -249,12 +249,7 @@ void scsi_device_t::scsi_read_data(Bit32u tag)
     scsi_command_complete(r, STATUS_CHECK_CONDITION, SENSE_HARDWARE_ERROR);
 #endif
   } else {
-    ret = (int)hdimage->lseek(r->sector * 512, SEEK_SET);
-    if (ret < 0) {
-      BX_ERROR(("could not lseek() hard drive image file"));
-      scsi_command_complete(r, STATUS_CHECK_CONDITION, SENSE_HARDWARE_ERROR);
-    }
-    ret = hdimage->read((bx_ptr_t)r->dma_buf, r->buf_len);
+    ret = (int)hdimage->pread(r->sector * 512, r->dma_buf, r->buf_len);
     if (ret < r->buf_len) {
       BX_ERROR(("could not read() hard drive image file"));
       scsi_command_complete(r, STATUS_CHECK_CONDITION, SENSE_HARDWARE_ERROR);
@@ -306,12 +301,7 @@ int scsi_device_t::scsi_write_data(Bit32u tag)
   if (type == SCSIDEV_TYPE_DISK) {
     n = r->buf_len / 512;
     if (n) {
-      ret = (int)hdimage->lseek(r->sector * 512, SEEK_SET);
-      if (ret < 0) {
-        BX_ERROR(("could not lseek() hard drive image file"));
-        scsi_command_complete(r, STATUS_CHECK_CONDITION, SENSE_HARDWARE_ERROR);
-      }
-      ret = hdimage->write((bx_ptr_t)r->dma_buf, r->buf_len);
+      ret = (int)hdimage->pwrite(r->sector * 512, r->dma_buf, r->buf_len);
       r->sector += n;
       r->sector_count -= n;
       if (ret < r->buf_len) {
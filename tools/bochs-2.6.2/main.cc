@@ -934,6 +934,127 @@ bx_bool load_and_init_display_lib(void)
   return true;
 }
 
+#if BX_SUPPORT_SMP && BX_DEBUGGER == 0
+
+// Threaded SMP simulation: every processor is simulated by its own host
+// thread. The threads run in rounds, each processor executes host_quantum
+// instructions per round (or less if it gets halted) and then waits for
+// the others. The emulated time is advanced by the main thread between the
+// rounds, so timer callbacks never race with the processor threads.
+
+struct bx_smp_thread_t {
+  unsigned cpu;
+  Bit32u executed;  // instructions executed in the last round
+  bx_thread_sem_t start;
+  BX_THREAD_ID(thread_id);
+};
+
+static bx_smp_thread_t *bx_smp_thread;
+static bx_thread_sem_t bx_smp_round_done;
+static Bit32u bx_smp_host_quantum;
+static volatile bx_bool bx_smp_threads_exit;
+
+BX_THREAD_FUNC(bx_smp_cpu_thread, indata)
+{
+  bx_smp_thread_t *thread = (bx_smp_thread_t *) indata;
+
+  while (1) {
+    bx_wait_sem(&thread->start);
+    if (bx_smp_threads_exit) break;
+    thread->executed = BX_CPU(thread->cpu)->cpu_run_quantum(bx_smp_host_quantum);
+    bx_set_sem(&bx_smp_round_done);
+  }
+
+  BX_THREAD_EXIT;
+}
+
+static bx_bool bx_smp_threads_supported(void)
+{
+  if (! SIM->get_param_bool(BXPN_SMP_HOST_THREADS)->get())
+    return 0;
+
+#if BX_GDBSTUB
+  if (bx_dbg.gdbstub_enabled) {
+    BX_ERROR(("cpu: host_threads is not supported with gdbstub, ignored"));
+    return 0;
+  }
+#endif
+
+#if BX_LARGE_RAMFILE
+  if (SIM->get_param_num(BXPN_HOST_MEM_SIZE)->get() < SIM->get_param_num(BXPN_MEM_SIZE)->get()) {
+    BX_ERROR(("cpu: host_threads requires host memory size equal to guest memory size, ignored"));
+    return 0;
+  }
+#endif
+
+  return 1;
+}
+
+static void bx_smp_run_threaded(void)
+{
+  unsigned n;
+
+  bx_smp_host_quantum = SIM->get_param_num(BXPN_SMP_HOST_QUANTUM)->get();
+  bx_smp_threads_exit = 0;
+
+  bx_pc_system.init_smp_threads();
+  bx_create_sem(&bx_smp_round_done);
+
+  bx_smp_thread = new bx_smp_thread_t[BX_SMP_PROCESSORS];
+  for (n=0; n<BX_SMP_PROCESSORS; n++) {
+    bx_smp_thread[n].cpu = n;
+    if (! bx_create_sem(&bx_smp_thread[n].start))
+      BX_PANIC(("failed to create semaphore for CPU%d thread", n));
+    BX_THREAD_CREATE(bx_smp_cpu_thread, &bx_smp_thread[n], bx_smp_thread[n].thread_id);
+  }
+
+  BX_INFO(("SMP: %d processors simulated by host threads, host_quantum=%d",
+    BX_SMP_PROCESSORS, bx_smp_host_quantum));
+
+  while (1) {
+    bx_pc_system.smp_stop_round = 0;
+    bx_pc_system.smp_in_round = 1;
+
+    for (n=0; n<BX_SMP_PROCESSORS; n++)
+      bx_set_sem(&bx_smp_thread[n].start);
+    for (n=0; n<BX_SMP_PROCESSORS; n++)
+      bx_wait_sem(&bx_smp_round_done);
+
+    bx_pc_system.smp_in_round = 0;
+
+    if (bx_pc_system.smp_reset_pending) {
+      bx_pc_system.smp_reset_pending = 0;
+      bx_pc_system.Reset(bx_pc_system.smp_reset_type);
+    }
+
+    bx_pc_system.handle_snapshot_request();
+
+    // all processors were halted for the whole round
+    bx_bool idle = 1;
+    for (n=0; n<BX_SMP_PROCESSORS; n++) {
+      if (bx_smp_thread[n].executed != 0 ||
+          BX_CPU(n)->activity_state == BX_CPU_C::BX_ACTIVITY_STATE_ACTIVE) idle = 0;
+    }
+    if (! idle || ! bx_pc_system.skip_idle_ticks())
+      BX_TICKN(bx_smp_host_quantum);
+
+    if (bx_pc_system.kill_bochs_request)
+      break;
+  }
+
+  bx_smp_threads_exit = 1;
+  for (n=0; n<BX_SMP_PROCESSORS; n++)
+    bx_set_sem(&bx_smp_thread[n].start);
+  for (n=0; n<BX_SMP_PROCESSORS; n++) {
+    bx_thread_join(bx_smp_thread[n].thread_id);
+    bx_destroy_sem(&bx_smp_thread[n].start);
+  }
+  bx_destroy_sem(&bx_smp_round_done);
+  delete [] bx_smp_thread;
+}
+
+#endif
+
 int bx_begin_simulation (int argc, char *argv[])
 {
   bx_user_quit = 0;
@@ -1018,11 +1139,16 @@ int bx_begin_simulation (int argc, char *argv[])
         BX_CPU(0)->cpu_loop();
         if (bx_pc_system.kill_bochs_request)
           break;
+        bx_pc_system.handle_snapshot_request();
       }
-      // for one processor, the only reason for cpu_loop to return is
-      // that kill_bochs_request was set by the GUI interface.
+      // for one processor, the only reasons for cpu_loop to return are
+      // that kill_bochs_request was set by the GUI interface or that the
+      // guest requested an in-memory snapshot.
     }
 #if BX_SUPPORT_SMP
+    else if (bx_smp_threads_supported()) {
+      bx_smp_run_threaded();
+    }
     else {
       // SMP simulation: do a few instructions on each processor, then switch
       // to another.  Increasing quantum speeds up overall performance, but
@@ -1032,27 +1158,67 @@ int bx_begin_simulation (int argc, char *argv[])
       // the next processor.
 
       static int quantum = SIM->get_param_num(BXPN_SMP_QUANTUM)->get();
-      Bit32u executed = 0, processor = 0;
+      Bit32u executed = 0, processor = 0, scheduled = 0;
+      bx_bool idle = 1;
+      // rounds a processor caught in a PAUSE spin loop still has to sit out,
+      // the time is advanced by the average of the processors that did run.
+      // A pending event or interrupt ends the wait at once.
+      Bit32u *spin_yield = new Bit32u[BX_SMP_PROCESSORS];
+      memset(spin_yield, 0, BX_SMP_PROCESSORS * sizeof(Bit32u));
 
       while (1) {
-         // do some instructions in each processor
-         Bit64u icount = BX_CPU(processor)->icount_last_sync = BX_CPU(processor)->get_icount();
-         BX_CPU(processor)->cpu_run_trace();
+         if (spin_yield[processor] > 0 && BX_CPU(processor)->unmasked_events_pending())
+           spin_yield[processor] = 0;
 
-         // see how many instruction it was able to run
-         Bit32u n = (Bit32u)(BX_CPU(processor)->get_icount() - icount);
-         if (n == 0) n = quantum; // the CPU was halted
-         executed += n;
+         if (spin_yield[processor] > 0) {
+           // leave the turn to the processors doing useful work
+           spin_yield[processor]--;
+           idle = 0;
+         }
+         else {
+           // do some instructions in each processor
+           Bit64u icount = BX_CPU(processor)->icount_last_sync = BX_CPU(processor)->get_icount();
+           BX_CPU(processor)->cpu_run_trace();
+
+           // see how many instruction it was able to run
+           Bit32u n = (Bit32u)(BX_CPU(processor)->get_icount() - icount);
+           if (n != 0 || BX_CPU(processor)->activity_state == BX_CPU_C::BX_ACTIVITY_STATE_ACTIVE)
+             idle = 0;
+           if (n == 0) n = quantum; // the CPU was halted
+           executed += n;
+           scheduled++;
+
+           if (BX_CPU(processor)->spin_loop) {
+             BX_CPU(processor)->spin_loop = 0;
+             spin_yield[processor] = BX_SMP_SPIN_YIELD_ROUNDS;
+           }
+         }
 
          if (++processor == BX_SMP_PROCESSORS) {
            processor = 0;
-           BX_TICKN(executed / BX_SMP_PROCESSORS);
-           executed %= BX_SMP_PROCESSORS;
+           // if all processors are halted, pass the time until the next timer fires
+           if (idle && bx_pc_system.skip_idle_ticks()) {
+             executed = 0;
+           }
+           else if (scheduled > 0) {
+             BX_TICKN(executed / scheduled);
+             executed %= scheduled;
+           }
+           else {
+             // all processors sat out a spin loop, time goes on anyway
+             BX_TICKN(quantum);
+           }
+           idle = 1;
+           scheduled = 0;
          }
 
          if (bx_pc_system.kill_bochs_request)
            break;
+
+         bx_pc_system.handle_snapshot_request();
       }
+
+      delete [] spin_yield;
     }
 #endif /* BX_SUPPORT_SMP */
   }
@@ -1072,6 +1238,11 @@ void bx_stop_simulation(void)
   // the cpu loop will exit very soon after this condition is set.
 }
 
+void bx_sr_before_save_state(void)
+{
+  BX_MEM(0)->before_save_state();
+}
+
 void bx_sr_after_restore_state(void)
 {
 #if BX_SUPPORT_SMP == 0
@@ -1081,6 +1252,8 @@ void bx_sr_after_restore_state(void)
     BX_CPU(i)->after_restore_state();
   }
 #endif
+  BX_MEM(0)->after_restore_state();
+  bx_pc_system.after_restore_state();
   DEV_after_restore_state();
 }
 
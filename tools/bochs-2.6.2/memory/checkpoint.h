@@ -0,0 +1,62 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2013  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+
+// Guest RAM of incremental save/restore checkpoints, shared with bxcommit.
+//
+// A full checkpoint stores the guest RAM in CHECKPOINT_RAM_FILE, at the
+// offset of the guest physical address. An incremental checkpoint stores an
+// empty CHECKPOINT_RAM_FILE and a CHECKPOINT_DELTA_FILE with the pages
+// written since the parent checkpoint:
+//
+//   checkpoint_delta_header_t
+//   Bit32u page number [pages]
+//   Bit8u  page data [pages][CHECKPOINT_PAGE_SIZE]
+//
+// The values are stored in host byte order, like the rest of the saved state.
+
+#ifndef BX_CHECKPOINT_H
+#define BX_CHECKPOINT_H
+
+#define CHECKPOINT_RAM_FILE      "memory.ram"
+#define CHECKPOINT_DELTA_FILE    "memory.delta"
+
+#define CHECKPOINT_DELTA_MAGIC   "Bochs RAM delta"
+#define CHECKPOINT_DELTA_VERSION 0x00010000
+#define CHECKPOINT_PAGE_SIZE     4096
+#define CHECKPOINT_PATH_LEN      512
+
+// guards against loops in the parent links
+#define CHECKPOINT_MAX_CHAIN     4096
+
+typedef struct
+{
+  char   magic[16];
+  Bit32u version;
+  Bit32u page_size;
+  Bit64u ram_size;
+  Bit32u pages;
+  Bit32u reserved;
+  // directory of the parent checkpoint, as given when saving it
+  char   parent[CHECKPOINT_PATH_LEN];
+} checkpoint_delta_header_t;
+
+#endif
@@ -69,15 +69,15 @@ void BX_MEM_C::writePhysicalPage(BX_CPU_C *cpu, bx_phy_address addr, unsigned le
     }
   }
 
-  memory_handler = BX_MEM_THIS memory_handlers[a20addr >> 20];
-  while (memory_handler) {
-    if (memory_handler->begin <= a20addr &&
-          memory_handler->end >= a20addr &&
-          memory_handler->write_handler(a20addr, len, data, memory_handler->param))
-    {
+  memory_handler = BX_MEM_THIS findMemoryHandler(a20addr);
+  if (memory_handler) {
+    BX_LOCK_DEVICES();
+    memory_handler->writes++;
+    if (memory_handler->write_handler(a20addr, len, data, memory_handler->param)) {
+      BX_UNLOCK_DEVICES();
       return;
     }
-    memory_handler = memory_handler->next;
+    BX_UNLOCK_DEVICES();
   }
 
 mem_write:
@@ -227,15 +227,15 @@ void BX_MEM_C::readPhysicalPage(BX_CPU_C *cpu, bx_phy_address addr, unsigned len
     }
   }
 
-  memory_handler = BX_MEM_THIS memory_handlers[a20addr >> 20];
-  while (memory_handler) {
-    if (memory_handler->begin <= a20addr &&
-          memory_handler->end >= a20addr &&
-          memory_handler->read_handler(a20addr, len, data, memory_handler->param))
-    {
+  memory_handler = BX_MEM_THIS findMemoryHandler(a20addr);
+  if (memory_handler) {
+    BX_LOCK_DEVICES();
+    memory_handler->reads++;
+    if (memory_handler->read_handler(a20addr, len, data, memory_handler->param)) {
+      BX_UNLOCK_DEVICES();
       return;
     }
-    memory_handler = memory_handler->next;
+    BX_UNLOCK_DEVICES();
   }
 
 mem_read:
@@ -406,3 +406,169 @@ void BX_MEM_C::dmaWritePhysicalPage(bx_phy_address addr, unsigned len, Bit8u *da
     }
   }
 }
+
+//
+// Split guest physical range into at most max_segs pieces for DMA. Adjacent
+// pages are merged into one piece if they are contiguous in host memory too,
+// so a transfer to RAM usually needs a single memcpy or host I/O call.
+// Pieces which are not RAM backed get NULL host pointer. Returns number of
+// pieces, they could cover less than 'len' bytes if max_segs is too small.
+//
+// For BX_WRITE the write stamps of the mapped pages are invalidated here.
+// The RAM blocks behind the host pointers stay in host memory until the
+// pieces are released with dmaUnmapPhysical(), which must be called for
+// every successful mapping.
+//
+unsigned BX_MEM_C::dmaMapPhysical(bx_phy_address addr, Bit32u len, unsigned rw,
+                                  bx_dma_seg_t *seg, unsigned max_segs)
+{
+  unsigned n = 0;
+
+  while (len > 0) {
+    Bit32u remainingInPage = 0x1000 - (Bit32u)(addr & 0xfff);
+    if (len < remainingInPage) remainingInPage = len;
+
+    Bit8u *memptr = getHostMemAddr(NULL, addr, rw);
+    bx_bool merge = (n > 0 && (seg[n-1].addr + seg[n-1].len) == addr &&
+        (memptr ? (seg[n-1].host != NULL && (seg[n-1].host + seg[n-1].len) == memptr) :
+                  (seg[n-1].host == NULL)));
+    if (! merge && n == max_segs) break;
+#if BX_LARGE_RAMFILE
+    // mapping the next page could swap out the block of this one otherwise
+    if (memptr != NULL) dma_pin_page(addr, memptr, 1);
+#endif
+    if (merge) {
+      seg[n-1].len += remainingInPage;
+    }
+    else {
+      seg[n].addr = addr;
+      seg[n].len  = remainingInPage;
+      seg[n].host = memptr;
+      n++;
+    }
+
+    addr += remainingInPage;
+    len  -= remainingInPage;
+  }
+
+  if (rw != BX_READ) {
+    for (unsigned i=0; i < n; i++) {
+      if (seg[i].host != NULL)
+        pageWriteStampTable.decWriteStampRange(seg[i].addr, seg[i].len);
+    }
+  }
+
+  return n;
+}
+
+// Release the pieces returned by dmaMapPhysical(), their host pointers
+// must not be used anymore.
+void BX_MEM_C::dmaUnmapPhysical(const bx_dma_seg_t *seg, unsigned count)
+{
+#if BX_LARGE_RAMFILE
+  for (unsigned i=0; i < count; i++) {
+    if (seg[i].host == NULL) continue;
+    bx_phy_address addr = seg[i].addr;
+    Bit32u len = seg[i].len;
+    while (len > 0) {
+      Bit32u remainingInPage = 0x1000 - (Bit32u)(addr & 0xfff);
+      if (len < remainingInPage) remainingInPage = len;
+      dma_pin_page(addr, seg[i].host + (Bit32u)(addr - seg[i].addr), -1);
+      addr += remainingInPage;
+      len  -= remainingInPage;
+    }
+  }
+#endif
+}
+
+#if BX_LARGE_RAMFILE
+// A page handed out by dmaMapPhysical() pins its RAM block, allocate_block()
+// never picks a pinned block for swap out. ROM and other host pointers
+// outside of the RAM blocks are left alone.
+void BX_MEM_C::dma_pin_page(bx_phy_address addr, const Bit8u *host, int delta)
+{
+  if (addr >= BX_MEM_THIS len) return;
+
+  Bit32u block = (Bit32u)(addr / BX_MEM_BLOCK_LEN);
+  const Bit8u *base = BX_MEM_THIS blocks[block];
+  if (base != NULL && base != BX_MEM_THIS swapped_out &&
+      host >= base && host < base + BX_MEM_BLOCK_LEN)
+  {
+    BX_MEM_THIS dma_pins[block] += delta;
+  }
+}
+#endif
+
+#define BX_DMA_MAX_SEGS 16
+
+void BX_MEM_C::dmaReadPhysical(bx_phy_address addr, Bit32u len, Bit8u *data)
+{
+  bx_dma_seg_t seg[BX_DMA_MAX_SEGS];
+
+  while (len > 0) {
+    unsigned n = dmaMapPhysical(addr, len, BX_READ, seg, BX_DMA_MAX_SEGS);
+    for (unsigned i=0; i < n; i++) {
+      if (seg[i].host != NULL) {
+        memcpy(data, seg[i].host, seg[i].len);
+      }
+      else {
+        // no direct access, go page by page through memory handlers
+        for (Bit32u done = 0; done < seg[i].len; ) {
+          Bit32u chunk = 0x1000 - (Bit32u)((seg[i].addr + done) & 0xfff);
+          if (chunk > seg[i].len - done) chunk = seg[i].len - done;
+          dmaReadPhysicalPage(seg[i].addr + done, chunk, data + done);
+          done += chunk;
+        }
+      }
+      data += seg[i].len;
+      addr += seg[i].len;
+      len  -= seg[i].len;
+    }
+    dmaUnmapPhysical(seg, n);
+  }
+}
+
+void BX_MEM_C::dmaWritePhysical(bx_phy_address addr, Bit32u len, const Bit8u *data)
+{
+  bx_dma_seg_t seg[BX_DMA_MAX_SEGS];
+
+  while (len > 0) {
+    unsigned n = dmaMapPhysical(addr, len, BX_WRITE, seg, BX_DMA_MAX_SEGS);
+    for (unsigned i=0; i < n; i++) {
+      if (seg[i].host != NULL) {
+        memcpy(seg[i].host, data, seg[i].len);
+      }
+      else {
+        // no direct access, go page by page through memory handlers
+        for (Bit32u done = 0; done < seg[i].len; ) {
+          Bit32u chunk = 0x1000 - (Bit32u)((seg[i].addr + done) & 0xfff);
+          if (chunk > seg[i].len - done) chunk = seg[i].len - done;
+          dmaWritePhysicalPage(seg[i].addr + done, chunk, (Bit8u *) data + done);
+          done += chunk;
+        }
+      }
+      data += seg[i].len;
+      addr += seg[i].len;
+      len  -= seg[i].len;
+    }
+    dmaUnmapPhysical(seg, n);
+  }
+}
+
+// gather the guest physical ranges into the contiguous buffer
+void BX_MEM_C::dmaReadPhysicalSG(const bx_dma_seg_t *sg, unsigned count, Bit8u *data)
+{
+  for (unsigned i=0; i < count; i++) {
+    dmaReadPhysical(sg[i].addr, sg[i].len, data);
+    data += sg[i].len;
+  }
+}
+
+// scatter the contiguous buffer to the guest physical ranges
+void BX_MEM_C::dmaWritePhysicalSG(const bx_dma_seg_t *sg, unsigned count, const Bit8u *data)
+{
+  for (unsigned i=0; i < count; i++) {
+    dmaWritePhysical(sg[i].addr, sg[i].len, data);
+    data += sg[i].len;
+  }
+}
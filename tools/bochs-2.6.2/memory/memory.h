@@ -70,18 +70,45 @@ struct memory_handler_struct {
   void *param;
   bx_phy_address begin;
   bx_phy_address end;
-  Bit16u bitmap;
   memory_handler_t read_handler;
   memory_handler_t write_handler;
   memory_direct_access_handler_t da_handler;
+  // access statistics
+  Bit64u reads;
+  Bit64u writes;
+  Bit64u direct;
+};
+
+// Memory handlers are looked up through a two-level table: one entry per
+// megabyte of physical address space, pointing to a table of handlers for
+// the 256 pages of that megabyte. Page tables are only allocated for the
+// megabytes containing a handler.
+#define BX_MEM_HANDLER_PAGES 256
+
+// Piece of guest physical memory for scatter-gather DMA. RAM backed pieces
+// have a host pointer and could be accessed directly by the device, for all
+// others (MMIO, ROM, SMRAM) host is NULL and the access must go through the
+// dmaRead/dmaWrite functions.
+struct bx_dma_seg_t {
+  bx_phy_address addr;
+  Bit32u len;
+  Bit8u *host;
 };
 
 #define SMRAM_CODE  1
 #define SMRAM_DATA  2
 
+// users of the guest RAM write tracking, every one has a bit in the dirty
+// page map which is cleared when the user starts tracking and set by the
+// first write to the page
+#define BX_MEM_DIRTY_SNAPSHOT   0x01
+#define BX_MEM_DIRTY_CHECKPOINT 0x02
+#define BX_MEM_DIRTY_ALL        0xff
+
 class BOCHSAPI BX_MEM_C : public logfunctions {
 private:
-  struct memory_handler_struct **memory_handlers;
+  struct memory_handler_struct ***memory_handlers;
+  struct memory_handler_struct *memory_handler_list; // all registered handlers
   bx_bool pci_enabled;
   bx_bool bios_write_enabled;
   bx_bool smram_available;
@@ -94,18 +121,52 @@ private:
   Bit8u  **blocks;
   Bit8u   *rom;      // 512k BIOS rom space + 128k expansion rom space
   Bit8u   *bogus;    // 4k for unexisting memory
+  bx_bool  ram_mapped;  // vector was allocated with mmap()
+  Bit64u   mapped_len;  // length of the mapping at actual_vector
   bx_bool rom_present[65];
   bx_bool memory_type[13][2];
 
   Bit32u used_blocks;
+
+  Bit8u   *dirty_map;        // per guest page: BX_MEM_DIRTY_* users which saw a write
+
+  // copy-on-write snapshot of the guest RAM
+  bx_bool  snapshot_active;
+  Bit32u  *snapshot_list;    // the guest pages written since the last take/restore
+  Bit32u   snapshot_list_len;
+  Bit8u  **snapshot_pages;   // per host page: contents at the take, copied on first write
+  Bit8u  **snapshot_blocks;  // block mapping at the take
+  Bit32u   snapshot_used_blocks;
+  bx_bool  snapshot_memory_type[13][2];
+
 #if BX_LARGE_RAMFILE
   static Bit8u * const swapped_out; // NULL; // (NULL - sizeof(Bit8u));
   Bit32u  next_swapout_idx;
+  Bit32u  *dma_pins;  // per block: pages mapped by dmaMapPhysical(), never swapped out
   FILE    *overflow_file;
 
+  // incremental save/restore, the last checkpoint saved or restored
+  bx_bool  checkpoint_incremental;
+  char    *checkpoint_base;
+
+  // lazy restore, the checkpoint whose RAM file is mapped into the vector
+  unsigned restore_mode;
+  char    *ram_image;
+  Bit64u   ram_image_len;
+  Bit64u   ram_image_dev, ram_image_ino;  // identity of the mapped file
+
   BX_MEM_SMF void   read_block(Bit32u block);
+  BX_MEM_SMF void   dma_pin_page(bx_phy_address addr, const Bit8u *host, int delta);
+  BX_MEM_SMF bx_bool checkpoint_save_delta(const char *path);
+  BX_MEM_SMF bx_bool checkpoint_load_delta(const char *path);
+  BX_MEM_SMF bx_bool checkpoint_load_ram(const char *path);
+  BX_MEM_SMF void   checkpoint_set_base(const char *path);
+  BX_MEM_SMF void   ram_image_detach(void);
+  BX_MEM_SMF void   ram_image_close(void);
 #endif
 
+  BX_MEM_SMF void   track_dirty_pages(Bit8u user);
+
 public:
   BX_MEM_C();
  ~BX_MEM_C();
@@ -132,6 +193,15 @@ public:
   BX_MEM_SMF void    dmaReadPhysicalPage(bx_phy_address addr, unsigned len, Bit8u *data);
   BX_MEM_SMF void    dmaWritePhysicalPage(bx_phy_address addr, unsigned len, Bit8u *data);
 
+  // DMA of any length, could cross pages
+  BX_MEM_SMF unsigned dmaMapPhysical(bx_phy_address addr, Bit32u len, unsigned rw,
+                                     bx_dma_seg_t *seg, unsigned max_segs);
+  BX_MEM_SMF void    dmaUnmapPhysical(const bx_dma_seg_t *seg, unsigned count);
+  BX_MEM_SMF void    dmaReadPhysical(bx_phy_address addr, Bit32u len, Bit8u *data);
+  BX_MEM_SMF void    dmaWritePhysical(bx_phy_address addr, Bit32u len, const Bit8u *data);
+  BX_MEM_SMF void    dmaReadPhysicalSG(const bx_dma_seg_t *sg, unsigned count, Bit8u *data);
+  BX_MEM_SMF void    dmaWritePhysicalSG(const bx_dma_seg_t *sg, unsigned count, const Bit8u *data);
+
   BX_MEM_SMF void    load_ROM(const char *path, bx_phy_address romaddress, Bit8u type);
   BX_MEM_SMF void    load_RAM(const char *path, bx_phy_address romaddress, Bit8u type);
 
@@ -153,10 +223,21 @@ public:
      return registerMemoryHandlers(param, read_handler, write_handler, NULL, begin_addr, end_addr);
   }
   BX_MEM_SMF bx_bool unregisterMemoryHandlers(void *param, bx_phy_address begin_addr, bx_phy_address end_addr);
+  BX_MEM_SMF BX_CPP_INLINE struct memory_handler_struct* findMemoryHandler(bx_phy_address a20addr);
 
   BX_MEM_SMF Bit64u  get_memory_len(void);
   BX_MEM_SMF void allocate_block(Bit32u index);
   BX_MEM_SMF Bit8u* alloc_vector_aligned(Bit32u bytes, Bit32u alignment);
+  BX_MEM_SMF Bit8u* alloc_vector_mapped(Bit64u ram_bytes, Bit64u bytes);
+  BX_MEM_SMF void   free_vector(void);
+
+  // in-memory snapshots, see bx_real_sim_c::snapshot_take()
+  BX_MEM_SMF bx_bool snapshot_take(void);
+  BX_MEM_SMF bx_bool snapshot_restore(void);
+  BX_MEM_SMF void    snapshot_discard(void);
+
+  // first write to a tracked page, see track_dirty_pages()
+  BX_MEM_SMF void    dirty_page(bx_phy_address addr);
 
 #if BX_SUPPORT_MONITOR_MWAIT
   BX_MEM_SMF bx_bool is_monitor(bx_phy_address begin_addr, unsigned len);
@@ -164,8 +245,11 @@ public:
 #endif
 
   void register_state(void);
+  void before_save_state(void);
+  void after_restore_state(void);
 
   friend void ramfile_save_handler(void *devptr, FILE *fp);
+  friend void ramfile_restore_handler(void *devptr, FILE *fp);
   friend Bit64s memory_param_save_handler(void *devptr, bx_param_c *param);
   friend void memory_param_restore_handler(void *devptr, bx_param_c *param, Bit64s val);
 };
@@ -195,6 +279,19 @@ BX_CPP_INLINE Bit8u* BX_MEM_C::get_vector(bx_phy_address addr)
   return BX_MEM_THIS blocks[block] + (Bit32u)(addr & (BX_MEM_BLOCK_LEN-1));
 }
 
+BX_CPP_INLINE struct memory_handler_struct* BX_MEM_C::findMemoryHandler(bx_phy_address a20addr)
+{
+  struct memory_handler_struct **page_table = BX_MEM_THIS memory_handlers[a20addr >> 20];
+  if (page_table) {
+    struct memory_handler_struct *memory_handler =
+       page_table[(Bit32u)(a20addr >> 12) & (BX_MEM_HANDLER_PAGES-1)];
+    // handler might cover only part of the page
+    if (memory_handler && memory_handler->begin <= a20addr && memory_handler->end >= a20addr)
+      return memory_handler;
+  }
+  return NULL;
+}
+
 BX_CPP_INLINE Bit64u BX_MEM_C::get_memory_len(void)
 {
   return (BX_MEM_THIS len);
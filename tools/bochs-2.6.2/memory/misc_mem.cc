@@ -26,10 +26,24 @@
 #include "param_names.h"
 #include "cpu/cpu.h"
 #include "iodev/iodev.h"
+#include "memory/checkpoint.h"
+#include "bxthread.h"
 #define LOG_THIS BX_MEM(0)->
 
+#if BX_HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+#endif
+
 // alignment of memory vector, must be a power of 2
 #define BX_MEM_VECTOR_ALIGN 4096
+// alignment of mapped memory vector, so the host can back it with huge pages
+#define BX_MEM_MAPPED_ALIGN (2*1024*1024)
 #define BX_MEM_HANDLERS   ((BX_CONST64(1) << BX_PHY_ADDRESS_WIDTH) >> 20) /* one per megabyte */
 
 #if BX_LARGE_RAMFILE
@@ -45,12 +59,30 @@ BX_MEM_C::BX_MEM_C()
   blocks = NULL;
   len    = 0;
   used_blocks = 0;
+  ram_mapped = 0;
+  mapped_len = 0;
 
   memory_handlers = NULL;
+  memory_handler_list = NULL;
+
+  dirty_map = NULL;
+  snapshot_active = 0;
+  snapshot_list = NULL;
+  snapshot_list_len = 0;
+  snapshot_pages = NULL;
+  snapshot_blocks = NULL;
+  snapshot_used_blocks = 0;
 
 #if BX_LARGE_RAMFILE
   next_swapout_idx = 0;
+  dma_pins = NULL;
   overflow_file = NULL;
+  checkpoint_incremental = 0;
+  checkpoint_base = NULL;
+  restore_mode = BX_MEM_RESTORE_EAGER;
+  ram_image = NULL;
+  ram_image_len = 0;
+  ram_image_dev = ram_image_ino = 0;
 #endif
 }
 
@@ -73,11 +105,115 @@ Bit8u* BX_MEM_C::alloc_vector_aligned(Bit32u bytes, Bit32u alignment)
   return vector;
 }
 
+// Map the memory vector instead of allocating it from the heap. The host
+// populates the pages only when they are touched first, so there is no
+// startup cost for large guests and untouched guest RAM uses no host
+// memory. The first ram_bytes could be backed by the RAM image file.
+Bit8u* BX_MEM_C::alloc_vector_mapped(Bit64u ram_bytes, Bit64u bytes)
+{
+#if BX_HAVE_SYS_MMAN_H
+  const Bit64u align_mask = BX_MEM_MAPPED_ALIGN - 1;
+  Bit64u map_len = ((bytes + 4095) & ~BX_CONST64(4095)) + align_mask;
+
+  void *ptr = mmap(NULL, (size_t) map_len, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (ptr == MAP_FAILED) {
+    BX_PANIC(("alloc_vector_mapped: unable to map " FMT_LL "u bytes of host RAM: %s",
+              map_len, strerror(errno)));
+    return 0;
+  }
+  BX_MEM_THIS actual_vector = (Bit8u *) ptr;
+  BX_MEM_THIS mapped_len = map_len;
+  BX_MEM_THIS ram_mapped = 1;
+
+  Bit8u *vector = (Bit8u *)(((bx_ptr_equiv_t) ptr + align_mask) & ~(bx_ptr_equiv_t) align_mask);
+
+  const char *path = SIM->get_param_string(BXPN_MEM_FILE)->getptr();
+  if (*path != '\0') {
+    bx_bool shared = SIM->get_param_bool(BXPN_MEM_FILE_SHARED)->get();
+    struct stat stat_buf;
+
+    int fd = open(path, shared ? (O_RDWR | O_CREAT) : O_RDONLY
+#ifdef O_BINARY
+                | O_BINARY
+#endif
+                , S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+      BX_PANIC(("RAM: couldn't open RAM image file '%s'.", path));
+      return vector;
+    }
+    if (fstat(fd, &stat_buf)) {
+      BX_PANIC(("RAM: couldn't stat RAM image file '%s'.", path));
+      close(fd);
+      return vector;
+    }
+    Bit64u file_len = stat_buf.st_size;
+    if (shared && file_len < ram_bytes) {
+      // writes to the pages beyond the end of file would fault
+      if (ftruncate(fd, (off_t) ram_bytes) == 0)
+        file_len = ram_bytes;
+      else
+        BX_ERROR(("RAM: couldn't extend RAM image file '%s'.", path));
+    }
+    // A private mapping is copy-on-write: several emulators could share
+    // the same base image, pages are copied only when the guest writes them.
+    // The part of guest RAM beyond the end of file stays anonymous.
+    Bit64u file_map_len = (file_len + 4095) & ~BX_CONST64(4095);
+    if (file_map_len > ram_bytes) file_map_len = ram_bytes;
+    if (file_map_len > 0) {
+      ptr = mmap(vector, (size_t) file_map_len, PROT_READ | PROT_WRITE,
+                 (shared ? MAP_SHARED : MAP_PRIVATE) | MAP_FIXED, fd, 0);
+      if (ptr == MAP_FAILED)
+        BX_PANIC(("RAM: couldn't map RAM image file '%s': %s", path, strerror(errno)));
+    }
+    close(fd);
+    BX_INFO(("RAM: mapped " FMT_LL "u bytes of '%s' (%s)", file_map_len, path,
+             shared ? "shared" : "copy-on-write"));
+  }
+
+#ifdef MADV_HUGEPAGE
+  if (madvise(vector, (size_t)(map_len - align_mask), MADV_HUGEPAGE))
+    BX_DEBUG(("madvise(MADV_HUGEPAGE) failed: %s", strerror(errno)));
+#endif
+
+  return vector;
+#else
+  BX_PANIC(("alloc_vector_mapped: mmap() is not supported on this host"));
+  return 0;
+#endif
+}
+
+void BX_MEM_C::free_vector(void)
+{
+#if BX_LARGE_RAMFILE
+  ram_image_close();
+#endif
+#if BX_HAVE_SYS_MMAN_H
+  if (BX_MEM_THIS ram_mapped) {
+    munmap(BX_MEM_THIS actual_vector, (size_t) BX_MEM_THIS mapped_len);
+  }
+  else
+#endif
+  delete [] BX_MEM_THIS actual_vector;
+
+  BX_MEM_THIS actual_vector = NULL;
+  BX_MEM_THIS vector = NULL;
+  BX_MEM_THIS ram_mapped = 0;
+  BX_MEM_THIS mapped_len = 0;
+
+  if (BX_MEM_THIS dirty_map != NULL) {
+    pageWriteStampTable.setDirtyPageMap(NULL, 0);
+    delete [] BX_MEM_THIS dirty_map;
+    BX_MEM_THIS dirty_map = NULL;
+  }
+}
+
 BX_MEM_C::~BX_MEM_C()
 {
 #if BX_LARGE_RAMFILE
   if (overflow_file)
     fclose(BX_MEM_THIS overflow_file);
+  delete [] checkpoint_base;
 #endif
 
   cleanup_memory();
@@ -95,12 +231,25 @@ void BX_MEM_C::init_memory(Bit64u guest, Bit64u host)
 
   if (BX_MEM_THIS actual_vector != NULL) {
     BX_INFO(("freeing existing memory vector"));
-    delete [] BX_MEM_THIS actual_vector;
-    BX_MEM_THIS actual_vector = NULL;
-    BX_MEM_THIS vector = NULL;
+    snapshot_discard();
+    free_vector();
     BX_MEM_THIS blocks = NULL;
   }
-  BX_MEM_THIS vector = alloc_vector_aligned(host + BIOSROMSZ + EXROMSIZE + 4096, BX_MEM_VECTOR_ALIGN);
+  bx_bool use_mmap = (SIM->get_param_enum(BXPN_MEM_BACKEND)->get() == BX_MEM_BACKEND_MMAP);
+#if BX_HAVE_SYS_MMAN_H == 0
+  if (use_mmap) {
+    BX_ERROR(("mmap() is not supported on this host, using heap memory backend"));
+    use_mmap = 0;
+  }
+#endif
+  if (use_mmap) {
+    // host memory is committed on demand, so all guest memory is mapped
+    host = guest;
+    BX_MEM_THIS vector = alloc_vector_mapped(guest, host + BIOSROMSZ + EXROMSIZE + 4096);
+  }
+  else {
+    BX_MEM_THIS vector = alloc_vector_aligned(host + BIOSROMSZ + EXROMSIZE + 4096, BX_MEM_VECTOR_ALIGN);
+  }
   BX_INFO(("allocated memory at %p. after alignment, vector=%p",
         BX_MEM_THIS actual_vector, BX_MEM_THIS vector));
 
@@ -117,7 +266,7 @@ void BX_MEM_C::init_memory(Bit64u guest, Bit64u host)
   BX_INFO(("%.2fMB", (float)(BX_MEM_THIS len / (1024.0*1024.0))));
   BX_INFO(("mem block size = 0x%08x, blocks=%u", BX_MEM_BLOCK_LEN, num_blocks));
   BX_MEM_THIS blocks = new Bit8u* [num_blocks];
-  if (0) {
+  if (BX_MEM_THIS ram_mapped) {
     // all guest memory is allocated, just map it
     for (idx = 0; idx < num_blocks; idx++) {
       BX_MEM_THIS blocks[idx] = BX_MEM_THIS vector + (idx * BX_MEM_BLOCK_LEN);
@@ -131,10 +280,16 @@ void BX_MEM_C::init_memory(Bit64u guest, Bit64u host)
     }
     BX_MEM_THIS used_blocks = 0;
   }
+#if BX_LARGE_RAMFILE
+  delete [] BX_MEM_THIS dma_pins;
+  BX_MEM_THIS dma_pins = new Bit32u [num_blocks];
+  memset(BX_MEM_THIS dma_pins, 0, num_blocks * sizeof(Bit32u));
+#endif
 
-  BX_MEM_THIS memory_handlers = new struct memory_handler_struct *[BX_MEM_HANDLERS];
+  BX_MEM_THIS memory_handlers = new struct memory_handler_struct **[BX_MEM_HANDLERS];
   for (idx = 0; idx < BX_MEM_HANDLERS; idx++)
     BX_MEM_THIS memory_handlers[idx] = NULL;
+  BX_MEM_THIS memory_handler_list = NULL;
 
   BX_MEM_THIS pci_enabled = SIM->get_param_bool(BXPN_PCI_ENABLED)->get();
   BX_MEM_THIS bios_write_enabled = 0;
@@ -149,6 +304,28 @@ void BX_MEM_C::init_memory(Bit64u guest, Bit64u host)
     BX_MEM_THIS memory_type[i][1] = 0;
   }
 
+#if BX_LARGE_RAMFILE
+  BX_MEM_THIS checkpoint_incremental = SIM->get_param_bool(BXPN_MEM_INCREMENTAL)->get();
+  delete [] BX_MEM_THIS checkpoint_base;
+  BX_MEM_THIS checkpoint_base = NULL;
+  if (BX_MEM_THIS checkpoint_incremental && (BX_MEM_THIS allocated < BX_MEM_THIS len)) {
+    // the pages of swapped out blocks could not be saved
+    BX_ERROR(("incremental save/restore requires host memory size equal to guest memory size"));
+    BX_MEM_THIS checkpoint_incremental = 0;
+  }
+  BX_MEM_THIS restore_mode = SIM->get_param_enum(BXPN_MEM_RESTORE)->get();
+  if ((BX_MEM_THIS restore_mode != BX_MEM_RESTORE_EAGER) && !BX_MEM_THIS ram_mapped) {
+    // the blocks of the heap backend are not at their guest offsets
+    BX_ERROR(("lazy restore requires the mmap memory backend"));
+    BX_MEM_THIS restore_mode = BX_MEM_RESTORE_EAGER;
+  }
+#else
+  if (SIM->get_param_bool(BXPN_MEM_INCREMENTAL)->get())
+    BX_ERROR(("incremental save/restore requires large ramfile support"));
+  if (SIM->get_param_enum(BXPN_MEM_RESTORE)->get() != BX_MEM_RESTORE_EAGER)
+    BX_ERROR(("lazy restore requires large ramfile support"));
+#endif
+
   BX_MEM_THIS register_state();
 }
 
@@ -171,6 +348,22 @@ void BX_MEM_C::allocate_block(Bit32u block)
 {
   const Bit32u max_blocks = BX_MEM_THIS allocated / BX_MEM_BLOCK_LEN;
 
+  BX_LOCK_DEVICES();
+
+#if BX_SUPPORT_SMP
+  // processor running on another host thread might have allocated the block
+  // while we were waiting for the lock
+#if BX_LARGE_RAMFILE
+  if (BX_MEM_THIS blocks[block] && (BX_MEM_THIS blocks[block] != BX_MEM_THIS swapped_out))
+#else
+  if (BX_MEM_THIS blocks[block])
+#endif
+  {
+    BX_UNLOCK_DEVICES();
+    return;
+  }
+#endif
+
 #if BX_LARGE_RAMFILE
   /* 
    * Match block to vector address
@@ -187,11 +380,12 @@ void BX_MEM_C::allocate_block(Bit32u block)
         if (++(BX_MEM_THIS next_swapout_idx)==((BX_MEM_THIS len)/BX_MEM_BLOCK_LEN))
           BX_MEM_THIS next_swapout_idx = 0;
         if (BX_MEM_THIS next_swapout_idx == original_replacement_block)
-          BX_PANIC(("FATAL ERROR: Insufficient working RAM, all blocks are currently used for TLB entries!"));
+          BX_PANIC(("FATAL ERROR: Insufficient working RAM, all blocks are currently used for TLB entries or DMA!"));
         buffer = BX_MEM_THIS blocks[BX_MEM_THIS next_swapout_idx];
       } while ((!buffer) || (buffer == BX_MEM_C::swapped_out));
 
-      used_for_tlb = false;
+      // a device still works on the block through a DMA mapping
+      used_for_tlb = (BX_MEM_THIS dma_pins[BX_MEM_THIS next_swapout_idx] != 0);
       // tlb buffer check loop
       const Bit8u* buffer_end = buffer+BX_MEM_BLOCK_LEN;
       // Don't replace it if any CPU is using it as a TLB entry
@@ -234,22 +428,444 @@ void BX_MEM_C::allocate_block(Bit32u block)
   }
   BX_DEBUG(("allocate_block: used_blocks=0x%x of 0x%x", BX_MEM_THIS used_blocks, max_blocks));
 #endif
+
+  BX_UNLOCK_DEVICES();
 }
 
 #if BX_LARGE_RAMFILE
 // The blocks in RAM must also be flushed to the save file.
 void ramfile_save_handler(void *devptr, FILE *fp)
 {
-  for (Bit32u idx = 0; idx < (BX_MEM(0)->len / BX_MEM_BLOCK_LEN); idx++) {
-    if ((BX_MEM(0)->blocks[idx]) && (BX_MEM(0)->blocks[idx] != BX_MEM(0)->swapped_out))
-    {
-      bx_phy_address address = ((bx_phy_address)idx)*BX_MEM_BLOCK_LEN;
-      if (fseeko64(fp, address, SEEK_SET))
-        BX_PANIC(("FATAL ERROR: Could not seek to 0x" FMT_PHY_ADDRX " in overflow file!", address)); 
-      if (1 != fwrite (BX_MEM(0)->blocks[idx], BX_MEM_BLOCK_LEN, 1, fp))
-        BX_PANIC(("FATAL ERROR: Could not write at 0x" FMT_PHY_ADDRX " in overflow file!", address));
+  const char *path = SIM->get_param_string(BXPN_RESTORE_PATH)->getptr();
+
+  if (! BX_MEM(0)->checkpoint_save_delta(path)) {
+    for (Bit32u idx = 0; idx < (BX_MEM(0)->len / BX_MEM_BLOCK_LEN); idx++) {
+      if ((BX_MEM(0)->blocks[idx]) && (BX_MEM(0)->blocks[idx] != BX_MEM(0)->swapped_out))
+      {
+        bx_phy_address address = ((bx_phy_address)idx)*BX_MEM_BLOCK_LEN;
+        if (fseeko64(fp, address, SEEK_SET))
+          BX_PANIC(("FATAL ERROR: Could not seek to 0x" FMT_PHY_ADDRX " in overflow file!", address)); 
+        if (1 != fwrite (BX_MEM(0)->blocks[idx], BX_MEM_BLOCK_LEN, 1, fp))
+          BX_PANIC(("FATAL ERROR: Could not write at 0x" FMT_PHY_ADDRX " in overflow file!", address));
+      }
+    }
+  }
+  BX_MEM(0)->checkpoint_set_base(path);
+}
+
+// The saved RAM file is already copied to the overflow file, the pages of
+// an incremental checkpoint are added to it. The mapped vector has no
+// overflow file, the RAM file is loaded into the vector directly.
+void ramfile_restore_handler(void *devptr, FILE *fp)
+{
+  const char *path = SIM->get_param_string(BXPN_RESTORE_PATH)->getptr();
+
+  if (! BX_MEM(0)->checkpoint_load_delta(path))
+    BX_PANIC(("cannot restore the guest RAM of checkpoint '%s'", path));
+  BX_MEM(0)->checkpoint_set_base(path);
+}
+
+// The paths could name the same file or folder in different ways, like
+// "cp", "./cp", "cp/" or a symbolic link.
+static bx_bool same_file(const char *fname1, const char *fname2)
+{
+#ifndef WIN32
+  struct stat stat1, stat2;
+
+  if ((stat(fname1, &stat1) == 0) && (stat(fname2, &stat2) == 0))
+    return (stat1.st_dev == stat2.st_dev) && (stat1.st_ino == stat2.st_ino);
+#endif
+  return !strcmp(fname1, fname2);
+}
+
+// Incremental checkpoints save only the guest pages written since the last
+// checkpoint saved or restored, see memory/checkpoint.h for the format. The
+// write tracking starts with the first checkpoint, so that one is always
+// saved in full.
+
+bx_bool BX_MEM_C::checkpoint_save_delta(const char *path)
+{
+  char fname[BX_PATHNAME_LEN];
+  checkpoint_delta_header_t header;
+  Bit32u pages = (Bit32u)(BX_MEM_THIS len >> 12), page, n = 0;
+  FILE *fp;
+
+  sprintf(fname, "%s/%s", path, CHECKPOINT_DELTA_FILE);
+  if (!BX_MEM_THIS checkpoint_incremental || !BX_MEM_THIS checkpoint_base ||
+      same_file(BX_MEM_THIS checkpoint_base, path)) {
+    // full checkpoint, a delta from an earlier save to this path is invalid
+    remove(fname);
+    return 0;
+  }
+  if (strlen(BX_MEM_THIS checkpoint_base) >= CHECKPOINT_PATH_LEN) {
+    BX_ERROR(("checkpoint path '%s' too long for a parent", BX_MEM_THIS checkpoint_base));
+    remove(fname);
+    return 0;
+  }
+  fp = fopen(fname, "wb");
+  if (fp == NULL) {
+    BX_ERROR(("cannot create '%s', saving a full checkpoint", fname));
+    return 0;
+  }
+
+  Bit32u *list = new Bit32u[pages];
+  for (page = 0; page < pages; page++) {
+    if (! (BX_MEM_THIS dirty_map[page] & BX_MEM_DIRTY_CHECKPOINT)) continue;
+    list[n++] = page;
+  }
+
+  memset(&header, 0, sizeof(header));
+  strcpy(header.magic, CHECKPOINT_DELTA_MAGIC);
+  header.version = CHECKPOINT_DELTA_VERSION;
+  header.page_size = CHECKPOINT_PAGE_SIZE;
+  header.ram_size = BX_MEM_THIS len;
+  header.pages = n;
+  strcpy(header.parent, BX_MEM_THIS checkpoint_base);
+
+  bx_bool ok = (fwrite(&header, sizeof(header), 1, fp) == 1);
+  if (ok && n > 0)
+    ok = (fwrite(list, sizeof(Bit32u), n, fp) == n);
+  for (Bit32u i = 0; ok && i < n; i++) {
+    Bit8u *host = get_vector(((bx_phy_address) list[i]) << 12);
+    ok = (fwrite(host, CHECKPOINT_PAGE_SIZE, 1, fp) == 1);
+  }
+  if (fclose(fp) != 0) ok = 0;
+  delete [] list;
+  if (!ok)
+    BX_PANIC(("FATAL ERROR: Could not write checkpoint delta '%s'!", fname));
+
+  BX_INFO(("checkpoint: %u of %u pages saved, parent '%s'", n, pages, BX_MEM_THIS checkpoint_base));
+  return 1;
+}
+
+// Finds the full checkpoint at the start of the chain ending at <path>.
+static bx_bool checkpoint_chain_root(const char *path, char *dir)
+{
+  char fname[BX_PATHNAME_LEN];
+  checkpoint_delta_header_t header;
+
+  strcpy(dir, path);
+  for (unsigned depth = 0; depth <= CHECKPOINT_MAX_CHAIN; depth++) {
+    sprintf(fname, "%s/%s", dir, CHECKPOINT_DELTA_FILE);
+    FILE *fp = fopen(fname, "rb");
+    if (fp == NULL)
+      return 1;
+    bx_bool ok = (fread(&header, sizeof(header), 1, fp) == 1) &&
+                 !strcmp(header.magic, CHECKPOINT_DELTA_MAGIC);
+    fclose(fp);
+    if (!ok)
+      return 0;
+    header.parent[CHECKPOINT_PATH_LEN-1] = 0;
+    strcpy(dir, header.parent);
+  }
+  return 0;
+}
+
+// Adds the pages of the incremental checkpoints in the chain ending at
+// <path> to the overflow file. The newest copy of every page is taken, so
+// the chain is walked backwards and each page written only once. Returns 1
+// for a full checkpoint without doing anything.
+// The mapped vector is loaded from the full checkpoint first and the pages
+// are written to it instead.
+bx_bool BX_MEM_C::checkpoint_load_delta(const char *path)
+{
+  char dir[BX_PATHNAME_LEN], fname[BX_PATHNAME_LEN];
+  checkpoint_delta_header_t header;
+  Bit32u pages = (Bit32u)(BX_MEM_THIS len >> 12), page, i, depth;
+  Bit8u buffer[CHECKPOINT_PAGE_SIZE], *data;
+  FILE *fp;
+
+  sprintf(fname, "%s/%s", path, CHECKPOINT_DELTA_FILE);
+  fp = fopen(fname, "rb");
+  if (fp == NULL)
+    return BX_MEM_THIS ram_mapped ? checkpoint_load_ram(path) : 1;
+
+  if (BX_MEM_THIS ram_mapped) {
+    if (!checkpoint_chain_root(path, dir)) {
+      BX_ERROR(("cannot find the full checkpoint of '%s'", path));
+      fclose(fp);
+      return 0;
+    }
+    if (!checkpoint_load_ram(dir)) {
+      fclose(fp);
+      return 0;
+    }
+  }
+
+  FILE *ram = BX_MEM_THIS overflow_file;
+  Bit8u *done = new Bit8u[pages];
+  memset(done, 0, pages);
+  strcpy(dir, path);
+  for (depth = 0; fp != NULL; depth++) {
+    if ((fread(&header, sizeof(header), 1, fp) != 1) ||
+        strcmp(header.magic, CHECKPOINT_DELTA_MAGIC) ||
+        (header.version != CHECKPOINT_DELTA_VERSION) ||
+        (header.page_size != CHECKPOINT_PAGE_SIZE) ||
+        (header.ram_size != BX_MEM_THIS len) ||
+        (header.pages > pages) || (depth >= CHECKPOINT_MAX_CHAIN)) {
+      BX_ERROR(("'%s' is not a valid checkpoint delta for this machine", fname));
+      break;
+    }
+    header.parent[CHECKPOINT_PATH_LEN-1] = 0;
+    BX_INFO(("checkpoint: adding %u pages from '%s'", header.pages, dir));
+    Bit32u *list = new Bit32u[header.pages];
+    if (fread(list, sizeof(Bit32u), header.pages, fp) != header.pages) {
+      delete [] list;
+      break;
+    }
+    for (i = 0; i < header.pages; i++) {
+      page = list[i];
+      if (page >= pages) break;
+      if (done[page]) {
+        // a newer checkpoint has this page
+        if (fseeko64(fp, CHECKPOINT_PAGE_SIZE, SEEK_CUR)) break;
+        continue;
+      }
+      data = BX_MEM_THIS ram_mapped ? BX_MEM_THIS vector + (((Bit64u) page) << 12) : buffer;
+      if (fread(data, CHECKPOINT_PAGE_SIZE, 1, fp) != 1) break;
+      if (!BX_MEM_THIS ram_mapped &&
+          (fseeko64(ram, ((Bit64u) page) << 12, SEEK_SET) ||
+           (fwrite(buffer, CHECKPOINT_PAGE_SIZE, 1, ram) != 1)))
+        BX_PANIC(("FATAL ERROR: Could not write to the memory overflow file!"));
+      done[page] = 1;
+    }
+    delete [] list;
+    if (i < header.pages) {
+      BX_ERROR(("'%s' is damaged", fname));
+      break;
+    }
+    fclose(fp);
+    strcpy(dir, header.parent);
+    sprintf(fname, "%s/%s", dir, CHECKPOINT_DELTA_FILE);
+    fp = fopen(fname, "rb");
+  }
+  if (fp != NULL) {
+    fclose(fp);
+    delete [] done;
+    return 0;
+  }
+  if (BX_MEM_THIS ram_mapped) {
+    delete [] done;
+    return 1;
+  }
+
+  // the full checkpoint at the start of the chain fills the other pages,
+  // pages past its end are zero
+  sprintf(fname, "%s/%s", dir, CHECKPOINT_RAM_FILE);
+  fp = fopen(fname, "rb");
+  if (fp == NULL) {
+    BX_ERROR(("cannot open '%s'", fname));
+    delete [] done;
+    return 0;
+  }
+  BX_INFO(("checkpoint: adding the remaining pages from '%s'", dir));
+  for (page = 0; page < pages; page++) {
+    if (done[page]) continue;
+    if (fseeko64(fp, ((Bit64u) page) << 12, SEEK_SET) ||
+        (fread(buffer, CHECKPOINT_PAGE_SIZE, 1, fp) != 1))
+      break;
+    if (fseeko64(ram, ((Bit64u) page) << 12, SEEK_SET) ||
+        (fwrite(buffer, CHECKPOINT_PAGE_SIZE, 1, ram) != 1))
+      BX_PANIC(("FATAL ERROR: Could not write to the memory overflow file!"));
+  }
+  fclose(fp);
+  fflush(ram);
+  delete [] done;
+  return 1;
+}
+
+#if BX_HAVE_SYS_MMAN_H
+// Replaces a part of the mapped vector with fresh zeroed pages.
+static bx_bool map_zero_pages(Bit8u *addr, Bit64u len)
+{
+  if (len == 0)
+    return 1;
+  void *ptr = mmap(addr, (size_t) len, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+  if (ptr == MAP_FAILED)
+    return 0;
+#ifdef MADV_HUGEPAGE
+  madvise(addr, (size_t) len, MADV_HUGEPAGE);
+#endif
+  return 1;
+}
+
+#if BX_HAVE_THREADS
+// The prefetch thread touches the pages of a lazily restored RAM file in
+// the background, so the guest rarely has to wait for the disk.
+static struct {
+  Bit8u *start;
+  Bit64u len;
+  volatile Bit32u stop;
+  bx_bool running;
+  BX_THREAD_ID(thread);
+} ram_prefetch;
+
+static BX_THREAD_FUNC(ram_prefetch_thread, arg)
+{
+  volatile Bit8u *data = ram_prefetch.start;
+
+  for (Bit64u offset = 0; offset < ram_prefetch.len; offset += CHECKPOINT_PAGE_SIZE) {
+    if (ram_prefetch.stop) break;
+    (void) data[offset];
+  }
+  BX_THREAD_EXIT;
+}
+#endif
+
+static void ram_prefetch_start(Bit8u *start, Bit64u len)
+{
+#ifdef MADV_WILLNEED
+  // the host reads ahead the file without waiting for page faults
+  madvise(start, (size_t) len, MADV_WILLNEED);
+#endif
+#if BX_HAVE_THREADS
+  ram_prefetch.start = start;
+  ram_prefetch.len = len;
+  ram_prefetch.stop = 0;
+  ram_prefetch.running = (BX_THREAD_CREATE(ram_prefetch_thread, NULL, ram_prefetch.thread) == 0);
+#endif
+}
+
+static void ram_prefetch_stop(void)
+{
+#if BX_HAVE_THREADS
+  if (ram_prefetch.running) {
+    ram_prefetch.stop = 1;
+    bx_thread_join(ram_prefetch.thread);
+    ram_prefetch.running = 0;
+  }
+#endif
+}
+#endif
+
+// Loads the RAM file of the full checkpoint <path> into the mapped vector.
+// With lazy restore the file is mapped copy-on-write instead, so the host
+// reads a page only when it is touched first. Guest RAM beyond the end of
+// the file is zero.
+bx_bool BX_MEM_C::checkpoint_load_ram(const char *path)
+{
+#if BX_HAVE_SYS_MMAN_H
+  char fname[BX_PATHNAME_LEN];
+  struct stat stat_buf;
+
+  ram_image_close();
+  sprintf(fname, "%s/%s", path, CHECKPOINT_RAM_FILE);
+  int fd = open(fname, O_RDONLY
+#ifdef O_BINARY
+                | O_BINARY
+#endif
+                );
+  if (fd < 0) {
+    BX_ERROR(("cannot open '%s'", fname));
+    return 0;
+  }
+  if (fstat(fd, &stat_buf)) {
+    BX_ERROR(("cannot stat '%s'", fname));
+    close(fd);
+    return 0;
+  }
+  Bit64u file_len = stat_buf.st_size;
+  if (file_len > BX_MEM_THIS len) file_len = BX_MEM_THIS len;
+
+  // a shared RAM image file stays mapped, it must keep the guest RAM
+  bx_bool shared = !SIM->get_param_string(BXPN_MEM_FILE)->isempty() &&
+                   SIM->get_param_bool(BXPN_MEM_FILE_SHARED)->get();
+  Bit64u map_len = 0;
+  if ((BX_MEM_THIS restore_mode != BX_MEM_RESTORE_EAGER) && !shared)
+    map_len = (file_len + 4095) & ~BX_CONST64(4095);
+  if (shared) {
+    memset(BX_MEM_THIS vector + file_len, 0, (size_t)(BX_MEM_THIS len - file_len));
+  }
+  else if (!map_zero_pages(BX_MEM_THIS vector + map_len, BX_MEM_THIS len - map_len)) {
+    BX_PANIC(("checkpoint: couldn't map guest RAM: %s", strerror(errno)));
+  }
+  if (map_len > 0) {
+    void *ptr = mmap(BX_MEM_THIS vector, (size_t) map_len, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_FIXED, fd, 0);
+    if (ptr == MAP_FAILED) {
+      BX_ERROR(("couldn't map '%s', reading it: %s", fname, strerror(errno)));
+      if (!map_zero_pages(BX_MEM_THIS vector, map_len))
+        BX_PANIC(("checkpoint: couldn't map guest RAM: %s", strerror(errno)));
+      map_len = 0;
     }
   }
+  if (map_len == 0) {
+    for (Bit64u offset = 0; offset < file_len;) {
+      Bit64u count = file_len - offset;
+      if (count > 0x40000000) count = 0x40000000;
+      ssize_t n = read(fd, BX_MEM_THIS vector + offset, (size_t) count);
+      if (n <= 0) {
+        BX_ERROR(("cannot read '%s'", fname));
+        close(fd);
+        return 0;
+      }
+      offset += n;
+    }
+  }
+  close(fd);
+
+  if (map_len > 0) {
+    BX_MEM_THIS ram_image = new char[strlen(path) + 1];
+    strcpy(BX_MEM_THIS ram_image, path);
+    BX_MEM_THIS ram_image_len = map_len;
+    BX_MEM_THIS ram_image_dev = stat_buf.st_dev;
+    BX_MEM_THIS ram_image_ino = stat_buf.st_ino;
+    BX_INFO(("checkpoint: mapped " FMT_LL "u bytes of '%s' copy-on-write", map_len, fname));
+    if (BX_MEM_THIS restore_mode == BX_MEM_RESTORE_PREFETCH)
+      ram_prefetch_start(BX_MEM_THIS vector, map_len);
+  }
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+// Copies the guest RAM still backed by the mapped checkpoint RAM file to
+// anonymous memory, so the file could be rewritten.
+void BX_MEM_C::ram_image_detach(void)
+{
+#if BX_HAVE_SYS_MMAN_H
+  if (BX_MEM_THIS ram_image == NULL)
+    return;
+
+  ram_prefetch_stop();
+  Bit8u *buffer = new Bit8u[BX_MEM_BLOCK_LEN];
+  for (Bit64u offset = 0; offset < BX_MEM_THIS ram_image_len; offset += BX_MEM_BLOCK_LEN) {
+    Bit64u count = BX_MEM_THIS ram_image_len - offset;
+    if (count > BX_MEM_BLOCK_LEN) count = BX_MEM_BLOCK_LEN;
+    memcpy(buffer, BX_MEM_THIS vector + offset, (size_t) count);
+    if (!map_zero_pages(BX_MEM_THIS vector + offset, count))
+      BX_PANIC(("checkpoint: couldn't map guest RAM: %s", strerror(errno)));
+    memcpy(BX_MEM_THIS vector + offset, buffer, (size_t) count);
+  }
+  delete [] buffer;
+  BX_INFO(("checkpoint: guest RAM detached from '%s'", BX_MEM_THIS ram_image));
+  ram_image_close();
+#endif
+}
+
+// The mapping of the checkpoint RAM file is going to be replaced or
+// unmapped, the prefetch thread must not touch it any more.
+void BX_MEM_C::ram_image_close(void)
+{
+#if BX_HAVE_SYS_MMAN_H
+  ram_prefetch_stop();
+#endif
+  delete [] BX_MEM_THIS ram_image;
+  BX_MEM_THIS ram_image = NULL;
+  BX_MEM_THIS ram_image_len = 0;
+}
+
+void BX_MEM_C::checkpoint_set_base(const char *path)
+{
+  if (!BX_MEM_THIS checkpoint_incremental)
+    return;
+
+  delete [] BX_MEM_THIS checkpoint_base;
+  BX_MEM_THIS checkpoint_base = new char[strlen(path) + 1];
+  strcpy(BX_MEM_THIS checkpoint_base, path);
+  track_dirty_pages(BX_MEM_DIRTY_CHECKPOINT);
 }
 #endif
 
@@ -280,6 +896,10 @@ void memory_param_restore_handler(void *devptr, bx_param_c *param, Bit64s val)
   if (! strncmp(pname, "blk", 3)) {
     Bit32u blk_index = atoi(pname + 3);
 #if BX_LARGE_RAMFILE
+    // the mapped vector always holds all blocks at their guest offsets,
+    // they are loaded by the RAM file restore handler
+    if (BX_MEM(0)->ram_mapped)
+      return;
     if ((Bit32s) val == -2) {
       BX_MEM(0)->blocks[blk_index] = BX_MEM(0)->swapped_out;
       return;
@@ -303,10 +923,13 @@ void BX_MEM_C::register_state()
   bx_list_c *list = new bx_list_c(SIM->get_bochs_root(), "memory", "Memory State");
   Bit32u num_blocks = BX_MEM_THIS len / BX_MEM_BLOCK_LEN;
 #if BX_LARGE_RAMFILE
-  bx_shadow_filedata_c *ramfile = new bx_shadow_filedata_c(list, "ram", &(BX_MEM_THIS overflow_file));
-  ramfile->set_sr_handlers(this, ramfile_save_handler, (filedata_restore_handler)NULL);
+  bx_shadow_filedata_c *ramfile = new bx_shadow_filedata_c(list, "ram",
+      BX_MEM_THIS ram_mapped ? NULL : &(BX_MEM_THIS overflow_file));
+  ramfile->set_sr_handlers(this, ramfile_save_handler, ramfile_restore_handler);
 #else
-  new bx_shadow_data_c(list, "ram", BX_MEM_THIS vector, BX_MEM_THIS allocated);
+  if (BX_MEM_THIS allocated > BX_MAX_BIT32U)
+    BX_ERROR(("save/restore supports only the first 4GB of guest RAM"));
+  new bx_shadow_data_c(list, "ram", BX_MEM_THIS vector, (Bit32u) BX_MEM_THIS allocated);
 #endif
   BXRS_DEC_PARAM_FIELD(list, len, BX_MEM_THIS len);
   BXRS_DEC_PARAM_FIELD(list, allocated, BX_MEM_THIS allocated);
@@ -328,32 +951,196 @@ void BX_MEM_C::register_state()
   }
 }
 
+// Guest RAM write tracking: the write stamp table calls dirty_page() for
+// the first write to a page after one of the users cleared its bit in the
+// dirty map.
+
+void handleDirtyPage(bx_phy_address pAddr)
+{
+  BX_MEM(0)->dirty_page(pAddr);
+}
+
+void BX_MEM_C::track_dirty_pages(Bit8u user)
+{
+  Bit32u pages = (Bit32u)(BX_MEM_THIS len >> 12);
+
+  if (BX_MEM_THIS dirty_map == NULL) {
+    BX_MEM_THIS dirty_map = new Bit8u[pages];
+    memset(BX_MEM_THIS dirty_map, BX_MEM_DIRTY_ALL, pages);
+    pageWriteStampTable.setDirtyPageMap(BX_MEM_THIS dirty_map, pages);
+  }
+  for (Bit32u page = 0; page < pages; page++)
+    BX_MEM_THIS dirty_map[page] &= ~user;
+}
+
+void BX_MEM_C::dirty_page(bx_phy_address addr)
+{
+  Bit32u page = (Bit32u)(addr >> 12);
+
+  // processors running on their own host threads could write the same page
+  BX_LOCK_DEVICES();
+  if (BX_MEM_THIS snapshot_active && !(BX_MEM_THIS dirty_map[page] & BX_MEM_DIRTY_SNAPSHOT)) {
+    Bit8u *host = get_vector(addr & ~((bx_phy_address) 0xfff));
+    Bit32u host_page = (Bit32u)((host - BX_MEM_THIS vector) >> 12);
+    if (BX_MEM_THIS snapshot_pages[host_page] == NULL) {
+      BX_MEM_THIS snapshot_pages[host_page] = new Bit8u[4096];
+      memcpy(BX_MEM_THIS snapshot_pages[host_page], host, 4096);
+    }
+    BX_MEM_THIS snapshot_list[BX_MEM_THIS snapshot_list_len++] = page;
+  }
+  BX_MEM_THIS dirty_map[page] = BX_MEM_DIRTY_ALL;
+  BX_UNLOCK_DEVICES();
+}
+
+// Copy-on-write snapshot of the guest RAM. After the take the first write
+// to every guest page saves the page contents, so the restore has to copy
+// back only the pages written since. The saved contents are kept for the
+// host page backing the guest page and the block mapping is restored along
+// with them, so the blocks allocated after the take could be reused.
+
+bx_bool BX_MEM_C::snapshot_take(void)
+{
+  Bit32u num_blocks = (Bit32u)(BX_MEM_THIS len / BX_MEM_BLOCK_LEN);
+  Bit32u pages = (Bit32u)(BX_MEM_THIS len >> 12);
+  Bit32u host_pages = (Bit32u)(BX_MEM_THIS allocated >> 12);
+
+#if BX_LARGE_RAMFILE
+  // the swapped out blocks are not tracked
+  if (BX_MEM_THIS allocated < BX_MEM_THIS len) {
+    BX_ERROR(("snapshot: host memory size must be equal to guest memory size"));
+    return 0;
+  }
+#endif
+
+  snapshot_discard();
+
+  BX_MEM_THIS snapshot_list = new Bit32u[pages];
+  BX_MEM_THIS snapshot_list_len = 0;
+  BX_MEM_THIS snapshot_pages = new Bit8u*[host_pages];
+  memset(BX_MEM_THIS snapshot_pages, 0, host_pages * sizeof(Bit8u*));
+  BX_MEM_THIS snapshot_blocks = new Bit8u*[num_blocks];
+  memcpy(BX_MEM_THIS snapshot_blocks, BX_MEM_THIS blocks, num_blocks * sizeof(Bit8u*));
+  BX_MEM_THIS snapshot_used_blocks = BX_MEM_THIS used_blocks;
+  memcpy(BX_MEM_THIS snapshot_memory_type, BX_MEM_THIS memory_type, sizeof(BX_MEM_THIS memory_type));
+
+  track_dirty_pages(BX_MEM_DIRTY_SNAPSHOT);
+  BX_MEM_THIS snapshot_active = 1;
+  return 1;
+}
+
+bx_bool BX_MEM_C::snapshot_restore(void)
+{
+  Bit32u num_blocks = (Bit32u)(BX_MEM_THIS len / BX_MEM_BLOCK_LEN);
+
+  if (! BX_MEM_THIS snapshot_active)
+    return 0;
+
+  for (Bit32u n = 0; n < BX_MEM_THIS snapshot_list_len; n++) {
+    Bit32u page = BX_MEM_THIS snapshot_list[n];
+    bx_phy_address addr = ((bx_phy_address) page) << 12;
+    Bit8u *host = get_vector(addr);
+    memcpy(host, BX_MEM_THIS snapshot_pages[(host - BX_MEM_THIS vector) >> 12], 4096);
+    // one of the CPUs might have a trace from this page and the other users
+    // of the dirty map see a write, the snapshot bit is still set so the
+    // page is not saved again
+    pageWriteStampTable.decWriteStamp(addr);
+    BX_MEM_THIS dirty_map[page] &= ~BX_MEM_DIRTY_SNAPSHOT;
+  }
+  BX_DEBUG(("snapshot: %u pages restored", BX_MEM_THIS snapshot_list_len));
+  BX_MEM_THIS snapshot_list_len = 0;
+
+  memcpy(BX_MEM_THIS blocks, BX_MEM_THIS snapshot_blocks, num_blocks * sizeof(Bit8u*));
+  BX_MEM_THIS used_blocks = BX_MEM_THIS snapshot_used_blocks;
+  memcpy(BX_MEM_THIS memory_type, BX_MEM_THIS snapshot_memory_type, sizeof(BX_MEM_THIS memory_type));
+  return 1;
+}
+
+void BX_MEM_C::snapshot_discard(void)
+{
+  if (! BX_MEM_THIS snapshot_active)
+    return;
+
+  // the dirty map stays, the pages with a cleared bit just cause one more
+  // call of dirty_page()
+  BX_MEM_THIS snapshot_active = 0;
+
+  Bit32u host_pages = (Bit32u)(BX_MEM_THIS allocated >> 12);
+  for (Bit32u n = 0; n < host_pages; n++)
+    delete [] BX_MEM_THIS snapshot_pages[n];
+  delete [] BX_MEM_THIS snapshot_pages;
+  delete [] BX_MEM_THIS snapshot_list;
+  delete [] BX_MEM_THIS snapshot_blocks;
+  BX_MEM_THIS snapshot_pages = NULL;
+  BX_MEM_THIS snapshot_list = NULL;
+  BX_MEM_THIS snapshot_blocks = NULL;
+  BX_MEM_THIS snapshot_list_len = 0;
+}
+
+// Saving a checkpoint rewrites its RAM file, so the guest RAM must not be
+// mapped from the file any more. The files are compared, not the paths,
+// which could name the mapped file in another way.
+void BX_MEM_C::before_save_state(void)
+{
+#if BX_LARGE_RAMFILE && BX_HAVE_SYS_MMAN_H
+  char fname[BX_PATHNAME_LEN];
+  struct stat stat_buf;
+
+  if (BX_MEM_THIS ram_image == NULL)
+    return;
+  sprintf(fname, "%s/%s", SIM->get_param_string(BXPN_RESTORE_PATH)->getptr(), CHECKPOINT_RAM_FILE);
+  if ((stat(fname, &stat_buf) == 0) && ((Bit64u) stat_buf.st_dev == BX_MEM_THIS ram_image_dev) &&
+      ((Bit64u) stat_buf.st_ino == BX_MEM_THIS ram_image_ino))
+    ram_image_detach();
+#endif
+}
+
+void BX_MEM_C::after_restore_state(void)
+{
+#if BX_LARGE_RAMFILE
+  if (BX_MEM_THIS ram_mapped)
+    BX_MEM_THIS used_blocks = (Bit32u)(BX_MEM_THIS len / BX_MEM_BLOCK_LEN);
+  // all blocks are read from the overflow file and none will be swapped
+  // out again, so the file is not needed any more (and must not be copied
+  // into the next checkpoint)
+  if ((BX_MEM_THIS overflow_file != NULL) && (BX_MEM_THIS allocated >= BX_MEM_THIS len)) {
+    fclose(BX_MEM_THIS overflow_file);
+    BX_MEM_THIS overflow_file = NULL;
+  }
+#endif
+}
+
 void BX_MEM_C::cleanup_memory()
 {
   unsigned idx;
 
   if (BX_MEM_THIS vector != NULL) {
-    delete [] BX_MEM_THIS actual_vector;
-    BX_MEM_THIS actual_vector = NULL;
-    BX_MEM_THIS vector = NULL;
+    snapshot_discard();
+    free_vector();
     BX_MEM_THIS rom = NULL;
     BX_MEM_THIS bogus = NULL;
     delete [] BX_MEM_THIS blocks;
     BX_MEM_THIS blocks = 0;
     BX_MEM_THIS used_blocks = 0;
+#if BX_LARGE_RAMFILE
+    delete [] BX_MEM_THIS dma_pins;
+    BX_MEM_THIS dma_pins = NULL;
+#endif
     if (BX_MEM_THIS memory_handlers != NULL) {
       for (idx = 0; idx < BX_MEM_HANDLERS; idx++) {
-        struct memory_handler_struct *memory_handler = BX_MEM_THIS memory_handlers[idx];
-        struct memory_handler_struct *prev = NULL;
-        while (memory_handler) {
-          prev = memory_handler;
-          memory_handler = memory_handler->next;
-          delete prev;
-        }
+        delete [] BX_MEM_THIS memory_handlers[idx];
       }
       delete [] BX_MEM_THIS memory_handlers;
       BX_MEM_THIS memory_handlers = NULL;
     }
+    while (BX_MEM_THIS memory_handler_list) {
+      struct memory_handler_struct *memory_handler = BX_MEM_THIS memory_handler_list;
+      BX_INFO(("memory handlers 0x" FMT_PHY_ADDRX " - 0x" FMT_PHY_ADDRX ": " FMT_LL "u reads, "
+               FMT_LL "u writes, " FMT_LL "u direct accesses", memory_handler->begin,
+               memory_handler->end, memory_handler->reads, memory_handler->writes,
+               memory_handler->direct));
+      BX_MEM_THIS memory_handler_list = memory_handler->next;
+      delete memory_handler;
+    }
   }
 }
 
@@ -722,16 +1509,17 @@ Bit8u *BX_MEM_C::getHostMemAddr(BX_CPU_C *cpu, bx_phy_address addr, unsigned rw)
   }
 #endif
 
-  struct memory_handler_struct *memory_handler = BX_MEM_THIS memory_handlers[a20addr >> 20];
-  while (memory_handler) {
-    if (memory_handler->begin <= a20addr &&
-        memory_handler->end >= a20addr) {
-      if (memory_handler->da_handler)
-        return memory_handler->da_handler(a20addr, rw, memory_handler->param);
-      else
-        return(NULL); // Vetoed! memory handler for i/o apic, vram, mmio and PCI PnP
+  struct memory_handler_struct *memory_handler = BX_MEM_THIS findMemoryHandler(a20addr);
+  if (memory_handler) {
+    if (memory_handler->da_handler) {
+      BX_LOCK_DEVICES();
+      memory_handler->direct++;
+      Bit8u *ptr = memory_handler->da_handler(a20addr, rw, memory_handler->param);
+      BX_UNLOCK_DEVICES();
+      return ptr;
     }
-    memory_handler = memory_handler->next;
+    else
+      return(NULL); // Vetoed! memory handler for i/o apic, vram, mmio and PCI PnP
   }
 
   if (! write) {
@@ -820,37 +1608,41 @@ BX_MEM_C::registerMemoryHandlers(void *param, memory_handler_t read_handler,
                 memory_handler_t write_handler, memory_direct_access_handler_t da_handler,
                 bx_phy_address begin_addr, bx_phy_address end_addr)
 {
+  bx_phy_address page;
+
   if (end_addr < begin_addr)
     return 0;
   if (!read_handler || !write_handler) // allow NULL fetch handler
     return 0;
   BX_INFO(("Register memory access handlers: 0x" FMT_PHY_ADDRX " - 0x" FMT_PHY_ADDRX, begin_addr, end_addr));
-  for (Bit32u page_idx = (Bit32u)(begin_addr >> 20); page_idx <= (Bit32u)(end_addr >> 20); page_idx++) {
-    Bit16u bitmap = 0xffff;
-    if (begin_addr > (page_idx << 20)) {
-      bitmap &= (0xffff << ((begin_addr >> 16) & 0xf));
+  // every page could be claimed by a single handler only
+  for (page = begin_addr >> 12; page <= (end_addr >> 12); page++) {
+    struct memory_handler_struct **page_table = BX_MEM_THIS memory_handlers[page >> 8];
+    if (page_table != NULL && page_table[page & (BX_MEM_HANDLER_PAGES-1)] != NULL) {
+      BX_ERROR(("Register failed: overlapping memory handlers!"));
+      return 0;
     }
-    if (end_addr < ((page_idx + 1) << 20)) {
-      bitmap &= (0xffff >> (0x0f - ((end_addr >> 16) & 0xf)));
-    }
-    if (BX_MEM_THIS memory_handlers[page_idx] != NULL) {
-      if ((bitmap & BX_MEM_THIS memory_handlers[page_idx]->bitmap) != 0) {
-        BX_ERROR(("Register failed: overlapping memory handlers!"));
-        return 0;
-      } else {
-        bitmap |= BX_MEM_THIS memory_handlers[page_idx]->bitmap;
-      }
+  }
+  struct memory_handler_struct *memory_handler = new struct memory_handler_struct;
+  memory_handler->next = BX_MEM_THIS memory_handler_list;
+  BX_MEM_THIS memory_handler_list = memory_handler;
+  memory_handler->read_handler = read_handler;
+  memory_handler->write_handler = write_handler;
+  memory_handler->da_handler = da_handler;
+  memory_handler->param = param;
+  memory_handler->begin = begin_addr;
+  memory_handler->end = end_addr;
+  memory_handler->reads = 0;
+  memory_handler->writes = 0;
+  memory_handler->direct = 0;
+  for (page = begin_addr >> 12; page <= (end_addr >> 12); page++) {
+    struct memory_handler_struct **page_table = BX_MEM_THIS memory_handlers[page >> 8];
+    if (page_table == NULL) {
+      page_table = new struct memory_handler_struct *[BX_MEM_HANDLER_PAGES];
+      memset(page_table, 0, sizeof(struct memory_handler_struct *) * BX_MEM_HANDLER_PAGES);
+      BX_MEM_THIS memory_handlers[page >> 8] = page_table;
     }
-    struct memory_handler_struct *memory_handler = new struct memory_handler_struct;
-    memory_handler->next = BX_MEM_THIS memory_handlers[page_idx];
-    BX_MEM_THIS memory_handlers[page_idx] = memory_handler;
-    memory_handler->read_handler = read_handler;
-    memory_handler->write_handler = write_handler;
-    memory_handler->da_handler = da_handler;
-    memory_handler->param = param;
-    memory_handler->begin = begin_addr;
-    memory_handler->end = end_addr;
-    memory_handler->bitmap = bitmap;
+    page_table[page & (BX_MEM_HANDLER_PAGES-1)] = memory_handler;
   }
   return 1;
 }
@@ -858,30 +1650,31 @@ BX_MEM_C::registerMemoryHandlers(void *param, memory_handler_t read_handler,
   bx_bool
 BX_MEM_C::unregisterMemoryHandlers(void *param, bx_phy_address begin_addr, bx_phy_address end_addr)
 {
-  bx_bool ret = 1;
   BX_INFO(("Memory access handlers unregistered: 0x" FMT_PHY_ADDRX " - 0x" FMT_PHY_ADDRX, begin_addr, end_addr));
-  for (Bit32u page_idx = (Bit32u)(begin_addr >> 20); page_idx <= (Bit32u)(end_addr >> 20); page_idx++) {
-    struct memory_handler_struct *memory_handler = BX_MEM_THIS memory_handlers[page_idx];
-    struct memory_handler_struct *prev = NULL;
-    while (memory_handler &&
-         memory_handler->param != param &&
-         memory_handler->begin != begin_addr &&
-         memory_handler->end != end_addr)
-    {
-      prev = memory_handler;
-      memory_handler = memory_handler->next;
-    }
-    if (!memory_handler) {
-      ret = 0;  // we should have found it
-      continue; // anyway, try the other pages
-    }
-    if (prev)
-      prev->next = memory_handler->next;
-    else
-      BX_MEM_THIS memory_handlers[page_idx] = memory_handler->next;
-    delete memory_handler;
+  struct memory_handler_struct *memory_handler = BX_MEM_THIS memory_handler_list;
+  struct memory_handler_struct *prev = NULL;
+  while (memory_handler &&
+        (memory_handler->param != param ||
+         memory_handler->begin != begin_addr ||
+         memory_handler->end != end_addr))
+  {
+    prev = memory_handler;
+    memory_handler = memory_handler->next;
   }
-  return ret;
+  if (!memory_handler)
+    return 0; // we should have found it
+
+  for (bx_phy_address page = begin_addr >> 12; page <= (end_addr >> 12); page++) {
+    struct memory_handler_struct **page_table = BX_MEM_THIS memory_handlers[page >> 8];
+    if (page_table != NULL && page_table[page & (BX_MEM_HANDLER_PAGES-1)] == memory_handler)
+      page_table[page & (BX_MEM_HANDLER_PAGES-1)] = NULL;
+  }
+  if (prev)
+    prev->next = memory_handler->next;
+  else
+    BX_MEM_THIS memory_handler_list = memory_handler->next;
+  delete memory_handler;
+  return 1;
 }
 
 void BX_MEM_C::enable_smram(bx_bool enable, bx_bool restricted)
@@ -20,6 +20,7 @@
 
 /* Commits a redolog file in a flat file for bochs images. */
 /* Converts growing mode image to flat and vice versa */
+/* Merges the guest RAM of incremental save/restore checkpoints */
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -63,10 +64,12 @@ int snprintf(char *s, size_t maxlen, const char *format, ...)
 
 #define HDIMAGE_HEADERS_ONLY 1
 #include "../iodev/hdimage/hdimage.h"
+#include "../memory/checkpoint.h"
 
 #define BXCOMMIT_MODE_COMMIT_UNDOABLE 1
 #define BXCOMMIT_MODE_GROWING_TO_FLAT 2
 #define BXCOMMIT_MODE_FLAT_TO_GROWING 3
+#define BXCOMMIT_MODE_MERGE_CHECKPOINT 4
 
 typedef struct {
   int              fd;
@@ -99,6 +102,7 @@ const char *main_menu_prompt =
 "1. Commit 'undoable' redolog to 'flat' file\n"
 "2. Create 'flat' disk image from 'growing' disk image\n"
 "3. Create 'growing' disk image from 'flat' disk image\n"
+"4. Merge the parents of an incremental save/restore checkpoint into it\n"
 "\n"
 "0. Quit\n"
 "\n"
@@ -687,14 +691,132 @@ int commit_redolog()
   return 0;
 }
 
+/* copy the RAM pages of the parent checkpoints into the given one */
+int merge_checkpoint()
+{
+  char dir[CHECKPOINT_PATH_LEN], fname[CHECKPOINT_PATH_LEN + 32];
+  char ramname[CHECKPOINT_PATH_LEN + 32], tmpname[CHECKPOINT_PATH_LEN + 32];
+  checkpoint_delta_header_t header;
+  Bit32u *list, pages = 0, page, i, depth;
+  Bit8u *done = NULL;
+  Bit8u buffer[CHECKPOINT_PAGE_SIZE];
+  int fd, ramfd, count;
+
+  snprintf(fname, sizeof(fname), "%s/%s", bx_flat_filename, CHECKPOINT_DELTA_FILE);
+  fd = open(fname, O_RDONLY
+#ifdef O_BINARY
+            | O_BINARY
+#endif
+            );
+  if (fd < 0)
+    fatal("ERROR: no incremental checkpoint found in this directory");
+
+  snprintf(tmpname, sizeof(tmpname), "%s/%s.new", bx_flat_filename, CHECKPOINT_RAM_FILE);
+  ramfd = open(tmpname, O_WRONLY | O_CREAT | O_TRUNC
+#ifdef O_BINARY
+               | O_BINARY
+#endif
+               , S_IWUSR | S_IRUSR | S_IWGRP | S_IRGRP
+               );
+  if (ramfd < 0)
+    fatal("ERROR: RAM file is not writable");
+
+  // walk back to the full checkpoint, the newest copy of a page wins
+  strncpy(dir, bx_flat_filename, CHECKPOINT_PATH_LEN);
+  dir[CHECKPOINT_PATH_LEN - 1] = 0;
+  for (depth = 0; fd >= 0; depth++) {
+    if ((read(fd, &header, sizeof(header)) != sizeof(header)) ||
+        strcmp(header.magic, CHECKPOINT_DELTA_MAGIC) ||
+        (header.version != CHECKPOINT_DELTA_VERSION) ||
+        (header.page_size != CHECKPOINT_PAGE_SIZE))
+      fatal("\nERROR: bad checkpoint delta header!");
+    if (depth == 0) {
+      pages = (Bit32u)(header.ram_size >> 12);
+      done = (Bit8u*)calloc(pages, 1);
+    } else if ((Bit32u)(header.ram_size >> 12) != pages) {
+      fatal("\nERROR: guest memory size differs between the checkpoints!");
+    }
+    if ((header.pages > pages) || (depth >= CHECKPOINT_MAX_CHAIN))
+      fatal("\nERROR: bad checkpoint delta header!");
+    header.parent[CHECKPOINT_PATH_LEN - 1] = 0;
+
+    printf("\nMerging %u pages from '%s'", header.pages, dir);
+    list = (Bit32u*)malloc(header.pages * sizeof(Bit32u) + 1);
+    count = header.pages * sizeof(Bit32u);
+    if (read(fd, list, count) != count)
+      fatal("\nERROR: while reading checkpoint delta!");
+    for (i = 0; i < header.pages; i++) {
+      page = list[i];
+      if (page >= pages)
+        fatal("\nERROR: bad page number in checkpoint delta!");
+      if (done[page]) {
+        lseek(fd, CHECKPOINT_PAGE_SIZE, SEEK_CUR);
+        continue;
+      }
+      if (read(fd, buffer, CHECKPOINT_PAGE_SIZE) != CHECKPOINT_PAGE_SIZE)
+        fatal("\nERROR: while reading checkpoint delta!");
+      if (bx_write_image(ramfd, (Bit64s)page << 12, buffer, CHECKPOINT_PAGE_SIZE) != CHECKPOINT_PAGE_SIZE)
+        fatal("\nERROR: while writing RAM file!");
+      done[page] = 1;
+    }
+    free(list);
+    close(fd);
+
+    strcpy(dir, header.parent);
+    snprintf(fname, sizeof(fname), "%s/%s", dir, CHECKPOINT_DELTA_FILE);
+    fd = open(fname, O_RDONLY
+#ifdef O_BINARY
+              | O_BINARY
+#endif
+              );
+  }
+
+  printf("\nMerging the other pages from '%s'", dir);
+  snprintf(fname, sizeof(fname), "%s/%s", dir, CHECKPOINT_RAM_FILE);
+  fd = open(fname, O_RDONLY
+#ifdef O_BINARY
+            | O_BINARY
+#endif
+            );
+  if (fd < 0)
+    fatal("\nERROR: RAM file of the full checkpoint not found");
+  for (page = 0; page < pages; page++) {
+    if (done[page]) continue;
+    // the RAM file ends after the last block in use, the rest is zero
+    count = bx_read_image(fd, (Bit64s)page << 12, buffer, CHECKPOINT_PAGE_SIZE);
+    if (count <= 0)
+      break;
+    if (count < CHECKPOINT_PAGE_SIZE)
+      memset(buffer + count, 0, CHECKPOINT_PAGE_SIZE - count);
+    if (bx_write_image(ramfd, (Bit64s)page << 12, buffer, CHECKPOINT_PAGE_SIZE) != CHECKPOINT_PAGE_SIZE)
+      fatal("\nERROR: while writing RAM file!");
+  }
+  close(fd);
+  close(ramfd);
+  free(done);
+
+  snprintf(ramname, sizeof(ramname), "%s/%s", bx_flat_filename, CHECKPOINT_RAM_FILE);
+  unlink(ramname);
+  if (rename(tmpname, ramname) != 0)
+    fatal("\nERROR: while renaming the RAM file!");
+  snprintf(fname, sizeof(fname), "%s/%s", bx_flat_filename, CHECKPOINT_DELTA_FILE);
+  if (unlink(fname) != 0)
+    fatal("\nERROR: while removing the checkpoint delta!");
+
+  printf(" Done.\n");
+  return 0;
+}
+
 void print_usage()
 {
   fprintf(stderr,
-    "Usage: bxcommit [options] [flat filename] [redolog filename]\n\n"
+    "Usage: bxcommit [options] [flat filename] [redolog filename]\n"
+    "       bxcommit -mode=merge-checkpoint [options] [checkpoint directory]\n\n"
     "Supported options:\n"
     "  -mode=commit-undoable  commit undoable redolog to flat file\n"
     "  -mode=growing-to-flat  create flat disk image from growing disk image\n"
     "  -mode=flat-to-growing  create growing disk image from flat disk image\n"
+    "  -mode=merge-checkpoint merge parents of an incremental checkpoint into it\n"
     "  -d                     delete source file after commit\n"
     "  -q                     quiet mode (don't prompt for user input)\n"
     "  --help                 display this help and exit\n\n");
@@ -724,6 +846,8 @@ int parse_cmdline(int argc, char *argv[])
         bxcommit_mode = BXCOMMIT_MODE_GROWING_TO_FLAT;
       } else if (!strcmp(&argv[arg][6], "flat-to-growing")) {
         bxcommit_mode = BXCOMMIT_MODE_FLAT_TO_GROWING;
+      } else if (!strcmp(&argv[arg][6], "merge-checkpoint")) {
+        bxcommit_mode = BXCOMMIT_MODE_MERGE_CHECKPOINT;
       } else {
         printf("Unknown bxcommit mode '%s'\n\n", &argv[arg][6]);
       }
@@ -750,7 +874,7 @@ int parse_cmdline(int argc, char *argv[])
     arg++;
   }
   if ((bxcommit_mode == 0) ||
-      (fnargs < 2)) {
+      (fnargs < ((bxcommit_mode == BXCOMMIT_MODE_MERGE_CHECKPOINT) ? 1 : 2))) {
     bx_interactive = 1;
   }
   return ret;
@@ -766,7 +890,7 @@ int CDECL main(int argc, char *argv[])
   print_banner();
 
   if (bx_interactive) {
-    if (ask_int(main_menu_prompt, 0, 3, bxcommit_mode, &bxcommit_mode) < 0)
+    if (ask_int(main_menu_prompt, 0, 4, bxcommit_mode, &bxcommit_mode) < 0)
       fatal(EOF_ERR);
 
     switch (bxcommit_mode) {
@@ -820,10 +944,18 @@ int CDECL main(int argc, char *argv[])
         if (ask_yn("\nShould the 'flat' image been removed afterwards?\n", 0, &bx_remove) < 0)
           fatal(EOF_ERR);
         break;
+
+      case BXCOMMIT_MODE_MERGE_CHECKPOINT:
+        if (ask_string("\nWhat is the checkpoint directory?\n", bx_flat_filename, bx_flat_filename) < 0)
+          fatal(EOF_ERR);
+        break;
     }
   }
 
-  if (bxcommit_mode != BXCOMMIT_MODE_FLAT_TO_GROWING) {
+  if (bxcommit_mode == BXCOMMIT_MODE_MERGE_CHECKPOINT) {
+    // the parents are not removed, other checkpoints could depend on them
+    merge_checkpoint();
+  } else if (bxcommit_mode != BXCOMMIT_MODE_FLAT_TO_GROWING) {
     commit_redolog();
     if (bx_remove) {
       if (unlink(bx_redolog_name) != 0)
@@ -0,0 +1,171 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2013  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+//
+// test-savestate.cc
+//
+// Test of the chunk codec of the binary save/restore format (see
+// gui/sr_codec.h). Chunks of zero, compressible and random data are packed
+// and unpacked again and must come back unchanged. Then the stored data,
+// the sizes, the checksum and the method of each chunk are damaged one at
+// a time. Unpacking must fail for all of them, except for flipped bits of
+// the stored data which do not change the unpacked data (e.g. the match
+// distance in a run of zeros); it must never return different data.
+//
+// Compile with (from the directory containing config.h):
+//   c++ -I. -O2 -o test-savestate misc/test-savestate.cc -lz
+// leaving out -lz if bochs was configured without zlib. Then run
+// "test-savestate" and see how it goes. If failures=0, the codec works.
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "gui/sr_codec.h"
+
+static unsigned failures = 0;
+
+static void fail(const char *what, const char *name, Bit32u size)
+{
+  printf("FAIL: %s, %s data, size %u\n", what, name, size);
+  failures++;
+}
+
+static void fill(Bit8u *buf, Bit32u size, int kind)
+{
+  static const char text[] = "Bochs is a highly portable open source IA-32 PC emulator. ";
+
+  for (Bit32u i = 0; i < size; i++) {
+    switch (kind) {
+      case 0: buf[i] = 0; break;
+      case 1: buf[i] = text[i % (sizeof(text) - 1)]; break;
+      case 2: buf[i] = (Bit8u) rand(); break;
+      // zero except for the last byte
+      default: buf[i] = (i == size - 1) ? 0x5a : 0; break;
+    }
+  }
+}
+
+static bx_bool unpack_fails(Bit32u method, const Bit8u *data, Bit32u csize,
+                            Bit32u checksum, Bit8u *dst, Bit32u size)
+{
+  // the destination holds other data than the chunk, like on restore
+  memset(dst, 0xa5, size);
+  return !sr_unpack_chunk(method, data, csize, checksum, dst, size);
+}
+
+static void test_chunk(const char *name, int kind, Bit32u size, Bit8u *src, Bit8u *buf,
+                       Bit8u *copy, Bit8u *dst)
+{
+  Bit32u method, csize, checksum, i;
+
+  fill(src, size, kind);
+  const Bit8u *out = sr_pack_chunk(src, size, buf, &method, &csize, &checksum);
+
+  // round trip
+  if (kind == 0) {
+    if ((method != SR_CHUNK_ZERO) || (out != NULL) || (csize != 0))
+      fail("zero chunk not recognized", name, size);
+  } else if (method == SR_CHUNK_ZERO) {
+    fail("data chunk stored as zero", name, size);
+    return;
+  } else if (csize > size) {
+    fail("chunk grew", name, size);
+  }
+#if BX_HAVE_ZLIB
+  if ((kind == 1) && (size >= 256) && (method != SR_CHUNK_ZLIB))
+    fail("text not compressed", name, size);
+#endif
+  if ((kind != 0) && (checksum != sr_adler32(src, size)))
+    fail("wrong checksum", name, size);
+  memset(dst, 0xa5, size);
+  if (!sr_unpack_chunk(method, out, csize, checksum, dst, size) || memcmp(dst, src, size))
+    fail("round trip", name, size);
+  if (kind == 0) {
+    if (unpack_fails(method, out, 1, checksum, dst, size))
+      return;
+    fail("zero chunk with data accepted", name, size);
+    return;
+  }
+
+  // damaged chunks
+  memcpy(copy, out, csize);
+  for (i = 0; i < 16; i++) {
+    Bit32u pos = (i < 2) ? i * (csize - 1) : (Bit32u) rand() % csize;
+    copy[pos] ^= 1 << (i & 7);
+    if (!unpack_fails(method, copy, csize, checksum, dst, size) && memcmp(dst, src, size))
+      fail("damaged data accepted", name, size);
+    copy[pos] ^= 1 << (i & 7);
+  }
+  if (!unpack_fails(method, copy, csize - 1, checksum, dst, size))
+    fail("truncated data accepted", name, size);
+  if ((csize > 2) && !unpack_fails(method, copy, csize / 2, checksum, dst, size))
+    fail("half of the data accepted", name, size);
+  if (!unpack_fails(method, copy, csize, checksum, dst, size - 1))
+    fail("smaller chunk size accepted", name, size);
+  if ((size < SR_CHUNK_SIZE) && !unpack_fails(method, copy, csize, checksum, dst, size + 1))
+    fail("larger chunk size accepted", name, size);
+  if (!unpack_fails(method, copy, csize, checksum ^ 0x10000, dst, size))
+    fail("wrong checksum accepted", name, size);
+  if (!unpack_fails(SR_CHUNK_ZERO, copy, csize, checksum, dst, size))
+    fail("data accepted as zero chunk", name, size);
+  if (!unpack_fails(7, copy, csize, checksum, dst, size))
+    fail("unknown method accepted", name, size);
+  if ((method == SR_CHUNK_ZLIB) && !unpack_fails(SR_CHUNK_RAW, copy, csize, checksum, dst, size))
+    fail("compressed data accepted as raw", name, size);
+}
+
+int main(int argc, char *argv[])
+{
+  static const char *names[4] = { "zero", "text", "random", "sparse" };
+  static const Bit32u sizes[] = { 1, 2, 7, 64, 511, 4096, 4099, SR_CHUNK_SIZE - 1, SR_CHUNK_SIZE };
+  Bit8u *src = new Bit8u[SR_CHUNK_SIZE + 1];
+  Bit8u *buf = new Bit8u[SR_CHUNK_SIZE];
+  Bit8u *copy = new Bit8u[SR_CHUNK_SIZE];
+  Bit8u *dst = new Bit8u[SR_CHUNK_SIZE + 1];
+  unsigned tests = 0;
+
+  srand(1);
+  // reference value of the Adler-32 checksum
+  if (sr_adler32((const Bit8u*) "Wikipedia", 9) != 0x11e60398)
+    fail("Adler-32 reference", "text", 9);
+#if BX_HAVE_ZLIB
+  fill(src, SR_CHUNK_SIZE, 2);
+  if (sr_adler32(src, SR_CHUNK_SIZE) != adler32(1, src, SR_CHUNK_SIZE))
+    fail("Adler-32 differs from zlib", "random", SR_CHUNK_SIZE);
+#endif
+  for (int kind = 0; kind < 4; kind++) {
+    for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      test_chunk(names[kind], kind, sizes[i], src, buf, copy, dst);
+      tests++;
+    }
+  }
+  printf("%u chunks tested (%s), failures=%u\n", tests,
+         BX_HAVE_ZLIB ? "zlib" : "stored only", failures);
+  delete [] src;
+  delete [] buf;
+  delete [] copy;
+  delete [] dst;
+  return (failures > 0);
+}
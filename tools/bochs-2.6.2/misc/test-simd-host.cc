@@ -0,0 +1,595 @@
+/////////////////////////////////////////////////////////////////////////
+// $Id$
+/////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2013  The Bochs Project
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+/////////////////////////////////////////////////////////////////////////
+//
+// test-simd-host.cc
+//
+// Differential test of the packed integer helpers in cpu/simd_int.h and
+// cpu/simd_compare.h. The helpers are compiled twice, once with the host
+// SIMD backend (see cpu/simd_host.h) and once with the scalar reference
+// code only, and both are run on the same random and edge case operands.
+// Any difference in the results is reported.
+//
+// The packed floating point operations the host unit executes are checked
+// against softfloat with NaN, infinite, denormal and rounding edge
+// operands. A result the host commits must match softfloat bit for bit and
+// with the same exception flags, a discarded one must leave the operand
+// alone, and the MXCSR of the host must be the same as before.
+//
+// "make check" builds it with the compiler flags bochs was configured
+// with, so it tests the host instruction set level the emulator uses. To
+// try another level, compile with (from the directory containing config.h):
+//   c++ -I. -O2 -msse4.2 -o test-simd-host misc/test-simd-host.cc
+//     cpu/fpu/softfloat.cc cpu/fpu/softfloat-round-pack.cc
+//     cpu/fpu/softfloat-specialize.cc
+// and repeat with -msse2 and -mssse3 for the other levels. Then run
+// "test-simd-host [iterations]" and see how it goes. If mismatches=0, both
+// backends agree. Without a host backend (--disable-host-simd or a target
+// without SSE2) there is nothing to compare and the test is skipped.
+//
+/////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "cpu/xmm.h"
+
+// the host intrinsics headers are included here, outside of the namespace
+#include "cpu/simd_host.h"
+
+#if BX_HOST_SSE2
+
+#include "cpu/fpu/softfloat.h"
+#include "cpu/simd_pfp.h"
+
+#define SIMD_HELPERS \
+  R(sse_pabsb) \
+  R(sse_pabsw) \
+  R(sse_pabsd) \
+  RA(sse_pminsb) \
+  RA(sse_pminub) \
+  RA(sse_pminsw) \
+  RA(sse_pminuw) \
+  RA(sse_pminsd) \
+  RA(sse_pminud) \
+  RA(sse_pmaxsb) \
+  RA(sse_pmaxub) \
+  RA(sse_pmaxsw) \
+  RA(sse_pmaxuw) \
+  RA(sse_pmaxsd) \
+  RA(sse_pmaxud) \
+  RA(sse_unpcklps) \
+  RA(sse_unpckhps) \
+  RA(sse_unpcklpd) \
+  RA(sse_unpckhpd) \
+  RA(sse_punpcklbw) \
+  RA(sse_punpckhbw) \
+  RA(sse_punpcklwd) \
+  RA(sse_punpckhwd) \
+  RA(sse_packuswb) \
+  RA(sse_packsswb) \
+  RA(sse_packusdw) \
+  RA(sse_packssdw) \
+  RAB(sse_pshufb) \
+  RAI(sse_pshufhw) \
+  RAI(sse_pshuflw) \
+  RABI(sse_shufps) \
+  RABI(sse_shufpd) \
+  RAB(sse_permilps) \
+  RAB(sse_permilpd) \
+  RABCI(sse_permil2ps) \
+  RABCI(sse_permil2pd) \
+  RA(sse_psignb) \
+  RA(sse_psignw) \
+  RA(sse_psignd) \
+  MSK(sse_pmovmskb) \
+  MSK(sse_pmovmskd) \
+  MSK(sse_pmovmskq) \
+  RAI(sse_pblendw) \
+  RAI(sse_blendps) \
+  RAI(sse_blendpd) \
+  RAB(sse_pblendvb) \
+  RAB(sse_blendvps) \
+  RAB(sse_blendvpd) \
+  RA(sse_andps) \
+  RA(sse_andnps) \
+  RA(sse_orps) \
+  RA(sse_xorps) \
+  RA(sse_paddb) \
+  RA(sse_paddw) \
+  RA(sse_paddd) \
+  RA(sse_paddq) \
+  RA(sse_psubb) \
+  RA(sse_psubw) \
+  RA(sse_psubd) \
+  RA(sse_psubq) \
+  RA(sse_paddsb) \
+  RA(sse_paddsw) \
+  RA(sse_paddusb) \
+  RA(sse_paddusw) \
+  RA(sse_psubsb) \
+  RA(sse_psubsw) \
+  RA(sse_psubusb) \
+  RA(sse_psubusw) \
+  RA(sse_phaddw) \
+  RA(sse_phaddd) \
+  RA(sse_phaddsw) \
+  RA(sse_phsubw) \
+  RA(sse_phsubd) \
+  RA(sse_phsubsw) \
+  RA(sse_pavgb) \
+  RA(sse_pavgw) \
+  RA(sse_pmullw) \
+  RA(sse_pmulhw) \
+  RA(sse_pmulhuw) \
+  RA(sse_pmulld) \
+  RA(sse_pmuldq) \
+  RA(sse_pmuludq) \
+  RA(sse_pmulhrsw) \
+  RA(sse_pmaddubsw) \
+  RA(sse_pmaddwd) \
+  RI(sse_pbroadcastb) \
+  RI(sse_pbroadcastw) \
+  RI(sse_pbroadcastd) \
+  RI(sse_pbroadcastq) \
+  RA(sse_psadbw) \
+  RABI(sse_mpsadbw) \
+  RAB(sse_pselect) \
+  RA(sse_psravd) \
+  RA(sse_psllvd) \
+  RA(sse_psllvq) \
+  RA(sse_psrlvd) \
+  RA(sse_psrlvq) \
+  RI(sse_psraw) \
+  RI(sse_psrad) \
+  RI(sse_psrlw) \
+  RI(sse_psrld) \
+  RI(sse_psrlq) \
+  RI(sse_psllw) \
+  RI(sse_pslld) \
+  RI(sse_psllq) \
+  RI(sse_psrldq) \
+  RI(sse_pslldq) \
+  RAI(sse_palignr) \
+  RI(sse_prorb) \
+  RI(sse_prorw) \
+  RI(sse_prord) \
+  RI(sse_prorq) \
+  RI(sse_prolb) \
+  RI(sse_prolw) \
+  RI(sse_prold) \
+  RI(sse_prolq) \
+  RA(sse_protb) \
+  RA(sse_protw) \
+  RA(sse_protd) \
+  RA(sse_protq) \
+  RA(sse_pshab) \
+  RA(sse_pshaw) \
+  RA(sse_pshad) \
+  RA(sse_pshaq) \
+  RA(sse_pshlb) \
+  RA(sse_pshlw) \
+  RA(sse_pshld) \
+  RA(sse_pshlq) \
+  RA(sse_pcmpltb) \
+  RA(sse_pcmpltw) \
+  RA(sse_pcmpltd) \
+  RA(sse_pcmpltq) \
+  RA(sse_pcmpltub) \
+  RA(sse_pcmpltuw) \
+  RA(sse_pcmpltud) \
+  RA(sse_pcmpltuq) \
+  RA(sse_pcmpleb) \
+  RA(sse_pcmplew) \
+  RA(sse_pcmpled) \
+  RA(sse_pcmpleq) \
+  RA(sse_pcmpleub) \
+  RA(sse_pcmpleuw) \
+  RA(sse_pcmpleud) \
+  RA(sse_pcmpleuq) \
+  RA(sse_pcmpgtb) \
+  RA(sse_pcmpgtw) \
+  RA(sse_pcmpgtd) \
+  RA(sse_pcmpgtq) \
+  RA(sse_pcmpgtub) \
+  RA(sse_pcmpgtuw) \
+  RA(sse_pcmpgtud) \
+  RA(sse_pcmpgtuq) \
+  RA(sse_pcmpgeb) \
+  RA(sse_pcmpgew) \
+  RA(sse_pcmpged) \
+  RA(sse_pcmpgeq) \
+  RA(sse_pcmpgeub) \
+  RA(sse_pcmpgeuw) \
+  RA(sse_pcmpgeud) \
+  RA(sse_pcmpgeuq) \
+  RA(sse_pcmpeqb) \
+  RA(sse_pcmpeqw) \
+  RA(sse_pcmpeqd) \
+  RA(sse_pcmpeqq) \
+  RA(sse_pcmpneb) \
+  RA(sse_pcmpnew) \
+  RA(sse_pcmpned) \
+  RA(sse_pcmpneq) \
+  RA(sse_pcmptrue) \
+  RA(sse_pcmpfalse)
+
+// one set of wrappers with uniform arguments per backend
+#define R(func)     static void func(BxPackedXmmRegister *r, BxPackedXmmRegister *a, BxPackedXmmRegister *b, BxPackedXmmRegister *c, Bit64u imm, Bit32u *ret) { ::NS::func(r); }
+#define RA(func)    static void func(BxPackedXmmRegister *r, BxPackedXmmRegister *a, BxPackedXmmRegister *b, BxPackedXmmRegister *c, Bit64u imm, Bit32u *ret) { ::NS::func(r, a); }
+#define RAB(func)   static void func(BxPackedXmmRegister *r, BxPackedXmmRegister *a, BxPackedXmmRegister *b, BxPackedXmmRegister *c, Bit64u imm, Bit32u *ret) { ::NS::func(r, a, b); }
+#define RAI(func)   static void func(BxPackedXmmRegister *r, BxPackedXmmRegister *a, BxPackedXmmRegister *b, BxPackedXmmRegister *c, Bit64u imm, Bit32u *ret) { ::NS::func(r, a, (Bit8u) imm); }
+#define RABI(func)  static void func(BxPackedXmmRegister *r, BxPackedXmmRegister *a, BxPackedXmmRegister *b, BxPackedXmmRegister *c, Bit64u imm, Bit32u *ret) { ::NS::func(r, a, b, (Bit8u) imm); }
+#define RABCI(func) static void func(BxPackedXmmRegister *r, BxPackedXmmRegister *a, BxPackedXmmRegister *b, BxPackedXmmRegister *c, Bit64u imm, Bit32u *ret) { ::NS::func(r, a, b, c, (Bit8u) imm); }
+#define RI(func)    static void func(BxPackedXmmRegister *r, BxPackedXmmRegister *a, BxPackedXmmRegister *b, BxPackedXmmRegister *c, Bit64u imm, Bit32u *ret) { ::NS::func(r, imm); }
+#define MSK(func)   static void func(BxPackedXmmRegister *r, BxPackedXmmRegister *a, BxPackedXmmRegister *b, BxPackedXmmRegister *c, Bit64u imm, Bit32u *ret) { *ret = ::NS::func(r); }
+
+typedef void (*helper_t)(BxPackedXmmRegister *r, BxPackedXmmRegister *a,
+     BxPackedXmmRegister *b, BxPackedXmmRegister *c, Bit64u imm, Bit32u *ret);
+
+// host backend
+namespace host {
+#include "cpu/simd_int.h"
+#include "cpu/simd_compare.h"
+}
+
+namespace host_test {
+#define NS host
+SIMD_HELPERS
+#undef NS
+}
+
+static const char *host_level =
+  BX_HOST_SSE4_2 ? "SSE4.2" : BX_HOST_SSE4_1 ? "SSE4.1" : BX_HOST_SSSE3 ? "SSSE3" :
+  BX_HOST_SSE3 ? "SSE3" : "SSE2";
+
+// scalar reference, the headers are included once more with the host
+// backend disabled
+#undef BX_SIMD_HOST_FUNCTIONS_H
+#undef BX_SIMD_INT_FUNCTIONS_H
+#undef BX_SIMD_INT_COMPARE_FUNCTIONS_H
+#undef BX_SUPPORT_HOST_SIMD
+#define BX_SUPPORT_HOST_SIMD 0
+#undef BX_HOST_SSE2
+#undef BX_HOST_SSE3
+#undef BX_HOST_SSSE3
+#undef BX_HOST_SSE4_1
+#undef BX_HOST_SSE4_2
+#undef BX_HOST_AVX2
+#undef BX_HOST_RUNTIME_ISA
+#undef BX_HOST_TARGET
+#undef SSE_HOST_FP_2OP
+
+namespace scalar {
+#include "cpu/simd_int.h"
+#include "cpu/simd_compare.h"
+}
+
+namespace scalar_test {
+#define NS scalar
+SIMD_HELPERS
+#undef NS
+}
+
+#undef R
+#undef RA
+#undef RAB
+#undef RAI
+#undef RABI
+#undef RABCI
+#undef RI
+#undef MSK
+
+#define R(func)     { #func, host_test::func, scalar_test::func },
+#define RA(func)    R(func)
+#define RAB(func)   R(func)
+#define RAI(func)   R(func)
+#define RABI(func)  R(func)
+#define RABCI(func) R(func)
+#define RI(func)    R(func)
+#define MSK(func)   R(func)
+
+static struct {
+  const char *name;
+  helper_t host, scalar;
+} helpers[] = {
+SIMD_HELPERS
+};
+
+static Bit64u seed = BX_CONST64(88172645463325252);
+
+static Bit64u rnd(void)
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return seed;
+}
+
+// random bytes mixed with the saturation and sign boundaries
+static void fill(BxPackedXmmRegister *op)
+{
+  static const Bit8u special[] = { 0x00, 0x01, 0x7f, 0x80, 0x81, 0xff, 0xfe, 0x40 };
+  unsigned mode = (unsigned) (rnd() % 4);
+
+  for (unsigned n=0; n<16; n++) {
+    switch(mode) {
+      case 0:
+        op->xmmubyte(n) = (Bit8u) rnd();
+        break;
+      case 1:
+        op->xmmubyte(n) = special[rnd() % 8];
+        break;
+      case 2:
+        op->xmmubyte(n) = (n & 1) ? special[rnd() % 8] : (Bit8u) rnd();
+        break;
+      default:
+        op->xmmubyte(n) = (rnd() % 3) ? 0x80 : 0x00;
+        break;
+    }
+  }
+}
+
+// packed floating point
+
+static void sse_sqrtps(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2, float_status_t &status)
+{
+  for (unsigned n=0; n<4; n++)
+    op1->xmm32u(n) = float32_sqrt(op1->xmm32u(n), status);
+}
+
+static void sse_sqrtpd(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2, float_status_t &status)
+{
+  for (unsigned n=0; n<2; n++)
+    op1->xmm64u(n) = float64_sqrt(op1->xmm64u(n), status);
+}
+
+typedef void (*fp_helper_t)(BxPackedXmmRegister *op1, const BxPackedXmmRegister *op2, float_status_t &status);
+
+static struct {
+  const char *name;
+  unsigned op;
+  bx_bool pd;
+  fp_helper_t softfloat;
+} fp_ops[] = {
+  { "addps", BX_HOST_FP_ADDPS, 0, sse_addps },
+  { "addpd", BX_HOST_FP_ADDPD, 1, sse_addpd },
+  { "subps", BX_HOST_FP_SUBPS, 0, sse_subps },
+  { "subpd", BX_HOST_FP_SUBPD, 1, sse_subpd },
+  { "mulps", BX_HOST_FP_MULPS, 0, sse_mulps },
+  { "mulpd", BX_HOST_FP_MULPD, 1, sse_mulpd },
+  { "divps", BX_HOST_FP_DIVPS, 0, sse_divps },
+  { "divpd", BX_HOST_FP_DIVPD, 1, sse_divpd },
+  { "minps", BX_HOST_FP_MINPS, 0, sse_minps },
+  { "minpd", BX_HOST_FP_MINPD, 1, sse_minpd },
+  { "maxps", BX_HOST_FP_MAXPS, 0, sse_maxps },
+  { "maxpd", BX_HOST_FP_MAXPD, 1, sse_maxpd },
+  { "sqrtps", BX_HOST_FP_SQRTPS, 0, sse_sqrtps },
+  { "sqrtpd", BX_HOST_FP_SQRTPD, 1, sse_sqrtpd },
+  { "haddps", BX_HOST_FP_HADDPS, 0, sse_haddps },
+  { "haddpd", BX_HOST_FP_HADDPD, 1, sse_haddpd },
+  { "hsubps", BX_HOST_FP_HSUBPS, 0, sse_hsubps },
+  { "hsubpd", BX_HOST_FP_HSUBPD, 1, sse_hsubpd },
+  { "addsubps", BX_HOST_FP_ADDSUBPS, 0, sse_addsubps },
+  { "addsubpd", BX_HOST_FP_ADDSUBPD, 1, sse_addsubpd }
+};
+
+// zeros, infinities, quiet and signaling NaNs, denormals, the normal
+// limits and values one ulp or half an ulp away from 1.0 and 2^24 / 2^53
+static const Bit32u special32[] = {
+  0x00000000, 0x80000000, 0x7f800000, 0xff800000, 0x7fc00000, 0xffc00001,
+  0x7fa00000, 0x00000001, 0x807fffff, 0x00800000, 0x7f7fffff, 0x3f800000,
+  0x3f800001, 0xbf7fffff, 0x33800000, 0x33800001, 0x4b800000, 0x4b800001
+};
+
+static const Bit64u special64[] = {
+  BX_CONST64(0x0000000000000000), BX_CONST64(0x8000000000000000),
+  BX_CONST64(0x7ff0000000000000), BX_CONST64(0xfff0000000000000),
+  BX_CONST64(0x7ff8000000000000), BX_CONST64(0xfff8000000000001),
+  BX_CONST64(0x7ff4000000000000), BX_CONST64(0x0000000000000001),
+  BX_CONST64(0x800fffffffffffff), BX_CONST64(0x0010000000000000),
+  BX_CONST64(0x7fefffffffffffff), BX_CONST64(0x3ff0000000000000),
+  BX_CONST64(0x3ff0000000000001), BX_CONST64(0xbfefffffffffffff),
+  BX_CONST64(0x3ca0000000000000), BX_CONST64(0x3ca0000000000001),
+  BX_CONST64(0x4340000000000000), BX_CONST64(0x4340000000000001)
+};
+
+// random values mixed with the special ones, small exponents that round
+// near the middle of an ulp, and tiny values that underflow
+static void fill_fp(BxPackedXmmRegister *op, bx_bool pd)
+{
+  unsigned lanes = pd ? 2 : 4;
+
+  for (unsigned n=0; n<lanes; n++) {
+    Bit64u r = rnd(), val;
+    switch(rnd() % 5) {
+      case 0:
+        val = r;
+        break;
+      case 1:
+        val = pd ? special64[r % 18] : special32[r % 18];
+        break;
+      case 2:
+        // few mantissa bits: exact results, ties and halfway cases
+        if (pd)
+          val = (r & BX_CONST64(0x8000000000000000)) | ((BX_CONST64(1020) + (r >> 8) % 8) << 52) | ((r & 0xff) << 44);
+        else
+          val = (r & 0x80000000) | ((124 + (r >> 8) % 8) << 23) | ((r & 0xff) << 15);
+        break;
+      case 3:
+        // full mantissa with exponents around 1.0
+        if (pd)
+          val = (r & BX_CONST64(0x800fffffffffffff)) | ((BX_CONST64(1020) + (r >> 52) % 8) << 52);
+        else
+          val = (r & 0x807fffff) | ((124 + (r >> 32) % 8) << 23);
+        break;
+      default:
+        // tiny normal and denormal values
+        if (pd)
+          val = (r & BX_CONST64(0x800fffffffffffff)) | (((r >> 52) % 3) << 52);
+        else
+          val = (r & 0x807fffff) | (((r >> 32) % 3) << 23);
+        break;
+    }
+    if (pd)
+      op->xmm64u(n) = val;
+    else
+      op->xmm32u(n) = (Bit32u) val;
+  }
+}
+
+// returns the number of operations with a mismatch
+static unsigned test_fp(unsigned iterations)
+{
+  unsigned num_ops = sizeof(fp_ops) / sizeof(fp_ops[0]);
+  unsigned mismatches = 0, tested = 0;
+  Bit32u saved_mxcsr = _mm_getcsr();
+  // the host thread runs with other settings than the guest operations
+  Bit32u host_mxcsr = MXCSR_MASKED_EXCEPTIONS | MXCSR_ROUNDING_CONTROL |
+       MXCSR_DAZ | MXCSR_FLUSH_MASKED_UNDERFLOW | MXCSR_PE;
+
+  for (unsigned fn=0; fn < num_ops; fn++) {
+    unsigned bad = 0, host = 0;
+    bx_bool pd = fp_ops[fn].pd;
+
+    if (! xmm_host_fp_allowed(bx_mxcsr_t(MXCSR_RESET), fp_ops[fn].op))
+      continue;
+
+    for (unsigned n=0; n < iterations; n++) {
+      BxPackedXmmRegister a, b, r1, r2;
+      float_status_t status;
+
+      fill_fp(&a, pd); fill_fp(&b, pd);
+      r1 = a; r2 = a;
+
+      // the precision exception may be unmasked
+      bx_mxcsr_t mxcsr((n & 1) ? MXCSR_RESET : (MXCSR_RESET & ~MXCSR_PM));
+      Bit32u guest_mxcsr = mxcsr.mxcsr;
+
+      _mm_setcsr(host_mxcsr);
+      bx_bool done = xmm_host_fp_2op(fp_ops[fn].op, &r1, &b, 1, mxcsr);
+      Bit32u after = _mm_getcsr();
+      _mm_setcsr(saved_mxcsr);
+
+      status.float_exception_flags = 0;
+      status.float_nan_handling_mode = float_first_operand_nan;
+      status.float_rounding_mode = float_round_nearest_even;
+      status.flush_underflow_to_zero = 0;
+      status.float_exception_masks = mxcsr.get_exceptions_masks();
+      status.denormals_are_zeros = 0;
+      fp_ops[fn].softfloat(&r2, &b, status);
+      // like check_exceptionsSSE(), the x87 only flags are dropped
+      Bit32u flags = status.float_exception_flags & MXCSR_EXCEPTIONS;
+
+      const char *what = NULL;
+      if (after != host_mxcsr)
+        what = "host MXCSR changed";
+      else if (done) {
+        host++;
+        if (memcmp(&r1, &r2, 16))
+          what = "result";
+        else if (flags & ~MXCSR_PE)
+          what = "committed with exceptions";
+        else if (mxcsr.mxcsr != (guest_mxcsr | flags))
+          what = "flags";
+        else if (flags && (mxcsr.get_PM() == 0))
+          what = "committed with unmasked precision";
+      } else {
+        if (memcmp(&r1, &a, 16))
+          what = "operand changed";
+        else if (mxcsr.mxcsr != guest_mxcsr)
+          what = "flags changed";
+      }
+
+      if (what) {
+        if (bad < 3)
+          printf("MISMATCH %s (%s) %08x%08x%08x%08x %08x%08x%08x%08x\n", fp_ops[fn].name, what,
+             a.xmm32u(3), a.xmm32u(2), a.xmm32u(1), a.xmm32u(0),
+             b.xmm32u(3), b.xmm32u(2), b.xmm32u(1), b.xmm32u(0));
+        bad++;
+      }
+    }
+    // the host must not give up on plain operands
+    if (host == 0) {
+      printf("MISMATCH %s never executed on the host\n", fp_ops[fn].name);
+      bad++;
+    }
+    if (bad) mismatches++;
+    tested++;
+  }
+
+  printf("%u floating point operations, mismatches=%u\n", tested, mismatches);
+  return mismatches;
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned iterations = (argc > 1) ? atoi(argv[1]) : 200000;
+  unsigned num_helpers = sizeof(helpers) / sizeof(helpers[0]);
+  unsigned mismatches = 0;
+
+  printf("host backend: %s, %u iterations\n", host_level, iterations);
+
+  for (unsigned fn=0; fn < num_helpers; fn++) {
+    unsigned bad = 0;
+    for (unsigned n=0; n < iterations; n++) {
+      BxPackedXmmRegister r1, a1, b1, c1, r2, a2, b2, c2;
+      Bit32u ret1 = 0, ret2 = 0;
+
+      fill(&r1); fill(&a1); fill(&b1); fill(&c1);
+      r2 = r1; a2 = a1; b2 = b1; c2 = c1;
+
+      // immediates and shift counts, including the out of range ones
+      Bit64u imm = rnd();
+      switch(rnd() % 4) {
+        case 0: imm &= 0xff; break;
+        case 1: imm %= 70; break;
+        case 2: imm &= 0x3; break;
+      }
+
+      helpers[fn].host(&r1, &a1, &b1, &c1, imm, &ret1);
+      helpers[fn].scalar(&r2, &a2, &b2, &c2, imm, &ret2);
+
+      if (memcmp(&r1, &r2, 16) || memcmp(&a1, &a2, 16) || memcmp(&b1, &b2, 16) || ret1 != ret2) {
+        if (bad < 3)
+          printf("MISMATCH %s imm=%llx\n", helpers[fn].name, (unsigned long long) imm);
+        bad++;
+      }
+    }
+    if (bad) mismatches++;
+  }
+
+  printf("%u helpers, mismatches=%u\n", num_helpers, mismatches);
+  mismatches += test_fp(iterations);
+  return mismatches != 0;
+}
+
+#else
+
+int main(int argc, char *argv[])
+{
+  printf("no host SIMD backend in this configuration, skipped\n");
+  return 0;
+}
+
+#endif
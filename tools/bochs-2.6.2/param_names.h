@@ -39,9 +39,16 @@
 #define BXPN_CPU_MODEL                   "cpu.model"
 #define BXPN_IPS                         "cpu.ips"
 #define BXPN_SMP_QUANTUM                 "cpu.quantum"
+#define BXPN_SMP_HOST_THREADS            "cpu.host_threads"
+#define BXPN_SMP_HOST_QUANTUM            "cpu.host_quantum"
+#define BXPN_SMP_SPIN_THRESHOLD          "cpu.spin_threshold"
 #define BXPN_RESET_ON_TRIPLE_FAULT       "cpu.reset_on_triple_fault"
 #define BXPN_IGNORE_BAD_MSRS             "cpu.ignore_bad_msrs"
 #define BXPN_CONFIGURABLE_MSRS_PATH      "cpu.msrs"
+#define BXPN_ICACHE_ENTRIES              "cpu.icache_entries"
+#define BXPN_ICACHE_MPOOL                "cpu.icache_mpool"
+#define BXPN_ICACHE_VICTIM               "cpu.icache_victim"
+#define BXPN_ICACHE_SPLIT                "cpu.icache_split"
 #define BXPN_CPUID_LIMIT_WINNT           "cpu.cpuid_limit_winnt"
 #define BXPN_MWAIT_IS_NOP                "cpu.mwait_is_nop"
 #define BXPN_VENDOR_STRING               "cpuid.vendor_string"
@@ -79,6 +86,11 @@
 #define BXPN_CPUID_SMAP                  "cpuid.smap"
 #define BXPN_MEM_SIZE                    "memory.standard.ram.size"
 #define BXPN_HOST_MEM_SIZE               "memory.standard.ram.host_size"
+#define BXPN_MEM_BACKEND                 "memory.standard.ram.backend"
+#define BXPN_MEM_FILE                    "memory.standard.ram.file"
+#define BXPN_MEM_FILE_SHARED             "memory.standard.ram.shared"
+#define BXPN_MEM_INCREMENTAL             "memory.standard.ram.incremental"
+#define BXPN_MEM_RESTORE                 "memory.standard.ram.restore"
 #define BXPN_ROM_PATH                    "memory.standard.rom.path"
 #define BXPN_ROM_ADDRESS                 "memory.standard.rom.addr"
 #define BXPN_VGA_ROM_PATH                "memory.standard.vgarom.path"
@@ -101,6 +113,7 @@
 #define BXPN_CLOCK_SYNC                  "clock_cmos.clock_sync"
 #define BXPN_CLOCK_TIME0                 "clock_cmos.time0"
 #define BXPN_CLOCK_RTC_SYNC              "clock_cmos.rtc_sync"
+#define BXPN_CLOCK_IDLE_SKIP             "clock_cmos.idle_skip"
 #define BXPN_CMOSIMAGE_ENABLED           "clock_cmos.cmosimage.enabled"
 #define BXPN_CMOSIMAGE_PATH              "clock_cmos.cmosimage.path"
 #define BXPN_CMOSIMAGE_RTC_INIT          "clock_cmos.cmosimage.rtc_init"
@@ -178,6 +191,10 @@
 #define BXPN_SOUND_ES1370                "sound.es1370"
 #define BXPN_ES1370_WAVEDEV              "sound.es1370.wavedev"
 #define BXPN_PORT_E9_HACK                "misc.port_e9_hack"
+#define BXPN_SAVE_RESTORE                "misc.save_restore"
+#define BXPN_SR_FORMAT                   "misc.save_restore.format"
+#define BXPN_SR_THREADS                  "misc.save_restore.threads"
+#define BXPN_SR_SNAPSHOT_PORT            "misc.save_restore.snapshot_port"
 #define BXPN_GDBSTUB                     "misc.gdbstub"
 #define BXPN_LOG_FILENAME                "log.filename"
 #define BXPN_LOG_PREFIX                  "log.prefix"
@@ -21,6 +21,7 @@
 /////////////////////////////////////////////////////////////////////////
 
 #include "bochs.h"
+#include "param_names.h"
 #include "cpu/cpu.h"
 #include "iodev/iodev.h"
 #define LOG_THIS bx_pc_system.
@@ -41,6 +42,8 @@ double     m_ips; // Millions of Instructions Per Second
 
 #define SpewPeriodicTimerInfo 0
 #define MinAllowableTimerPeriod 1
+// longest host sleep of an idle skip, keeps the simulation responsive
+#define MaxIdleSleepUsec 20000
 
 const Bit64u bx_pc_system_c::NullTimerInterval = 0xffffffff;
 
@@ -62,6 +65,20 @@ bx_pc_system_c::bx_pc_system_c()
   timer[0].funct      = nullTimer;
   timer[0].this_ptr   = this;
   numTimers = 1; // So far, only the nullTimer.
+
+  for (unsigned i=1; i < BX_MAX_TIMERS; i++)
+    timer[i].heapPos = BX_NULL_TIMER_HANDLE;
+  timer[0].heapPos = 0;
+  timerHeap[0] = 0;
+  heapSize = 1;
+
+#if BX_SUPPORT_SMP
+  smp_threaded = 0;
+  smp_in_round = 0;
+  smp_stop_round = 0;
+  smp_reset_pending = 0;
+  smp_reset_type = BX_RESET_HARDWARE;
+#endif
 }
 
 void bx_pc_system_c::initialize(Bit32u ips)
@@ -75,10 +92,22 @@ void bx_pc_system_c::initialize(Bit32u ips)
   triggeredTimer = 0;
   HRQ = 0;
   kill_bochs_request = 0;
+  snapshot_request = 0;
+#if BX_HAVE_THREADS
+  for (unsigned i=0; i < (BX_MAX_TIMERS + 31) / 32; i++)
+    timer_signals[i] = 0;
+  timer_signal_pending = 0;
+#endif
 
   // parameter 'ips' is the processor speed in Instructions-Per-Second
   m_ips = double(ips) / 1000000.0L;
 
+  idleSkip = SIM->get_param_bool(BXPN_CLOCK_IDLE_SKIP)->get();
+  unsigned clock_sync = SIM->get_param_enum(BXPN_CLOCK_SYNC)->get();
+  idleSleep = (clock_sync == BX_CLOCK_SYNC_REALTIME) || (clock_sync == BX_CLOCK_SYNC_BOTH);
+  idleSkips = 0;
+  idleTicks = 0;
+
   BX_DEBUG(("ips = %u", (unsigned) ips));
 }
 
@@ -180,18 +209,116 @@ bx_bool bx_pc_system_c::get_enable_a20(void)
 
 void bx_pc_system_c::MemoryMappingChanged(void)
 {
+#if BX_SUPPORT_SMP
+  if (smp_in_round) {
+    // the TLB of a processor running on its own host thread can only be
+    // flushed by the processor itself
+    for (unsigned i=0; i<BX_SMP_PROCESSORS; i++)
+      BX_CPU(i)->request_smp_flush(BX_SMP_FLUSH_TLB);
+    return;
+  }
+#endif
+
   for (unsigned i=0; i<BX_SMP_PROCESSORS; i++)
     BX_CPU(i)->TLB_flush();
 }
 
 void bx_pc_system_c::invlpg(bx_address addr)
 {
+#if BX_SUPPORT_SMP
+  if (smp_in_round) {
+    // no way to queue single pages, flush whole TLB instead
+    for (unsigned i=0; i<BX_SMP_PROCESSORS; i++)
+      BX_CPU(i)->request_smp_flush(BX_SMP_FLUSH_TLB);
+    return;
+  }
+#endif
+
   for (unsigned i=0; i<BX_SMP_PROCESSORS; i++)
     BX_CPU(i)->TLB_invlpg(addr);
 }
 
+#if BX_SUPPORT_SMP
+void bx_pc_system_c::init_smp_threads(void)
+{
+  BX_INIT_RECURSIVE_MUTEX(devices_mutex);
+  BX_INIT_MUTEX(bus_mutex);
+  smp_threaded = 1;
+}
+
+void bx_pc_system_c::stop_smp_round(void)
+{
+  smp_stop_round = 1;
+  for (unsigned i=0; i<BX_SMP_PROCESSORS; i++)
+    bx_atomic_or32(&BX_CPU(i)->async_event, BX_ASYNC_EVENT_STOP_TRACE);
+}
+#endif
+
+void bx_pc_system_c::request_snapshot(unsigned what)
+{
+  snapshot_request = what;
+#if BX_SUPPORT_SMP
+  if (smp_in_round) stop_smp_round();
+#endif
+  for (unsigned i=0; i<BX_SMP_PROCESSORS; i++) {
+#if BX_SUPPORT_SMP
+    bx_atomic_or32(&BX_CPU(i)->async_event, 1);
+#else
+    BX_CPU(i)->async_event |= 1;
+#endif
+  }
+}
+
+#if BX_HAVE_THREADS
+void bx_pc_system_c::signal_timer(unsigned i)
+{
+  bx_atomic_or32(&timer_signals[i / 32], 1 << (i & 31));
+  bx_atomic_or32(&timer_signal_pending, 1);
+  bx_atomic_or32(&BX_CPU(0)->async_event, 1);
+}
+
+// Called by the simulation thread only
+void bx_pc_system_c::handle_timer_signals(void)
+{
+  bx_atomic_and32(&timer_signal_pending, 0);
+  for (unsigned n=0; n < (BX_MAX_TIMERS + 31) / 32; n++) {
+    Bit32u signals = bx_atomic_and32(&timer_signals[n], 0);
+    for (unsigned i = n*32; signals != 0; i++, signals >>= 1) {
+      if (signals & 1)
+        activate_timer_ticks(i, 1, 0);
+    }
+  }
+}
+#endif
+
+// Must be called with all processors outside of the cpu loop
+bx_bool bx_pc_system_c::handle_snapshot_request(void)
+{
+  unsigned what = snapshot_request;
+
+  if (what == 0) return 0;
+  snapshot_request = 0;
+  if (what == BX_SNAPSHOT_TAKE)
+    SIM->snapshot_take();
+  else
+    SIM->snapshot_restore();
+  return 1;
+}
+
 int bx_pc_system_c::Reset(unsigned type)
 {
+#if BX_SUPPORT_SMP
+  if (smp_in_round) {
+    // processors are running on their own host threads, reset the system
+    // when all of them have stopped
+    if (! smp_reset_pending || type == BX_RESET_HARDWARE)
+      smp_reset_type = type;
+    smp_reset_pending = 1;
+    stop_smp_round();
+    return(0);
+  }
+#endif
+
   // type is BX_RESET_HARDWARE or BX_RESET_SOFTWARE
   BX_INFO(("bx_pc_system_c::Reset(%s) called",type==BX_RESET_HARDWARE?"HARDWARE":"SOFTWARE"));
 
@@ -217,8 +344,19 @@ Bit8u bx_pc_system_c::IAC(void)
 
 void bx_pc_system_c::exit(void)
 {
+  for (unsigned i=0; i < numTimers; i++) {
+    if (timer[i].inUse && timer[i].fires) {
+      BX_INFO(("timer %2u '%s': fired " FMT_LL "u times, " FMT_LL "u usec in callback",
+               i, timer[i].id, timer[i].fires, timer[i].costUsec));
+    }
+  }
+  if (idleSkips > 0) {
+    BX_INFO(("idle skip: " FMT_LL "u times, " FMT_LL "u ticks", idleSkips, idleTicks));
+  }
+
   // delete all registered timers (exception: null timer and APIC timer)
   numTimers = 1 + BX_SUPPORT_APIC;
+  rebuildTimerHeap();
   bx_devices.exit();
   if (bx_gui) {
     bx_gui->cleanup();
@@ -248,7 +386,110 @@ void bx_pc_system_c::register_state(void)
     BXRS_DEC_PARAM_FIELD(bxtimer, timeToFire, timer[i].timeToFire);
     BXRS_PARAM_BOOL(bxtimer, active, timer[i].active);
     BXRS_PARAM_BOOL(bxtimer, continuous, timer[i].continuous);
+#if BX_DEBUGGER
+    // host side counters, logged at exit
+    BXRS_DEC_PARAM_FIELD(bxtimer, fires, timer[i].fires);
+    BXRS_DEC_PARAM_FIELD(bxtimer, cost_usec, timer[i].costUsec);
+#endif
+  }
+}
+
+void bx_pc_system_c::after_restore_state(void)
+{
+  // the active flags and deadlines were written behind our back
+  rebuildTimerHeap();
+}
+
+// ===============================================
+// Min-heap of active timers, keyed by timeToFire
+// ===============================================
+
+void bx_pc_system_c::heapSiftUp(unsigned pos)
+{
+  unsigned i = timerHeap[pos];
+  Bit64u key = timer[i].timeToFire;
+
+  while (pos > 0) {
+    unsigned parent = (pos - 1) >> 1;
+    if (timer[timerHeap[parent]].timeToFire <= key) break;
+    timerHeap[pos] = timerHeap[parent];
+    timer[timerHeap[pos]].heapPos = pos;
+    pos = parent;
+  }
+
+  timerHeap[pos] = i;
+  timer[i].heapPos = pos;
+}
+
+void bx_pc_system_c::heapSiftDown(unsigned pos)
+{
+  unsigned i = timerHeap[pos];
+  Bit64u key = timer[i].timeToFire;
+
+  for (;;) {
+    unsigned child = 2*pos + 1;
+    if (child >= heapSize) break;
+    if (child + 1 < heapSize &&
+        timer[timerHeap[child+1]].timeToFire < timer[timerHeap[child]].timeToFire)
+      child++;
+    if (key <= timer[timerHeap[child]].timeToFire) break;
+    timerHeap[pos] = timerHeap[child];
+    timer[timerHeap[pos]].heapPos = pos;
+    pos = child;
+  }
+
+  timerHeap[pos] = i;
+  timer[i].heapPos = pos;
+}
+
+// Insert timer into the heap, or move it after its timeToFire has changed.
+void bx_pc_system_c::queueTimer(unsigned i)
+{
+  unsigned pos = timer[i].heapPos;
+
+  if (pos == BX_NULL_TIMER_HANDLE) {
+    pos = heapSize++;
+    timerHeap[pos] = i;
+    heapSiftUp(pos);
+  }
+  else {
+    heapSiftUp(pos);
+    heapSiftDown(timer[i].heapPos);
+  }
+}
+
+void bx_pc_system_c::dequeueTimer(unsigned i)
+{
+  unsigned pos = timer[i].heapPos;
+  if (pos == BX_NULL_TIMER_HANDLE) return;
+
+  timer[i].heapPos = BX_NULL_TIMER_HANDLE;
+  if (pos == --heapSize) return;
+
+  // fill the hole with the last element and restore heap order
+  timerHeap[pos] = timerHeap[heapSize];
+  timer[timerHeap[pos]].heapPos = pos;
+  heapSiftUp(pos);
+  heapSiftDown(timer[timerHeap[pos]].heapPos);
+}
+
+void bx_pc_system_c::rebuildTimerHeap(void)
+{
+  unsigned i;
+
+  for (i=0; i < BX_MAX_TIMERS; i++)
+    timer[i].heapPos = BX_NULL_TIMER_HANDLE;
+
+  heapSize = 0;
+  for (i=0; i < numTimers; i++) {
+    if (timer[i].inUse && timer[i].active) {
+      timer[i].heapPos = heapSize;
+      timerHeap[heapSize++] = i;
+    }
   }
+
+  for (i = heapSize/2; i-- > 0; )
+    heapSiftDown(i);
 }
 
 // ================================================
@@ -277,6 +518,8 @@ int bx_pc_system_c::register_timer_ticks(void* this_ptr, bx_timer_handler_t func
     ticks = MinAllowableTimerPeriod;
   }
 
+  BX_LOCK_DEVICES();
+
   // search for new timer for i=1, i=0 is reserved for NullTimer
   for (i=1; i < numTimers; i++) {
     if (timer[i].inUse == 0)
@@ -301,10 +544,13 @@ int bx_pc_system_c::register_timer_ticks(void* this_ptr, bx_timer_handler_t func
   timer[i].continuous = continuous;
   timer[i].funct      = funct;
   timer[i].this_ptr   = this_ptr;
+  timer[i].fires      = 0;
+  timer[i].costUsec   = 0;
   strncpy(timer[i].id, id, BxMaxTimerIDLen);
   timer[i].id[BxMaxTimerIDLen-1] = 0; // Null terminate if not already.
 
   if (active) {
+    queueTimer(i);
     if (ticks < Bit64u(currCountdown)) {
       // This new timer needs to fire before the current countdown.
       // Skew the current countdown and countdown period to be smaller
@@ -319,15 +565,16 @@ int bx_pc_system_c::register_timer_ticks(void* this_ptr, bx_timer_handler_t func
   if (i==numTimers)
     numTimers++; // One new timer installed.
 
+  BX_UNLOCK_DEVICES();
+
   // Return timer id.
   return(i);
 }
 
 void bx_pc_system_c::countdownEvent(void)
 {
-  unsigned i;
-  Bit64u   minTimeToFire;
-  bx_bool  triggered[BX_MAX_TIMERS];
+  unsigned i, n, numTriggered = 0;
+  unsigned triggered[BX_MAX_TIMERS];
 
   // The countdown decremented to 0.  We need to service all the active
   // timers, and invoke callbacks from those timers which have fired.
@@ -336,39 +583,40 @@ void bx_pc_system_c::countdownEvent(void)
     BX_PANIC(("countdownEvent: ticks!=0"));
 #endif
 
+#if BX_HAVE_THREADS
+  // catch signals whose wakeup of the processor got lost
+  if (timer_signal_pending)
+    handle_timer_signals();
+#endif
+
   // Increment global ticks counter by number of ticks which have
   // elapsed since the last update.
   ticksTotal += Bit64u(currCountdownPeriod);
-  minTimeToFire = (Bit64u) -1;
 
-  for (i=0; i < numTimers; i++) {
-    triggered[i] = 0; // Reset triggered flag.
-    if (timer[i].active) {
+  // Only the timers at the top of the heap can be ready to fire.  The
+  // null timer is always active, so the heap is never empty.
+  while (timer[timerHeap[0]].timeToFire <= ticksTotal) {
+    i = timerHeap[0];
 #if BX_TIMER_DEBUG
-      if (ticksTotal > timer[i].timeToFire)
-        BX_PANIC(("countdownEvent: ticksTotal > timeToFire[%u], D " FMT_LL "u", i,
-                  timer[i].timeToFire-ticksTotal));
+    if (ticksTotal > timer[i].timeToFire)
+      BX_PANIC(("countdownEvent: ticksTotal > timeToFire[%u], D " FMT_LL "u", i,
+                ticksTotal-timer[i].timeToFire));
 #endif
-      if (ticksTotal == timer[i].timeToFire) {
-        // This timer is ready to fire.
-        triggered[i] = 1;
-
-        if (timer[i].continuous==0) {
-          // If triggered timer is one-shot, deactive.
-          timer[i].active = 0;
-        }
-        else {
-          // Continuous timer, increment time-to-fire by period.
-          timer[i].timeToFire += timer[i].period;
-          if (timer[i].timeToFire < minTimeToFire)
-            minTimeToFire = timer[i].timeToFire;
-        }
-      }
-      else {
-        // This timer is not ready to fire yet.
-        if (timer[i].timeToFire < minTimeToFire)
-          minTimeToFire = timer[i].timeToFire;
-      }
+    // This timer is ready to fire.  Keep the list sorted by timer index
+    // so the callbacks run in the same order as registered.
+    for (n = numTriggered++; n > 0 && triggered[n-1] > i; n--)
+      triggered[n] = triggered[n-1];
+    triggered[n] = i;
+
+    if (timer[i].continuous==0) {
+      // If triggered timer is one-shot, deactive.
+      timer[i].active = 0;
+      dequeueTimer(i);
+    }
+    else {
+      // Continuous timer, increment time-to-fire by period.
+      timer[i].timeToFire += timer[i].period;
+      heapSiftDown(0);
     }
   }
 
@@ -376,16 +624,22 @@ void bx_pc_system_c::countdownEvent(void)
   // any of the callbacks, as they may call timer features, which need
   // to be advanced to the next countdown cycle.
   currCountdown = currCountdownPeriod =
-      Bit32u(minTimeToFire - ticksTotal);
+      Bit32u(timer[timerHeap[0]].timeToFire - ticksTotal);
 
-  for (i=0; i < numTimers; i++) {
+  for (n=0; n < numTriggered; n++) {
     // Call requested timer function.  It may request a different
     // timer period or deactivate etc.
-    if (triggered[i]) {
-      triggeredTimer = i;
-      timer[i].funct(timer[i].this_ptr);
-      triggeredTimer = 0;
-    }
+    i = triggered[n];
+    triggeredTimer = i;
+#if BX_HAVE_REALTIME_USEC
+    Bit64u start = bx_get_realtime64_usec();
+#endif
+    timer[i].funct(timer[i].this_ptr);
+#if BX_HAVE_REALTIME_USEC
+    timer[i].costUsec += bx_get_realtime64_usec() - start;
+#endif
+    timer[i].fires++;
+    triggeredTimer = 0;
   }
 }
 
@@ -459,6 +713,44 @@ Bit64u bx_pc_system_c::time_usec()
   return (Bit64u) (((double)(Bit64s)time_ticks()) / m_ips);
 }
 
+// Called when all processors are halted: nothing can happen before the
+// next timer fires, so the time jumps to its deadline. With realtime
+// synchronization the host sleeps for the skipped time instead, so the
+// emulated time does not run ahead of the host clock. Returns 0 if the
+// caller has to pass the time itself.
+bx_bool bx_pc_system_c::skip_idle_ticks(void)
+{
+  // a DMA transfer runs while the processor is halted
+  if (!idleSkip || HRQ)
+    return 0;
+#if BX_HAVE_THREADS
+  // a host thread is about to wake up a device
+  if (timer_signal_pending)
+    return 0;
+#endif
+
+  Bit32u ticks = currCountdown;
+  if (idleSleep) {
+    Bit64u usec = (Bit64u) (double(ticks) / m_ips);
+    if (usec > MaxIdleSleepUsec) {
+      usec = MaxIdleSleepUsec;
+      ticks = (Bit32u) (double(usec) * m_ips);
+      if (ticks == 0) ticks = 1;
+    }
+    if (usec > 0) {
+#if BX_HAVE_USLEEP
+      usleep((Bit32u) usec);
+#elif BX_HAVE_MSLEEP
+      msleep((Bit32u) usec / 1000);
+#endif
+    }
+  }
+  idleSkips++;
+  idleTicks += ticks;
+  tickn(ticks);
+  return 1;
+}
+
 void bx_pc_system_c::start_timers(void) { }
 
 void bx_pc_system_c::activate_timer_ticks(unsigned i, Bit64u ticks, bx_bool continuous)
@@ -481,10 +773,13 @@ void bx_pc_system_c::activate_timer_ticks(unsigned i, Bit64u ticks, bx_bool cont
     ticks = MinAllowableTimerPeriod;
   }
 
+  BX_LOCK_DEVICES();
+
   timer[i].period = ticks;
   timer[i].timeToFire = (ticksTotal + Bit64u(currCountdownPeriod-currCountdown)) + ticks;
   timer[i].active     = 1;
   timer[i].continuous = continuous;
+  queueTimer(i);
 
   if (ticks < Bit64u(currCountdown)) {
     // This new timer needs to fire before the current countdown.
@@ -493,6 +788,8 @@ void bx_pc_system_c::activate_timer_ticks(unsigned i, Bit64u ticks, bx_bool cont
     currCountdownPeriod -= (currCountdown - Bit32u(ticks));
     currCountdown = Bit32u(ticks);
   }
+
+  BX_UNLOCK_DEVICES();
 }
 
 void bx_pc_system_c::activate_timer(unsigned i, Bit32u useconds, bx_bool continuous)
@@ -538,7 +835,10 @@ void bx_pc_system_c::deactivate_timer(unsigned i)
     BX_PANIC(("deactivate_timer: timer 0 is the nullTimer!"));
 #endif
 
+  BX_LOCK_DEVICES();
   timer[i].active = 0;
+  dequeueTimer(i);
+  BX_UNLOCK_DEVICES();
 }
 
 bx_bool bx_pc_system_c::unregisterTimer(unsigned timerIndex)
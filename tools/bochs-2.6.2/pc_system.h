@@ -23,9 +23,17 @@
 #ifndef BX_PCSYS_H
 #define BX_PCSYS_H
 
+#if BX_HAVE_THREADS
+#include "bxthread.h"
+#endif
+
 #define BX_MAX_TIMERS 64
 #define BX_NULL_TIMER_HANDLE 10000
 
+// in-memory snapshot requests
+#define BX_SNAPSHOT_TAKE    1
+#define BX_SNAPSHOT_RESTORE 2
+
 typedef void (*bx_timer_handler_t)(void *);
 
 BOCHSAPI extern class bx_pc_system_c bx_pc_system;
@@ -53,8 +61,17 @@ private:
                                //   has to be stored as well.
 #define BxMaxTimerIDLen 32
     char id[BxMaxTimerIDLen]; // String ID of timer.
+    unsigned heapPos;   // Index in timerHeap[], BX_NULL_TIMER_HANDLE if inactive.
+    Bit64u  fires;      // Number of times the callback was invoked.
+    Bit64u  costUsec;   // Host time spent in the callback (in usec).
   } timer[BX_MAX_TIMERS];
 
+  // Active timers are kept in a binary min-heap ordered by timeToFire,
+  // so the next deadline is always timerHeap[0] and (re)arming a timer
+  // costs O(log n) instead of a scan over all registered timers.
+  unsigned   timerHeap[BX_MAX_TIMERS];
+  unsigned   heapSize;   // Number of timers in timerHeap[].
+
   unsigned   numTimers;  // Number of currently allocated timers.
   unsigned   triggeredTimer;  // ID of the actually triggered timer.
   Bit32u     currCountdown; // Current countdown ticks value (decrements to 0).
@@ -63,6 +80,13 @@ private:
   Bit64u     lastTimeUsec; // Last sequentially read time in usec.
   Bit64u     usecSinceLast; // Number of useconds claimed since then.
 
+  // Idle skip: while all processors are halted, the time jumps to the
+  // next timer deadline (or the host sleeps until it with realtime sync).
+  bx_bool    idleSkip;
+  bx_bool    idleSleep;
+  Bit64u     idleSkips;  // Number of jumps to a timer deadline.
+  Bit64u     idleTicks;  // Ticks passed by the jumps.
+
   // A special null timer is always inserted in the timer[0] slot.  This
   // make sure that at least one timer is always active, and that the
   // duration is always less than a maximum 32-bit integer, so a 32-bit
@@ -81,6 +105,13 @@ private:
   // ticks finds that an event has occurred.
   void   countdownEvent(void);
 
+  // Timer heap maintenance
+  void   heapSiftUp(unsigned pos);
+  void   heapSiftDown(unsigned pos);
+  void   queueTimer(unsigned i);
+  void   dequeueTimer(unsigned i);
+  void   rebuildTimerHeap(void);
+
 public:
 
   // ==============================
@@ -120,6 +151,7 @@ public:
                             bx_bool continuous);
   Bit64u time_usec();
   Bit64u time_usec_sequential();
+  bx_bool skip_idle_ticks(void);
   static BX_CPP_INLINE Bit64u time_ticks() {
     return bx_pc_system.ticksTotal +
       Bit64u(bx_pc_system.currCountdownPeriod - bx_pc_system.currCountdown);
@@ -156,6 +188,24 @@ public:
 
   volatile bx_bool kill_bochs_request;
 
+  // In-memory snapshot requested by the guest. The processors leave the
+  // cpu loop at the next instruction boundary and the simulation loop
+  // carries out the request.
+  volatile unsigned snapshot_request;
+  void request_snapshot(unsigned what);
+  bx_bool handle_snapshot_request(void);
+
+#if BX_HAVE_THREADS
+  // One-shot timers fired on behalf of host threads outside of the
+  // simulation, like the disk image I/O threads. signal_timer() could be
+  // called from any thread, the timer fires at the next instruction
+  // boundary of the bootstrap processor or at the next timer event.
+  volatile Bit32u timer_signals[(BX_MAX_TIMERS + 31) / 32];
+  volatile Bit32u timer_signal_pending;
+  void signal_timer(unsigned timer_index);
+  void handle_timer_signals(void);
+#endif
+
   void set_HRQ(bx_bool val);  // set the Hold ReQuest line
 
   void raise_INTR(void);
@@ -175,6 +225,40 @@ public:
   void    invlpg(bx_address addr);    // flush TLB page in all CPUs
   void    exit(void);
   void    register_state(void);
+  void    after_restore_state(void);
+
+#if BX_SUPPORT_SMP
+  // ===========================================================
+  // Threaded SMP: every processor is simulated by its own host
+  // thread. The processor threads run in rounds of fixed length,
+  // timers are only advanced between the rounds.
+  // ===========================================================
+
+  bx_bool smp_threaded;            // processors run on host threads
+  volatile bx_bool smp_in_round;   // processor threads are running now
+  volatile bx_bool smp_stop_round; // end current round as soon as possible
+  volatile bx_bool smp_reset_pending; // Reset() deferred till end of round
+  unsigned smp_reset_type;
+
+  // serializes devices, timers and local APIC state between threads
+  BX_MUTEX(devices_mutex);
+  // serializes locked read-modify-write memory accesses
+  BX_MUTEX(bus_mutex);
+
+  void init_smp_threads(void);
+  void stop_smp_round(void);
+#endif
+
+  BX_CPP_INLINE void lock_devices(void) {
+#if BX_SUPPORT_SMP
+    if (smp_threaded) BX_LOCK(devices_mutex);
+#endif
+  }
+  BX_CPP_INLINE void unlock_devices(void) {
+#if BX_SUPPORT_SMP
+    if (smp_threaded) BX_UNLOCK(devices_mutex);
+#endif
+  }
 };
 
 #endif